@@ -2,6 +2,7 @@
 
 #include <asio.hpp>
 #include <algorithm>
+#include <cmath>
 #include <optional>
 #include <fstream>
 #include <iterator>
@@ -22,8 +23,13 @@
     #include <eigen3/Eigen/SVD>
     #include <eigen3/Eigen/QR>
     #include <eigen3/Eigen/Cholesky>
+    #include <eigen3/Eigen/Geometry>
 #endif
 
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
 #include "Structs.h"
 #include "Thread_Pool.h"
 
@@ -344,22 +350,17 @@ AlignViaExhaustiveICP( const point_set<double> & moving,
         // transformation. Note that multiple working points may correspond to the same stationary point.
         const auto N_working_points = working.points.size();
         if(N_working_points != corresp.points.size()) throw std::logic_error("Encountered inconsistent working buffers. Cannot continue.");
-        {
-            asio_thread_pool tp;
-            for(size_t i = 0; i < N_working_points; ++i){
-                tp.submit_task([&,i]() -> void {
-                    const auto w_p = working.points[i];
-                    double min_sq_dist = std::numeric_limits<double>::infinity();
-                    for(const auto &s_p : stationary.points){
-                        const auto sq_dist = w_p.sq_dist(s_p);
-                        if(sq_dist < min_sq_dist){
-                            min_sq_dist = sq_dist;
-                            corresp.points[i] = s_p;
-                        }
-                    }
-                }); // thread pool task closure.
+        parallel_for(0, N_working_points, [&](size_t i) -> void {
+            const auto w_p = working.points[i];
+            double min_sq_dist = std::numeric_limits<double>::infinity();
+            for(const auto &s_p : stationary.points){
+                const auto sq_dist = w_p.sq_dist(s_p);
+                if(sq_dist < min_sq_dist){
+                    min_sq_dist = sq_dist;
+                    corresp.points[i] = s_p;
+                }
             }
-        } // Wait until all threads are done.
+        }); // Chunked; waits until all chunks are done.
 
 
         ///////////////////////////////////
@@ -504,3 +505,245 @@ AlignViaExhaustiveICP( const point_set<double> & moving,
 #endif // DCMA_USE_EIGEN
 
 
+#ifdef DCMA_USE_EIGEN
+// Spatial index over stationary points, used for nearest-neighbour queries.
+using icp_rtree_point_t = boost::geometry::model::point<double, 3, boost::geometry::cs::cartesian>;
+using icp_rtree_value_t = std::pair<icp_rtree_point_t, long int>;
+using icp_rtree_t = boost::geometry::index::rtree<icp_rtree_value_t, boost::geometry::index::rstar<16>>;
+
+// This routine performs an iterative closest point (ICP) alignment using a spatial index.
+//
+// Note that this routine only identifies a suitable transform, it does not implement it by altering the inputs.
+//
+std::optional<affine_transform<double>>
+AlignViaIndexedICP( AlignViaIndexedICPParams & params,
+                    const point_set<double> & moving,
+                    const point_set<double> & stationary ){
+    const auto N_move_points = static_cast<long int>(moving.points.size());
+    const auto N_stat_points = static_cast<long int>(stationary.points.size());
+    if( (N_move_points == 0)
+    ||  (N_stat_points == 0) ){
+        throw std::invalid_argument("Both point clouds must contain points. Cannot continue.");
+    }
+    const bool point_to_plane = (params.metric == AlignViaIndexedICPParams::Metric::PointToPlane);
+    if( point_to_plane
+    &&  (N_stat_points < 3) ){
+        throw std::invalid_argument("Point-to-plane ICP requires at least three stationary points. Cannot continue.");
+    }
+
+    // Build the spatial index once using the bulk-loading (packing) algorithm.
+    const auto to_rtree_point = [](const vec3<double> &v) -> icp_rtree_point_t {
+        return icp_rtree_point_t(v.x, v.y, v.z);
+    };
+    std::vector<icp_rtree_value_t> rtree_values;
+    rtree_values.reserve(N_stat_points);
+    for(long int j = 0; j < N_stat_points; ++j){
+        rtree_values.emplace_back( to_rtree_point(stationary.points[j]), j );
+    }
+    const icp_rtree_t rtree(std::begin(rtree_values), std::end(rtree_values));
+
+    // Estimate stationary surface normals from the nearest neighbours via PCA. The normal is the direction of least
+    // variance. The sign is irrelevant for point-to-plane distances.
+    std::vector<vec3<double>> normals;
+    if(point_to_plane){
+        const auto N_neighbours = std::clamp<long int>(params.N_normal_neighbours, 3L, N_stat_points);
+        normals.resize(N_stat_points);
+        parallel_for(0, N_stat_points, [&](size_t j) -> void {
+            std::vector<icp_rtree_value_t> nearest;
+            nearest.reserve(N_neighbours);
+            rtree.query( boost::geometry::index::nearest(to_rtree_point(stationary.points[j]), N_neighbours),
+                         std::back_inserter(nearest) );
+
+            Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+            for(const auto &n : nearest){
+                const auto &q = stationary.points[n.second];
+                centroid += Eigen::Vector3d(q.x, q.y, q.z);
+            }
+            centroid /= static_cast<double>(nearest.size());
+
+            Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+            for(const auto &n : nearest){
+                const auto &q = stationary.points[n.second];
+                const Eigen::Vector3d d = Eigen::Vector3d(q.x, q.y, q.z) - centroid;
+                cov += d * d.transpose();
+            }
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(cov);
+            const Eigen::Vector3d n = eig.eigenvectors().col(0); // Eigenvalues are sorted in increasing order.
+            normals[j] = vec3<double>( n(0), n(1), n(2) ).unit();
+        });
+    }
+
+    // Sums per-point contributions in fixed-size blocks (in parallel), then combines the blocks in order so the result
+    // does not depend on the number of threads.
+    const long int block_size = 4096;
+    const long int N_blocks = (N_move_points + block_size - 1) / block_size;
+    const auto ordered_sum = [&](const auto &zero, const auto &f){
+        std::vector<std::decay_t<decltype(zero)>> partial(N_blocks, zero);
+        parallel_for(0, N_blocks, [&](size_t k) -> void {
+            const auto end = std::min<long int>(N_move_points, (k + 1) * block_size);
+            for(long int i = k * block_size; i < end; ++i){
+                partial[k] += f(i);
+            }
+        });
+        auto out = zero;
+        for(const auto &p : partial) out += p;
+        return out;
+    };
+
+    // The WIP transformation, $A * P_{M} + b$.
+    //
+    // Prime the transformation using a simplistic alignment. See the exhaustive ICP routine for discussion.
+    Eigen::Matrix3d A;
+    Eigen::Vector3d b;
+    {
+        auto t_init = AlignViaPCA(moving, stationary).value();
+        for(long int r = 0; r < 3; ++r){
+            for(long int c = 0; c < 3; ++c){
+                A(r, c) = t_init.coeff(c, r);
+            }
+            b(r) = t_init.coeff(3, r);
+        }
+    }
+    const auto to_affine = [](const Eigen::Matrix3d &l_A, const Eigen::Vector3d &l_b) -> affine_transform<double> {
+        affine_transform<double> t;
+        for(long int r = 0; r < 3; ++r){
+            for(long int c = 0; c < 3; ++c){
+                t.coeff(c, r) = l_A(r, c);
+            }
+            t.coeff(3, r) = l_b(r);
+        }
+        return t;
+    };
+
+    // The transformation that resulted in the lowest cost estimate so far.
+    affine_transform<double> t_best = to_affine(A, b);
+    double f_best = std::numeric_limits<double>::infinity();
+
+    std::vector<vec3<double>> working(N_move_points);
+    std::vector<long int> corresp(N_move_points, 0);
+
+    params.N_iterations = 0;
+    double f_prev = std::numeric_limits<double>::quiet_NaN();
+    for(long int icp_iter = 0; icp_iter < params.max_icp_iters; ++icp_iter){
+        ++params.N_iterations;
+
+        // Apply the current transformation and query the nearest stationary point for each moving point.
+        // Note that multiple working points may correspond to the same stationary point.
+        parallel_for(0, N_move_points, [&](size_t i) -> void {
+            const auto &m = moving.points[i];
+            const Eigen::Vector3d w = A * Eigen::Vector3d(m.x, m.y, m.z) + b;
+            working[i] = vec3<double>( w(0), w(1), w(2) );
+
+            std::vector<icp_rtree_value_t> nearest;
+            rtree.query( boost::geometry::index::nearest(to_rtree_point(working[i]), 1),
+                         std::back_inserter(nearest) );
+            corresp[i] = nearest.front().second;
+        });
+
+        // Centroids of the working points and their correspondences.
+        const Eigen::Matrix<double, 3, 2> zero_32 = Eigen::Matrix<double, 3, 2>::Zero();
+        const Eigen::Matrix<double, 3, 2> centroids = ordered_sum(zero_32, [&](long int i) -> Eigen::Matrix<double, 3, 2> {
+            const auto &w = working[i];
+            const auto &q = stationary.points[corresp[i]];
+            Eigen::Matrix<double, 3, 2> out;
+            out << w.x, q.x,
+                   w.y, q.y,
+                   w.z, q.z;
+            return out;
+        }) / static_cast<double>(N_move_points);
+        const Eigen::Vector3d centroid_w = centroids.col(0);
+        const Eigen::Vector3d centroid_c = centroids.col(1);
+
+        // Solve for the incremental rigid transformation $R * (P_{W} - centroid_{W}) + centroid_{W} + d$.
+        Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+        Eigen::Vector3d d = Eigen::Vector3d::Zero();
+        if(point_to_plane){
+            // Linearize the rotation (i.e., $R \approx I + [\omega]_{\times}$) and solve the resulting 6x6 linear
+            // least-squares problem for the rotation vector $\omega$ and translation $d$. Coordinates are taken
+            // relative to the working centroid to improve conditioning.
+            const Eigen::Matrix<double, 6, 7> zero_67 = Eigen::Matrix<double, 6, 7>::Zero();
+            const Eigen::Matrix<double, 6, 7> JTJr = ordered_sum(zero_67, [&](long int i) -> Eigen::Matrix<double, 6, 7> {
+                const auto &w = working[i];
+                const auto &q = stationary.points[corresp[i]];
+                const auto &n = normals[corresp[i]];
+                const Eigen::Vector3d p( w.x - centroid_w(0), w.y - centroid_w(1), w.z - centroid_w(2) );
+                const Eigen::Vector3d e_n( n.x, n.y, n.z );
+                Eigen::Matrix<double, 7, 1> J_r;
+                J_r.head<3>() = p.cross(e_n);
+                J_r.segment<3>(3) = e_n;
+                J_r(6) = (w - q).Dot(n);
+                return J_r.head<6>() * J_r.transpose();
+            });
+            const Eigen::Matrix<double, 6, 1> x = JTJr.leftCols<6>().colPivHouseholderQr().solve( -JTJr.col(6) );
+            if(!x.allFinite()){
+                FUNCWARN("Unable to solve for point-to-plane transformation. Terminating early");
+                break;
+            }
+            const Eigen::Vector3d omega = x.head<3>();
+            const auto angle = omega.norm();
+            if(0.0 < angle){
+                R = Eigen::AngleAxisd(angle, omega / angle).toRotationMatrix();
+            }
+            d = x.tail<3>();
+
+        }else{
+            // Closed-form least-squares rigid transformation. (Refer to the 'Kabsch algorithm' for more info.)
+            const Eigen::Matrix3d zero_33 = Eigen::Matrix3d::Zero();
+            const Eigen::Matrix3d H = ordered_sum(zero_33, [&](long int i) -> Eigen::Matrix3d {
+                const auto &w = working[i];
+                const auto &q = stationary.points[corresp[i]];
+                const Eigen::Vector3d p = Eigen::Vector3d(w.x, w.y, w.z) - centroid_w;
+                const Eigen::Vector3d c = Eigen::Vector3d(q.x, q.y, q.z) - centroid_c;
+                return p * c.transpose();
+            });
+            Eigen::JacobiSVD<Eigen::Matrix3d> SVD(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+            const Eigen::Matrix3d U = SVD.matrixU();
+            const Eigen::Matrix3d V = SVD.matrixV();
+
+            // Restrict the solution to rotations only.
+            Eigen::Matrix3d PI = Eigen::Matrix3d::Identity();
+            PI(2, 2) = (V * U.transpose()).determinant();
+            R = V * PI * U.transpose();
+            d = centroid_c - centroid_w;
+        }
+
+        // Compose the incremental transformation with the WIP transformation.
+        b = R * (b - centroid_w) + centroid_w + d;
+        A = R * A;
+        const auto t = to_affine(A, b);
+
+        // Evaluate the cost using the correspondence estimated during this iteration.
+        const double f_curr = ordered_sum(0.0, [&](long int i) -> double {
+            const auto &m = moving.points[i];
+            const Eigen::Vector3d e_w = A * Eigen::Vector3d(m.x, m.y, m.z) + b;
+            const vec3<double> w( e_w(0), e_w(1), e_w(2) );
+            const auto &q = stationary.points[corresp[i]];
+            return point_to_plane ? std::abs( (w - q).Dot(normals[corresp[i]]) )
+                                  : w.distance(q);
+        });
+
+        FUNCINFO("Global distance using correspondence estimated during iteration " << icp_iter << " is " << f_curr);
+
+        if(f_curr < f_best){
+            f_best = f_curr;
+            t_best = t;
+        }
+        if( std::isfinite(params.f_rel_tol)
+        &&  std::isfinite(f_curr)
+        &&  std::isfinite(f_prev) ){
+            const auto f_rel = std::fabs( (f_prev - f_curr) / f_prev );
+            FUNCINFO("The relative change in global distance compared to the last iteration is " << f_rel);
+            if(f_rel < params.f_rel_tol) break;
+        }
+        f_prev = f_curr;
+    }
+
+    // Test if the transformation is valid.
+    vec3<double> v_test(1.0, 1.0, 1.0);
+    t_best.apply_to(v_test);
+    if( !v_test.isfinite() ){
+        return std::nullopt;
+    }
+    return t_best;
+}
+#endif // DCMA_USE_EIGEN
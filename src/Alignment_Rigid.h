@@ -48,3 +48,43 @@ AlignViaExhaustiveICP( const point_set<double> & moving,
 #endif // DCMA_USE_EIGEN
 
 
+#ifdef DCMA_USE_EIGEN
+// This routine performs an iterative closest point (ICP) alignment using a spatial index.
+//
+// A spatial index is built over the stationary points once, and all moving points are queried in parallel each
+// iteration, so each iteration costs O(N log M) rather than O(N M). The result is a rigid transformation. Unlike the
+// exhaustive routine, the transformation is updated incrementally each iteration.
+//
+// Note that this routine only identifies a suitable transform, it does not implement it by altering the inputs.
+//
+struct AlignViaIndexedICPParams {
+    // The quantity minimized at each iteration.
+    //
+    // Point-to-point minimizes the distance between each moving point and its corresponding stationary point.
+    // Point-to-plane minimizes the distance between each moving point and the plane tangent to the stationary cloud at
+    // the corresponding point, which permits sliding along surfaces and generally converges in fewer iterations when
+    // the stationary points sample a surface. Surface normals are estimated from the nearest neighbours.
+    enum class Metric {
+        PointToPoint,
+        PointToPlane
+    };
+    Metric metric = Metric::PointToPlane;
+
+    // The number of nearest stationary points used to estimate each surface normal. Only used for point-to-plane.
+    long int N_normal_neighbours = 10;
+
+    // Termination criteria.
+    long int max_icp_iters = 100;
+    double f_rel_tol = std::numeric_limits<double>::quiet_NaN();
+
+    // The number of iterations that were performed.
+    long int N_iterations = 0;
+};
+
+std::optional<affine_transform<double>>
+AlignViaIndexedICP( AlignViaIndexedICPParams & params,
+                    const point_set<double> & moving,
+                    const point_set<double> & stationary );
+#endif // DCMA_USE_EIGEN
+
+
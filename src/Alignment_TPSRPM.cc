@@ -2,8 +2,12 @@
 
 #include <asio.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <optional>
 #include <fstream>
+#include <iomanip>
 #include <iterator>
 #include <list>
 #include <map>
@@ -16,6 +20,10 @@
 #include <utility>            //Needed for std::pair.
 #include <vector>
 
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
 #ifdef DCMA_USE_EIGEN    
     #include <eigen3/Eigen/Dense>
     #include <eigen3/Eigen/Eigenvalues>
@@ -188,6 +196,153 @@ thin_plate_spline::read_from( std::istream &is ){
     return (!is.fail());
 }
 
+
+thin_plate_spline_field::thin_plate_spline_field(const thin_plate_spline &t,
+                                                 const vec3<double> &bbox_min,
+                                                 const vec3<double> &bbox_max,
+                                                 double tolerance,
+                                                 long int max_nodes) : tps(t) {
+    if( !bbox_min.isfinite()
+    ||  !bbox_max.isfinite() ){
+        throw std::invalid_argument("Displacement field bounding box is invalid. Cannot continue.");
+    }
+    if( !std::isfinite(tolerance)
+    ||  (tolerance <= 0.0) ){
+        throw std::invalid_argument("Displacement field tolerance must be positive. Cannot continue.");
+    }
+
+    const vec3<double> lower( std::min(bbox_min.x, bbox_max.x),
+                              std::min(bbox_min.y, bbox_max.y),
+                              std::min(bbox_min.z, bbox_max.z) );
+    const vec3<double> upper( std::max(bbox_min.x, bbox_max.x),
+                              std::max(bbox_min.y, bbox_max.y),
+                              std::max(bbox_min.z, bbox_max.z) );
+    const auto extent = upper - lower;
+    const auto max_extent = std::max({ extent.x, extent.y, extent.z });
+
+    // Begin with a coarse lattice. Thin-plate splines are smooth, so a coarse lattice often suffices.
+    this->origin = lower;
+    this->spacing = (0.0 < max_extent) ? max_extent / 16.0 : 1.0;
+    const auto nodes_along = [&](double l) -> long int {
+        return 1L + std::max(0L, static_cast<long int>(std::ceil(l / this->spacing - 1.0E-6)));
+    };
+    this->N_x = nodes_along(extent.x);
+    this->N_y = nodes_along(extent.y);
+    this->N_z = nodes_along(extent.z);
+
+    // Halving the spacing (while keeping the origin) maps node (i,j,k) onto node (2i,2j,2k), so nodes from the previous
+    // lattice are re-used rather than re-evaluated.
+    const auto refine = [](long int N) -> long int {
+        return (1 < N) ? 2 * (N - 1) + 1 : N;
+    };
+
+    std::vector<vec3<double>> prev;
+    long int prev_N_x = 0;
+    long int prev_N_y = 0;
+    while(true){
+        const long int N_nodes = this->N_x * this->N_y * this->N_z;
+        this->displacements.assign(N_nodes, vec3<double>(0.0, 0.0, 0.0));
+        parallel_for(0, N_nodes, [&](size_t n) -> void {
+            const long int i = static_cast<long int>(n) % this->N_x;
+            const long int j = (static_cast<long int>(n) / this->N_x) % this->N_y;
+            const long int k = static_cast<long int>(n) / (this->N_x * this->N_y);
+            if( !prev.empty()
+            &&  ((i % 2) == 0) && ((j % 2) == 0) && ((k % 2) == 0) ){
+                this->displacements[n] = prev[((k / 2) * prev_N_y + (j / 2)) * prev_N_x + (i / 2)];
+                return;
+            }
+            const vec3<double> p = this->origin + vec3<double>( static_cast<double>(i) * this->spacing,
+                                                                static_cast<double>(j) * this->spacing,
+                                                                static_cast<double>(k) * this->spacing );
+            this->displacements[n] = this->tps.transform(p) - p;
+        });
+
+        // Estimate the interpolation error at cell centres. Cells are sampled deterministically (via a multiplicative
+        // hash of the sample number) so the estimate is reproducible.
+        const long int C_x = std::max(1L, this->N_x - 1);
+        const long int C_y = std::max(1L, this->N_y - 1);
+        const long int C_z = std::max(1L, this->N_z - 1);
+        const long int N_cells = C_x * C_y * C_z;
+        const long int N_samples = std::min<long int>(N_cells, 4096L);
+        std::vector<double> errors(N_samples, 0.0);
+        parallel_for(0, N_samples, [&](size_t s) -> void {
+            const long int c = (N_samples == N_cells) ? static_cast<long int>(s)
+                             : static_cast<long int>( (static_cast<uint64_t>(s) * 2654435761ULL)
+                                                      % static_cast<uint64_t>(N_cells) );
+            const auto centre = [&](long int i, long int N) -> double {
+                return (static_cast<double>(i) + ((1 < N) ? 0.5 : 0.0)) * this->spacing;
+            };
+            const vec3<double> p = this->origin + vec3<double>( centre(c % C_x, this->N_x),
+                                                                centre((c / C_x) % C_y, this->N_y),
+                                                                centre(c / (C_x * C_y), this->N_z) );
+            errors[s] = this->transform(p).distance( this->tps.transform(p) );
+        });
+        this->estimated_max_error = errors.empty() ? 0.0 : *std::max_element(std::begin(errors), std::end(errors));
+
+        if(this->estimated_max_error <= tolerance) break;
+        if(max_nodes < refine(this->N_x) * refine(this->N_y) * refine(this->N_z)){
+            FUNCWARN("Displacement field node limit reached. Estimated interpolation error (" << this->estimated_max_error
+                     << ") exceeds the tolerance (" << tolerance << ")");
+            break;
+        }
+
+        prev.swap(this->displacements);
+        prev_N_x = this->N_x;
+        prev_N_y = this->N_y;
+        this->N_x = refine(this->N_x);
+        this->N_y = refine(this->N_y);
+        this->N_z = refine(this->N_z);
+        this->spacing *= 0.5;
+    }
+    FUNCINFO("Sampled displacement field on " << this->N_x << "x" << this->N_y << "x" << this->N_z
+             << " lattice with spacing " << this->spacing << " and estimated max error " << this->estimated_max_error);
+}
+
+vec3<double>
+thin_plate_spline_field::transform(const vec3<double> &v) const {
+    const auto r = (v - this->origin) / this->spacing;
+    const auto within = [](double x, long int N) -> bool {
+        return (0.0 <= x) && (x <= static_cast<double>(N - 1));
+    };
+    if( this->displacements.empty()
+    ||  !within(r.x, this->N_x)
+    ||  !within(r.y, this->N_y)
+    ||  !within(r.z, this->N_z) ){
+        return this->tps.transform(v);
+    }
+
+    // Locate the enclosing cell and the fractional position within it. Single-node axes are degenerate.
+    const auto locate = [](double x, long int N, long int &i0, long int &i1, double &f) -> void {
+        i0 = std::clamp<long int>(static_cast<long int>(std::floor(x)), 0L, std::max(0L, N - 2));
+        i1 = (1 < N) ? i0 + 1 : i0;
+        f  = (1 < N) ? x - static_cast<double>(i0) : 0.0;
+    };
+    long int i0, i1, j0, j1, k0, k1;
+    double fx, fy, fz;
+    locate(r.x, this->N_x, i0, i1, fx);
+    locate(r.y, this->N_y, j0, j1, fy);
+    locate(r.z, this->N_z, k0, k1, fz);
+
+    const auto d = [&](long int i, long int j, long int k) -> const vec3<double> & {
+        return this->displacements[(k * this->N_y + j) * this->N_x + i];
+    };
+    const auto d_00 = d(i0,j0,k0) * (1.0 - fx) + d(i1,j0,k0) * fx;
+    const auto d_10 = d(i0,j1,k0) * (1.0 - fx) + d(i1,j1,k0) * fx;
+    const auto d_01 = d(i0,j0,k1) * (1.0 - fx) + d(i1,j0,k1) * fx;
+    const auto d_11 = d(i0,j1,k1) * (1.0 - fx) + d(i1,j1,k1) * fx;
+    const auto d_0 = d_00 * (1.0 - fy) + d_10 * fy;
+    const auto d_1 = d_01 * (1.0 - fy) + d_11 * fy;
+    return v + d_0 * (1.0 - fz) + d_1 * fz;
+}
+
+void
+thin_plate_spline_field::apply_to(point_set<double> &ps) const {
+    parallel_for(0, ps.points.size(), [&](size_t i) -> void {
+        ps.points[i] = this->transform(ps.points[i]);
+    });
+    return;
+}
+
 #ifdef DCMA_USE_EIGEN
 // This routine finds a non-rigid alignment using thin plate splines.
 //
@@ -309,6 +464,22 @@ AlignViaTPS(AlignViaTPSParams & params,
 
 
 #ifdef DCMA_USE_EIGEN
+// Spatial index used for nearest-neighbour queries. Values are (point, index into the point_set) pairs.
+using tps_rtree_point_t = boost::geometry::model::point<double, 3, boost::geometry::cs::cartesian>;
+using tps_rtree_value_t = std::pair<tps_rtree_point_t, long int>;
+using tps_rtree_t = boost::geometry::index::rtree<tps_rtree_value_t, boost::geometry::index::rstar<16>>;
+
+static tps_rtree_t
+build_tps_rtree(const point_set<double> &ps){
+    std::vector<tps_rtree_value_t> values;
+    values.reserve(ps.points.size());
+    for(size_t i = 0; i < ps.points.size(); ++i){
+        const auto &p = ps.points[i];
+        values.emplace_back( tps_rtree_point_t(p.x, p.y, p.z), static_cast<long int>(i) );
+    }
+    return tps_rtree_t(std::begin(values), std::end(values)); // Bulk-loaded, which is faster to build and query.
+}
+
 // This routine finds a non-rigid alignment using the 'robust point matching: thin plate spline' algorithm.
 //
 // Note that this routine only identifies a transform, it does not implement it by altering the inputs.
@@ -321,7 +492,21 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     const auto N_move_points = static_cast<long int>(moving.points.size());
     const auto N_stat_points = static_cast<long int>(stationary.points.size());
 
-    thin_plate_spline t(moving, params.kernel_dimension);
+    if( (params.N_nearest_neighbours < 0)
+    ||  (params.N_control_points < 0) ){
+        throw std::invalid_argument("Scalability parameters are invalid. Cannot continue.");
+    }
+
+    // Whether the correspondence matrix is truncated to the nearest stationary points and stored sparsely.
+    const bool sparse = (0 < params.N_nearest_neighbours) && (params.N_nearest_neighbours < N_stat_points);
+    const long int N_nn = sparse ? params.N_nearest_neighbours : N_stat_points;
+
+    // Whether a subset of the moving points are used as TPS control points.
+    const bool reduced = (0 < params.N_control_points) && (params.N_control_points < N_move_points);
+    if( reduced
+    &&  params.double_sided_outliers ){
+        throw std::invalid_argument("Reduced control points cannot be used with double-sided outlier handling. Cannot continue.");
+    }
 
     // Compute the centroid for the stationary point cloud.
     // Stationary point outliers will be assumed to have this location.
@@ -337,44 +522,63 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     double max_sq_dist = 0.0;
     {
         FUNCINFO("Locating mean nearest-neighbour separation in moving point cloud");
+        const auto rtree_move = build_tps_rtree(moving);
+        std::vector<double> min_sq_dists(N_move_points, std::numeric_limits<double>::infinity());
+        parallel_for(0, N_move_points, [&](size_t i) -> void {
+            const auto &P_i = moving.points[i];
+            std::vector<tps_rtree_value_t> nearest;
+            rtree_move.query( boost::geometry::index::nearest(tps_rtree_point_t(P_i.x, P_i.y, P_i.z), 2),
+                              std::back_inserter(nearest) );
+            for(const auto &v : nearest){
+                if(v.second == static_cast<long int>(i)) continue;
+                const auto sq_dist = P_i.sq_dist( moving.points[v.second] );
+                if(sq_dist < min_sq_dists[i]) min_sq_dists[i] = sq_dist;
+            }
+        });
         Stats::Running_Sum<double> rs;
-        {
-            //asio_thread_pool tp;
-            for(long int i = 0; i < N_move_points; ++i){
-                //tp.submit_task([&,i](void) -> void {
-                double min_sq_dist = std::numeric_limits<double>::infinity();
-                for(long int j = 0; j < N_move_points; ++j){
-                    if(i == j) continue;
-                    const auto sq_dist = (moving.points[i]).sq_dist( moving.points[j] );
-                    if(sq_dist < min_sq_dist) min_sq_dist = sq_dist;
-                }
-                if(!std::isfinite(min_sq_dist)){
-                    throw std::runtime_error("Unable to estimate nearest neighbour distance.");
-                }
-                rs.Digest(min_sq_dist);
-                //}); // thread pool task closure.
+        for(const auto &min_sq_dist : min_sq_dists){
+            if(!std::isfinite(min_sq_dist)){
+                throw std::runtime_error("Unable to estimate nearest neighbour distance.");
             }
+            rs.Digest(min_sq_dist);
         }
         mean_nn_sq_dist = rs.Current_Sum() / static_cast<double>( N_move_points );
 
-        FUNCINFO("Locating max square-distance between all points");
-        {
-            //asio_thread_pool tp;
-            //std::mutex saver_printer;
-            for(long int i = 0; i < (N_move_points + N_stat_points); ++i){
-                //tp.submit_task([&,i](void) -> void {
-                    for(long int j = 0; j < i; ++j){
-                        const auto A = (i < N_move_points) ? moving.points[i] : stationary.points[i - N_move_points];
-                        const auto B = (j < N_move_points) ? moving.points[j] : stationary.points[j - N_move_points];
-                        const auto sq_dist = A.sq_dist(B);
-                        if(max_sq_dist < sq_dist){
-                            //std::lock_guard<std::mutex> lock(saver_printer);
-                            max_sq_dist = sq_dist;
-                        }
-                    }
-                //}); // thread pool task closure.
+        if(sparse){
+            // Locating the exact maximum is quadratic in the number of points, so the bounding box diagonal is used
+            // instead. It over-estimates the maximum by at most a factor of three, which merely raises T_start.
+            FUNCINFO("Bounding max square-distance between all points");
+            const auto inf = std::numeric_limits<double>::infinity();
+            vec3<double> lower( inf,  inf,  inf);
+            vec3<double> upper(-inf, -inf, -inf);
+            for(const auto *ps : { &moving, &stationary }){
+                for(const auto &p : ps->points){
+                    lower.x = std::min(lower.x, p.x);
+                    lower.y = std::min(lower.y, p.y);
+                    lower.z = std::min(lower.z, p.z);
+                    upper.x = std::max(upper.x, p.x);
+                    upper.y = std::max(upper.y, p.y);
+                    upper.z = std::max(upper.z, p.z);
+                }
+            }
+            max_sq_dist = lower.sq_dist(upper);
+
+        }else{
+            FUNCINFO("Locating max square-distance between all points");
+            const auto N_all_points = N_move_points + N_stat_points;
+            std::vector<double> max_sq_dists(N_all_points, 0.0);
+            parallel_for(0, N_all_points, [&](size_t i) -> void {
+                const auto A = (static_cast<long int>(i) < N_move_points) ? moving.points[i] : stationary.points[i - N_move_points];
+                for(long int j = 0; j < static_cast<long int>(i); ++j){
+                    const auto B = (j < N_move_points) ? moving.points[j] : stationary.points[j - N_move_points];
+                    const auto sq_dist = A.sq_dist(B);
+                    if(max_sq_dists[i] < sq_dist) max_sq_dists[i] = sq_dist;
+                }
+            });
+            for(const auto &sq_dist : max_sq_dists){
+                if(max_sq_dist < sq_dist) max_sq_dist = sq_dist;
             }
-        } // Wait until all threads are done.
+        }
     }
 
     const double T_start = params.T_start_scale * max_sq_dist;
@@ -403,7 +607,7 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
         for(const auto &apair : params.forced_correspondence){
             const auto i_m = apair.first;
             const auto j_s = apair.second;
- 
+
             const auto i_is_valid = isininc(0, i_m, N_move_points - 1);
             const auto j_is_valid = isininc(0, j_s, N_stat_points - 1);
 
@@ -432,7 +636,7 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             }
         }
     }
-    
+
     // Warn when the Sinkhorn procedure is likely to fail.
     {
         if( (N_stat_points < N_move_points)
@@ -445,14 +649,53 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
         }
     }
 
+    // Select the TPS control points.
+    //
+    // Farthest-point sampling is used so that the control points evenly cover the moving set. Moving points with a
+    // forced correspondence are selected first, since they are expected to be matched precisely.
+    point_set<double> control;
+    if(reduced){
+        FUNCINFO("Selecting " << params.N_control_points << " control points via farthest-point sampling");
+        control.points.reserve(params.N_control_points);
+        std::vector<double> min_sq_dists(N_move_points, std::numeric_limits<double>::infinity());
+        const auto add_control_point = [&](long int i) -> void {
+            const auto P_c = moving.points[i];
+            control.points.emplace_back(P_c);
+            parallel_for(0, N_move_points, [&](size_t j) -> void {
+                const auto sq_dist = P_c.sq_dist( moving.points[j] );
+                if(sq_dist < min_sq_dists[j]) min_sq_dists[j] = sq_dist;
+            });
+            return;
+        };
+
+        for(const auto &apair : params.forced_correspondence){
+            if( isininc(0, apair.first, N_move_points - 1)
+            &&  isininc(0, apair.second, N_stat_points - 1)
+            &&  (static_cast<long int>(control.points.size()) < params.N_control_points) ){
+                add_control_point(apair.first);
+            }
+        }
+        if(control.points.empty()) add_control_point(0);
+        while(static_cast<long int>(control.points.size()) < params.N_control_points){
+            const auto it = std::max_element(std::begin(min_sq_dists), std::end(min_sq_dists));
+            if(*it <= 0.0) break; // Every remaining point coincides with a control point.
+            add_control_point( static_cast<long int>(std::distance(std::begin(min_sq_dists), it)) );
+        }
+    }else{
+        control = moving;
+    }
+    const auto N_ctrl = static_cast<long int>(control.points.size());
+
+    thin_plate_spline t(control, params.kernel_dimension);
+
     // Prepare working buffers.
     //
-    // Main system matrix.
-    Eigen::MatrixXd L = Eigen::MatrixXd::Zero(N_move_points + 4, N_move_points + 4);
+    // Main system matrix. Only needed when every moving point is a control point.
+    Eigen::MatrixXd L;
     // Corresponding points working buffer.
-    Eigen::MatrixXd Y = Eigen::MatrixXd::Zero(N_move_points + 4, 3); 
+    Eigen::MatrixXd Y = Eigen::MatrixXd::Zero(N_move_points + 4, 3);
     // Identity matrix used for regularization.
-    Eigen::MatrixXd I_N4 = Eigen::MatrixXd::Identity(N_move_points + 4, N_move_points + 4);
+    Eigen::MatrixXd I_N4;
     // Weighting matrix needed for 'double-sided outlier handling' -- Yang et al. (2011).
     Eigen::MatrixXd W;
     if(params.double_sided_outliers){
@@ -460,7 +703,46 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     }
 
     // Corresponence matrix.
-    Eigen::MatrixXd M = Eigen::MatrixXd::Zero(N_move_points + 1, N_stat_points + 1);
+    //
+    // When the correspondence is truncated, row i (i.e., moving point i) retains N_nn coefficients, which are
+    // M(i, M_cols[i*N_nn + n]) = M_vals[i*N_nn + n] for n in [0, N_nn). The gutter coefficients are held separately:
+    // M(i, N_stat_points) = M_gutter[i] and M(N_move_points, j) = M_outl[j]. All other coefficients are zero.
+    Eigen::MatrixXd M;
+    std::vector<long int> M_cols;
+    std::vector<double> M_vals;
+    std::vector<double> M_gutter;
+    std::vector<double> M_outl;
+
+    // Column-wise index into the retained coefficients, used for column normalization. The coefficients of column j
+    // are M_vals[M_col_pos[n]] for n in [M_col_start[j], M_col_start[j+1]), ordered by row.
+    std::vector<long int> M_col_start;
+    std::vector<long int> M_col_pos;
+
+    // The stationary point that each moving point is forced to correspond with, or -1 if there is none.
+    std::vector<long int> M_forced_cols;
+
+    tps_rtree_t rtree_stat;
+    if(sparse){
+        M_cols.resize(N_move_points * N_nn, 0);
+        M_vals.resize(N_move_points * N_nn, 0.0);
+        M_gutter.resize(N_move_points, 0.0);
+        M_outl.resize(N_stat_points, 0.0);
+        M_col_start.resize(N_stat_points + 1, 0);
+        M_col_pos.resize(N_move_points * N_nn, 0);
+
+        M_forced_cols.resize(N_move_points, -1);
+        for(const auto &apair : params.forced_correspondence){
+            if( isininc(0, apair.first, N_move_points - 1)
+            &&  isininc(0, apair.second, N_stat_points - 1) ){
+                M_forced_cols[apair.first] = apair.second;
+            }
+        }
+
+        FUNCINFO("Indexing stationary point cloud for " << N_nn << "-nearest-neighbour correspondence");
+        rtree_stat = build_tps_rtree(stationary);
+    }else{
+        M = Eigen::MatrixXd::Zero(N_move_points + 1, N_stat_points + 1);
+    }
 
     // TPS model parameters.
     //
@@ -469,61 +751,92 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     // Note: To avoid a later copy, these coefficients are directly mapped to the transform buffer.
     //
     // Note: These are the parameters that get updated during the transformation update phase.
-    if(static_cast<long int>(t.W_A.size()) != (N_move_points + 4) * 3){
+    if(static_cast<long int>(t.W_A.size()) != (N_ctrl + 4) * 3){
         throw std::logic_error("TPS coefficients allocated with incorrect size. Refusing to continue.");
     }
     Eigen::Map<Eigen::Matrix< double,
                               Eigen::Dynamic,
                               Eigen::Dynamic,
                               Eigen::ColMajor >> W_A(&(*(t.W_A.begin())),
-                                                     N_move_points + 4,  3);
+                                                     N_ctrl + 4,  3);
     if( (t.W_A.num_rows() != W_A.rows())
     ||  (t.W_A.num_cols() != W_A.cols()) ){
         throw std::logic_error("TPS coefficient matrix dimesions do not match. Refusing to continue.");
     }
 
+    // Reduced control point system.
+    //
+    // The TPS basis functions (i.e., the kernel centred at each control point, and the affine terms) are evaluated at
+    // every moving point and stored column-wise, so the transformed moving points are B_T^T * W_A. The coefficients
+    // are fitted in a least-squares sense by solving (B_T * B_T^T + lambda * I_C4) * W_A = B_T * Y, where I_C4 only
+    // penalizes the warp coefficients.
+    Eigen::MatrixXd B_T;  // (N_ctrl + 4) x N_move_points.
+    Eigen::MatrixXd BTB;  // (N_ctrl + 4) x (N_ctrl + 4).
+    Eigen::MatrixXd K_cc; // N_ctrl x N_ctrl, used for the bending energy.
+    if(reduced){
+        B_T = Eigen::MatrixXd::Zero(N_ctrl + 4, N_move_points);
+        parallel_for(0, N_move_points, [&](size_t i) -> void {
+            const auto P_moving = moving.points[i];
+            for(long int c = 0; c < N_ctrl; ++c){
+                B_T(c, i) = t.eval_kernel( P_moving.distance(control.points[c]) );
+            }
+            B_T(N_ctrl + 0, i) = 1.0;
+            B_T(N_ctrl + 1, i) = P_moving.x;
+            B_T(N_ctrl + 2, i) = P_moving.y;
+            B_T(N_ctrl + 3, i) = P_moving.z;
+        });
+
+        BTB = Eigen::MatrixXd::Zero(N_ctrl + 4, N_ctrl + 4);
+        BTB.selfadjointView<Eigen::Lower>().rankUpdate(B_T);
+        BTB.triangularView<Eigen::StrictlyUpper>() = BTB.transpose();
+
+        K_cc = Eigen::MatrixXd::Zero(N_ctrl, N_ctrl);
+        parallel_for(0, N_ctrl, [&](size_t c) -> void {
+            const auto P_c = control.points[c];
+            for(long int d = 0; d < N_ctrl; ++d){
+                if(static_cast<long int>(c) != d) K_cc(d, c) = t.eval_kernel( P_c.distance(control.points[d]) );
+            }
+        });
 
-    Eigen::MatrixXd X(N_move_points, 4); // Stacked matrix of homogeneous moving set points.
-    Eigen::MatrixXd Z(N_move_points, 4); // Stacked matrix of corresponding homogeneous fixed set points.
-    Eigen::MatrixXd k(1, N_move_points); // TPS kernel vector.
-    Eigen::MatrixXd K(N_move_points, N_move_points); // TPS kernel matrix.
+    }else{
+        L = Eigen::MatrixXd::Zero(N_move_points + 4, N_move_points + 4);
+        I_N4 = Eigen::MatrixXd::Identity(N_move_points + 4, N_move_points + 4);
 
-    // Populate static elements.
-    //
-    // L matrix: "K" kernel part.
-    //
-    // Note: "K"s diagonals are later adjusted using the regularization parameter. They are set to zero initially.
-    for(long int i = 0; i < N_move_points; ++i) L(i, i) = 0.0;
-    for(long int i = 0; i < N_move_points; ++i){
-        const auto P_i = moving.points[i];
-        for(long int j = i + 1; j < N_move_points; ++j){
-            const auto P_j = moving.points[j];
-            const auto dist = P_i.distance(P_j);
-            const auto kij = t.eval_kernel(dist);
-            L(i, j) = kij;
-            L(j, i) = kij;
-        }
-    }
+        // Populate static elements.
+        //
+        // L matrix: "K" kernel part.
+        //
+        // Note: "K"s diagonals are later adjusted using the regularization parameter. They are set to zero initially.
+        parallel_for(0, N_move_points, [&](size_t i) -> void {
+            const auto P_i = moving.points[i];
+            for(long int j = 0; j < N_move_points; ++j){
+                if(static_cast<long int>(i) == j) continue;
+                const auto P_j = moving.points[j];
+                const auto dist = P_i.distance(P_j);
+                L(j, i) = t.eval_kernel(dist);
+            }
+        });
 
-    // L matrix: "P" and "PT" parts.
-    for(long int i = 0; i < N_move_points; ++i){
-        const auto P_moving = moving.points[i];
-        L(i, N_move_points + 0) = 1.0;
-        L(i, N_move_points + 1) = P_moving.x;
-        L(i, N_move_points + 2) = P_moving.y;
-        L(i, N_move_points + 3) = P_moving.z;
+        // L matrix: "P" and "PT" parts.
+        for(long int i = 0; i < N_move_points; ++i){
+            const auto P_moving = moving.points[i];
+            L(i, N_move_points + 0) = 1.0;
+            L(i, N_move_points + 1) = P_moving.x;
+            L(i, N_move_points + 2) = P_moving.y;
+            L(i, N_move_points + 3) = P_moving.z;
+
+            L(N_move_points + 0, i) = 1.0;
+            L(N_move_points + 1, i) = P_moving.x;
+            L(N_move_points + 2, i) = P_moving.y;
+            L(N_move_points + 3, i) = P_moving.z;
+        }
 
-        L(N_move_points + 0, i) = 1.0;
-        L(N_move_points + 1, i) = P_moving.x;
-        L(N_move_points + 2, i) = P_moving.y;
-        L(N_move_points + 3, i) = P_moving.z;
+        // Index matrix that only alters the "K" kernel part of L.
+        I_N4(N_move_points + 0, N_move_points + 0) = 0.0;
+        I_N4(N_move_points + 1, N_move_points + 1) = 0.0;
+        I_N4(N_move_points + 2, N_move_points + 2) = 0.0;
+        I_N4(N_move_points + 3, N_move_points + 3) = 0.0;
     }
- 
-    // Index matrix that only alters the "K" kernel part of L.
-    I_N4(N_move_points + 0, N_move_points + 0) = 0.0;
-    I_N4(N_move_points + 1, N_move_points + 1) = 0.0;
-    I_N4(N_move_points + 2, N_move_points + 2) = 0.0;
-    I_N4(N_move_points + 3, N_move_points + 3) = 0.0;
 
     // Prime the transformation with an identity affine component and no warp component.
     //
@@ -531,9 +844,9 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     // temperature is sufficiently high then something like centroid-matching and PCA-alignment will naturally occur.
     // Conversely, if the temperature is set below the threshold required for global transformations, then only local
     // transformations (waprs) will occur; this may be what the user intends!
-    W_A(N_move_points + 1, 0) = 1.0; // x-component.
-    W_A(N_move_points + 2, 1) = 1.0; // y-component.
-    W_A(N_move_points + 3, 2) = 1.0; // z-component.
+    W_A(N_ctrl + 1, 0) = 1.0; // x-component.
+    W_A(N_ctrl + 2, 1) = 1.0; // y-component.
+    W_A(N_ctrl + 3, 2) = 1.0; // z-component.
 
     if(params.seed_with_centroid_shift){
         // Seed the affine transformation with the output from a simpler rigid registration.
@@ -543,37 +856,80 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             return std::nullopt;
         }
 
-        W_A(N_move_points + 0, 0) = t_com.value().read_coeff(3,0);
-        W_A(N_move_points + 0, 1) = t_com.value().read_coeff(3,1);
-        W_A(N_move_points + 0, 2) = t_com.value().read_coeff(3,2);
+        W_A(N_ctrl + 0, 0) = t_com.value().read_coeff(3,0);
+        W_A(N_ctrl + 0, 1) = t_com.value().read_coeff(3,1);
+        W_A(N_ctrl + 0, 2) = t_com.value().read_coeff(3,2);
     }
 
-    // Invert the system matrix.
+    // The reduced system matrix, regularized using the given lambda.
+    const auto reduced_system = [&](double lambda) -> Eigen::MatrixXd {
+        Eigen::MatrixXd R = BTB;
+        for(long int c = 0; c < N_ctrl; ++c) R(c, c) += lambda;
+        return R;
+    };
+
+    // Invert or decompose the system matrix.
     //
-    // Note: only necessary when regularization is disabled.
+    // Note: only necessary when regularization is disabled, since otherwise the system changes with temperature.
     Eigen::MatrixXd L_pinv;
-    if( (params.solution_method == AlignViaTPSRPMParams::SolutionMethod::PseudoInverse)
-    &&  (std::abs(L_1_start) == 0.0) ){
-        L_pinv = L.completeOrthogonalDecomposition().pseudoInverse();
+    Eigen::LDLT<Eigen::MatrixXd> R_LDLT;
+    if(std::abs(L_1_start) == 0.0){
+        if(params.solution_method == AlignViaTPSRPMParams::SolutionMethod::PseudoInverse){
+            L_pinv = reduced ? reduced_system(0.0).completeOrthogonalDecomposition().pseudoInverse()
+                             : L.completeOrthogonalDecomposition().pseudoInverse();
+        }else if( reduced
+              &&  (params.solution_method == AlignViaTPSRPMParams::SolutionMethod::LDLT) ){
+            R_LDLT.compute(reduced_system(0.0));
+            if(R_LDLT.info() != Eigen::Success){
+                throw std::runtime_error("Unable to update transformation: LDLT decomposition failed.");
+            }
+        }
     }
 
     // Prime the correspondence matrix with uniform correspondence terms.
-    for(long int i = 0; i < N_move_points; ++i){ // row
-        for(long int j = 0; j < N_stat_points; ++j){ // column
-            M(i, j) = 1.0 / static_cast<double>(N_move_points);
+    //
+    // Note: the sparse correspondence is fully overwritten on every update, so it does not need to be primed.
+    if(!sparse){
+        for(long int i = 0; i < N_move_points; ++i){ // row
+            for(long int j = 0; j < N_stat_points; ++j){ // column
+                M(i, j) = 1.0 / static_cast<double>(N_move_points);
+            }
         }
-    }
-    {
-        const auto i = N_move_points; // row
-        for(long int j = 0; j < N_stat_points; ++j){ // column
+        {
+            const auto i = N_move_points; // row
+            for(long int j = 0; j < N_stat_points; ++j){ // column
+                M(i, j) = 0.01 / static_cast<double>(N_move_points);
+            }
+        }
+        for(long int i = 0; i < N_move_points; ++i){ // row
+            const auto j = N_stat_points; // column
             M(i, j) = 0.01 / static_cast<double>(N_move_points);
         }
+        M(N_move_points, N_stat_points) = 0.0;
     }
-    for(long int i = 0; i < N_move_points; ++i){ // row
-        const auto j = N_stat_points; // column
-        M(i, j) = 0.01 / static_cast<double>(N_move_points);
-    }
-    M(N_move_points, N_stat_points) = 0.0;
+
+    // Visit the (retained) non-outlier coefficients of a row of the correspondence matrix, in order of column.
+    const auto for_each_row_coeff = [&](long int i, const auto &f) -> void {
+        if(sparse){
+            for(long int n = 0; n < N_nn; ++n) f( M_cols[i * N_nn + n], M_vals[i * N_nn + n] );
+        }else{
+            for(long int j = 0; j < N_stat_points; ++j) f( j, M(i, j) );
+        }
+        return;
+    };
+
+    // Rebuild the column-wise index into the sparse correspondence matrix.
+    const auto index_sparse_columns = [&]() -> void {
+        std::fill(std::begin(M_col_start), std::end(M_col_start), 0);
+        for(const auto &j : M_cols) ++M_col_start[j + 1];
+        for(long int j = 0; j < N_stat_points; ++j) M_col_start[j + 1] += M_col_start[j];
+
+        std::vector<long int> next(std::begin(M_col_start), std::end(M_col_start) - 1);
+        for(long int n = 0; n < (N_move_points * N_nn); ++n){
+            M_col_pos[ next[ M_cols[n] ]++ ] = n;
+        }
+        return;
+    };
 
     // Implement the user-provided forced correspondences, if any exist, by overwriting the correspondence matrix.
     //
@@ -589,22 +945,49 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             const auto i_is_valid = isininc(0, i_m, N_move_points - 1);
             const auto j_is_valid = isininc(0, j_s, N_stat_points - 1);
 
-            // Zero-out rows and columns.
-            if( i_is_valid ){
-                for(long int j = 0; j < (N_stat_points + 1); ++j){ // column
-                    M(i_m, j) = 0.0;
+            if(sparse){
+                // Zero-out rows and columns.
+                if( i_is_valid ){
+                    for(long int n = 0; n < N_nn; ++n) M_vals[i_m * N_nn + n] = 0.0;
+                    M_gutter[i_m] = 0.0;
                 }
-            }
-            if( j_is_valid ){
-                for(long int i = 0; i < (N_move_points + 1); ++i){ // row
-                    M(i, j_s) = 0.0;
+                if( j_is_valid ){
+                    for(long int n = M_col_start[j_s]; n < M_col_start[j_s + 1]; ++n) M_vals[ M_col_pos[n] ] = 0.0;
+                    M_outl[j_s] = 0.0;
                 }
-            }
 
-            // Place the correspondence coefficient.
-            if( i_is_valid && j_is_valid )   M(i_m, j_s) = 1.0;
-            if( !i_is_valid && j_is_valid )  M(N_move_points, j_s) = 1.0;
-            if( i_is_valid && !j_is_valid )  M(i_m, N_stat_points) = 1.0;
+                // Place the correspondence coefficient.
+                //
+                // Note: the forced stationary point is always retained when the correspondence is updated.
+                if( i_is_valid && j_is_valid ){
+                    const auto beg = std::next(std::begin(M_cols), i_m * N_nn);
+                    const auto it = std::find(beg, std::next(beg, N_nn), j_s);
+                    if(it == std::next(beg, N_nn)){
+                        throw std::logic_error("Forced correspondence was not retained. Cannot continue.");
+                    }
+                    M_vals[ std::distance(std::begin(M_cols), it) ] = 1.0;
+                }
+                if( !i_is_valid && j_is_valid )  M_outl[j_s] = 1.0;
+                if( i_is_valid && !j_is_valid )  M_gutter[i_m] = 1.0;
+
+            }else{
+                // Zero-out rows and columns.
+                if( i_is_valid ){
+                    for(long int j = 0; j < (N_stat_points + 1); ++j){ // column
+                        M(i_m, j) = 0.0;
+                    }
+                }
+                if( j_is_valid ){
+                    for(long int i = 0; i < (N_move_points + 1); ++i){ // row
+                        M(i, j_s) = 0.0;
+                    }
+                }
+
+                // Place the correspondence coefficient.
+                if( i_is_valid && j_is_valid )   M(i_m, j_s) = 1.0;
+                if( !i_is_valid && j_is_valid )  M(N_move_points, j_s) = 1.0;
+                if( i_is_valid && !j_is_valid )  M(i_m, N_stat_points) = 1.0;
+            }
         }
         return;
     };
@@ -622,12 +1005,20 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
         //       outlier coefficients does *not* seem to salvage the Sinkhorn method in these cases.
         if(!params.permit_move_outliers){
             for(long int i = 0; i < N_move_points; ++i){ // row
-                M(i, N_stat_points) = 0.0;
+                if(sparse){
+                    M_gutter[i] = 0.0;
+                }else{
+                    M(i, N_stat_points) = 0.0;
+                }
             }
         }
         if(!params.permit_stat_outliers){
             for(long int j = 0; j < N_stat_points; ++j){ // column
-                M(N_move_points, j) = 0.0;
+                if(sparse){
+                    M_outl[j] = 0.0;
+                }else{
+                    M(N_move_points, j) = 0.0;
+                }
             }
         }
 
@@ -638,18 +1029,50 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     // the normalization (i.e., every row and every column sums to one, except the row and column including the
     // bottom-right coefficient).
     const auto worst_row_col_sum_deviation = [&]() -> double {
+        std::vector<double> ds(N_move_points + N_stat_points, 0.0);
+        parallel_for(0, N_move_points + N_stat_points, [&](size_t k) -> void {
+            const auto i = static_cast<long int>(k);
+            const auto j = static_cast<long int>(k) - N_move_points;
+            double s = 0.0;
+            if(sparse){
+                if(i < N_move_points){
+                    for(long int n = 0; n < N_nn; ++n) s += M_vals[i * N_nn + n];
+                    s += M_gutter[i];
+                }else{
+                    for(long int n = M_col_start[j]; n < M_col_start[j + 1]; ++n) s += M_vals[ M_col_pos[n] ];
+                    s += M_outl[j];
+                }
+            }else{
+                s = (i < N_move_points) ? M.row(i).sum() : M.col(j).sum();
+            }
+            ds[k] = std::abs(s - 1.0);
+        });
         double w = 0.0;
-        for(long int i = 0; i < N_move_points; ++i){
-            const auto ds = std::abs(M.row(i).sum() - 1.0);
-            if( w < ds ) w = ds;
-        }
-        for(long int j = 0; j < N_stat_points; ++j){
-            const auto ds = std::abs(M.col(j).sum() - 1.0);
-            if( w < ds ) w = ds;
+        for(const auto &d : ds){
+            if( w < d ) w = d;
         }
         return w;
     };
 
+    // Transform the moving points using the current TPS transformation.
+    std::vector<vec3<double>> moved(N_move_points);
+    const auto update_moved_points = [&]() -> void {
+        if(reduced){
+            const Eigen::MatrixXd P_moved = B_T.transpose() * W_A;
+            if(!P_moved.allFinite()){
+                throw std::runtime_error("Failed to evaluate TPS mapping function. Cannot continue.");
+            }
+            for(long int i = 0; i < N_move_points; ++i){
+                moved[i] = vec3<double>( P_moved(i, 0), P_moved(i, 1), P_moved(i, 2) );
+            }
+        }else{
+            parallel_for(0, N_move_points, [&](size_t i) -> void {
+                moved[i] = t.transform(moving.points[i]);
+            });
+        }
+        return;
+    };
+
     // Update the correspondence.
     //
     // Note: This sub-routine solves for the point cloud correspondence using the current TPS transformation.
@@ -657,50 +1080,99 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     // Note: This sub-routine implements a 'soft-assign' technique for evaluating the correspondence.
     //       It supports outliers in either point cloud set.
     const auto update_correspondence = [&](double T_now, double s_reg) -> void {
-        // Non-outlier coefficients.
+        update_moved_points();
+
         Stats::Running_Sum<double> com_moved_x;
         Stats::Running_Sum<double> com_moved_y;
         Stats::Running_Sum<double> com_moved_z;
-        for(long int i = 0; i < N_move_points; ++i){ // row
-            const auto P_moving = moving.points[i];
-            const auto P_moved = t.transform(P_moving); // Transform the point.
+        for(const auto &P_moved : moved){
             com_moved_x.Digest(P_moved.x);
             com_moved_y.Digest(P_moved.y);
             com_moved_z.Digest(P_moved.z);
-            for(long int j = 0; j < N_stat_points; ++j){ // column
-                const auto P_stationary = stationary.points[j];
-                const auto dP = P_stationary - P_moved;
-                M(i, j) = (1.0 / T_now)
-                        * std::exp(s_reg / T_now)
-                        * std::exp( -dP.Dot(dP) / T_now);
-            }
         }
-        const vec3<double> com_moved( com_moved_x.Current_Sum() / static_cast<double>(N_move_points), 
-                                      com_moved_y.Current_Sum() / static_cast<double>(N_move_points), 
+        const vec3<double> com_moved( com_moved_x.Current_Sum() / static_cast<double>(N_move_points),
+                                      com_moved_y.Current_Sum() / static_cast<double>(N_move_points),
                                       com_moved_z.Current_Sum() / static_cast<double>(N_move_points) );
 
+        // Non-outlier coefficients.
+        if(sparse){
+            // Only the nearest stationary points are retained. They are stored in order of column so the layout does
+            // not depend on the order in which the spatial index returns them.
+            parallel_for(0, N_move_points, [&](size_t i) -> void {
+                const auto &P_moved = moved[i];
+                std::vector<tps_rtree_value_t> nearest;
+                nearest.reserve(N_nn);
+                rtree_stat.query( boost::geometry::index::nearest(tps_rtree_point_t(P_moved.x, P_moved.y, P_moved.z), N_nn),
+                                  std::back_inserter(nearest) );
+                if(static_cast<long int>(nearest.size()) != N_nn){
+                    throw std::logic_error("Unable to locate nearest neighbours. Cannot continue.");
+                }
+
+                const auto beg = std::next(std::begin(M_cols), i * N_nn);
+                const auto end = std::next(beg, N_nn);
+                std::transform(std::begin(nearest), std::end(nearest), beg,
+                               [](const tps_rtree_value_t &v){ return v.second; });
+
+                // Ensure a forced correspondence can be represented by displacing the most distant neighbour.
+                const auto j_f = M_forced_cols[i];
+                if( (0 <= j_f)
+                &&  (std::find(beg, end, j_f) == end) ){
+                    const auto it = std::max_element(beg, end, [&](long int j_A, long int j_B){
+                        return stationary.points[j_A].sq_dist(P_moved) < stationary.points[j_B].sq_dist(P_moved);
+                    });
+                    *it = j_f;
+                }
+                std::sort(beg, end);
+
+                for(long int n = 0; n < N_nn; ++n){
+                    const auto P_stationary = stationary.points[ M_cols[i * N_nn + n] ];
+                    const auto dP = P_stationary - P_moved;
+                    M_vals[i * N_nn + n] = (1.0 / T_now)
+                                         * std::exp(s_reg / T_now)
+                                         * std::exp( -dP.Dot(dP) / T_now);
+                }
+            });
+            index_sparse_columns();
+
+        }else{
+            parallel_for(0, N_move_points, [&](size_t i) -> void {
+                const auto &P_moved = moved[i];
+                for(long int j = 0; j < N_stat_points; ++j){ // column
+                    const auto P_stationary = stationary.points[j];
+                    const auto dP = P_stationary - P_moved;
+                    M(i, j) = (1.0 / T_now)
+                            * std::exp(s_reg / T_now)
+                            * std::exp( -dP.Dot(dP) / T_now);
+                }
+            });
+        }
+
         // Moving outlier coefficients.
-        {
-            const auto i = N_move_points; // row
+        parallel_for(0, N_stat_points, [&](size_t j) -> void {
             const auto& P_moving = com_moved;
-            for(long int j = 0; j < N_stat_points; ++j){ // column
-                const auto P_stationary = stationary.points[j];
-                const auto dP = P_stationary - P_moving; // Note: intentionally not transformed.
-                M(i, j) = (1.0 / T_start)
-                        * std::exp( -dP.Dot(dP) / T_start);
+            const auto P_stationary = stationary.points[j];
+            const auto dP = P_stationary - P_moving; // Note: intentionally not transformed.
+            const auto m = (1.0 / T_start)
+                         * std::exp( -dP.Dot(dP) / T_start);
+            if(sparse){
+                M_outl[j] = m;
+            }else{
+                M(N_move_points, j) = m;
             }
-        }
+        });
 
         // Stationary outlier coefficients.
-        for(long int i = 0; i < N_move_points; ++i){ // row
-            const auto P_moving = moving.points[i];
-            const auto P_moved = t.transform(P_moving); // Transform the point.
-            const auto j = N_stat_points; // column
+        parallel_for(0, N_move_points, [&](size_t i) -> void {
             const auto& P_stationary = com_stat;
-            const auto dP = P_stationary - P_moved;
-            M(i, j) = (1.0 / T_start)
-                    * std::exp( -dP.Dot(dP) / T_start);
-        }
+            const auto dP = P_stationary - moved[i];
+            const auto m = (1.0 / T_start)
+                         * std::exp( -dP.Dot(dP) / T_start);
+            if(sparse){
+                M_gutter[i] = m;
+            }else{
+                M(i, N_stat_points) = m;
+            }
+        });
 
         // Override forced correspondences and disable outlier detection (iff user specifies to do so).
         //
@@ -712,16 +1184,24 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
 
         // Normalize the rows and columns iteratively using the Sinkhorn procedure so that the non-outlier part of M
         // becomes doubly-stochastic.
+        //
+        // Note: rows (and then columns) are normalized independently, so they are normalized in parallel. Each sum is
+        //       accumulated in a fixed order, so the result does not depend on the number of threads.
         {
             double w_last = -1.0; // Used to detect if the method stalls.
             const auto machine_eps = 100.0 * std::sqrt( std::numeric_limits<double>::epsilon() );
             for(long int norm_iter = 0; norm_iter < params.N_Sinkhorn_iters; ++norm_iter){
 
                 // Tally the current row sums and re-scale the correspondence coefficients.
-                for(long int i = 0; i < N_move_points; ++i){ // row
+                parallel_for(0, N_move_points, [&](size_t i) -> void { // row
                     Stats::Running_Sum<double> rs;
-                    for(long int j = 0; j < (N_stat_points+1); ++j){ // column
-                        rs.Digest( M(i,j) );
+                    if(sparse){
+                        for(long int n = 0; n < N_nn; ++n) rs.Digest( M_vals[i * N_nn + n] );
+                        rs.Digest( M_gutter[i] );
+                    }else{
+                        for(long int j = 0; j < (N_stat_points+1); ++j){ // column
+                            rs.Digest( M(i,j) );
+                        }
                     }
                     const auto s = rs.Current_Sum();
                     if(s < machine_eps){
@@ -729,22 +1209,32 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
                         //throw std::runtime_error("Unable to normalize column");
                         // Option B: forgo normalization.
                         // This might ruin the transform scaling, but it might also self-correct (n.b. verified below!).
-                        continue;
+                        return;
                         // Option C: nominate this point as an outlier.
                         // This may work, but I can't say for sure...
                         //row_sums[i] += 1.0;
                         //M(i,N_stat_points) += 1.0;
                     }
-                    for(long int j = 0; j < (N_stat_points+1); ++j){ // column, intentionally ignoring the outlier coeff.
-                        M(i,j) /= s;
+                    if(sparse){
+                        for(long int n = 0; n < N_nn; ++n) M_vals[i * N_nn + n] /= s;
+                        M_gutter[i] /= s;
+                    }else{
+                        for(long int j = 0; j < (N_stat_points+1); ++j){ // column, intentionally ignoring the outlier coeff.
+                            M(i,j) /= s;
+                        }
                     }
-                }
+                });
 
                 // Tally the current column sums and re-scale the correspondence coefficients.
-                for(long int j = 0; j < N_stat_points; ++j){ // column
+                parallel_for(0, N_stat_points, [&](size_t j) -> void { // column
                     Stats::Running_Sum<double> rs;
-                    for(long int i = 0; i < (N_move_points+1); ++i){ // row
-                        rs.Digest( M(i,j) );
+                    if(sparse){
+                        for(long int n = M_col_start[j]; n < M_col_start[j + 1]; ++n) rs.Digest( M_vals[ M_col_pos[n] ] );
+                        rs.Digest( M_outl[j] );
+                    }else{
+                        for(long int i = 0; i < (N_move_points+1); ++i){ // row
+                            rs.Digest( M(i,j) );
+                        }
                     }
                     const auto s = rs.Current_Sum();
                     if(s < machine_eps){
@@ -752,20 +1242,25 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
                         //throw std::runtime_error("Unable to normalize row");
                         // Option B: forgo normalization.
                         // This might ruin the transform scaling, but it might also self-correct (n.b. verified below!).
-                        continue;
+                        return;
                         // Option C: nominate this point as an outlier.
                         // This may work, but I can't say for sure...
                         //col_sums[j] += 1.0;
                         //M(N_move_points,j) += 1.0;
                     }
-                    for(long int i = 0; i < (N_move_points+1); ++i){ // row, intentionally ignoring the outlier coeff.
-                        M(i,j) /= s;
+                    if(sparse){
+                        for(long int n = M_col_start[j]; n < M_col_start[j + 1]; ++n) M_vals[ M_col_pos[n] ] /= s;
+                        M_outl[j] /= s;
+                    }else{
+                        for(long int i = 0; i < (N_move_points+1); ++i){ // row, intentionally ignoring the outlier coeff.
+                            M(i,j) /= s;
+                        }
                     }
-                }
-                
+                });
+
                 // Determine whether convergence has been reached and we can break early.
                 const auto w = worst_row_col_sum_deviation();
-                if(w < params.Sinkhorn_tolerance){ 
+                if(w < params.Sinkhorn_tolerance){
                     break;
                 }
 
@@ -776,9 +1271,6 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
                     throw std::runtime_error("Sinkhorn technique stalled. Unable to normalize correspondence matrix. Cannot continue.");
                 }
                 w_last = w;
-
-                //FUNCINFO("On normalization iteration " << norm_iter << " the mean col sum was " << Stats::Mean(col_sums));
-                //FUNCINFO("On normalization iteration " << norm_iter << " the mean row sum was " << Stats::Mean(row_sums));
             }
         }
 
@@ -794,23 +1286,35 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             }
         }
 
-        if(!M.allFinite()){
+        const auto is_finite = [](double x){ return std::isfinite(x); };
+        if( sparse ? !( std::all_of(std::begin(M_vals), std::end(M_vals), is_finite)
+                     && std::all_of(std::begin(M_gutter), std::end(M_gutter), is_finite)
+                     && std::all_of(std::begin(M_outl), std::end(M_outl), is_finite) )
+                   : !M.allFinite() ){
             throw std::runtime_error("Failed to compute coefficient matrix.");
         }
         return;
     };
 
     // Estimates how the correspondence matrix will binarize when T -> 0.
+    //
+    // Note: ties are resolved in favour of the lowest index.
     const auto update_final_correspondence = [&]() -> void {
         for(long int i = 0; i < N_move_points; ++i){ // row
             double max_coeff = -(std::numeric_limits<double>::infinity());
             long int max_j = -1;
-            for(long int j = 0; j < (N_stat_points + 1); ++j){ // column
-                const auto m = M(i,j);
+            for_each_row_coeff(i, [&](long int j, double m){
                 if(max_coeff < m){
                     max_coeff = m;
                     max_j = j;
                 }
+            });
+            {
+                const auto m = sparse ? M_gutter[i] : M(i, N_stat_points);
+                if(max_coeff < m){
+                    max_coeff = m;
+                    max_j = N_stat_points;
+                }
             }
             if(!std::isfinite(max_coeff)){
                 throw std::logic_error("Unable to estimate binary correspondence.");
@@ -821,11 +1325,25 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
         for(long int j = 0; j < N_stat_points; ++j){ // column
             double max_coeff = -(std::numeric_limits<double>::infinity());
             long int max_i = -1;
-            for(long int i = 0; i < (N_move_points + 1); ++i){ // row
-                const auto m = M(i,j);
-                if(max_coeff < m){
-                    max_coeff = m;
-                    max_i = i;
+            if(sparse){
+                for(long int n = M_col_start[j]; n < M_col_start[j + 1]; ++n){
+                    const auto m = M_vals[ M_col_pos[n] ];
+                    if(max_coeff < m){
+                        max_coeff = m;
+                        max_i = M_col_pos[n] / N_nn;
+                    }
+                }
+                if(max_coeff < M_outl[j]){
+                    max_coeff = M_outl[j];
+                    max_i = N_move_points;
+                }
+            }else{
+                for(long int i = 0; i < (N_move_points + 1); ++i){ // row
+                    const auto m = M(i,j);
+                    if(max_coeff < m){
+                        max_coeff = m;
+                        max_i = i;
+                    }
                 }
             }
             if(!std::isfinite(max_coeff)){
@@ -843,16 +1361,16 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     const auto update_transformation = [&](double lambda) -> void {
 
         // Fill the Y vector with the corresponding points.
-        for(long int i = 0; i < N_move_points; ++i){
+        parallel_for(0, N_move_points, [&](size_t i) -> void {
             double col_sum_inv = std::numeric_limits<double>::quiet_NaN();
             if(params.double_sided_outliers){
                 // This column sum is only needed for the 'double-sided outlier handling' approach described by Yang et al (2011).
                 //
                 // Note: The 'gutter' term is intentionally omitted here.
                 Stats::Running_Sum<double> col_sum_rs;
-                for(long int j = 0; j < N_stat_points; ++j){ // column
-                    col_sum_rs.Digest( M(i,j) );
-                }
+                for_each_row_coeff(i, [&](long int, double m){
+                    col_sum_rs.Digest( m );
+                });
                 col_sum_inv = 1.0 / col_sum_rs.Current_Sum();
                 if(!std::isfinite(col_sum_inv)){
                     // Kludge factor here. Change from inf to 'some big number'.
@@ -866,13 +1384,13 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             Stats::Running_Sum<double> c_x;
             Stats::Running_Sum<double> c_y;
             Stats::Running_Sum<double> c_z;
-            for(long int j = 0; j < N_stat_points; ++j){ // column
+            for_each_row_coeff(i, [&](long int j, double m){
                 const auto P_stationary = stationary.points[j];
 
                 double weight = std::numeric_limits<double>::quiet_NaN();
                 if(params.double_sided_outliers){
                     // 'Double-sided outlier handling' approach from Yang et al (2011).
-                    weight = M(i,j) * col_sum_inv;
+                    weight = m * col_sum_inv;
                     if( !std::isfinite(weight)
                     ||  !isininc(0.0, weight, 1.0) ){
                         throw std::runtime_error("Encountered invalid weight. Is the point cloud degenerate? Refusing to continue.");
@@ -882,21 +1400,62 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
 
                 }else{
                     // Original formulation from Chui and Rangaran.
-                    weight = M(i,j);
+                    weight = m;
                 }
 
                 const auto weighted_P = P_stationary * weight;
                 c_x.Digest(weighted_P.x);
                 c_y.Digest(weighted_P.y);
                 c_z.Digest(weighted_P.z);
-            }
+            });
             Y(i, 0) = c_x.Current_Sum();
             Y(i, 1) = c_y.Current_Sum();
             Y(i, 2) = c_z.Current_Sum();
-        }
+        });
+
+        // Fit the reduced set of control points.
+        //
+        // Note: the least-squares fit cannot interpolate every corresponding point, so the 'outlier' share of each row
+        //       (i.e., the gutter coefficient) is directed to the current position of the moving point rather than the
+        //       origin. Otherwise points that are temporarily considered outliers drag the whole transformation toward
+        //       the origin. At convergence this is equivalent to weighting each moving point by its row sum.
+        if(reduced){
+            Eigen::MatrixXd Y_eff = Y.topRows(N_move_points);
+            parallel_for(0, N_move_points, [&](size_t i) -> void {
+                double row_sum = 0.0;
+                for_each_row_coeff(i, [&](long int, double m){
+                    row_sum += m;
+                });
+                const auto w_outlier = std::clamp(1.0 - row_sum, 0.0, 1.0);
+                Y_eff(i, 0) += moved[i].x * w_outlier;
+                Y_eff(i, 1) += moved[i].y * w_outlier;
+                Y_eff(i, 2) += moved[i].z * w_outlier;
+            });
+            const Eigen::MatrixXd BTY = B_T * Y_eff;
+
+            if(params.solution_method == AlignViaTPSRPMParams::SolutionMethod::PseudoInverse){
+                if(std::abs(L_1_start) != 0.0){
+                    L_pinv = reduced_system(lambda).completeOrthogonalDecomposition().pseudoInverse();
+                }
+                W_A = L_pinv * BTY;
+
+            }else if(params.solution_method == AlignViaTPSRPMParams::SolutionMethod::LDLT){
+                if(std::abs(L_1_start) != 0.0){
+                    R_LDLT.compute(reduced_system(lambda));
+                    if(R_LDLT.info() != Eigen::Success){
+                        throw std::runtime_error("Unable to update transformation: LDLT decomposition failed.");
+                    }
+                }
+                W_A = R_LDLT.solve(BTY);
+                if(R_LDLT.info() != Eigen::Success){
+                    throw std::runtime_error("Unable to update transformation: LDLT solve failed.");
+                }
+            }else{
+                throw std::logic_error("Solution method not understood. Cannot continue.");
+            }
 
         // Use pseudo-inverse method.
-        if(params.solution_method == AlignViaTPSRPMParams::SolutionMethod::PseudoInverse){
+        }else if(params.solution_method == AlignViaTPSRPMParams::SolutionMethod::PseudoInverse){
             // Update the L matrix inverse using current regularization lambda.
             if(std::abs(L_1_start) != 0.0){
                 Eigen::MatrixXd R;
@@ -911,8 +1470,8 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
 
                 L_pinv = R.completeOrthogonalDecomposition().pseudoInverse();
             }
-            
-            if( (L_pinv.rows() == 0) 
+
+            if( (L_pinv.rows() == 0)
             ||  (L_pinv.cols() == 0) ){
                 throw std::runtime_error("Matrix inverse not pre-computed. Refusing to continue.");
             }
@@ -935,13 +1494,13 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             }else{
                 LHS = L;
             }
-            
+
             Eigen::LDLT<Eigen::MatrixXd> LDLT;
             LDLT.compute(LHS.transpose() * LHS);
             if(LDLT.info() != Eigen::Success){
                 throw std::runtime_error("Unable to update transformation: LDLT decomposition failed.");
             }
-            
+
             W_A = LDLT.solve(LHS.transpose() * Y);
             if(LDLT.info() != Eigen::Success){
                 throw std::runtime_error("Unable to update transformation: LDLT solve failed.");
@@ -958,19 +1517,37 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     };
 
     // Print information about the optimization.
-    const auto print_optimizer_progress = [&](double T_now, double /*lambda*/) -> void {
+    const auto print_optimizer_progress = [&](double T_now, double /*lambda*/, double step_duration) -> void {
 
         // Correspondence coefficients.
         //
         // These will approach a binary state (min=0 and max=1) when the temperature is low.
         // Whether these are binary or not fully depends on the temperature, so they can be used to tweak the annealing
         // schedule.
-        const auto mean_row_min_coeff = M.rowwise().minCoeff().sum() / static_cast<double>( M.rows() );
-        const auto mean_row_max_coeff = M.rowwise().maxCoeff().sum() / static_cast<double>( M.rows() );
+        //
+        // Note: only the retained coefficients and the gutter are considered when the correspondence is truncated.
+        double mean_row_min_coeff = std::numeric_limits<double>::quiet_NaN();
+        double mean_row_max_coeff = std::numeric_limits<double>::quiet_NaN();
+        if(sparse){
+            Stats::Running_Sum<double> rs_min;
+            Stats::Running_Sum<double> rs_max;
+            for(long int i = 0; i < N_move_points; ++i){
+                const auto beg = std::next(std::begin(M_vals), i * N_nn);
+                const auto minmax = std::minmax_element(beg, std::next(beg, N_nn));
+                rs_min.Digest( std::min(*(minmax.first), M_gutter[i]) );
+                rs_max.Digest( std::max(*(minmax.second), M_gutter[i]) );
+            }
+            mean_row_min_coeff = rs_min.Current_Sum() / static_cast<double>(N_move_points);
+            mean_row_max_coeff = rs_max.Current_Sum() / static_cast<double>(N_move_points);
+        }else{
+            mean_row_min_coeff = M.rowwise().minCoeff().sum() / static_cast<double>( M.rows() );
+            mean_row_max_coeff = M.rowwise().maxCoeff().sum() / static_cast<double>( M.rows() );
+        }
 
-        FUNCINFO("Optimizer state: T = " << std::setw(12) << T_now 
+        FUNCINFO("Optimizer state: T = " << std::setw(12) << T_now
                    << ", mean min,max corr coeffs = " << std::setw(12) << mean_row_min_coeff
-                   << ", " << std::setw(12) << mean_row_max_coeff );
+                   << ", " << std::setw(12) << mean_row_max_coeff
+                   << ", step took " << step_duration << " s" );
         return;
     };
 
@@ -988,16 +1565,12 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
     const auto estimate_bending_energies = [&]() -> bending_energies {
 
         // Compute (approximate) bending energy.
-        const auto E_x = (  W_A.block(0,0, N_move_points,1).transpose()
-                            * L.block(0,0, N_move_points,N_move_points) 
-                            * W_A.block(0,0, N_move_points,1) ).sum();
-        const auto E_y = (  W_A.block(0,1, N_move_points,1).transpose()
-                            * L.block(0,0, N_move_points,N_move_points) 
-                            * W_A.block(0,1, N_move_points,1) ).sum();
-        const auto E_z = (  W_A.block(0,2, N_move_points,1).transpose()
-                            * L.block(0,0, N_move_points,N_move_points) 
-                            * W_A.block(0,2, N_move_points,1) ).sum();
-        return bending_energies{ E_x, E_y, E_z };
+        const auto E = [&](long int dim) -> double {
+            const auto w = W_A.block(0,dim, N_ctrl,1);
+            return reduced ? (w.transpose() * K_cc * w).sum()
+                           : (w.transpose() * L.block(0,0, N_ctrl,N_ctrl) * w).sum();
+        };
+        return bending_energies{ E(0), E(1), E(2) };
     };
 
 /*
@@ -1016,7 +1589,10 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
 */
 
     // Anneal deterministically.
+    params.N_annealing_steps = 0;
     for(double T_now = T_start; T_now >= T_end; T_now *= params.T_step){
+        const auto t_step_start = std::chrono::steady_clock::now();
+
         // Regularization parameter: controls how smooth the TPS interpolation is.
         const double L_1 = T_now * L_1_start;
 
@@ -1034,8 +1610,10 @@ AlignViaTPSRPM(AlignViaTPSRPMParams & params,
             // Update transformation.
             update_transformation(L_1);
         }
+        ++params.N_annealing_steps;
 
-        print_optimizer_progress(T_now, L_1);
+        const auto step_duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_step_start).count();
+        print_optimizer_progress(T_now, L_1, step_duration);
 
         //write_to_xyz_file("warped_tps-rpm_");
     }
@@ -4,6 +4,7 @@
 
 #include <optional>
 #include <iosfwd>
+#include <vector>
 
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorMath.h"         //Needed for vec3 class.
@@ -35,6 +36,45 @@ class thin_plate_spline {
 };
 
 
+// This class caches a thin-plate spline transformation as a displacement field sampled on a regular lattice.
+//
+// Evaluating a thin-plate spline costs one kernel evaluation per control point, which is prohibitive when warping
+// millions of mesh vertices or image voxels. Here the exact transformation is evaluated (in parallel) once for each
+// lattice node, and positions are subsequently transformed by trilinearly interpolating the nodal displacements.
+// The lattice is successively refined until the interpolation error, estimated by comparing against the exact spline
+// at a deterministic sample of at most 4096 cell centres (where trilinear interpolation error is typically greatest),
+// falls within the requested tolerance or the node budget is exhausted. The error is not bounded elsewhere, so the
+// estimate is only indicative; it is reported in 'estimated_max_error'.
+//
+// Positions outside of the lattice are transformed exactly using the underlying spline.
+class thin_plate_spline_field {
+    public:
+        thin_plate_spline tps;
+
+        vec3<double> origin;   // Position of the lattice node (0,0,0).
+        double spacing = 0.0;  // Isotropic distance between adjacent nodes.
+        long int N_x = 0;
+        long int N_y = 0;
+        long int N_z = 0;
+        std::vector<vec3<double>> displacements; // Node (i,j,k) is stored at index (k*N_y + j)*N_x + i.
+
+        double estimated_max_error = 0.0; // Largest deviation from the exact spline among the sampled cell centres (mm).
+
+        // Constructor.
+        //
+        thin_plate_spline_field() = delete;
+        thin_plate_spline_field(const thin_plate_spline &tps,
+                                const vec3<double> &bbox_min,       // The region that will be transformed.
+                                const vec3<double> &bbox_max,
+                                double tolerance = 0.1,             // The tolerable interpolation error (in mm).
+                                long int max_nodes = 10'000'000L);  // Limits memory usage (~24 B per node).
+
+        // Member functions.
+        vec3<double> transform(const vec3<double> &v) const;
+        void apply_to(point_set<double> &ps) const;
+};
+
+
 #ifdef DCMA_USE_EIGEN
 // This routine finds a non-rigid alignment using thin plate splines.
 //
@@ -157,6 +197,28 @@ struct AlignViaTPSRPMParams {
     // computation.
     bool seed_with_centroid_shift = false;
 
+    // Scalability parameters.
+    //
+    // The number of nearest stationary points (to each transformed moving point) that are permitted to correspond.
+    // All other correspondence coefficients are taken to be zero, so the correspondence matrix is stored sparsely and
+    // the cost of each Sinkhorn iteration scales linearly with the number of points. Neighbours are located using a
+    // spatial index built once over the stationary points and re-queried at every correspondence update. Setting this
+    // to zero (or to a number at least as large as the stationary set) disables truncation and uses a dense
+    // correspondence matrix.
+    //
+    // Note: truncation is only reasonable once the temperature is low enough that distant correspondence coefficients
+    //       are negligible. For large point clouds, a lower starting temperature is advisable.
+    long int N_nearest_neighbours = 0;
+
+    // The number of moving points used as TPS control points. Control points are selected via farthest-point sampling
+    // so they evenly cover the moving set; moving points that participate in forced correspondences are always
+    // selected. The TPS coefficients are then fitted in a (regularized) least-squares sense, so the linear system that
+    // is solved at each iteration has a size that depends only on the number of control points. Setting this to zero
+    // (or to a number at least as large as the moving set) uses every moving point as a control point.
+    //
+    // Note: reduced control points cannot be used with double-sided outlier handling.
+    long int N_control_points = 0;
+
     // Correspondence parameters.
     //
     // Point-pairs that are forced to correspond. Indices are zero-based. The first index refers to the moving set, and
@@ -179,6 +241,9 @@ struct AlignViaTPSRPMParams {
     std::vector< std::pair<long int, long int> > final_move_correspondence; // moving point index -> stat point index.
     std::vector< std::pair<long int, long int> > final_stat_correspondence; // ALSO moving point index -> stat point index.
 
+    // The number of annealing (i.e., temperature) steps that were performed. Useful for benchmarking.
+    long int N_annealing_steps = 0;
+
 };
 
 std::optional<thin_plate_spline>
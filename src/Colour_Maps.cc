@@ -1,6 +1,11 @@
 //Colour_Maps.cc - A part of DICOMautomaton 2017. Written by hal clark.
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <optional>
 
 #include "Colour_Maps.h"
@@ -16950,6 +16955,85 @@ ClampedColourRGB ColourMap_Composite_50_90_100_107_110(double y){
     return out;
 }
 
+ColourMapLUT::ColourMapLUT(const std::function<ClampedColourRGB(double)> &colour_map){
+    const auto to_8bit = [](double c) -> uint8_t {
+        const auto dest_max = static_cast<double>( std::numeric_limits<uint8_t>::max() );
+        return static_cast<uint8_t>( std::floor( std::clamp(c, 0.0, 1.0) * dest_max ) );
+    };
+    for(size_t i = 0; i < N_entries; ++i){
+        const auto x = static_cast<double>(i) / static_cast<double>(N_entries - 1);
+        const auto c = colour_map(x);
+        this->rgb[3*i + 0] = to_8bit(c.R);
+        this->rgb[3*i + 1] = to_8bit(c.G);
+        this->rgb[3*i + 2] = to_8bit(c.B);
+    }
+}
+
+void Colour_Map_To_RGB8(const float *in,
+                        size_t N,
+                        size_t in_stride,
+                        double window_low,
+                        double window_high,
+                        const ColourMapLUT &lut,
+                        const std::array<uint8_t, 3> &nan_colour,
+                        uint8_t *out,
+                        size_t out_stride){
+
+    // Pixels are processed in blocks. The index computation only performs branchless arithmetic on contiguous arrays
+    // so the compiler can vectorize it, and the second loop gathers from the lookup table.
+    //
+    // Note: intensities are clamped to the window before scaling, and the argument order of std::min and std::max is
+    //       chosen so that NaNs are replaced, so no undefined float-to-integer conversions occur. Non-finite
+    //       intensities are detected arithmetically, since (v - v) is zero for finite v and NaN otherwise.
+    constexpr size_t block_size = 512;
+    constexpr auto nan_index = static_cast<int32_t>(ColourMapLUT::N_entries);
+
+    // A degenerate window is treated as a step at the window location.
+    const bool degenerate = !(window_low < window_high);
+    const auto low = static_cast<float>(window_low);
+    const auto high = static_cast<float>(window_high);
+    const auto scale = degenerate ? 0.0f
+                                  : static_cast<float>( static_cast<double>(nan_index - 1) / (window_high - window_low) );
+
+    std::array<float, block_size> vals;
+    std::array<int32_t, block_size> indices;
+    for(size_t b = 0; b < N; b += block_size){
+        const size_t n = std::min(block_size, N - b);
+
+        const float *in_b = in + b * in_stride;
+        float *v = vals.data();
+        for(size_t k = 0; k < n; ++k) v[k] = in_b[k * in_stride];
+
+        int32_t *idx = indices.data();
+        if(!degenerate){
+            for(size_t k = 0; k < n; ++k){
+                const auto c = std::min(high, std::max(low, v[k]));
+                const auto i = std::min(nan_index - 1, static_cast<int32_t>((c - low) * scale + 0.5f));
+                const auto non_finite = static_cast<int32_t>(std::min(1.0f, std::fabs(v[k] - v[k])));
+                idx[k] = i + non_finite * (nan_index - i);
+            }
+        }else{
+            for(size_t k = 0; k < n; ++k){
+                idx[k] = !std::isfinite(v[k]) ? nan_index
+                       : (v[k] <= low)        ? 0
+                                              : nan_index - 1;
+            }
+        }
+
+        uint8_t *out_b = out + b * out_stride;
+        for(size_t k = 0; k < n; ++k){
+            const uint8_t *c = (indices[k] == nan_index) ? nan_colour.data()
+                                                         : lut.rgb.data() + 3 * static_cast<size_t>(indices[k]);
+            uint8_t *o = out_b + k * out_stride;
+            o[0] = c[0];
+            o[1] = c[1];
+            o[2] = c[2];
+        }
+    }
+    return;
+}
+
+
 /*
 //Note: prototype for above functions:
 
@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <string>
 
@@ -46,3 +50,33 @@ ClampedColourRGB ColourMap_Composite_50_90_100_107_110(double y);
 //This function takes a named colour and map it to a colour specified in terms of R,G,B all within [0,1].
 std::optional<ClampedColourRGB> Colour_from_name(const std::string& n);
 
+
+
+//A precomputed lookup table for a colour map, so colour maps with many control points need not be interpolated for
+// every pixel. Entry 'i' holds the colour for input i/(N_entries - 1), converted to 8-bit R, G, B the same way the
+// viewers have always converted colours (i.e., floor(255 * c)). Quantization of the input to 4096 levels is well
+// below what 8-bit output can resolve.
+struct ColourMapLUT {
+    static constexpr size_t N_entries = 4096;
+
+    std::array<uint8_t, 3 * N_entries> rgb; // Packed R, G, B triplets.
+
+    explicit ColourMapLUT(const std::function<ClampedColourRGB(double)> &colour_map);
+};
+
+//Converts intensities to 8-bit colours in a single pass. Each intensity is linearly mapped from [window_low, window_high]
+// onto [0,1] (clamping values outside the window), and then coloured using the lookup table. Non-finite intensities
+// are assigned 'nan_colour'.
+//
+// Input intensity 'i' is read from in[i * in_stride] and its colour is written to out[i * out_stride] (R), 
+// out[i * out_stride + 1] (G), and out[i * out_stride + 2] (B); any remaining output bytes are not altered. This permits
+// reading a single channel from a multi-channel image and writing directly into RGB or RGBA buffers.
+void Colour_Map_To_RGB8(const float *in,
+                        size_t N,
+                        size_t in_stride,
+                        double window_low,
+                        double window_high,
+                        const ColourMapLUT &lut,
+                        const std::array<uint8_t, 3> &nan_colour,
+                        uint8_t *out,
+                        size_t out_stride = 3);
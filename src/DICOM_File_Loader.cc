@@ -8,7 +8,9 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>    
+#include <vector>
 //#include <cfenv>              //Needed for std::feclearexcept(FE_ALL_EXCEPT).
 
 #include <boost/algorithm/string/predicate.hpp>
@@ -19,22 +21,12 @@
 #include "Explicator.h"       //Needed for Explicator class.
 #include "Imebra_Shim.h"      //Wrapper for Imebra library. Black-boxed to speed up compilation.
 #include "Structs.h"
+#include "Thread_Pool.h"
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 
 
-static
-std::unique_ptr<Contour_Data>
-Concatenate_Contour_Data(std::unique_ptr<Contour_Data> A,
-                         std::unique_ptr<Contour_Data> B){
-    //This routine concatenates A and B's contour collections. No internal checking is performed.
-    // No copying is performed, but A and B are consumed. A is returned as if it were a new pointer.
-    A->ccs.splice( A->ccs.end(), std::move(B->ccs) );
-    return A;
-}
-
-
 bool Load_From_DICOM_Files( Drover &DICOM_data,
                             std::map<std::string,std::string> & /* InvocationMetadata */,
                             const std::string &FilenameLex,
@@ -59,21 +51,83 @@ bool Load_From_DICOM_Files( Drover &DICOM_data,
     loaded_imgs_storage.emplace_back();
     loaded_dose_storage.emplace_back();
 
-    size_t i = 0;
     const size_t N = Filenames.size();
 
+    //Parse and decode all files in parallel. Each file is parsed exactly once, and the parsed handle is shared between
+    // the modality check and the specific loader. Results are stashed in per-file slots so the bookkeeping below can
+    // proceed serially in the original file order, which keeps the outcome independent of thread scheduling.
+    struct parsed_file_t {
+        std::string Modality;
+        std::unique_ptr<TPlan_Config> tplan;
+        std::unique_ptr<Contour_Data> contours;
+        std::unique_ptr<Image_Array> img_arr;
+        std::exception_ptr eptr; // Set iff the specific loader threw.
+    };
+    std::vector<parsed_file_t> parsed(N);
+
+    //When enabled, only metadata is loaded for images. Pixels are decoded later, when an operation requires them.
+    const bool defer_pixels = Get_Deferred_Pixel_Settings().enabled;
+    {
+        asio_thread_pool tp;
+        std::mutex printer; // Who gets to print to the console and iterate the counter.
+        size_t completed = 0;
+
+        size_t i = 0;
+        for(const auto &p : Filenames){
+            const auto Filename = p.string();
+            auto &slot = parsed.at(i++);
+            tp.submit_task([&,Filename]() -> void {
+                std::shared_ptr<Parsed_DICOM_File> pf;
+                try{
+                    pf = Parse_DICOM_File(Filename);
+                    slot.Modality = get_modality(pf);
+                }catch(const std::exception &){
+                    slot.Modality = "";
+                };
+
+                try{
+                    if(boost::iequals(slot.Modality,"RTPLAN")){
+                        slot.tplan = Load_TPlan_Config(pf);
+
+                    }else if(boost::iequals(slot.Modality,"RTSTRUCT")){
+                        slot.contours = get_Contour_Data(pf);
+
+                    }else if(boost::iequals(slot.Modality,"RTDOSE")){
+                        slot.img_arr = Load_Dose_Array(pf);
+
+                    }else if(  boost::iequals(slot.Modality,"CT")
+                            || boost::iequals(slot.Modality,"OT")
+                            || boost::iequals(slot.Modality,"US")
+                            || boost::iequals(slot.Modality,"MR")
+                            || boost::iequals(slot.Modality,"RTIMAGE")
+                            || boost::iequals(slot.Modality,"PT") ){
+                        slot.img_arr = Load_Image_Array(pf, defer_pixels);
+                    }
+                }catch(const std::exception &){
+                    slot.eptr = std::current_exception();
+                }
+
+                //Release the parsed file as soon as possible; only the decoded data is retained.
+                pf.reset();
+
+                {
+                    std::lock_guard<std::mutex> lock(printer);
+                    ++completed;
+                    FUNCINFO("Parsed file #" << completed << "/" << N << " = " << 100*completed/N << "% \t" << Filename);
+                }
+                return;
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    size_t i = 0;
     auto bfit = Filenames.begin();
     while(bfit != Filenames.end()){
-        FUNCINFO("Parsing file #" << i+1 << "/" << N << " = " << 100*(i+1)/N << "% \t" << *bfit);
+        auto &slot = parsed.at(i);
         ++i;
 
         const auto Filename = bfit->string();
-        std::string Modality;
-        try{
-            Modality = get_modality(Filename);
-        }catch(const std::exception &){
-            Modality = "";
-        };
+        const auto &Modality = slot.Modality;
 
         if(boost::iequals(Modality,"RTRECORD")){
             FUNCWARN("RTRECORD file encountered. "
@@ -92,17 +146,18 @@ bool Load_From_DICOM_Files( Drover &DICOM_data,
         }else if(boost::iequals(Modality,"RTPLAN")){
             FUNCWARN("RTPLAN file support is experimental");
 
-            auto tplan = Load_TPlan_Config(Filename);
-            DICOM_data.tplan_data.emplace_back( std::move(tplan) );
+            if(slot.eptr) std::rethrow_exception(slot.eptr);
+            DICOM_data.tplan_data.emplace_back( std::move(slot.tplan) );
 
             bfit = Filenames.erase( bfit ); 
 
         }else if(boost::iequals(Modality,"RTSTRUCT")){
             const auto preloadcount = loaded_contour_data_storage->ccs.size();
             try{
-                auto combined = Concatenate_Contour_Data( loaded_contour_data_storage->Duplicate(),
-                                                          get_Contour_Data(Filename));
-                loaded_contour_data_storage = std::move(combined);
+                if(slot.eptr) std::rethrow_exception(slot.eptr);
+                //The storage is not shared yet, so contours can be spliced in without copying.
+                loaded_contour_data_storage->ccs.splice( loaded_contour_data_storage->ccs.end(),
+                                                         std::move(slot.contours->ccs) );
 
             }catch(const std::exception &e){
                 FUNCWARN("Difficulty encountered during contour data loading: '" << e.what() << "'. Ignoring file and continuing");
@@ -124,7 +179,8 @@ bool Load_From_DICOM_Files( Drover &DICOM_data,
 
         }else if(boost::iequals(Modality,"RTDOSE")){
             try{
-                loaded_dose_storage.back().push_back( Load_Dose_Array(Filename));
+                if(slot.eptr) std::rethrow_exception(slot.eptr);
+                loaded_dose_storage.back().push_back( std::move(slot.img_arr) );
             }catch(const std::exception &e){
                 FUNCWARN("Difficulty encountered during dose array loading: '" << e.what() << "'. Ignoring file and continuing");
                 //loaded_dose_storage.back().pop_back();
@@ -142,7 +198,8 @@ bool Load_From_DICOM_Files( Drover &DICOM_data,
                 || boost::iequals(Modality,"PT") ){
 
             try{
-                loaded_imgs_storage.back().push_back( Load_Image_Array(Filename));
+                if(slot.eptr) std::rethrow_exception(slot.eptr);
+                loaded_imgs_storage.back().push_back( std::move(slot.img_arr) );
             }catch(const std::exception &e){
                 FUNCWARN("Difficulty encountered during image array loading: '" << e.what() << "'. Ignoring file and continuing");
                 //loaded_imgs_storage.back().pop_back();
@@ -150,22 +207,22 @@ bool Load_From_DICOM_Files( Drover &DICOM_data,
                 continue;
             }
 
-            if(loaded_imgs_storage.back().back()->imagecoll.images.size() != 1){
-                FUNCWARN("More or less than one image loaded into the image array. You'll need to tweak the code to handle this");
+            if(loaded_imgs_storage.back().back()->imagecoll.images.empty()){
+                FUNCWARN("No images loaded into the image array. Refusing to continue");
                 return false;
-                //If you get here, you've tried to load a file that contains more than one image slice. This is OK,
-                // (and is legitimate behaviour) but you'll need to update the following code to ensure each file's 
-                // metadata is set accordingly. This is all you need to do at the time of writing, but take a look over
-                // the rest of the code to ensure the code doesn't assume too much.
             }
             
             bfit = Filenames.erase( bfit ); 
 
             //If we want to add any additional image metadata, or replace the default Imebra_Shim.cc populated metadata
             // with, say, the non-null PostgreSQL metadata, it should be done here.
-            loaded_imgs_storage.back().back()->imagecoll.images.back().metadata["Filename"] = Filename;
-            loaded_imgs_storage.back().back()->imagecoll.images.back().metadata["dt"] = "0.0";
-            // ... more metadata operations ...
+            //
+            // Note: Multi-frame files produce one image per frame, and all are tagged alike.
+            for(auto &img : loaded_imgs_storage.back().back()->imagecoll.images){
+                img.metadata["Filename"] = Filename;
+                img.metadata["dt"] = "0.0";
+                // ... more metadata operations ...
+            }
 
         }else{
             //Skip the file. It might be destined for some other loader.
@@ -193,10 +250,13 @@ bool Load_From_DICOM_Files( Drover &DICOM_data,
 
     //Concatenate contour data into the Drover instance.
     {
+        //Existing contours are only duplicated if they are shared with another owner.
         if(DICOM_data.contour_data == nullptr) DICOM_data.contour_data = std::make_shared<Contour_Data>();
-        auto combined = Concatenate_Contour_Data( DICOM_data.contour_data->Duplicate(),
-                                                  loaded_contour_data_storage->Duplicate());
-        DICOM_data.contour_data = std::move(combined);
+        if(DICOM_data.contour_data.use_count() != 1){
+            DICOM_data.contour_data = DICOM_data.contour_data->Duplicate();
+        }
+        DICOM_data.contour_data->ccs.splice( DICOM_data.contour_data->ccs.end(),
+                                             std::move(loaded_contour_data_storage->ccs) );
     }
 
     //Collate each group of images into a single set, if possible. Also stuff the correct contour data in the same set.
@@ -25,11 +25,13 @@
 #include "Structs.h"
 
 #include "Documentation.h"
+#include "Imebra_Shim.h"
 #include "PACS_Loader.h"
 #include "File_Loader.h"
 #include "Lexicon_Loader.h"
 
 #include "Operation_Dispatcher.h"
+#include "Thread_Pool.h"
 
 
 int main(int argc, char* argv[]){
@@ -187,6 +189,38 @@ int main(int argc, char* argv[]){
       })
     );
 
+    arger.push_back( ygor_arg_handlr_t(240, 'y', "defer-pixels", false, "",
+      "Load only metadata from DICOM image files, and decode pixels later when an operation requires them."
+      " Operations that only inspect or rearrange metadata will not trigger decoding.",
+      [&](const std::string &) -> void {
+        Get_Deferred_Pixel_Settings().enabled = true;
+        return;
+      })
+    );
+
+    arger.push_back( ygor_arg_handlr_t(241, 'b', "pixel-budget", true, "2048",
+      "The amount of decoded, unmodified pixel data (in MiB) to keep resident when pixels are deferred."
+      " Least-recently used pixels beyond this budget are released after each operation and decoded again"
+      " if needed. Only has an effect in combination with deferred pixel loading.",
+      [&](const std::string &optarg) -> void {
+        const auto MiB = std::stoll(optarg);
+        if(MiB < 0) FUNCERR("Pixel budget must be non-negative");
+        Get_Deferred_Pixel_Settings().budget_bytes = static_cast<int64_t>(MiB) * 1024 * 1024;
+        return;
+      })
+    );
+
+    arger.push_back( ygor_arg_handlr_t(250, 't', "max-threads", true, "4",
+      "The maximum number of threads used to perform work concurrently."
+      " The default (or zero) uses all available hardware threads.",
+      [&](const std::string &optarg) -> void {
+        const auto n = std::stoll(optarg);
+        if(n < 0) FUNCERR("Maximum number of threads must be non-negative");
+        work_stealing_scheduler::set_thread_cap(static_cast<size_t>(n));
+        return;
+      })
+    );
+
     arger.push_back( ygor_arg_handlr_t(300, 'm', "metadata", true, "'Volunteer=01'",
       "Metadata key-value pairs which are tacked onto results destined for a database. "
       "If there is an conflicting key-value pair, the values are concatenated.",
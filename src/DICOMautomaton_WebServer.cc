@@ -1176,6 +1176,7 @@ void BaseWebServerApplication::createComputeGB(){
 
         //Perform the operation.
         std::list<OperationArgPkg> PackedOperation = { op_args };
+        Drover DICOM_data_backup(this->DICOM_data); // Shallow; only shared pointers are copied.
         try{
             if(!Operation_Dispatcher( this->DICOM_data, 
                                       this->InvocationMetadata, 
@@ -1184,6 +1185,7 @@ void BaseWebServerApplication::createComputeGB(){
                 throw std::runtime_error("Return value non-zero (non-descript error condition)");
             }
         }catch(const std::exception &e){
+            this->DICOM_data = std::move(DICOM_data_backup);
             feedback->setText("<p>Operation failed: "_s + e.what() + ".</p>");
             AllSuccessful = false;
             //return;
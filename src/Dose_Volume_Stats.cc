@@ -0,0 +1,364 @@
+//Dose_Volume_Stats.cc.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+#include "Thread_Pool.h"
+#include "YgorImages_Functors/ROI_Mask_Cache.h"
+#include "Dose_Volume_Stats.h"
+
+
+double
+Dose_Volume_Stats::Mean() const {
+    if(this->N_voxels == 0) return std::numeric_limits<double>::quiet_NaN();
+    return this->D_shift + this->S1 / static_cast<double>(this->N_voxels);
+}
+
+double
+Dose_Volume_Stats::Std_Dev() const {
+    if(this->N_voxels < 2) return std::numeric_limits<double>::quiet_NaN();
+    const auto N = static_cast<double>(this->N_voxels);
+    const auto var = (this->S2 - this->S1 * this->S1 / N) / (N - 1.0);
+    return std::sqrt( std::max(0.0, var) );
+}
+
+double
+Dose_Volume_Stats::Dx(double fraction) const {
+    if(this->N_voxels == 0) return std::numeric_limits<double>::quiet_NaN();
+    fraction = std::clamp(fraction, 0.0, 1.0);
+
+    // Walk down from the hottest bin until the requested volume has been covered.
+    const auto target = fraction * static_cast<double>(this->N_voxels);
+    if(target <= 0.0) return this->D_max;
+    double cumulative = 0.0;
+    for(size_t k = this->bins.size(); 0 < k--; ){
+        const auto c = static_cast<double>(this->bins[k]);
+        if(c == 0.0) continue;
+        if(target <= (cumulative + c)){
+            const auto upper = this->bin_low + this->bin_width * static_cast<double>(k + 1);
+            const auto D = upper - this->bin_width * (target - cumulative) / c;
+            return std::clamp(D, this->D_min, this->D_max);
+        }
+        cumulative += c;
+    }
+    return this->D_min;
+}
+
+double
+Dose_Volume_Stats::Vx(double dose) const {
+    if(this->N_voxels == 0) return std::numeric_limits<double>::quiet_NaN();
+    if(dose < this->D_min) return 1.0;
+    if(this->D_max <= dose) return 0.0;
+
+    const auto N_bins = static_cast<long int>(this->bins.size());
+    const auto k = std::clamp(static_cast<long int>(std::floor((dose - this->bin_low) / this->bin_width)), 0L, N_bins - 1L);
+    double above = 0.0;
+    for(auto j = k + 1; j < N_bins; ++j) above += static_cast<double>(this->bins[j]);
+
+    const auto upper = this->bin_low + this->bin_width * static_cast<double>(k + 1);
+    const auto partial = std::clamp((upper - dose) / this->bin_width, 0.0, 1.0);
+    above += partial * static_cast<double>(this->bins[k]);
+    return above / static_cast<double>(this->N_voxels);
+}
+
+double
+Dose_Volume_Stats::Percentile(double q) const {
+    return this->Dx(1.0 - q);
+}
+
+std::map<double,double>
+Dose_Volume_Stats::Cumulative_DVH() const {
+    std::map<double,double> out;
+    if(this->N_voxels == 0) return out;
+
+    const auto N = static_cast<double>(this->N_voxels);
+    double above = 0.0;
+    for(size_t k = this->bins.size(); 0 < k--; ){
+        above += static_cast<double>(this->bins[k]);
+        out[this->bin_low + this->bin_width * static_cast<double>(k)] = above / N;
+    }
+    out[this->bin_low + this->bin_width * static_cast<double>(this->bins.size())] = 0.0;
+    return out;
+}
+
+void
+Dose_Volume_Stats::Merge(const Dose_Volume_Stats &other){
+    if(other.N_voxels == 0) return;
+    if(this->N_voxels == 0){
+        this->D_min = other.D_min;
+        this->D_max = other.D_max;
+    }else{
+        this->D_min = std::min(this->D_min, other.D_min);
+        this->D_max = std::max(this->D_max, other.D_max);
+    }
+    this->N_voxels += other.N_voxels;
+    this->voxel_volume += other.voxel_volume;
+    this->S1 += other.S1;
+    this->S2 += other.S2;
+
+    if(this->bins.size() < other.bins.size()) this->bins.resize(other.bins.size(), 0);
+    for(size_t k = 0; k < other.bins.size(); ++k) this->bins[k] += other.bins[k];
+    return;
+}
+
+
+namespace {
+
+using geom_key_t = std::tuple< std::array<double, 15>, std::array<long int, 3> >;
+
+geom_key_t
+make_geom_key(const planar_image<float,double> &img){
+    return std::make_tuple( std::array<double, 15>{{ img.pxl_dx, img.pxl_dy, img.pxl_dz,
+                                                     img.anchor.x, img.anchor.y, img.anchor.z,
+                                                     img.offset.x, img.offset.y, img.offset.z,
+                                                     img.row_unit.x, img.row_unit.y, img.row_unit.z,
+                                                     img.col_unit.x, img.col_unit.y, img.col_unit.z }},
+                            std::array<long int, 3>{{ img.rows, img.columns, img.channels }} );
+}
+
+// Voxel values for a group of images with identical geometry. A single image is used in-place; otherwise the first
+// channel of each image is summed into a buffer.
+struct voxel_source {
+    const planar_image<float,double> *img = nullptr;
+    const float *vals = nullptr;
+    long int stride = 1;
+};
+
+voxel_source
+get_voxel_source(const std::vector<const planar_image<float,double> *> &group, std::vector<float> &buffer){
+    voxel_source vs;
+    vs.img = group.front();
+    const auto N_vox = vs.img->rows * vs.img->columns;
+    if(group.size() == 1){
+        vs.vals = vs.img->data.data();
+        vs.stride = vs.img->channels;
+        return vs;
+    }
+
+    buffer.assign(static_cast<size_t>(N_vox), 0.0f);
+    for(const auto &img_ptr : group){
+        const auto chns = img_ptr->channels;
+        for(long int i = 0; i < N_vox; ++i) buffer[i] += img_ptr->data[i * chns];
+    }
+    vs.vals = buffer.data();
+    vs.stride = 1;
+    return vs;
+}
+
+} // namespace
+
+
+std::vector<Dose_Volume_Stats>
+Compute_Dose_Volume_Stats(const std::list<std::reference_wrapper<const planar_image<float,double>>> &imgs,
+                          const std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> &rois,
+                          size_t N_bins){
+    return Compute_Dose_Volume_Stats(std::vector<std::list<std::reference_wrapper<const planar_image<float,double>>>>{ imgs },
+                                     rois, N_bins).front();
+}
+
+std::vector<std::vector<Dose_Volume_Stats>>
+Compute_Dose_Volume_Stats(const std::vector<std::list<std::reference_wrapper<const planar_image<float,double>>>> &dose_arrays,
+                          const std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> &rois,
+                          size_t N_bins){
+    if(N_bins == 0){
+        throw std::invalid_argument("At least one histogram bin is required. Cannot continue.");
+    }
+    const auto N_arrays = dose_arrays.size();
+    const auto N_rois = rois.size();
+
+    // Group images of each dose array that share a geometry so that partial doses are summed. Images from distinct dose
+    // arrays are never summed.
+    std::vector<std::vector<const planar_image<float,double> *>> groups;
+    std::vector<size_t> group_array;
+    for(size_t a = 0; a < N_arrays; ++a){
+        std::map<geom_key_t, size_t> group_index;
+        for(const auto &img_refw : dose_arrays[a]){
+            const auto &img = img_refw.get();
+            if((img.rows <= 0) || (img.columns <= 0) || (img.channels <= 0)) continue;
+            const auto key = make_geom_key(img);
+            const auto it = group_index.find(key);
+            if(it == group_index.end()){
+                group_index[key] = groups.size();
+                groups.push_back({ &img });
+                group_array.push_back(a);
+            }else{
+                groups[it->second].push_back(&img);
+            }
+        }
+    }
+    const auto N_groups = groups.size();
+
+    // Masks are shared with (and cached alongside) those used by Mutate_Voxels()-based operations.
+    Mutate_Voxels_Opts mv_opts;
+    mv_opts.inclusivity = Mutate_Voxels_Opts::Inclusivity::Centre;
+    mv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::Ignore;
+
+    std::vector<ROI_Contours_Fingerprint> roi_fps;
+    for(const auto &roi : rois) roi_fps.push_back( Fingerprint_ROI_Contours(roi) );
+
+    // Bins span the full range of (summed) voxel values so that every dose array and ROI shares the same binning.
+    std::vector<std::pair<double,double>> group_range(N_groups, { std::numeric_limits<double>::infinity(),
+                                                                  -std::numeric_limits<double>::infinity() });
+    parallel_for(0, N_groups, [&](size_t g) -> void {
+        std::vector<float> buffer;
+        const auto vs = get_voxel_source(groups[g], buffer);
+        const auto N_vox = vs.img->rows * vs.img->columns;
+        auto &r = group_range[g];
+        for(long int i = 0; i < N_vox; ++i){
+            const auto v = static_cast<double>(vs.vals[i * vs.stride]);
+            if(!std::isfinite(v)) continue;
+            r.first  = std::min(r.first, v);
+            r.second = std::max(r.second, v);
+        }
+    }, 1);
+
+    double D_low  = std::numeric_limits<double>::infinity();
+    double D_high = -std::numeric_limits<double>::infinity();
+    for(const auto &r : group_range){
+        D_low  = std::min(D_low, r.first);
+        D_high = std::max(D_high, r.second);
+    }
+    if(!std::isfinite(D_low) || !std::isfinite(D_high)){
+        D_low  = 0.0;
+        D_high = 0.0;
+    }
+    const double D_shift = 0.5 * (D_low + D_high);
+    const double bin_width = (D_low < D_high) ? (D_high - D_low) / static_cast<double>(N_bins) : 1.0;
+    const double inv_bin_width = 1.0 / bin_width;
+    const auto last_bin = static_cast<long int>(N_bins) - 1L;
+
+    auto make_empty = [&]() -> Dose_Volume_Stats {
+        Dose_Volume_Stats s;
+        s.D_shift = D_shift;
+        s.bin_low = D_low;
+        s.bin_width = bin_width;
+        return s;
+    };
+
+    // Moments are accumulated separately for every image group and ROI, and then reduced in group order, so that the
+    // result is reproducible regardless of the number of threads. Histogram counts are integers, so they can be
+    // accumulated in any order; each thread borrows a private set of histograms (one per dose array and ROI), which are
+    // merged at the end.
+    struct roi_moments {
+        uint64_t N_voxels = 0;
+        double voxel_volume = 0.0;
+        double D_min = 0.0;
+        double D_max = 0.0;
+        double S1 = 0.0;
+        double S2 = 0.0;
+    };
+    std::vector<roi_moments> moments(N_groups * N_rois);
+
+    using histograms_t = std::vector<std::vector<uint64_t>>;
+    std::mutex histograms_m;
+    std::list<histograms_t> histograms;
+    std::vector<histograms_t *> idle_histograms;
+
+    parallel_for(0, N_groups, [&](size_t g) -> void {
+        const auto &img = *(groups[g].front());
+        const auto a = group_array[g];
+        const auto voxel_volume = img.pxl_dx * img.pxl_dy * img.pxl_dz;
+        const auto chns = static_cast<uint64_t>(img.channels);
+
+        histograms_t *hists = nullptr;
+        bool have_source = false;
+        std::vector<float> buffer;
+        voxel_source vs;
+
+        for(size_t n = 0; n < N_rois; ++n){
+            if(rois[n].empty()) continue;
+            const auto mask = Get_ROI_Mask(img, rois[n], roi_fps[n], mv_opts);
+            if(mask->runs.empty()) continue;
+
+            if(!have_source){
+                vs = get_voxel_source(groups[g], buffer);
+                have_source = true;
+            }
+            if(hists == nullptr){
+                std::lock_guard<std::mutex> lock(histograms_m);
+                if(idle_histograms.empty()){
+                    histograms.emplace_back(N_arrays * N_rois);
+                    hists = &(histograms.back());
+                }else{
+                    hists = idle_histograms.back();
+                    idle_histograms.pop_back();
+                }
+            }
+            auto &bins = (*hists)[a * N_rois + n];
+            if(bins.empty()) bins.assign(N_bins, 0);
+
+            // Only the first channel is used.
+            auto &m = moments[g * N_rois + n];
+            for(const auto &run : mask->runs){
+                for(auto i = ((run.first + chns - 1) / chns) * chns; i < run.second; i += chns){
+                    const auto v = static_cast<double>(vs.vals[(i / chns) * vs.stride]);
+                    if(!std::isfinite(v)) continue;
+
+                    if(m.N_voxels == 0){
+                        m.D_min = v;
+                        m.D_max = v;
+                    }else{
+                        m.D_min = std::min(m.D_min, v);
+                        m.D_max = std::max(m.D_max, v);
+                    }
+                    ++(m.N_voxels);
+                    m.voxel_volume += voxel_volume;
+                    const auto dv = v - D_shift;
+                    m.S1 += dv;
+                    m.S2 += dv * dv;
+                    const auto b = std::clamp(static_cast<long int>((v - D_low) * inv_bin_width), 0L, last_bin);
+                    ++(bins[b]);
+                }
+            }
+        }
+
+        if(hists != nullptr){
+            std::lock_guard<std::mutex> lock(histograms_m);
+            idle_histograms.push_back(hists);
+        }
+    }, 1);
+
+    std::vector<std::vector<Dose_Volume_Stats>> out(N_arrays, std::vector<Dose_Volume_Stats>(N_rois, make_empty()));
+    for(size_t a = 0; a < N_arrays; ++a) for(size_t n = 0; n < N_rois; ++n){
+        auto &s = out[a][n];
+        s.bins.assign(N_bins, 0);
+        for(size_t g = 0; g < N_groups; ++g){
+            if(group_array[g] != a) continue;
+            const auto &m = moments[g * N_rois + n];
+            if(m.N_voxels == 0) continue;
+            if(s.N_voxels == 0){
+                s.D_min = m.D_min;
+                s.D_max = m.D_max;
+            }else{
+                s.D_min = std::min(s.D_min, m.D_min);
+                s.D_max = std::max(s.D_max, m.D_max);
+            }
+            s.N_voxels += m.N_voxels;
+            s.voxel_volume += m.voxel_volume;
+            s.S1 += m.S1;
+            s.S2 += m.S2;
+        }
+        for(const auto &hists : histograms){
+            const auto &bins = hists[a * N_rois + n];
+            for(size_t k = 0; k < bins.size(); ++k) s.bins[k] += bins[k];
+        }
+    }
+    return out;
+}
+
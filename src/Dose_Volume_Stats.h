@@ -0,0 +1,83 @@
+//Dose_Volume_Stats.h.
+//
+// Single-pass dose-volume histogram and dose statistics for collections of ROIs.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+
+template <class T, class R> class planar_image;
+template <class T> class contour_collection;
+
+
+// Dose statistics for a single ROI. Moments, minimum, and maximum are exact. Quantities that depend on the dose
+// distribution (Dx, Vx, and percentiles) are derived from a fixed-bin differential histogram, assuming voxels are
+// uniformly distributed within each bin, so they are accurate to within a bin width. All ROIs computed together share
+// the same binning.
+struct Dose_Volume_Stats {
+    uint64_t N_voxels = 0;
+    double voxel_volume = 0.0; // Total volume of the bounded voxels (in DICOM units; mm^3).
+
+    double D_min = 0.0;
+    double D_max = 0.0;
+
+    // Running sums of (D - D_shift) and (D - D_shift)^2. The shift is common to all ROIs and reduces cancellation.
+    double D_shift = 0.0;
+    double S1 = 0.0;
+    double S2 = 0.0;
+
+    double bin_low = 0.0;
+    double bin_width = 1.0;
+    std::vector<uint64_t> bins; // Differential histogram.
+
+    double Mean() const;
+    double Std_Dev() const; // Unbiased estimate; NaN when fewer than two voxels are present.
+
+    // The minimum dose received by the hottest 'fraction' of the volume. Dx(0.95) is D95; Dx(0.5) is the median.
+    double Dx(double fraction) const;
+
+    // The fraction of the volume receiving more than the given dose.
+    double Vx(double dose) const;
+
+    // The dose below which the given fraction of voxels lie. Percentile(0.98) == Dx(0.02).
+    double Percentile(double q) const;
+
+    // Cumulative DVH sampled at the lower edge of every bin: dose -> fraction of the volume receiving more.
+    std::map<double,double> Cumulative_DVH() const;
+
+    // Combines statistics accumulated with identical binning.
+    void Merge(const Dose_Volume_Stats &other);
+};
+
+
+// Computes dose statistics for each ROI in a single, parallel pass over the images.
+//
+// Each ROI is a set of contour collections. Voxels are bounded when their centre lies within a contour, and the contours
+// of an ROI on a given image are combined via union, so every voxel is counted at most once per ROI. Masks are provided
+// by Get_ROI_Mask(), so they match (and are cached alongside) those used by Mutate_Voxels()-based operations.
+//
+// Images that share an identical geometry are treated as partial doses and summed voxel-wise. Only the first channel is
+// used. Non-finite voxels are ignored.
+//
+// The returned vector has one element per ROI, in the order provided.
+std::vector<Dose_Volume_Stats>
+Compute_Dose_Volume_Stats(const std::list<std::reference_wrapper<const planar_image<float,double>>> &imgs,
+                          const std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> &rois,
+                          size_t N_bins = 4096);
+
+// As above, but statistics are computed separately for each dose array, e.g., for each plan of a multi-plan dose.
+// Images are only summed within a dose array. All dose arrays and ROIs share the same binning, so the results can be
+// merged to pool voxels across dose arrays.
+//
+// The returned vector is indexed as [dose array][ROI].
+std::vector<std::vector<Dose_Volume_Stats>>
+Compute_Dose_Volume_Stats(const std::vector<std::list<std::reference_wrapper<const planar_image<float,double>>>> &dose_arrays,
+                          const std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> &rois,
+                          size_t N_bins = 4096);
+
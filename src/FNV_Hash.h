@@ -0,0 +1,39 @@
+//FNV_Hash.h.
+//
+// A small incremental hash for deriving cache keys from in-memory data.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+
+// FNV-1a, applied to whole 64-bit words rather than individual bytes so that hashing large amounts of numeric data is
+// inexpensive. Each word is passed through a bijective avalanche mix before it is folded in; without it, a plain
+// word-wise FNV-1a step cannot propagate the high bits, so e.g. flipping the sign bit of any two words would produce
+// the same digest. Values are mixed in the order they are added, so the same values added in a different order produce
+// a distinct digest. This hash is not suitable for adversarial inputs, and matching digests do not imply matching
+// inputs.
+struct fnv1a_hash {
+    uint64_t h = 14695981039346656037ULL;
+
+    void add(uint64_t u){
+        // The 64-bit finalizer from MurmurHash3.
+        u ^= u >> 33;
+        u *= 0xFF51AFD7ED558CCDULL;
+        u ^= u >> 33;
+        u *= 0xC4CEB9FE1A85EC53ULL;
+        u ^= u >> 33;
+
+        this->h ^= u;
+        this->h *= 1099511628211ULL;
+    }
+
+    void add(double x){
+        if(x == 0.0) x = 0.0; // Normalize the sign of zero.
+        uint64_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        this->add(u);
+    }
+};
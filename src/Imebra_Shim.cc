@@ -21,10 +21,13 @@
 #include <list>
 #include <map>
 #include <memory>         //Needed for std::unique_ptr.
+#include <mutex>
 #include <random>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <tuple>
+#include <typeinfo>
 #include <utility>        //Needed for std::pair.
 #include <vector>
 
@@ -38,6 +41,7 @@
 #include "Imebra_Shim.h"
 #include "DCMA_DICOM.h"
 #include "Structs.h"
+#include "Thread_Pool.h"
 #include "YgorContainers.h" //Needed for 'bimap' class.
 #include "YgorMath.h"       //Needed for 'vec3' class.
 #include "YgorMisc.h"       //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
@@ -46,6 +50,10 @@
 #include "YgorTAR.h"
 
 
+//Metadata key that flags images whose pixels have not (yet) been decoded. See Has_Deferred_Pixels().
+static const std::string deferred_pixel_flag = "DeferredPixels";
+
+
 std::string Generate_Random_UID(long int len){
     std::string out;
     const std::string alphanum(R"***(.0123456789)***");
@@ -89,6 +97,34 @@ std::string Generate_Random_Int_Str(long int L, long int H){
     return std::to_string(dist(gen));
 }
 
+//----------------- Parsed files ------------------
+
+//Holds a fully-parsed DICOM file. Only the shim knows what is inside.
+struct Parsed_DICOM_File {
+    std::string filename;
+    puntoexe::ptr<puntoexe::imebra::dataSet> tds;
+};
+
+std::shared_ptr<Parsed_DICOM_File> Parse_DICOM_File(const std::string &filename){
+    using namespace puntoexe;
+    ptr<puntoexe::stream> readStream(new puntoexe::stream);
+    readStream->openFile(filename.c_str(), std::ios::in);
+    if(readStream == nullptr){
+        throw std::runtime_error("Unable to open file '"_s + filename + "'");
+    }
+
+    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
+    ptr<imebra::dataSet> tds = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+    if(tds == nullptr){
+        throw std::runtime_error("Unable to parse file '"_s + filename + "' as DICOM");
+    }
+
+    auto out = std::make_shared<Parsed_DICOM_File>();
+    out->filename = filename;
+    out->tds = tds;
+    return out;
+}
+
 //----------------- Accessors ---------------------
 
 // seq_group,seq_tag,seq_name or tag_group,tag_tag,tag_name.
@@ -591,15 +627,18 @@ FUNCINFO("    This node is a leaf node. Creating a leaf tag");
 //
 //NOTE: On error, the output will be an empty string.
 std::string get_tag_as_string(const std::string &filename, size_t U, size_t L){
-    using namespace puntoexe;
-    ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(filename.c_str(), std::ios::in);
-    if(readStream == nullptr) return std::string("");
+    std::shared_ptr<Parsed_DICOM_File> pf;
+    try{
+        pf = Parse_DICOM_File(filename);
+    }catch(const std::exception &){
+        return std::string("");
+    }
+    return get_tag_as_string(pf, U, L);
+}
 
-    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    ptr<imebra::dataSet> TopDataSet = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
-    if(TopDataSet == nullptr) return std::string("");
-    return TopDataSet->getString(U, 0, L, 0);
+std::string get_tag_as_string(const std::shared_ptr<Parsed_DICOM_File> &pf, size_t U, size_t L){
+    if( (pf == nullptr) || (pf->tds == nullptr) ) return std::string("");
+    return pf->tds->getString(U, 0, L, 0);
 }
 
 std::string get_modality(const std::string &filename){
@@ -607,6 +646,10 @@ std::string get_modality(const std::string &filename){
     return get_tag_as_string(filename,0x0008,0x0060);
 }
 
+std::string get_modality(const std::shared_ptr<Parsed_DICOM_File> &pf){
+    return get_tag_as_string(pf,0x0008,0x0060);
+}
+
 std::string get_patient_ID(const std::string &filename){
     //Should exist in each DICOM file.
     return get_tag_as_string(filename,0x0010,0x0020);
@@ -616,21 +659,27 @@ std::string get_patient_ID(const std::string &filename){
 //
 //NOTE: May not be complete. Add additional tags as needed!
 std::map<std::string,std::string> get_metadata_top_level_tags(const std::string &filename){
+    std::shared_ptr<Parsed_DICOM_File> pf;
+    try{
+        pf = Parse_DICOM_File(filename);
+    }catch(const std::exception &e){
+        FUNCWARN("Could not parse file '" << filename << "': " << e.what() << ". Is it valid DICOM? Cannot continue");
+        return std::map<std::string,std::string>();
+    }
+    return get_metadata_top_level_tags(pf);
+}
+
+std::map<std::string,std::string> get_metadata_top_level_tags(const std::shared_ptr<Parsed_DICOM_File> &pf){
     std::map<std::string,std::string> out;
     const auto ctrim = CANONICALIZE::TRIM_ENDS;
 
-    //Attempt to parse the DICOM file and harvest the elements of interest. We are only interested in
-    // top-level elements specifying metadata (i.e., not pixel data) and will not need to recurse into 
-    // any DICOM sequences.
-    puntoexe::ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(filename.c_str(), std::ios::in);
-    if(readStream == nullptr){
-        FUNCWARN("Could not parse file '" << filename << "'. Is it valid DICOM? Cannot continue");
+    //Harvest the elements of interest from the parsed DICOM file. We are only interested in top-level elements
+    // specifying metadata (i.e., not pixel data) and will not need to recurse into any DICOM sequences.
+    if( (pf == nullptr) || (pf->tds == nullptr) ){
+        FUNCWARN("Could not parse file. Is it valid DICOM? Cannot continue");
         return out;
     }
-
-    puntoexe::ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    puntoexe::ptr<puntoexe::imebra::dataSet> tds = puntoexe::imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+    puntoexe::ptr<puntoexe::imebra::dataSet> tds = pf->tds;
 
     //We pull out all the data we need as strings. For single element strings, the SQL engine can directly perform
     // the type casting. The benefit of this is twofold: (1) the SQL engine hides the checking code, simplifying
@@ -1125,12 +1174,12 @@ std::map<std::string,std::string> get_metadata_top_level_tags(const std::string
 //Returns a bimap with the (raw) ROI tags and their corresponding ROI numbers. The ROI numbers are
 // arbitrary identifiers used within the DICOM file to identify contours more conveniently.
 bimap<std::string,long int> get_ROI_tags_and_numbers(const std::string &FilenameIn){
-    using namespace puntoexe;
-    ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(FilenameIn.c_str(), std::ios::in);
+    return get_ROI_tags_and_numbers( Parse_DICOM_File(FilenameIn) );
+}
 
-    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    ptr<imebra::dataSet> TopDataSet = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+bimap<std::string,long int> get_ROI_tags_and_numbers(const std::shared_ptr<Parsed_DICOM_File> &pf){
+    using namespace puntoexe;
+    ptr<imebra::dataSet> TopDataSet = pf->tds;
     ptr<imebra::dataSet> SecondDataSet;
 
     size_t i=0, j;
@@ -1165,16 +1214,17 @@ bimap<std::string,long int> get_ROI_tags_and_numbers(const std::string &Filename
 
 //Returns contour data from a DICOM RTSTRUCT file sorted into ROI-specific collections.
 std::unique_ptr<Contour_Data> get_Contour_Data(const std::string &filename){
+    return get_Contour_Data( Parse_DICOM_File(filename) );
+}
+
+std::unique_ptr<Contour_Data> get_Contour_Data(const std::shared_ptr<Parsed_DICOM_File> &pf){
     auto output = std::make_unique<Contour_Data>();
-    bimap<std::string,long int> tags_names_and_numbers = get_ROI_tags_and_numbers(filename);
+    bimap<std::string,long int> tags_names_and_numbers = get_ROI_tags_and_numbers(pf);
 
-    auto FileMetadata = get_metadata_top_level_tags(filename);
+    auto FileMetadata = get_metadata_top_level_tags(pf);
 
     using namespace puntoexe;
-    ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(filename.c_str(), std::ios::in);
-    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    ptr<imebra::dataSet> TopDataSet = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+    ptr<imebra::dataSet> TopDataSet = pf->tds;
     ptr<imebra::dataSet> SecondDataSet, ThirdDataSet;
 
     //Collect the data into a container of contours with meta info. It may be unordered (within the file).
@@ -1253,21 +1303,91 @@ std::unique_ptr<Contour_Data> get_Contour_Data(const std::string &filename){
 
 
 //-------------------- Images ----------------------
+
+template <class T>
+static
+void
+convert_pixels_to_float(const T *in, float *out, size_t N, float scale, float intercept){
+    //Written as a simple loop over contiguous memory so the compiler can vectorize it.
+    for(size_t i = 0; i < N; ++i){
+        out[i] = static_cast<float>(in[i]) * scale + intercept;
+    }
+    return;
+}
+
+//Copies all pixel data from an Imebra data handler into an image in one pass, bypassing per-element virtual calls.
+//
+// The handler's native storage type is detected and the whole buffer is converted at once. The image buffer must
+// already be allocated. Values are mapped as (value * scale + intercept). Returns false (without modifying the image) if the bulk path cannot be used, e.g., if the
+// storage type is not recognized or the image memory layout differs from Imebra's; the caller should then fall back
+// on per-element access.
+static
+bool
+bulk_copy_pixels_to_float(const puntoexe::ptr<puntoexe::imebra::handlers::dataHandlerNumericBase> &handler,
+                          planar_image<float,double> &img,
+                          float scale = 1.0f,
+                          float intercept = 0.0f){
+    if(handler == nullptr) return false;
+
+    const auto rows = img.rows;
+    const auto cols = img.columns;
+    const auto chnls = img.channels;
+    if((rows <= 0) || (cols <= 0) || (chnls <= 0)) return false;
+    const auto N = static_cast<size_t>(rows * cols * chnls);
+    if( (img.data.size() != N)
+    ||  (static_cast<size_t>(handler->getSize()) < N) ) return false;
+
+    //Imebra stores pixels row-major with channels interleaved. Confirm the image uses the same layout.
+    if( (img.index(0,0,0) != 0)
+    ||  (img.index(0,0,chnls-1) != (chnls-1))
+    ||  (img.index(0,1,0) != chnls)
+    ||  (img.index(1 % rows, 0, 0) != ((1 % rows) * cols * chnls))
+    ||  (img.index(rows-1,cols-1,chnls-1) != static_cast<long int>(N-1)) ) return false;
+
+    using namespace puntoexe::imebra::handlers;
+    const dataHandlerNumericBase *h = handler.get();
+    const imbxUint8 *mem = handler->getMemoryBuffer();
+    float *out = img.data.data();
+    if(mem == nullptr) return false;
+
+    if(false){
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<imbxUint8>)){
+        convert_pixels_to_float(reinterpret_cast<const imbxUint8 *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<imbxInt8>)){
+        convert_pixels_to_float(reinterpret_cast<const imbxInt8 *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<imbxUint16>)){
+        convert_pixels_to_float(reinterpret_cast<const imbxUint16 *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<imbxInt16>)){
+        convert_pixels_to_float(reinterpret_cast<const imbxInt16 *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<imbxUint32>)){
+        convert_pixels_to_float(reinterpret_cast<const imbxUint32 *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<imbxInt32>)){
+        convert_pixels_to_float(reinterpret_cast<const imbxInt32 *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<float>)){
+        convert_pixels_to_float(reinterpret_cast<const float *>(mem), out, N, scale, intercept);
+    }else if(typeid(*h) == typeid(dataHandlerNumeric<double>)){
+        convert_pixels_to_float(reinterpret_cast<const double *>(mem), out, N, scale, intercept);
+    }else{
+        return false;
+    }
+    return true;
+}
+
 //This routine will often result in an array with only a single image. So collate output as needed.
 //
-// NOTE: I believe this routine is only valid for single frame images, like common CT and MR images.
-//       PT and US have not been tested. RTDOSE files should use the Load_Dose_Array code, which 
-//       handles multi-frame images (and thus might be adaptable for other non-RTDOSE multi-frame 
-//       images).
+// NOTE: Multi-frame images (e.g., enhanced CT and MR, multi-frame PET) are supported. Each frame becomes a separate
+//       image in the returned array. Per-frame geometry and rescaling are taken from the per-frame functional groups,
+//       falling back on the shared functional groups and then the top-level tags. RTDOSE files should use the
+//       Load_Dose_Array code.
 std::unique_ptr<Image_Array> Load_Image_Array(const std::string &FilenameIn){
+    return Load_Image_Array( Parse_DICOM_File(FilenameIn) );
+}
+
+std::unique_ptr<Image_Array> Load_Image_Array(const std::shared_ptr<Parsed_DICOM_File> &pf, bool defer_pixels){
     auto out = std::make_unique<Image_Array>();
 
     using namespace puntoexe;
-    ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(FilenameIn.c_str(), std::ios::in);
-
-    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    ptr<imebra::dataSet> TopDataSet = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+    ptr<imebra::dataSet> TopDataSet = pf->tds;
 
     //Helper routines that do not create tags when they are missing.
     //
@@ -1399,10 +1519,9 @@ std::unique_ptr<Image_Array> Load_Image_Array(const std::string &FilenameIn){
     const vec3<double> image_anchor  = vec3<double>(0.0,0.0,0.0); //Could us RTIMAGE IsocenterPosition (300a,012c) ?
 
     //Determine how many frames there are in the pixel data. A CT scan may just be a 2d jpeg or something, 
-    // but dose pixel data is 3d data composed of 'frames' of stacked 2d data.
-    const auto frame_count = retrieve_coalesce_as_long_int({ {0x0028, 0x0008, 0} }).value_or(0.0);
-    if(frame_count != 0) throw std::domain_error("This routine only supports 2D images."
-                                                 " Adapt the dose array loading code. Cannot continue");
+    // but enhanced (multi-frame) objects store a whole series as 'frames' of stacked 2d data.
+    const auto frame_count = static_cast<long int>(retrieve_coalesce_as_long_int({ {0x0028, 0x0008, 0} }).value_or(0.0));
+    const long int N_frames = std::max(1L, frame_count);
 
     const auto image_rows  = retrieve_coalesce_as_long_int({ {0x0028, 0x0010, 0} }).value();
     const auto image_cols  = retrieve_coalesce_as_long_int({ {0x0028, 0x0011, 0} }).value();
@@ -1443,146 +1562,316 @@ std::unique_ptr<Image_Array> Load_Image_Array(const std::string &FilenameIn){
         //       in this routine.
     }
 
+    // ------------------------------------- Multi-frame Geometry -------------------------------------------
+    //Enhanced objects store the geometry and rescaling of each frame in functional group sequences, either shared by all
+    // frames or specific to each frame. Both are located once here and consulted for each frame below.
+    ptr<imebra::dataSet> shared_fg = TopDataSet->getSequenceItem(0x5200, 0, 0x9229, 0); // "SharedFunctionalGroupsSequence".
+    std::vector<ptr<imebra::dataSet>> per_frame_fgs;
+    per_frame_fgs.reserve(N_frames);
+    for(long int i = 0; i < N_frames; ++i){
+        ptr<imebra::dataSet> fg = TopDataSet->getSequenceItem(0x5200, 0, 0x9230, static_cast<imbxUint32>(i)); // "PerFrameFunctionalGroupsSequence".
+        if(fg == nullptr) break;
+        per_frame_fgs.emplace_back(fg);
+    }
+
+    //Retrieves an element from a functional group macro, preferring the per-frame item over the shared item.
+    auto retrieve_fg_as_double = [&](long int frame,
+                                     uint16_t seq_group, uint16_t seq_tag,
+                                     uint16_t group, uint16_t tag,
+                                     uint32_t element = 0) -> std::optional<double> {
+        std::optional<double> out;
+        std::deque<path_node> apath = { path_node{ seq_group, seq_tag, 0, 0 },
+                                        path_node{ group, tag, 0, 0 } };
+        for(const auto &fg : { (frame < static_cast<long int>(per_frame_fgs.size())) ? per_frame_fgs[frame]
+                                                                                      : ptr<imebra::dataSet>(),
+                               shared_fg }){
+            if(fg == nullptr) continue;
+            const auto res = extract_seq_tag_as_string(fg, apath);
+            if(res.size() <= element) continue;
+            try{
+                out = std::stod(res[element]);
+                return out;
+            }catch(const std::exception &){}
+        }
+        return out;
+    };
+    auto retrieve_fg_as_string = [&](long int frame,
+                                     uint16_t seq_group, uint16_t seq_tag,
+                                     uint16_t group, uint16_t tag) -> std::optional<std::string> {
+        std::deque<path_node> apath = { path_node{ seq_group, seq_tag, 0, 0 },
+                                        path_node{ group, tag, 0, 0 } };
+        for(const auto &fg : { (frame < static_cast<long int>(per_frame_fgs.size())) ? per_frame_fgs[frame]
+                                                                                      : ptr<imebra::dataSet>(),
+                               shared_fg }){
+            if(fg == nullptr) continue;
+            const auto res = extract_seq_tag_as_string(fg, apath);
+            if(res.empty()) continue;
+            std::string out;
+            for(const auto &r : res){
+                const auto trimmed = Canonicalize_String2(r, CANONICALIZE::TRIM_ENDS);
+                out += (out.empty() ? ""_s : R"***(\)***"_s) + trimmed;
+            }
+            if(!out.empty()) return out;
+        }
+        return std::nullopt;
+    };
+
+    //Some older multi-frame objects instead provide a list of offsets along the stacking direction.
+    std::vector<double> gfov;
+    try{
+        for(long int i = 0; (1 < N_frames) && (i < N_frames); ++i){
+            const auto val = retrieve_as_double(0x3004, 0x000c, static_cast<uint32_t>(i)); // "GridFrameOffsetVector".
+            if(!val) break;
+            gfov.push_back(val.value());
+        }
+    }catch(const std::exception &){ }
+    if(static_cast<long int>(gfov.size()) != N_frames) gfov.clear();
+
+    //Modality rescaling is handled by Imebra when it is provided at the top level. Otherwise it must be taken from the
+    // functional groups.
+    const bool has_top_level_rescale = (TopDataSet->getTag(0x0028, 0, 0x1053, false) != nullptr);
+
+    //When pixels are deferred, the channel count cannot be taken from the decoded image. Imebra converts everything to
+    // MONOCHROME2 except RTIMAGEs, which are taken as-is.
+    const auto deferred_channels = ( modality == "RTIMAGE" ) ? static_cast<imbxUint32>(retrieve_as_long_int(0x0028, 0x0002).value_or(1)) // "SamplesPerPixel".
+                                                             : static_cast<imbxUint32>(1);
+
     // --------------------------------------- Image Pixel Data ---------------------------------------------
-    {    
+
+    //Process image using modalityVOILUT transform to convert its pixel values into meaningful values.
+    // From what I can tell, this conversion is necessary to transform the raw data from a possibly
+    // manufacturer-specific, proprietary format into something physically meaningful for us. 
+    //
+    // I have not experimented with disabling this conversion. Leaving it intact causes the datum from
+    // a Philips "Interra" machine's PAR/REC format to coincide with the exported DICOM data.
+    //
+    // Note: The transform only depends on the top-level dataset, so a single instance is shared by all frames.
+    ptr<imebra::transforms::transform> modVOILUT(new imebra::transforms::modalityVOILUT(TopDataSet));
+
+    std::optional<std::string> file_uid; // The file's (i.e., not the frame's) SOPInstanceUID.
+    for(long int frame = 0; frame < N_frames; ++frame){
         out->imagecoll.images.emplace_back();
 
-        //--------------------------------------------------------------------------------------------------
-        //Retrieve the pixel data from file. This is an excessively long exercise!
-        ptr<puntoexe::imebra::image> firstImage;
-        try{
-            firstImage = TopDataSet->getImage(0);
-        }catch(const std::exception &e){
-            throw std::domain_error("This file does not have accessible pixel data."
-                                    " The DICOM image loader should not be called for this file");
-        }
+        //Pixel data are retrieved here unless they are being deferred, in which case only the geometry is set up.
+        ptr<puntoexe::imebra::handlers::dataHandlerNumericBase> myHandler;
+        imbxUint32 channelPixelSize = 0;
+        imbxUint32 channelsNumber = deferred_channels;
+        if(!defer_pixels){
+            //--------------------------------------------------------------------------------------------------
+            //Retrieve the pixel data from file. This is an excessively long exercise!
+            ptr<puntoexe::imebra::image> firstImage;
+            try{
+                firstImage = TopDataSet->getImage(static_cast<imbxUint32>(frame));
+            }catch(const std::exception &e){
+                throw std::domain_error("This file does not have accessible pixel data."
+                                        " The DICOM image loader should not be called for this file");
+            }
+            if(firstImage == nullptr){
+                throw std::domain_error("Frame "_s + std::to_string(frame) + " does not have accessible pixel data");
+            }
     
-        //Process image using modalityVOILUT transform to convert its pixel values into meaningful values.
-        // From what I can tell, this conversion is necessary to transform the raw data from a possibly
-        // manufacturer-specific, proprietary format into something physically meaningful for us. 
-        //
-        // I have not experimented with disabling this conversion. Leaving it intact causes the datum from
-        // a Philips "Interra" machine's PAR/REC format to coincide with the exported DICOM data.
-        ptr<imebra::transforms::transform> modVOILUT(new imebra::transforms::modalityVOILUT(TopDataSet));
-        imbxUint32 width, height;
-        firstImage->getSize(&width, &height);
-        ptr<imebra::image> convertedImage(modVOILUT->allocateOutputImage(firstImage, width, height));
-        modVOILUT->runTransform(firstImage, 0, 0, width, height, convertedImage, 0, 0);
+            imbxUint32 width, height;
+            firstImage->getSize(&width, &height);
+            ptr<imebra::image> convertedImage(modVOILUT->allocateOutputImage(firstImage, width, height));
+            modVOILUT->runTransform(firstImage, 0, 0, width, height, convertedImage, 0, 0);
 
     
-        //Convert the 'convertedImage' into an image suitable for the viewing on screen. The VOILUT transform 
-        // applies the contrast suggested by the dataSet to the image. Apply the first one we find. Relevant
-        // DICOM tags reside around (0x0028,0x3010) and (0x0028,0x1050).
-        //
-        // This conversion uses the first suggested transformation found in the DICOM file, and will vary
-        // from file to file. Generally, the transformation scales the pixel values to cover the range of the
-        // available pixel range (i.e., u16). The transformation *CAN* induce clipping or truncation which 
-        // cannot be recovered from!
-        //
-        // Therefore, in my opinion, it is never worthwhile to perform this conversion. If you want to window
-        // or scale the values, you should do so as needed using the WindowCenter and WindowWidth values 
-        // directly.
-        //
-        // Report available conversions:
-        if(false){
-            ptr<imebra::transforms::VOILUT> myVoiLut(new imebra::transforms::VOILUT(TopDataSet));
-            std::vector<imbxUint32> VoiLutIds;
-            for(imbxUint32 i = 0;  ; ++i){
-                const auto VoiLutId = myVoiLut->getVOILUTId(i);
-                if(VoiLutId == 0) break;
-                VoiLutIds.push_back(VoiLutId);
-            }
-            //auto VoiLutIds = myVoiLut->getVOILUTIds();
-            for(auto VoiLutId : VoiLutIds){
-                const std::wstring VoiLutDescriptionWS = myVoiLut->getVOILUTDescription(VoiLutId);
-                const std::string VoiLutDescription(VoiLutDescriptionWS.begin(), VoiLutDescriptionWS.end());
-                FUNCINFO("Found 'presentation' VOI/LUT with description '" << VoiLutDescription << "' (not applying it!)");
-
-                //Print the center and width of the VOI/LUT.
-                imbxInt32 VoiLutCenter = std::numeric_limits<imbxInt32>::max();
-                imbxInt32 VoiLutWidth  = std::numeric_limits<imbxInt32>::max();
-                myVoiLut->getCenterWidth(&VoiLutCenter, &VoiLutWidth);
-                if((VoiLutCenter != std::numeric_limits<imbxInt32>::max())
-                || (VoiLutWidth  != std::numeric_limits<imbxInt32>::max())){
-                    FUNCINFO("    - 'Presentation' VOI/LUT has centre = " << VoiLutCenter << " and width = " << VoiLutWidth);
+            //Convert the 'convertedImage' into an image suitable for the viewing on screen. The VOILUT transform 
+            // applies the contrast suggested by the dataSet to the image. Apply the first one we find. Relevant
+            // DICOM tags reside around (0x0028,0x3010) and (0x0028,0x1050).
+            //
+            // This conversion uses the first suggested transformation found in the DICOM file, and will vary
+            // from file to file. Generally, the transformation scales the pixel values to cover the range of the
+            // available pixel range (i.e., u16). The transformation *CAN* induce clipping or truncation which 
+            // cannot be recovered from!
+            //
+            // Therefore, in my opinion, it is never worthwhile to perform this conversion. If you want to window
+            // or scale the values, you should do so as needed using the WindowCenter and WindowWidth values 
+            // directly.
+            //
+            // Report available conversions:
+            if(false){
+                ptr<imebra::transforms::VOILUT> myVoiLut(new imebra::transforms::VOILUT(TopDataSet));
+                std::vector<imbxUint32> VoiLutIds;
+                for(imbxUint32 i = 0;  ; ++i){
+                    const auto VoiLutId = myVoiLut->getVOILUTId(i);
+                    if(VoiLutId == 0) break;
+                    VoiLutIds.push_back(VoiLutId);
+                }
+                //auto VoiLutIds = myVoiLut->getVOILUTIds();
+                for(auto VoiLutId : VoiLutIds){
+                    const std::wstring VoiLutDescriptionWS = myVoiLut->getVOILUTDescription(VoiLutId);
+                    const std::string VoiLutDescription(VoiLutDescriptionWS.begin(), VoiLutDescriptionWS.end());
+                    FUNCINFO("Found 'presentation' VOI/LUT with description '" << VoiLutDescription << "' (not applying it!)");
+
+                    //Print the center and width of the VOI/LUT.
+                    imbxInt32 VoiLutCenter = std::numeric_limits<imbxInt32>::max();
+                    imbxInt32 VoiLutWidth  = std::numeric_limits<imbxInt32>::max();
+                    myVoiLut->getCenterWidth(&VoiLutCenter, &VoiLutWidth);
+                    if((VoiLutCenter != std::numeric_limits<imbxInt32>::max())
+                    || (VoiLutWidth  != std::numeric_limits<imbxInt32>::max())){
+                        FUNCINFO("    - 'Presentation' VOI/LUT has centre = " << VoiLutCenter << " and width = " << VoiLutWidth);
+                    }
                 }
             }
-        }
-        //
-        // Disable Imebra conversion:
-        ptr<imebra::image> presImage(convertedImage);
-        //
-        // Enable Imebra conversion:
-        //ptr<imebra::transforms::VOILUT> myVoiLut(new imebra::transforms::VOILUT(TopDataSet));
-        //imbxUint32 lutId = myVoiLut->getVOILUTId(0);
-        //myVoiLut->setVOILUT(lutId);
-        //ptr<imebra::image> presImage(myVoiLut->allocateOutputImage(convertedImage, width, height));
-        //myVoiLut->runTransform(convertedImage, 0, 0, width, height, presImage, 0, 0);
-        //{
-        //  //Print a description of the VOI/LUT if available.
-        //  //const std::wstring VoiLutDescriptionWS = myVoiLut->getVOILUTDescription(lutId);
-        //  //const std::string VoiLutDescription(VoiLutDescriptionWS.begin(), VoiLutDescriptionWS.end());
-        //  //FUNCINFO("Using VOI/LUT with description '" << VoiLutDescription << "'");
-        //
-        //  //Print the center and width of the VOI/LUT.
-        //  imbxInt32 VoiLutCenter = std::numeric_limits<imbxInt32>::max();
-        //  imbxInt32 VoiLutWidth  = std::numeric_limits<imbxInt32>::max();
-        //  myVoiLut->getCenterWidth(&VoiLutCenter, &VoiLutWidth);
-        //  if((VoiLutCenter != std::numeric_limits<imbxInt32>::max())
-        //  || (VoiLutWidth  != std::numeric_limits<imbxInt32>::max())){
-        //      FUNCINFO("Using VOI/LUT with centre = " << VoiLutCenter << " and width = " << VoiLutWidth);
-        //  }
-        //}
+            //
+            // Disable Imebra conversion:
+            ptr<imebra::image> presImage(convertedImage);
+            //
+            // Enable Imebra conversion:
+            //ptr<imebra::transforms::VOILUT> myVoiLut(new imebra::transforms::VOILUT(TopDataSet));
+            //imbxUint32 lutId = myVoiLut->getVOILUTId(0);
+            //myVoiLut->setVOILUT(lutId);
+            //ptr<imebra::image> presImage(myVoiLut->allocateOutputImage(convertedImage, width, height));
+            //myVoiLut->runTransform(convertedImage, 0, 0, width, height, presImage, 0, 0);
+            //{
+            //  //Print a description of the VOI/LUT if available.
+            //  //const std::wstring VoiLutDescriptionWS = myVoiLut->getVOILUTDescription(lutId);
+            //  //const std::string VoiLutDescription(VoiLutDescriptionWS.begin(), VoiLutDescriptionWS.end());
+            //  //FUNCINFO("Using VOI/LUT with description '" << VoiLutDescription << "'");
+            //
+            //  //Print the center and width of the VOI/LUT.
+            //  imbxInt32 VoiLutCenter = std::numeric_limits<imbxInt32>::max();
+            //  imbxInt32 VoiLutWidth  = std::numeric_limits<imbxInt32>::max();
+            //  myVoiLut->getCenterWidth(&VoiLutCenter, &VoiLutWidth);
+            //  if((VoiLutCenter != std::numeric_limits<imbxInt32>::max())
+            //  || (VoiLutWidth  != std::numeric_limits<imbxInt32>::max())){
+            //      FUNCINFO("Using VOI/LUT with centre = " << VoiLutCenter << " and width = " << VoiLutWidth);
+            //  }
+            //}
 
  
-        //Get the image in terms of 'RGB'/'MONOCHROME1'/'MONOCHROME2'/'YBR_FULL'/etc.. channels.
-        //
-        // This allows up to transform the data into a desired format before allocating any space.
-        //
-        // NOTE: The 'Photometric Interpretation' is specified in the DICOM file at 0x0028,0x0004 as a
-        //       string. For instance "MONOCHROME2" is present in some MR images at the time of writing.
-        //       It's not clear that I will want Imebra to transform the data under any circumstances, but
-        //       to simplify things for now I'll assume we always want 'MONOCHROME2' format.
-        //
-        // NOTE: After some further digging, I believe letting Imebra convert to monochrome will allow
-        //       us to handle compressed images without any extra work.
-        puntoexe::imebra::transforms::colorTransforms::colorTransformsFactory*  pFactory = 
-            puntoexe::imebra::transforms::colorTransforms::colorTransformsFactory::getColorTransformsFactory();
-        ptr<puntoexe::imebra::transforms::transform> myColorTransform = 
-            pFactory->getTransform(presImage->getColorSpace(), L"MONOCHROME2");//L"RGB");
-        if(myColorTransform != nullptr){ //If we get a nullptr, we do not need to transform the image.
-            ptr<puntoexe::imebra::image> rgbImage(myColorTransform->allocateOutputImage(presImage,width,height));
-            myColorTransform->runTransform(presImage, 0, 0, width, height, rgbImage, 0, 0);
-            presImage = rgbImage;
-        }
+            //Get the image in terms of 'RGB'/'MONOCHROME1'/'MONOCHROME2'/'YBR_FULL'/etc.. channels.
+            //
+            // This allows up to transform the data into a desired format before allocating any space.
+            //
+            // NOTE: The 'Photometric Interpretation' is specified in the DICOM file at 0x0028,0x0004 as a
+            //       string. For instance "MONOCHROME2" is present in some MR images at the time of writing.
+            //       It's not clear that I will want Imebra to transform the data under any circumstances, but
+            //       to simplify things for now I'll assume we always want 'MONOCHROME2' format.
+            //
+            // NOTE: After some further digging, I believe letting Imebra convert to monochrome will allow
+            //       us to handle compressed images without any extra work.
+            puntoexe::imebra::transforms::colorTransforms::colorTransformsFactory*  pFactory = 
+                puntoexe::imebra::transforms::colorTransforms::colorTransformsFactory::getColorTransformsFactory();
+            ptr<puntoexe::imebra::transforms::transform> myColorTransform = 
+                pFactory->getTransform(presImage->getColorSpace(), L"MONOCHROME2");//L"RGB");
+            if(myColorTransform != nullptr){ //If we get a nullptr, we do not need to transform the image.
+                ptr<puntoexe::imebra::image> rgbImage(myColorTransform->allocateOutputImage(presImage,width,height));
+                myColorTransform->runTransform(presImage, 0, 0, width, height, rgbImage, 0, 0);
+                presImage = rgbImage;
+            }
     
-        //Get a 'dataHandler' to access the image data waiting in 'presImage.' Get some image metadata.
-        imbxUint32 rowSize, channelPixelSize, channelsNumber, sizeX, sizeY;
-        //Select the image to use.
-        // firstImage     -- Displays RTIMAGE, and CT(MR?) but neither CT nor RTIMAGE values are in HU.
-        // convertedImage -- Works for CT (MR?) but not RTIMAGE.
-        // presImage      -- Works for CT and MR, but not RTIMAGE.
-        ptr<puntoexe::imebra::image> switchImage = ( modality == "RTIMAGE" ) ? firstImage : presImage;
-        ptr<puntoexe::imebra::handlers::dataHandlerNumericBase> myHandler = 
-            switchImage->getDataHandler(false, &rowSize, &channelPixelSize, &channelsNumber);
-        presImage->getSize(&sizeX, &sizeY);
-        //----------------------------------------------------------------------------------------------------
-
-        if((static_cast<long int>(sizeX) != image_cols) || (static_cast<long int>(sizeY) != image_rows)){
-            FUNCWARN("sizeX = " << sizeX << ", sizeY = " << sizeY << " and image_cols = " << image_cols << ", image_rows = " << image_rows);
-            throw std::domain_error("The number of rows and columns in the image data differ when comparing sizeX/Y and img_rows/cols. Please verify");
-            //If this issue arises, I have likely confused definition of X and Y. The DICOM standard specifically calls (0028,0010) 
-            // a 'row'. Perhaps I've got many things backward...
+            //Get a 'dataHandler' to access the image data waiting in 'presImage.' Get some image metadata.
+            imbxUint32 rowSize, sizeX, sizeY;
+            //Select the image to use.
+            // firstImage     -- Displays RTIMAGE, and CT(MR?) but neither CT nor RTIMAGE values are in HU.
+            // convertedImage -- Works for CT (MR?) but not RTIMAGE.
+            // presImage      -- Works for CT and MR, but not RTIMAGE.
+            ptr<puntoexe::imebra::image> switchImage = ( modality == "RTIMAGE" ) ? firstImage : presImage;
+            myHandler = switchImage->getDataHandler(false, &rowSize, &channelPixelSize, &channelsNumber);
+            presImage->getSize(&sizeX, &sizeY);
+            //----------------------------------------------------------------------------------------------------
+
+            if((static_cast<long int>(sizeX) != image_cols) || (static_cast<long int>(sizeY) != image_rows)){
+                FUNCWARN("sizeX = " << sizeX << ", sizeY = " << sizeY << " and image_cols = " << image_cols << ", image_rows = " << image_rows);
+                throw std::domain_error("The number of rows and columns in the image data differ when comparing sizeX/Y and img_rows/cols. Please verify");
+                //If this issue arises, I have likely confused definition of X and Y. The DICOM standard specifically calls (0028,0010) 
+                // a 'row'. Perhaps I've got many things backward...
+            }
         }
 
-        out->imagecoll.images.back().metadata = get_metadata_top_level_tags(FilenameIn);
-        out->imagecoll.images.back().init_orientation(image_orien_r,image_orien_c);
+        //Determine the geometry of this frame. Functional groups take priority over the top-level tags.
+        const auto frame_orien_c = vec3<double>( retrieve_fg_as_double(frame, 0x0020, 0x9116, 0x0020, 0x0037, 0).value_or(image_orien_c.x),
+                                                 retrieve_fg_as_double(frame, 0x0020, 0x9116, 0x0020, 0x0037, 1).value_or(image_orien_c.y),
+                                                 retrieve_fg_as_double(frame, 0x0020, 0x9116, 0x0020, 0x0037, 2).value_or(image_orien_c.z) ).unit();
+        const auto frame_orien_r = vec3<double>( retrieve_fg_as_double(frame, 0x0020, 0x9116, 0x0020, 0x0037, 3).value_or(image_orien_r.x),
+                                                 retrieve_fg_as_double(frame, 0x0020, 0x9116, 0x0020, 0x0037, 4).value_or(image_orien_r.y),
+                                                 retrieve_fg_as_double(frame, 0x0020, 0x9116, 0x0020, 0x0037, 5).value_or(image_orien_r.z) ).unit();
+
+        const auto frame_pxldy = retrieve_fg_as_double(frame, 0x0028, 0x9110, 0x0028, 0x0030, 0).value_or(image_pxldy); // "PixelMeasuresSequence".
+        const auto frame_pxldx = retrieve_fg_as_double(frame, 0x0028, 0x9110, 0x0028, 0x0030, 1).value_or(image_pxldx);
+        const auto frame_thickness = retrieve_fg_as_double(frame, 0x0028, 0x9110, 0x0018, 0x0050, 0).value_or(image_thickness);
+
+        auto frame_pos = image_pos;
+        if(!gfov.empty()){
+            const auto stack_unit = frame_orien_c.Cross(frame_orien_r).unit();
+            frame_pos = image_pos + stack_unit * gfov.at(frame);
+        }
+        frame_pos = vec3<double>( retrieve_fg_as_double(frame, 0x0020, 0x9113, 0x0020, 0x0032, 0).value_or(frame_pos.x), // "PlanePositionSequence".
+                                  retrieve_fg_as_double(frame, 0x0020, 0x9113, 0x0020, 0x0032, 1).value_or(frame_pos.y),
+                                  retrieve_fg_as_double(frame, 0x0020, 0x9113, 0x0020, 0x0032, 2).value_or(frame_pos.z) );
+
+        const auto frame_slope = has_top_level_rescale ? 1.0
+                               : retrieve_fg_as_double(frame, 0x0028, 0x9145, 0x0028, 0x1053, 0).value_or(1.0); // "PixelValueTransformationSequence".
+        const auto frame_intercept = has_top_level_rescale ? 0.0
+                                   : retrieve_fg_as_double(frame, 0x0028, 0x9145, 0x0028, 0x1052, 0).value_or(0.0);
+
+        if(frame == 0){
+            out->imagecoll.images.back().metadata = get_metadata_top_level_tags(pf);
+            file_uid = out->imagecoll.images.back().GetMetadataValueAs<std::string>("SOPInstanceUID");
+        }else{
+            out->imagecoll.images.back().metadata = out->imagecoll.images.front().metadata;
+        }
+        out->imagecoll.images.back().init_orientation(frame_orien_r,frame_orien_c);
 
         const auto img_chnls = static_cast<long int>(channelsNumber);
-        out->imagecoll.images.back().init_buffer(image_rows, image_cols, img_chnls); //Underlying type specifies per-pixel space allocated.
+        if(defer_pixels){
+            //Record the shape, but do not allocate the pixel buffer.
+            out->imagecoll.images.back().data.clear();
+            out->imagecoll.images.back().data.shrink_to_fit();
+            out->imagecoll.images.back().rows     = image_rows;
+            out->imagecoll.images.back().columns  = image_cols;
+            out->imagecoll.images.back().channels = img_chnls;
+        }else{
+            out->imagecoll.images.back().init_buffer(image_rows, image_cols, img_chnls); //Underlying type specifies per-pixel space allocated.
+        }
 
-        const auto img_pxldz = image_thickness;
-        out->imagecoll.images.back().init_spatial(image_pxldx,image_pxldy,img_pxldz, image_anchor, image_pos);
+        const auto img_pxldz = frame_thickness;
+        out->imagecoll.images.back().init_spatial(frame_pxldx,frame_pxldy,img_pxldz, image_anchor, frame_pos);
+
+        if(1 < N_frames){
+            auto &m = out->imagecoll.images.back().metadata;
+            m["Frame"] = std::to_string(frame);
+            m["ImagePositionPatient"] = frame_pos.to_string();
+            m["ImageOrientationPatient"] = std::to_string(frame_orien_c.x) + R"***(\)***"_s
+                                         + std::to_string(frame_orien_c.y) + R"***(\)***"_s
+                                         + std::to_string(frame_orien_c.z) + R"***(\)***"_s
+                                         + std::to_string(frame_orien_r.x) + R"***(\)***"_s
+                                         + std::to_string(frame_orien_r.y) + R"***(\)***"_s
+                                         + std::to_string(frame_orien_r.z);
+            m["SliceThickness"] = std::to_string(frame_thickness);
+
+            //Frames share the file's SOPInstanceUID, but images are expected to have distinct UIDs. Derive one per
+            // frame, keeping it reproducible when it fits within the 64 character limit.
+            if(file_uid){
+                const auto frame_uid = file_uid.value() + "." + std::to_string(frame + 1);
+                m["SOPInstanceUID"] = (frame_uid.size() <= 64) ? frame_uid : Generate_Random_UID(60);
+            }
+
+            if(!has_top_level_rescale){
+                m["RescaleSlope"] = std::to_string(frame_slope);
+                m["RescaleIntercept"] = std::to_string(frame_intercept);
+            }
+            for(const auto &t : { std::make_tuple(0x0018, 0x9074, "FrameAcquisitionDateTime"),
+                                  std::make_tuple(0x0020, 0x9157, "DimensionIndexValues"),
+                                  std::make_tuple(0x0020, 0x9056, "StackID"),
+                                  std::make_tuple(0x0020, 0x9057, "InStackPositionNumber"),
+                                  std::make_tuple(0x0020, 0x9128, "TemporalPositionIndex") }){
+                const auto v = retrieve_fg_as_string(frame, 0x0020, 0x9111, // "FrameContentSequence".
+                                                     static_cast<uint16_t>(std::get<0>(t)),
+                                                     static_cast<uint16_t>(std::get<1>(t)));
+                if(v) m[std::get<2>(t)] = v.value();
+            }
+        }
+
+        if(defer_pixels){
+            //The source is recorded so the pixels can be decoded later.
+            out->imagecoll.images.back().metadata["Filename"] = pf->filename;
+            out->imagecoll.images.back().metadata["Frame"] = std::to_string(frame);
+            out->imagecoll.images.back().metadata[deferred_pixel_flag] = "True";
+            continue;
+        }
 
         //Sometimes Imebra returns a different number of bits than the DICOM header specifies. Presumably this
         // is for some reason (maybe even simplification of implementation, which is fair). Since I convert to
@@ -1593,22 +1882,27 @@ std::unique_ptr<Image_Array> Load_Image_Array(const std::string &FilenameIn){
                                     " You can increase this if needed, or try to scale down to 32 bits");
         }
 
-        //Write the data to our allocated memory. We do it pixel-by-pixel because the 'PixelRepresentation' could mean
-        // the pixel locality is laid out in various ways (two ways?). This approach abstracts the issue away.
+        //Write the data to our allocated memory. Whenever possible the whole buffer is converted in a single pass.
+        const auto f_slope = static_cast<float>(frame_slope);
+        const auto f_intercept = static_cast<float>(frame_intercept);
+        if(bulk_copy_pixels_to_float(myHandler, out->imagecoll.images.back(), f_slope, f_intercept)) continue;
+
+        //Otherwise, do it pixel-by-pixel because the 'PixelRepresentation' could mean the pixel locality is laid out in
+        // various ways (two ways?). This approach abstracts the issue away.
         imbxUint32 data_index = 0;
         for(long int row = 0; row < image_rows; ++row){
             for(long int col = 0; col < image_cols; ++col){
                 for(long int chnl = 0; chnl < img_chnls; ++chnl){
                     //Let Imebra work out the conversion by asking for a double. Hope it can be narrowed if necessary!
                     const auto DoubleChannelValue = myHandler->getDouble(data_index);
-                    const auto OutgoingPixelValue = static_cast<float>(DoubleChannelValue);
+                    const auto OutgoingPixelValue = static_cast<float>(DoubleChannelValue) * f_slope + f_intercept;
 
                     out->imagecoll.images.back().reference(row,col,chnl) = OutgoingPixelValue;
                     ++data_index;
                 } //Loop over channels.
             } //Loop over columns.
         } //Loop over rows.
-    }
+    } //Loop over frames.
     return out;
 }
 
@@ -1621,6 +1915,205 @@ std::list<std::shared_ptr<Image_Array>>  Load_Image_Arrays(const std::list<std::
     return out;
 }
 
+//------------------ Deferred pixels ----------------------
+
+Deferred_Pixel_Settings & Get_Deferred_Pixel_Settings(){
+    static Deferred_Pixel_Settings settings;
+    return settings;
+}
+
+//Bookkeeping for images whose pixels were decoded on demand. Only images in the registry can have their pixels released
+// again. Images are removed from the registry whenever an operation that might alter pixels is given access to them, so
+// no inspection of the pixels themselves is needed. The 'last use' clock orders releases.
+namespace {
+    using deferred_pixel_key_t = std::pair<std::string, long int>; // Filename and frame number.
+
+    struct deferred_pixel_record {
+        deferred_pixel_key_t source;
+        uint64_t last_use = 0;
+    };
+
+    std::mutex deferred_pixel_registry_mutex;
+    std::map<const planar_image<float,double> *, deferred_pixel_record> deferred_pixel_registry;
+    uint64_t deferred_pixel_clock = 0;
+}
+
+static
+std::optional<deferred_pixel_key_t>
+deferred_pixel_source(const planar_image<float,double> &img){
+    const auto fname = img.GetMetadataValueAs<std::string>("Filename");
+    if(!fname) return std::nullopt;
+    const auto frame = img.GetMetadataValueAs<long int>("Frame").value_or(0L);
+    return std::make_pair(fname.value(), frame);
+}
+
+bool Has_Deferred_Pixels(const planar_image<float,double> &img){
+    return img.data.empty()
+        && (img.metadata.count(deferred_pixel_flag) != 0);
+}
+
+void Materialize_Deferred_Pixels(std::list<std::shared_ptr<Image_Array>> &ias){
+    //Group deferred images by source file so each file is parsed and decoded only once.
+    std::map<std::string, std::list<std::pair<long int, std::reference_wrapper<planar_image<float,double>>>>> by_file;
+    std::list<std::reference_wrapper<planar_image<float,double>>> resident;
+    for(auto &ia_ptr : ias){
+        if(ia_ptr == nullptr) continue;
+        for(auto &img : ia_ptr->imagecoll.images){
+            if(!Has_Deferred_Pixels(img)){
+                if(!img.data.empty()) resident.emplace_back(std::ref(img));
+                continue;
+            }
+            const auto src = deferred_pixel_source(img);
+            if(!src){
+                throw std::runtime_error("Image has deferred pixels but no recorded source. Cannot continue");
+            }
+            by_file[src.value().first].emplace_back( src.value().second, std::ref(img) );
+        }
+    }
+
+    //Mark already-resident images as recently used.
+    {
+        std::lock_guard<std::mutex> lock(deferred_pixel_registry_mutex);
+        ++deferred_pixel_clock;
+        for(auto &img_refw : resident){
+            auto it = deferred_pixel_registry.find( &(img_refw.get()) );
+            if(it != deferred_pixel_registry.end()) it->second.last_use = deferred_pixel_clock;
+        }
+    }
+    if(by_file.empty()) return;
+
+    FUNCINFO("Decoding deferred pixels from " << by_file.size() << " files");
+    std::mutex err_mutex;
+    std::list<std::string> errors;
+    {
+        asio_thread_pool tp;
+        for(auto &fp : by_file){
+            const auto &fname = fp.first;
+            auto &imgs = fp.second;
+            tp.submit_task([&]() -> void {
+                try{
+                    const bool defer_pixels = false;
+                    auto decoded = Load_Image_Array(Parse_DICOM_File(fname), defer_pixels);
+                    std::vector<std::reference_wrapper<planar_image<float,double>>> frames;
+                    for(auto &d_img : decoded->imagecoll.images) frames.emplace_back(std::ref(d_img));
+
+                    for(auto &p : imgs){
+                        const auto frame = p.first;
+                        auto &img = p.second.get();
+                        if( (frame < 0) || (static_cast<long int>(frames.size()) <= frame) ){
+                            throw std::runtime_error("Frame "_s + std::to_string(frame) + " not present in file");
+                        }
+                        auto &d_img = frames[frame].get();
+                        if( (d_img.rows != img.rows) || (d_img.columns != img.columns) ){
+                            throw std::runtime_error("Decoded image dimensions differ from the deferred image");
+                        }
+                        img.channels = d_img.channels;
+                        img.data = d_img.data;
+                        img.metadata.erase(deferred_pixel_flag);
+
+                        std::lock_guard<std::mutex> lock(deferred_pixel_registry_mutex);
+                        auto &rec = deferred_pixel_registry[ &img ];
+                        rec.source = std::make_pair(fname, frame);
+                        rec.last_use = deferred_pixel_clock;
+                    }
+                }catch(const std::exception &e){
+                    std::lock_guard<std::mutex> lock(err_mutex);
+                    errors.emplace_back("'"_s + fname + "': " + e.what());
+                }
+                return;
+            });
+        }
+    } // Wait for all tasks to complete.
+
+    if(!errors.empty()){
+        throw std::runtime_error("Unable to decode deferred pixels from "_s + errors.front());
+    }
+    return;
+}
+
+void Mark_Deferred_Pixels_Modified(std::list<std::shared_ptr<Image_Array>> &ias){
+    std::lock_guard<std::mutex> lock(deferred_pixel_registry_mutex);
+    if(deferred_pixel_registry.empty()) return;
+    for(auto &ia_ptr : ias){
+        if(ia_ptr == nullptr) continue;
+        for(const auto &img : ia_ptr->imagecoll.images){
+            deferred_pixel_registry.erase( &img );
+        }
+    }
+    return;
+}
+
+int64_t Release_Deferred_Pixels(std::list<std::shared_ptr<Image_Array>> &ias, int64_t budget_bytes){
+    if(budget_bytes < 0) return 0;
+
+    //Gather images whose pixels can be reproduced by decoding their source again.
+    struct candidate_t {
+        std::reference_wrapper<planar_image<float,double>> img;
+        uint64_t last_use;
+        int64_t bytes;
+    };
+    std::vector<candidate_t> candidates;
+    int64_t resident_bytes = 0;
+
+    std::lock_guard<std::mutex> lock(deferred_pixel_registry_mutex);
+    std::set<const planar_image<float,double> *> present;
+    for(auto &ia_ptr : ias){
+        if(ia_ptr == nullptr) continue;
+        for(auto &img : ia_ptr->imagecoll.images){
+            if(img.data.empty()) continue;
+            present.insert( &img );
+
+            auto it = deferred_pixel_registry.find( &img );
+            if(it == deferred_pixel_registry.end()) continue;
+
+            //Guard against a different image occupying the address of a registered image.
+            const auto src = deferred_pixel_source(img);
+            const auto N_voxels = static_cast<size_t>(img.rows * img.columns * img.channels);
+            if( !src
+            ||  (src.value() != it->second.source)
+            ||  (img.data.size() != N_voxels) ){
+                deferred_pixel_registry.erase(it);
+                continue;
+            }
+
+            const auto bytes = static_cast<int64_t>(img.data.size() * sizeof(float));
+            candidates.push_back( candidate_t{ std::ref(img), it->second.last_use, bytes } );
+            resident_bytes += bytes;
+        }
+    }
+
+    //Forget images that no longer exist so their addresses cannot be mistaken for new images.
+    for(auto it = std::begin(deferred_pixel_registry); it != std::end(deferred_pixel_registry); ){
+        if(present.count(it->first) == 0){
+            it = deferred_pixel_registry.erase(it);
+        }else{
+            ++it;
+        }
+    }
+
+    //Release the least-recently used first.
+    std::stable_sort(std::begin(candidates), std::end(candidates),
+                     [](const candidate_t &A, const candidate_t &B){ return A.last_use < B.last_use; });
+
+    int64_t released = 0;
+    for(auto &c : candidates){
+        if(resident_bytes <= budget_bytes) break;
+
+        auto &img = c.img.get();
+        img.data.clear();
+        img.data.shrink_to_fit();
+        img.metadata[deferred_pixel_flag] = "True";
+        deferred_pixel_registry.erase( &img );
+
+        resident_bytes -= c.bytes;
+        released += c.bytes;
+    }
+    if(0 < released){
+        FUNCINFO("Released " << released << " bytes of re-loadable pixel data");
+    }
+    return released;
+}
+
 //Since many images must be loaded individually from a file, we will often have to collate them together.
 //
 //Note: Returns a nullptr if the collation was not successful. The input data will not be restored to the
@@ -1654,17 +2147,18 @@ std::unique_ptr<Image_Array> Collate_Image_Arrays(std::list<std::shared_ptr<Imag
 //--------------------- Dose -----------------------
 //This routine reads a single DICOM dose file.
 std::unique_ptr<Image_Array>  Load_Dose_Array(const std::string &FilenameIn){
-    auto metadata = get_metadata_top_level_tags(FilenameIn);
+    return Load_Dose_Array( Parse_DICOM_File(FilenameIn) );
+}
+
+std::unique_ptr<Image_Array>  Load_Dose_Array(const std::shared_ptr<Parsed_DICOM_File> &pf){
+    const auto &FilenameIn = pf->filename;
+    auto metadata = get_metadata_top_level_tags(pf);
     metadata["Modality"] = "RTDOSE";
 
     auto out = std::make_unique<Image_Array>();
 
     using namespace puntoexe;
-    ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(FilenameIn.c_str(), std::ios::in);
-
-    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    ptr<imebra::dataSet> TopDataSet = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+    ptr<imebra::dataSet> TopDataSet = pf->tds;
 
     //These should exist in all files. They appear to be the same for CT and DS files of the same set. Not sure
     // if this is *always* the case.
@@ -1796,7 +2290,9 @@ std::unique_ptr<Image_Array>  Load_Dose_Array(const std::string &FilenameIn){
             //Not sure what to do if this happens. Perhaps just go with the imebra result?
         }
 
-        //Write the data to our allocated memory.
+        //Write the data to our allocated memory. Whenever possible the whole frame is converted in a single pass.
+        if(bulk_copy_pixels_to_float(myHandler, out->imagecoll.images.back(), static_cast<float>(grid_scale))) continue;
+
         imbxUint32 data_index = 0;
         for(long int row = 0; row < image_rows; ++row){
             for(long int col = 0; col < image_cols; ++col){
@@ -1831,14 +2327,15 @@ std::list<std::shared_ptr<Image_Array>>  Load_Dose_Arrays(const std::list<std::s
 
 std::unique_ptr<TPlan_Config> 
 Load_TPlan_Config(const std::string &FilenameIn){
+    return Load_TPlan_Config( Parse_DICOM_File(FilenameIn) );
+}
+
+std::unique_ptr<TPlan_Config> 
+Load_TPlan_Config(const std::shared_ptr<Parsed_DICOM_File> &pf){
     std::unique_ptr<TPlan_Config> out(new TPlan_Config());
 
     using namespace puntoexe;
-    ptr<puntoexe::stream> readStream(new puntoexe::stream);
-    readStream->openFile(FilenameIn.c_str(), std::ios::in);
-
-    ptr<puntoexe::streamReader> reader(new puntoexe::streamReader(readStream));
-    ptr<imebra::dataSet> base_node_ptr = imebra::codecs::codecFactory::getCodecFactory()->load(reader);
+    ptr<imebra::dataSet> base_node_ptr = pf->tds;
 
 
     const auto convert_first_to_string = [](const std::vector<std::string> &in) -> std::optional<std::string> {
@@ -1911,7 +2408,7 @@ Load_TPlan_Config(const std::string &FilenameIn){
 
 
     // ------------------------------------------- General --------------------------------------------------
-    out->metadata = get_metadata_top_level_tags(FilenameIn);
+    out->metadata = get_metadata_top_level_tags(pf);
     out->metadata["Modality"] = "RTPLAN";
 
     // DoseReferenceSequence
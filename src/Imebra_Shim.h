@@ -4,6 +4,7 @@
 #define _IMEBRA_SHIM_H_DICOMAUTOMATON
 
 #include <cstddef>
+#include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
@@ -16,6 +17,11 @@
 class Contour_Data;
 class Image_Array;
 
+//Opaque handle to a parsed DICOM file. Parsing is the most expensive part of most of the routines below, so callers
+// that need to query a file several times should parse it once and pass the handle around. Handles are read-only
+// and can be shared between threads.
+struct Parsed_DICOM_File;
+
 
 //------------------ General ----------------------
 //Generic helper functions.
@@ -23,44 +29,78 @@ std::string Generate_Random_UID(long int len);
 
 std::string Generate_Random_Int_Str(long int low, long int high);
 
+//Parse a file once. Throws if the file cannot be read or parsed.
+std::shared_ptr<Parsed_DICOM_File> Parse_DICOM_File(const std::string &filename);
+
 //One-offs.
 std::string get_tag_as_string(const std::string &filename, size_t U, size_t L);
+std::string get_tag_as_string(const std::shared_ptr<Parsed_DICOM_File> &pf, size_t U, size_t L);
 
 std::string get_modality(const std::string &filename);
+std::string get_modality(const std::shared_ptr<Parsed_DICOM_File> &pf);
 
 std::string get_patient_ID(const std::string &filename);
 
 //Mass top-level tag enumeration, for ingress into database.
 //
 //NOTE: May not be complete. Add additional tags as needed!
+//NOTE: If the file cannot be parsed, a warning is emitted and an empty map is returned.
 std::map<std::string,std::string> get_metadata_top_level_tags(const std::string &filename);
+std::map<std::string,std::string> get_metadata_top_level_tags(const std::shared_ptr<Parsed_DICOM_File> &pf);
 
 
 //------------------ Contours ---------------------
 bimap<std::string,long int> get_ROI_tags_and_numbers(const std::string &filename);
+bimap<std::string,long int> get_ROI_tags_and_numbers(const std::shared_ptr<Parsed_DICOM_File> &pf);
 
 std::unique_ptr<Contour_Data>  get_Contour_Data(const std::string &filename);
+std::unique_ptr<Contour_Data>  get_Contour_Data(const std::shared_ptr<Parsed_DICOM_File> &pf);
 
 
 //-------------------- Images ----------------------
 //This routine will often result in an array with only a single image. So collate output as needed.
 std::unique_ptr<Image_Array> Load_Image_Array(const std::string &filename);
+std::unique_ptr<Image_Array> Load_Image_Array(const std::shared_ptr<Parsed_DICOM_File> &pf, bool defer_pixels = false);
 
 //These pointers will actually be unique. This just aims to convert from unique_ptr to shared_ptr for you.
 std::list<std::shared_ptr<Image_Array>>  Load_Image_Arrays(const std::list<std::string> &filenames);
 
+//Deferred (lazy) pixel loading. Images loaded with deferred pixels have valid metadata and geometry, but an empty
+// pixel buffer. They are flagged with 'DeferredPixels' metadata, and the source file and frame are recorded in the
+// 'Filename' and 'Frame' metadata so pixels can be decoded on demand. Decoded pixels that remain unmodified can later be
+// released again to stay within a budget.
+struct Deferred_Pixel_Settings {
+    bool enabled = false;       // Whether the DICOM file loader should defer decoding pixels.
+    int64_t budget_bytes = -1;  // Upper limit on re-loadable pixel data kept resident. Negative means unlimited.
+};
+Deferred_Pixel_Settings & Get_Deferred_Pixel_Settings(); // Process-wide.
+
+bool Has_Deferred_Pixels(const planar_image<float,double> &img);
+
+//Decodes all deferred pixels in the given image arrays. Throws if any cannot be decoded.
+void Materialize_Deferred_Pixels(std::list<std::shared_ptr<Image_Array>> &ias);
+
+//Marks the decoded pixels in the given image arrays as (potentially) modified, so they will never be released. This
+// must be called before anything that might alter pixels is given access to the image arrays.
+void Mark_Deferred_Pixels_Modified(std::list<std::shared_ptr<Image_Array>> &ias);
+
+//Releases least-recently-used, unmodified, re-loadable pixel data until the budget is met. Returns bytes released.
+int64_t Release_Deferred_Pixels(std::list<std::shared_ptr<Image_Array>> &ias, int64_t budget_bytes);
+
 //Since many images must be loaded individually from a file, we will often have to collate them together.
 std::unique_ptr<Image_Array> Collate_Image_Arrays(std::list<std::shared_ptr<Image_Array>> &in);
 
 
 //--------------------- Dose -----------------------
 std::unique_ptr<Image_Array> Load_Dose_Array(const std::string &filename);
+std::unique_ptr<Image_Array> Load_Dose_Array(const std::shared_ptr<Parsed_DICOM_File> &pf);
 
 //These pointers will actually be unique. This just aims to convert from unique_ptr to shared_ptr for you.
 std::list<std::shared_ptr<Image_Array>>  Load_Dose_Arrays(const std::list<std::string> &filenames);
 
 //-------------------- Plans ------------------------
 std::unique_ptr<TPlan_Config> Load_TPlan_Config(const std::string &filename);
+std::unique_ptr<TPlan_Config> Load_TPlan_Config(const std::shared_ptr<Parsed_DICOM_File> &pf);
 
 //-------------------- Export -----------------------
 //Writes an Image_Array as if it were a dose matrix.
@@ -5,10 +5,12 @@
 //
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <atomic>
 #include <exception>
 #include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <stdexcept>
 #include <string>    
@@ -17,7 +19,10 @@
 
 #include <YgorMisc.h>
 
+#include "Imebra_Shim.h"
+#include "Regex_Selectors.h"
 #include "Structs.h"
+#include "YgorImages_Functors/ROI_Mask_Cache.h"
 
 #include "Operations/AccumulateRowsColumns.h"
 #include "Operations/AnalyzeHistograms.h"
@@ -391,6 +396,85 @@ std::map<std::string, op_packet_t> Known_Operations(){
 }
 
 
+//Operations that only inspect or rearrange metadata, or only dispatch other operations, do not need decoded pixels.
+static bool operation_ignores_pixels(const std::string &op_name){
+    for(const auto &n : { "DeleteImages",
+                          "DroverDebug",
+                          "DumpAllOrderedImageMetadataToFile",
+                          "DumpImageMetadataOccurrencesToFile",
+                          "DumpPlanSummary",
+                          "DumpTPlanMetadataOccurrencesToFile",
+                          "ForEachDistinct",
+                          "GroupImages",
+                          "ModifyImageMetadata",
+                          "OrderImages",
+                          "Repeat" }){
+        if(boost::iequals(n, op_name)) return true;
+    }
+    return false;
+}
+
+//Operations that read, but never alter, pixel data. Decoded pixels they access can still be released afterward.
+static bool operation_preserves_pixels(const std::string &op_name){
+    for(const auto &n : { "DICOMExportImagesAsCT",
+                          "DICOMExportImagesAsDose",
+                          "DumpImageMeshes",
+                          "DumpPixelValuesOverTimeForAnEncompassedPoint",
+                          "DumpROIData",
+                          "DumpVoxelDoseInfo",
+                          "EvaluateDoseVolumeStats",
+                          "ExportFITSImages" }){
+        if(boost::iequals(n, op_name)) return true;
+    }
+    return false;
+}
+
+//Decode any deferred pixels the operation might access. If the operation selects image arrays, only the selected
+// arrays are decoded. Otherwise all image arrays are decoded. Unless the operation is known to leave pixels unaltered,
+// the accessible pixels are then considered modified and will not be released again.
+static void materialize_pixels_for_operation(Drover &DICOM_data,
+                                             const std::string &op_name,
+                                             const OperationDoc &OpDocs,
+                                             const OperationArgPkg &OptArgs){
+    if(operation_ignores_pixels(op_name)) return;
+
+    bool has_selection = false;
+    std::list<std::shared_ptr<Image_Array>> selected;
+    for(const auto &a : OpDocs.args){
+        const std::string suffix = "ImageSelection";
+        if( (a.name.size() < suffix.size())
+        ||  (a.name.compare(a.name.size() - suffix.size(), suffix.size(), suffix) != 0) ) continue;
+
+        const auto ImageSelectionStr = OptArgs.getValueStr(a.name);
+        if(!ImageSelectionStr) continue;
+        has_selection = true;
+
+        auto IAs_all = All_IAs( DICOM_data );
+        auto IAs = Whitelist( IAs_all, ImageSelectionStr.value() );
+        for(auto & iap_it : IAs) selected.emplace_back( *iap_it );
+    }
+    if(!has_selection) selected = DICOM_data.image_data;
+
+    Materialize_Deferred_Pixels(selected);
+    if(!operation_preserves_pixels(op_name)) Mark_Deferred_Pixels_Modified(selected);
+    return;
+}
+
+namespace {
+//Empties the ROI mask cache when the outermost dispatcher run begins and ends.
+struct ROI_Mask_Cache_Scope {
+    static std::atomic<long int> depth;
+
+    ROI_Mask_Cache_Scope(){
+        if(depth++ == 0) Clear_ROI_Mask_Cache();
+    }
+    ~ROI_Mask_Cache_Scope(){
+        if(--depth == 0) Clear_ROI_Mask_Cache();
+    }
+};
+std::atomic<long int> ROI_Mask_Cache_Scope::depth(0);
+} // namespace
+
 bool Operation_Dispatcher( Drover &DICOM_data,
                            const std::map<std::string,std::string> &InvocationMetadata,
                            const std::string &FilenameLex,
@@ -398,6 +482,11 @@ bool Operation_Dispatcher( Drover &DICOM_data,
 
     auto op_name_mapping = Known_Operations();
 
+    //Rasterized ROI masks are shared by the operations in this run, including nested runs (e.g., 'Repeat'). They are
+    // keyed on content, so alterations made by earlier operations cannot produce stale masks, but they are not retained
+    // beyond the outermost run.
+    const ROI_Mask_Cache_Scope mask_cache_scope;
+
     try{
         for(const auto &OptArgs : Operations){
             auto optargs = OptArgs;
@@ -412,11 +501,21 @@ bool Operation_Dispatcher( Drover &DICOM_data,
                         if(r.expected) optargs.insert( r.name, r.default_val );
                     }
 
+                    //Decode pixels that were deferred during loading, if the operation might need them.
+                    materialize_pixels_for_operation(DICOM_data, op_func.first, OpDocs, optargs);
+
                     FUNCINFO("Performing operation '" << op_func.first << "' now..");
-                    DICOM_data = op_func.second.second(DICOM_data,
+                    //The Drover is moved into the operation and moved back out, so no per-operation copy is made.
+                    // If the operation throws, the Drover contents are lost; callers that need to recover should
+                    // keep their own (shallow) copy.
+                    DICOM_data = op_func.second.second(std::move(DICOM_data),
                                                        optargs,
                                                        InvocationMetadata,
                                                        FilenameLex);
+
+                    //Release re-loadable pixels to stay within the memory budget, if one was specified.
+                    const auto budget = Get_Deferred_Pixel_Settings().budget_bytes;
+                    if(0 <= budget) Release_Deferred_Pixels(DICOM_data.image_data, budget);
                 }
             }
             if(!WasFound) throw std::invalid_argument("No operation matched '" + optargs.getName() + "'");
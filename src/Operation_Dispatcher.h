@@ -19,6 +19,8 @@ typedef std::pair<op_doc_func_t,op_func_t> op_packet_t;
 
 std::map<std::string, op_packet_t> Known_Operations();
 
+//Sequentially performs the given operations. Returns false if any operation fails, in which case the contents of
+// DICOM_data are unspecified.
 bool Operation_Dispatcher( Drover &DICOM_data,
                            const std::map<std::string,std::string> &InvocationMetadata,
                            const std::string &FilenameLex,
@@ -294,6 +294,24 @@ OperationDoc OpArgDocComparePixels(){
     out.args.back().examples = { "true",
                                  "false" };
 
+    out.args.emplace_back();
+    out.args.back().name = "GammaEngine";
+    out.args.back().desc = "Parameter for gamma-index comparisons."
+                           " Controls which implementation is used."
+                           " The 'fast' engine resamples the reference images into a contiguous volume and"
+                           " searches voxels in order of increasing distance, stopping as soon as no remaining"
+                           " voxel can lower the gamma index. It interpolates along voxel edges only where doing"
+                           " so could lower the gamma index, so it is exact for linear interpolation between"
+                           " adjacent voxels. It reports throughput in voxels/second. It requires the reference"
+                           " images to form a regular grid (uniformly spaced, aligned slices); otherwise the"
+                           " 'wavefront' engine is used instead."
+                           " The 'wavefront' engine is the original implementation, which grows shells of voxels"
+                           " around each voxel and uses the straddle-based estimates described above.";
+    out.args.back().default_val = "fast";
+    out.args.back().expected = true;
+    out.args.back().examples = { "fast",
+                                 "wavefront" };
+
     return out;
 }
 
@@ -329,6 +347,7 @@ Drover ComparePixels(Drover DICOM_data,
     const auto GammaDTAThreshold = std::stod( OptArgs.getValueStr("GammaDTAThreshold").value() );
     const auto GammaDiscThreshold = std::stod( OptArgs.getValueStr("GammaDiscThreshold").value() );
     const auto GammaTerminateAboveOneStr = OptArgs.getValueStr("GammaTerminateAboveOne").value();
+    const auto GammaEngineStr = OptArgs.getValueStr("GammaEngine").value();
 
     //-----------------------------------------------------------------------------------------------------------------
     const auto regex_true = Compile_Regex("^tr?u?e?$");
@@ -345,6 +364,9 @@ Drover ComparePixels(Drover DICOM_data,
     const auto disctype_dif = Compile_Regex("^di?f?f?e?r?e?n?c?e?$");
     const auto disctype_pin = Compile_Regex("^pi?n?n?e?d?-?t?o?-?m?a?x?$");
 
+    const auto engine_fast      = Compile_Regex("^fa?s?t?$");
+    const auto engine_wavefront = Compile_Regex("^wa?v?e?f?r?o?n?t?$");
+
     const auto GammaTerminateAboveOne = std::regex_match(GammaTerminateAboveOneStr, regex_true);
     //-----------------------------------------------------------------------------------------------------------------
 
@@ -424,6 +446,13 @@ Drover ComparePixels(Drover DICOM_data,
         ud.gamma_DTA_threshold = GammaDTAThreshold;
 
         ud.gamma_terminate_when_max_exceeded = GammaTerminateAboveOne;
+        if(std::regex_match(GammaEngineStr, engine_fast)){
+            ud.gamma_engine = ComputeCompareImagesUserData::GammaEngine::Fast;
+        }else if(std::regex_match(GammaEngineStr, engine_wavefront)){
+            ud.gamma_engine = ComputeCompareImagesUserData::GammaEngine::Wavefront;
+        }else{
+            throw std::invalid_argument("Gamma engine not understood. Cannot continue.");
+        }
         //ud.gamma_terminated_early = std::nextafter(1.0, std::numeric_limits<double>::infinity());
 
         if(!(*iap_it)->imagecoll.Compute_Images( ComputeCompareImages, 
@@ -10,7 +10,6 @@
 #include <memory>
 #include <mutex>
 #include <regex>
-#include <set> 
 #include <stdexcept>
 #include <string>    
 #include <utility>            //Needed for std::pair.
@@ -257,68 +256,69 @@ Drover ContourViaThreshold(Drover DICOM_data,
                     const auto R = animg.rows;
                     const auto C = animg.columns;
 
-                    //Construct the vertex grid. Vertices are in the corners of pixels, but we also need a mapping from
-                    // pixel coordinate space to the vertex grid storage indices.
+                    //Vertices are in the corners of pixels. The vertex grid has (R+1)*(C+1) elements, and each pixel's
+                    // corners are mapped to vertex grid storage indices.
                     const auto vert_count = (R+1)*(C+1);
-                    std::vector<vec3<double>> verts( vert_count );
-                    enum row_modif { r_neg = 0, r_pos = 1 }; // Modifiers which translate (in the img plane) +-1/2 of pxl_dx.
-                    enum col_modif { c_neg = 0, c_pos = 1 }; // Modifiers which translate (in the img plane) +-1/2 of pxl_dy.
-
                     const auto vert_index = [C](long int vert_row, long int vert_col) -> long int {
                         return (C+1)*vert_row + vert_col;
                     };
-                    const auto vert_mapping = [vert_index](long int r, long int c, row_modif rm, col_modif cm ) -> long int {
-                        const auto vert_row = r + rm;
-                        const auto vert_col = c + cm;
-                        return vert_index(vert_row,vert_col);
-                    };
 
                     //Pin each vertex grid element to the appropriate pixel corner.
                     const auto corner = animg.position(0,0) - animg.row_unit*animg.pxl_dx*0.5 - animg.col_unit*animg.pxl_dy*0.5;
-                    for(auto r = 0; r < (R+1); ++r){
-                        for(auto c = 0; c < (C+1); ++c){
-                            verts.at(vert_index(r,c)) = corner + animg.row_unit*animg.pxl_dx*r
-                                                               + animg.col_unit*animg.pxl_dy*c;
-                        }
-                    }
+                    const auto vert_position = [&](long int vert) -> vec3<double> {
+                        const auto r = vert / (C+1);
+                        const auto c = vert % (C+1);
+                        return corner + animg.row_unit*animg.pxl_dx*r
+                                      + animg.col_unit*animg.pxl_dy*c;
+                    };
+
+                    //Half-edges connect adjacent vertices, so each vertex has at most four outgoing half-edges. They
+                    // are stored as a bitmask per vertex in a flat array that is reused across images.
+                    //
+                    // The bits are ordered by the index of the destination vertex, so the lowest set bit always
+                    // identifies the outgoing half-edge with the lowest-index destination.
+                    enum half_edge_dir : unsigned char {
+                        he_row_neg = 1, // Destination: vert - (C+1).
+                        he_col_neg = 2, // Destination: vert - 1.
+                        he_col_pos = 4, // Destination: vert + 1.
+                        he_row_pos = 8, // Destination: vert + (C+1).
+                    };
+                    const auto he_dest = [C](long int vert, unsigned char dir) -> long int {
+                        return (dir == he_row_neg) ? vert - (C+1)
+                             : (dir == he_col_neg) ? vert - 1
+                             : (dir == he_col_pos) ? vert + 1
+                             :                       vert + (C+1);
+                    };
 
-                    //Construct a container for storing half-edges.
-                    std::map<long int, std::set<long int>> half_edges;
+                    thread_local std::vector<unsigned char> half_edges;
+                    half_edges.assign(vert_count, 0);
 
                     //Iterate over each pixel. If the oracle tells us the pixel is within the ROI, add four half-edges
-                    // around the pixel's perimeter.
-                    for(auto r = 0; r < R; ++r){
-                        for(auto c = 0; c < C; ++c){
+                    // around the pixel's perimeter. Each half-edge is generated by exactly one pixel.
+                    bool any_half_edges = false;
+                    for(long int r = 0; r < R; ++r){
+                        for(long int c = 0; c < C; ++c){
                             if(pixel_oracle(animg.value(r, c, Channel))){
-                                const auto bot_l = vert_mapping(r,c,r_pos,c_neg);
-                                const auto bot_r = vert_mapping(r,c,r_pos,c_pos);
-                                const auto top_r = vert_mapping(r,c,r_neg,c_pos);
-                                const auto top_l = vert_mapping(r,c,r_neg,c_neg);
-
-                                half_edges[bot_l].insert(bot_r);
-                                half_edges[bot_r].insert(top_r);
-                                half_edges[top_r].insert(top_l);
-                                half_edges[top_l].insert(bot_l);
+                                half_edges[vert_index(r+1,c  )] |= he_col_pos; // Bottom-left to bottom-right.
+                                half_edges[vert_index(r+1,c+1)] |= he_row_neg; // Bottom-right to top-right.
+                                half_edges[vert_index(r  ,c+1)] |= he_col_neg; // Top-right to top-left.
+                                half_edges[vert_index(r  ,c  )] |= he_row_pos; // Top-left to bottom-left.
+                                any_half_edges = true;
                             }
                         }
                     }
 
                     //Find and remove all cancelling half-edges, which are equivalent to circular two-vertex loops.
                     if(SimplifyMergeAdjacent){
-                        //'Retire' half-edges by merely removing their endpoint, invalidating them.
-                        for(auto &he_group : half_edges){
-                            const auto A = he_group.first;
-                            auto B_it = he_group.second.begin();
-                            while(B_it != he_group.second.end()){
-                                const auto he_group2_it = half_edges.find(*B_it);
-                                if( (he_group2_it != half_edges.end()) 
-                                &&  (he_group2_it->second.count(A) != 0) ){
-                                    //Cycle detected -- remove both half-edges.
-                                    he_group2_it->second.erase(A);
-                                    B_it = he_group.second.erase(B_it);
-                                }else{
-                                    ++B_it;
-                                }
+                        for(long int v = 0; v < vert_count; ++v){
+                            auto &he = half_edges[v];
+                            if( (he & he_col_pos) && (half_edges[v+1] & he_col_neg) ){
+                                he &= ~he_col_pos;
+                                half_edges[v+1] &= ~he_col_neg;
+                            }
+                            if( (he & he_row_pos) && (half_edges[v+(C+1)] & he_row_neg) ){
+                                he &= ~he_row_pos;
+                                half_edges[v+(C+1)] &= ~he_row_neg;
                             }
                         }
                     }
@@ -335,14 +335,8 @@ Drover ContourViaThreshold(Drover DICOM_data,
                     
                     //Walk all available half-edges forming contour perimeters.
                     std::list<contour_of_points<double>> copl;
-                    if(!half_edges.empty()){
-                        auto he_it = half_edges.begin();
-                        while(he_it != half_edges.end()){
-                            if(he_it->second.empty()){
-                                ++he_it;
-                                continue;
-                            }
-
+                    for(long int A = 0; any_half_edges && (A < vert_count); ++A){
+                        while(half_edges[A] != 0){
                             copl.emplace_back();
                             copl.back().closed = true;
                             copl.back().metadata["ROIName"] = ROILabel;
@@ -355,16 +349,16 @@ Drover ContourViaThreshold(Drover DICOM_data,
                                 if(animg.metadata.count(key) != 0) copl.back().metadata[key] = animg.metadata.at(key);
                             }
 
-                            const auto A = he_it->first; //The starting node.
                             auto B = A;
                             do{
-                                const auto B_he_it = half_edges.find(B);
-                                auto B_it = B_he_it->second.begin(); // TODO: pick left-most (relative to current direction) node.
-                                                                     //       This is how you can will get consistent orientation handling!
-
-                                B = *B_it;
-                                copl.back().points.emplace_back(verts[B]); //Add the vertex to the current contour.
-                                B_he_it->second.erase(B_it); //Retire the node.
+                                // TODO: pick left-most (relative to current direction) node.
+                                //       This is how you can will get consistent orientation handling!
+                                auto &he = half_edges[B];
+                                const auto dir = static_cast<unsigned char>(he & (-he)); // Lowest set bit.
+                                he &= ~dir; //Retire the half-edge.
+
+                                B = he_dest(B, dir);
+                                copl.back().points.emplace_back(vert_position(B)); //Add the vertex to the current contour.
                             }while(B != A);
                         }
                     }
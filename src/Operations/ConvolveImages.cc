@@ -17,6 +17,7 @@
 #include "../YgorImages_Functors/ConvenienceRoutines.h"
 #include "../YgorImages_Functors/Grouping/Misc_Functors.h"
 #include "../YgorImages_Functors/Compute/Volumetric_Neighbourhood_Sampler.h"
+#include "../YgorImages_Functors/Compute/Volumetric_Convolution_FFT.h"
 
 #include "YgorImages.h"
 #include "YgorString.h"       //Needed for GetFirstRegex(...)
@@ -111,6 +112,26 @@ OperationDoc OpArgDocConvolveImages(){
                                  "pattern-match" };
     out.args.back().samples = OpArgSamples::Exhaustive;
 
+
+    out.args.emplace_back();
+    out.args.back().name = "Engine";
+    out.args.back().desc = "Controls how the kernel is applied."
+                           " The 'direct' engine visits every kernel voxel for every outgoing voxel, so its cost"
+                           " grows with the kernel size."
+                           " The 'fft' engine uses blocked fast Fourier transforms, so its cost is largely"
+                           " independent of the kernel size; pattern-matching is expressed via correlation."
+                           " Both engines produce the same results (up to floating-point round-off), including"
+                           " at the boundaries where the kernel extends beyond the image array."
+                           " The 'fft' engine requires a specific (non-negative) channel."
+                           " The 'auto' engine selects 'fft' for kernels with at least 125 voxels (e.g., 5x5x5)"
+                           " when a specific channel is selected, and 'direct' otherwise.";
+    out.args.back().default_val = "auto";
+    out.args.back().expected = true;
+    out.args.back().examples = { "auto",
+                                 "direct",
+                                 "fft" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
     return out;
 }
 
@@ -129,6 +150,7 @@ Drover ConvolveImages(Drover DICOM_data,
 
     const auto Channel = std::stol( OptArgs.getValueStr("Channel").value() );
     const auto OperationStr = OptArgs.getValueStr("Operation").value();
+    const auto EngineStr = OptArgs.getValueStr("Engine").value();
 
     //-----------------------------------------------------------------------------------------------------------------
     const auto regex_conv = Compile_Regex("^conv?o?l?u?t?i?o?n?$");
@@ -138,6 +160,23 @@ Drover ConvolveImages(Drover DICOM_data,
     const bool op_is_conv = std::regex_match(OperationStr, regex_conv);
     const bool op_is_corr = std::regex_match(OperationStr, regex_corr);
     const bool op_is_mtch = std::regex_match(OperationStr, regex_mtch);
+
+    const auto regex_auto = Compile_Regex("^au?t?o?$");
+    const auto regex_dirc = Compile_Regex("^di?r?e?c?t?$");
+    const auto regex_fft  = Compile_Regex("^ff?t?$");
+
+    const bool engine_is_auto = std::regex_match(EngineStr, regex_auto);
+    const bool engine_is_dirc = std::regex_match(EngineStr, regex_dirc);
+    const bool engine_is_fft  = std::regex_match(EngineStr, regex_fft);
+    if(!engine_is_auto && !engine_is_dirc && !engine_is_fft){
+        throw std::invalid_argument("Engine not understood. Cannot continue.");
+    }
+    if(engine_is_fft && (Channel < 0)){
+        throw std::invalid_argument("The FFT engine requires a specific channel. Cannot continue.");
+    }
+
+    // Kernels with at least this many voxels are applied via FFT when the engine is selected automatically.
+    const long int fft_kernel_threshold = 125;
     //-----------------------------------------------------------------------------------------------------------------
 
     // Identify the contours to use.
@@ -200,6 +239,44 @@ Drover ConvolveImages(Drover DICOM_data,
             const auto k_imgs = static_cast<long int>(img_adj.int_to_img.size());
             //std::map<long int, img_ptr_t> int_to_img;
 
+            const bool use_fft = engine_is_fft
+                              || ( engine_is_auto
+                                   && (0 <= Channel)
+                                   && (fft_kernel_threshold <= k_rows * k_columns * k_imgs) );
+            if(use_fft){
+                ComputeVolumetricConvolutionFFTUserData fft_ud;
+                fft_ud.channel = Channel;
+                fft_ud.description = "Image Convolved";
+                if(op_is_conv){
+                    fft_ud.operation = ComputeVolumetricConvolutionFFTUserData::Operation::Convolution;
+                }else if(op_is_corr){
+                    fft_ud.operation = ComputeVolumetricConvolutionFFTUserData::Operation::Correlation;
+                }else if(op_is_mtch){
+                    fft_ud.operation = ComputeVolumetricConvolutionFFTUserData::Operation::PatternMatch;
+                }else{
+                    throw std::logic_error("Requested operation is not understood. Cannot continue.");
+                }
+                fft_ud.kernel_rows = k_rows;
+                fft_ud.kernel_columns = k_columns;
+                fft_ud.kernel_images = k_imgs;
+                fft_ud.kernel.resize( static_cast<size_t>(k_rows * k_columns * k_imgs) );
+                for(long int i = 0; i < k_imgs; ++i){
+                    const auto l_img_refw = img_adj.index_to_image(i + first_img_num);
+                    for(long int r = 0; r < k_rows; ++r){
+                        for(long int c = 0; c < k_columns; ++c){
+                            fft_ud.kernel[ static_cast<size_t>((i * k_rows + r) * k_columns + c) ]
+                                = static_cast<float>( l_img_refw.get().value(r, c, Channel) );
+                        }
+                    }
+                }
+
+                if(!(*iap_it)->imagecoll.Compute_Images( ComputeVolumetricConvolutionFFT,
+                                                         {}, cc_ROIs, &fft_ud )){
+                    throw std::runtime_error("Unable to convolve images.");
+                }
+                continue;
+            }
+
             const auto d_r = k_rows / 2;   // Offsets to (approximately) centre the kernel.
             const auto d_c = k_columns / 2;
             const auto d_i = k_imgs / 2;
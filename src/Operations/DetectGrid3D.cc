@@ -1,6 +1,7 @@
 //DetectGrid3D.cc - A part of DICOMautomaton 2019. Written by hal clark.
 
 #include <any>
+#include <atomic>
 #include <optional>
 #include <functional>
 #include <iterator>
@@ -41,6 +42,7 @@
 #include "YgorFilesDirs.h"
 
 #include "../Structs.h"
+#include "../Parallel_RANSAC.h"
 #include "../Regex_Selectors.h"
 #include "../Insert_Contours.h"
 #include "../Write_File.h"
@@ -920,7 +922,7 @@ ICP_Fit_Grid( std::mt19937 re,
 
     Grid_Context best_GC = GC;
 
-static int icp_invoke = 0;
+static std::atomic<long int> icp_invoke(0);
 
     for(long int loop = 1; loop <= icp_max_loops; ++loop){
 //        std::cout << "====================================== " << "Loop: " << loop << std::endl;
@@ -930,7 +932,7 @@ static int icp_invoke = 0;
         // Note: This *might* be wasteful, but it will also help protect against picking an irrelevant point and being
         // stuck with it for the entire ICP procedure. TODO: try commenting out this code to always use the ransac point
         // as the rotation centre.
-        std::uniform_int_distribution<long int> rd(0, ICPC.cohort.size());
+        std::uniform_int_distribution<long int> rd(0, ICPC.cohort.size() - 1);
         const auto N_select = rd(re);
         ICPC.rot_centre = (*std::next( std::begin(ICPC.cohort), N_select ));
 
@@ -1207,8 +1209,6 @@ Drover DetectGrid3D(Drover DICOM_data,
         return ResultsSummaryFileName;
     };
 
-    std::mt19937 re( RandomSeed );
-
 FUNCINFO("Loading point clouds");
 
     auto PCs_all = All_PCs( DICOM_data );
@@ -1238,11 +1238,9 @@ if(false){
 
         Grid_Context best_GC; // The current best estimate of the grid position.
 
-        Grid_Context GC; // A working estimate of the grid position.
-        GC.grid_sep = GridSeparation;
-        GC.grid_sampling = GridSampling;
-
-        ICP_Context ICPC; // Working ICP context.
+        Grid_Context initial_GC; // The initial estimate of the grid position.
+        initial_GC.grid_sep = GridSeparation;
+        initial_GC.grid_sampling = GridSampling;
 
         ICP_Context whole_ICPC; // Whole (i.e., entire point cloud) context.
         whole_ICPC.cohort = (*pcp_it)->pset.points;
@@ -1256,40 +1254,34 @@ if(false){
         // identify a reasonable default threshold. Here we tailor to the case of extremely noisy data and try allow for
         // *most* points to be randomly sampled. This might result in an excessive amount of tries for large data sets,
         // but it will also minimize the likelihood that valid cases will erroneously be rejected.
-        //
-        // The routine below can be called only a certain number of times before throwing.
-        long int RANSACFails = 0;
-        const long int PermittedRANSACFails = std::max(100L, static_cast<long int>((*pcp_it)->pset.points.size() * 2));
-        auto Handle_RANSAC_Failure = [&]() -> void {
-            ++RANSACFails;
-            if(RANSACFails > PermittedRANSACFails){
-                std::stringstream ss;
-                ss << "Encountered too many RANSAC failures."
-                   << " Confirm GridSeparation and RANSACDist are valid and appropriate for the point cloud density.";
-                throw std::runtime_error(ss.str());
-            }
-            return;
-        };
+        Parallel_RANSAC_Params ransac_params;
+        ransac_params.random_seed = static_cast<uint64_t>(RandomSeed);
+        ransac_params.max_trials = RANSACMaxLoops;
+        ransac_params.max_failures = std::max(100L, static_cast<long int>((*pcp_it)->pset.points.size() * 2));
 
         // Perform a RANSAC analysis by only analyzing the vicinity of a randomly selected point.
-        long int ransac_loop = 0;
+        //
+        // Trials are independent given their random stream, so they are performed in parallel. Each trial begins with
+        // the best grid found in preceding batches of trials (or the default grid for the first batch).
+        const auto &all_points = (*pcp_it)->pset.points;
+        std::atomic<long int> completed(0);
         std::mutex saver_printer;
-        while(ransac_loop < RANSACMaxLoops){
+        auto ransac_best = Parallel_RANSAC<Grid_Context>(ransac_params,
+                               [&](Parallel_RANSAC_Trial<Grid_Context> &trial) -> std::optional<std::pair<Grid_Context, double>> {
+            Grid_Context GC = (trial.incumbent == nullptr) ? initial_GC : *(trial.incumbent);
+            ICP_Context ICPC; // Working ICP context.
+
             // Randomly select a point from the cloud.
-            std::uniform_int_distribution<long int> rd(0, (*pcp_it)->pset.points.size());
-            const auto N = rd(re);
-            ICPC.ransac_centre = (* std::next( std::begin((*pcp_it)->pset.points), N ));
+            std::uniform_int_distribution<long int> rd(0, all_points.size() - 1);
+            const auto N = rd(trial.re);
+            ICPC.ransac_centre = (* std::next( std::begin(all_points), N ));
 
             // Retain only the points within a small distance of the RANSAC centre.
-            using pcp_t = decltype((*pcp_it)->pset.points.front());
-            ICPC.cohort = (*pcp_it)->pset.points;
-            ICPC.cohort.erase(
-                std::remove_if(std::begin(ICPC.cohort), 
-                               std::end(ICPC.cohort),
-                               [&](pcp_t &pcp) -> bool {
-                                   return (pcp.distance(ICPC.ransac_centre) > RANSACDist);
-                               }),
-                std::end(ICPC.cohort) );
+            for(const auto &pcp : all_points){
+                if(pcp.distance(ICPC.ransac_centre) <= RANSACDist){
+                    ICPC.cohort.push_back(pcp);
+                }
+            }
 
             if(ICPC.cohort.size() < 3){
                 // If there are too few points to meaningfully continue, then the only thing we can assume is that the
@@ -1297,58 +1289,55 @@ if(false){
                 // failures occur then we can probably conclude that the grid parameters are inappropriate. For example,
                 // if the GridSeparation is too small then all points will appear to be in regions of low density.
                 FUNCWARN("Too few adjacent points (" << ICPC.cohort.size() << "), rebooting RANSAC loop.");
-                Handle_RANSAC_Failure(); // Will throw if too many failures encountered.
-                continue;
+                return std::nullopt;
             }
 
             // Allocate storage for ICP loops.
             ICPC.p_cell = ICPC.cohort;
             ICPC.p_corr = ICPC.cohort;
-            //ICPC.p_corr.resize(ICPC.cohort.size());
-            //ICPC.rot_centre = ICPC.ransac_centre;
 
             // Perform ICP on the sub-set cohort.
             try{
-                ICP_Fit_Grid(re, CoarseICPMaxLoops, GC, ICPC);
+                ICP_Fit_Grid(trial.re, CoarseICPMaxLoops, GC, ICPC);
             }catch(const std::exception &e){
                 FUNCWARN("Error encountered during coarse ICP (" << e.what() << "), rebooting RANSAC loop.");
-                Handle_RANSAC_Failure(); // Will throw if too many failures encountered.
-                continue;
+                return std::nullopt;
             }
 
             // Invalidate the coarse fit score since it is not applicable to the whole point cloud.
             GC.score = std::numeric_limits<double>::quiet_NaN();
 
             // Using the subset cohort fit, perform an ICP using the whole point cloud.
-            //Grid_Context whole_GC = GC; // Needed?
-            //whole_GC.grid_sep = GridSeparation;
-            whole_ICPC.ransac_centre = ICPC.ransac_centre;
+            ICP_Context l_whole_ICPC = whole_ICPC;
+            l_whole_ICPC.ransac_centre = ICPC.ransac_centre;
 
             try{
-                ICP_Fit_Grid(re, FineICPMaxLoops, GC, whole_ICPC);
+                ICP_Fit_Grid(trial.re, FineICPMaxLoops, GC, l_whole_ICPC);
             }catch(const std::exception &e){
                 FUNCWARN("Error encountered during fine ICP (" << e.what() << "), rebooting RANSAC loop.");
-                Handle_RANSAC_Failure(); // Will throw if too many failures encountered.
-                continue;
+                return std::nullopt;
             }
 
-            // Evaluate over the entire point cloud, retaining the global best.
-            GC.score = Score_Fit(whole_ICPC);
-            if(!std::isfinite(best_GC.score) || (GC.score < best_GC.score)){
-                best_GC = GC;
-            }
+            // Evaluate over the entire point cloud.
+            GC.score = Score_Fit(l_whole_ICPC);
 
             {
+                const auto l_completed = ++completed;
                 std::lock_guard<std::mutex> lock(saver_printer);
                 std::stringstream ss;
 
-                ss << "Completed RANSAC loop " << ransac_loop << " of " << RANSACMaxLoops
-                   << " --> " << static_cast<int>(1000.0*(ransac_loop)/RANSACMaxLoops)/10.0 << "%."
-                   << " Best and current scores are " << best_GC.score << " and " << GC.score;
+                ss << "Completed RANSAC loop " << l_completed << " of " << RANSACMaxLoops
+                   << " --> " << static_cast<int>(1000.0*(l_completed)/RANSACMaxLoops)/10.0 << "%."
+                   << " Best and current scores are " << std::min(trial.best_score->load(), GC.score)
+                   << " and " << GC.score;
                 FUNCINFO(ss.str());
             }
-            ++ransac_loop;
-        } // RANSAC loop.
+            return std::make_pair(GC, GC.score);
+        });
+        if(!ransac_best){
+            throw std::runtime_error("RANSAC was unable to fit a grid. Cannot continue.");
+        }
+        best_GC = ransac_best->first;
 
         // Do something with the results.
         if(true){
@@ -1511,7 +1500,7 @@ if(false){
                     // Determine which triplet of indices the corner corresponds to.
                     //
                     // Vector rel. to grid anchor.
-                    const auto R_owner = (P_owner - GC.current_grid_anchor);
+                    const auto R_owner = (P_owner - best_GC.current_grid_anchor);
 
                     // Vector within the unit cube, described in the grid axes basis.
                     auto index_x = static_cast<long int>( std::round( R_owner.Dot(best_GC.current_grid_x) / best_GC.grid_sep ) );
@@ -1,6 +1,7 @@
 //DumpROIData.cc - A part of DICOMautomaton 2015, 2016. Written by hal clark.
 
 #include <algorithm>
+#include <functional>
 #include <optional>
 #include <iostream>
 #include <iterator>
@@ -14,16 +15,21 @@
 #include <vector>
 
 #include "../Structs.h"
+#include "../Dose_Meld.h"
+#include "../Dose_Volume_Stats.h"
 #include "DumpROIData.h"
 #include "Explicator.h"       //Needed for Explicator class.
+#include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
+#include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 
 
 OperationDoc OpArgDocDumpROIData(){
     OperationDoc out;
     out.name = "DumpROIData";
 
-    out.desc = "This operation dumps ROI contour information for debugging and quick inspection purposes.";
+    out.desc = "This operation dumps ROI contour information for debugging and quick inspection purposes."
+               " If dose is available, dose statistics for each ROI are also reported.";
 
     return out;
 }
@@ -162,6 +168,53 @@ Drover DumpROIData(const Drover& DICOM_data,
     std::cout << std::endl;
 
 
+    //Dose statistics, if dose is available. All ROIs are evaluated together in a single pass over the dose.
+    auto d = Isolate_Dose_Data(DICOM_data);
+    if((DICOM_data.contour_data != nullptr) && d.Has_Image_Data()){
+        auto dose_data_to_use = d.image_data;
+        if(dose_data_to_use.size() > 1) dose_data_to_use = Meld_Image_Data(d.image_data);
+
+        if(dose_data_to_use.size() != 1){
+            FUNCWARN("Unable to meld dose data. Dose statistics will not be reported");
+        }else{
+            std::map<key_t, contour_collection<double>> ROIContours;
+            for(auto & cc : DICOM_data.contour_data->ccs){
+                for(auto & c : cc.contours){
+                    key_t key = std::tie(c.metadata["PatientID"], c.metadata["ROIName"], c.metadata["NormalizedROIName"]);
+                    ROIContours[key].contours.push_back(c);
+                }
+            }
+
+            std::list<std::reference_wrapper<const planar_image<float,double>>> imgs;
+            for(const auto &img : dose_data_to_use.front()->imagecoll.images) imgs.push_back( std::cref(img) );
+            std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> rois;
+            for(auto & rc : ROIContours) rois.push_back({ std::ref(rc.second) });
+            const auto stats = Compute_Dose_Volume_Stats(imgs, rois);
+
+            std::cout << "==== Dose statistics ====" << std::endl;
+            auto s_it = stats.begin();
+            for(auto & rc : ROIContours){
+                const auto &thekey = rc.first;
+                const auto &s = *(s_it++);
+                std::cout << "DumpROIData:\t"
+                          << "PatientID='" << std::get<0>(thekey) << "'\t"
+                          << "ROIName='" << std::get<1>(thekey) << "'\t"
+                          << "NormalizedROIName='" << std::get<2>(thekey) << "'\t"
+                          << "VoxelCount=" << s.N_voxels << "\t"
+                          << "Volume=" << s.voxel_volume << "\t"
+                          << "DoseMin=" << s.D_min << "\t"
+                          << "DoseMean=" << s.Mean() << "\t"
+                          << "DoseMax=" << s.D_max << "\t"
+                          << "DoseStdDev=" << s.Std_Dev() << "\t"
+                          << "D98=" << s.Dx(0.98) << "\t"
+                          << "D50=" << s.Dx(0.50) << "\t"
+                          << "D02=" << s.Dx(0.02) << "\t"
+                          << std::endl;
+            }
+            std::cout << std::endl;
+        }
+    }
+
 
     std::cout << "==== Explictor best-guesses ====" << std::endl;
     Explicator X(FilenameLex);
@@ -20,15 +20,14 @@
 #include <vector>
 
 #include "../Structs.h"
+#include "../Dose_Volume_Stats.h"
 #include "../Regex_Selectors.h"
-#include "../YgorImages_Functors/Compute/AccumulatePixelDistributions.h"
 #include "EvaluateDoseVolumeStats.h"
 #include "Explicator.h"       //Needed for Explicator class.
 #include "YgorFilesDirs.h"    //Needed for Does_File_Exist_And_Can_Be_Read(...), etc..
 #include "YgorImages.h"
 #include "YgorMath.h"         //Needed for vec3 class.
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
-#include "YgorStats.h"        //Needed for Stats:: namespace.
 
 
 
@@ -49,8 +48,9 @@ OperationDoc OpArgDocEvaluateDoseVolumeStats(){
         
         
     out.notes.emplace_back(
-        "This routine will combine spatially-overlapping images by summing voxel intensities. It will not"
-        " combine separate image_arrays though. If needed, you'll have to perform a meld on them beforehand."
+        "This routine will combine spatially-overlapping images that share an identical geometry by summing voxel"
+        " intensities. It will not combine separate image_arrays though. If needed, you'll have to perform a meld on"
+        " them beforehand."
     );
 
 
@@ -195,63 +195,49 @@ Drover EvaluateDoseVolumeStats(Drover DICOM_data,
         patient_ID = "unknown_person";
     }
 
-    //Accumulate the voxel intensity distributions.
-    AccumulatePixelDistributionsUserData ud_PTV;
-    if(!img_arr_ptr->imagecoll.Compute_Images( AccumulatePixelDistributions, { },
-                                               cc_PTV_ROIs, &ud_PTV )){
-        throw std::runtime_error("Unable to accumulate PTV pixel distributions.");
-    }
-    AccumulatePixelDistributionsUserData ud_Body;
-    if(!img_arr_ptr->imagecoll.Compute_Images( AccumulatePixelDistributions, { },
-                                               cc_Body_ROIs, &ud_Body )){
-        throw std::runtime_error("Unable to accumulate Body pixel distributions.");
+    //Accumulate the dose distributions of every PTV and the body in a single pass. PTVs are kept distinct (keyed by
+    // ROIName), but all body ROIs are treated as a single object.
+    std::map<std::string, size_t> PTV_index;
+    std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> rois;
+    for(const auto &cc_refw : cc_PTV_ROIs){
+        const auto ROIName = cc_refw.get().contours.front().GetMetadataValueAs<std::string>("ROIName").value_or("");
+        auto it = PTV_index.find(ROIName);
+        if(it == PTV_index.end()){
+            it = PTV_index.emplace(ROIName, rois.size()).first;
+            rois.emplace_back();
+        }
+        rois[it->second].push_back(cc_refw);
     }
+    rois.push_back(cc_Body_ROIs);
 
+    std::list<std::reference_wrapper<const planar_image<float,double>>> imgs;
+    for(const auto &img : img_arr_ptr->imagecoll.images) imgs.push_back( std::cref(img) );
+    const auto stats = Compute_Dose_Volume_Stats(imgs, rois);
+    const auto &Body_stats = stats.back();
 
     const auto Dpres95 = 0.95 * PTVPrescriptionDose;
-    long int N_Body_over_Dpres95 = 0; //We assume all body ROIs are part of a single object.
 
     //Evalute the models.
-    {
-        for(auto &av : ud_Body.accumulated_voxels){
-            for(const auto &D_voxel : av.second){
-                if(D_voxel > Dpres95) ++N_Body_over_Dpres95;
-            }
-            av.second.clear(); // Reduce memory pressure.
-        }
-    }
+    const auto N_Body_over_Dpres95 = static_cast<double>(Body_stats.N_voxels) * Body_stats.Vx(Dpres95);
 
     std::map<std::string, double> HI; // Heterogeneity index.
     std::map<std::string, double> CN; // Conformity number.
+    for(const auto &p : PTV_index){
+        const auto lROIname = p.first;
+        const auto &s = stats[p.second];
+        if(s.N_voxels == 0) continue;
 
-    std::map<std::string, long int> N_PTV_over_Dpres95; //We assume all PTV ROIs are distinct.
-    {
-        for(const auto &av : ud_PTV.accumulated_voxels){
-            const auto lROIname = av.first;
+        const auto D_02 = s.Percentile(0.98); // D_02 == 98% dose percentile.
+        const auto D_50 = s.Percentile(0.50);
+        const auto D_98 = s.Percentile(0.02); // D_98 == 2% dose percentile.
 
-            const auto D_02 = Stats::Percentile(av.second, 0.98); // D_02 == 98% dose percentile.
-            const auto D_50 = Stats::Percentile(av.second, 0.50);
-            const auto D_98 = Stats::Percentile(av.second, 0.02); // D_98 == 2% dose percentile.
+        HI[lROIname] = (D_02 - D_98)/D_50;
 
-            HI[lROIname] = (D_02 - D_98)/D_50;
+        const auto N_T = static_cast<double>(s.N_voxels);
+        const auto N_T_pres = N_T * s.Vx(Dpres95);
+        const auto N_pres = N_Body_over_Dpres95;
 
-            long int N_over_Dpres95 = 0;
-            for(const auto &D_voxel : av.second){
-                if(D_voxel > Dpres95) ++N_over_Dpres95;
-            }
-            N_PTV_over_Dpres95[lROIname] += N_over_Dpres95;
-        }
-        for(const auto &av : ud_PTV.accumulated_voxels){
-            const auto lROIname = av.first;
-            const auto N = av.second.size();
-            //const long double V_frac = static_cast<long double>(1) / N; // Fractional volume of a single voxel compared to whole ROI.
-
-            const auto N_T = static_cast<double>(N);
-            const auto N_T_pres = static_cast<double>(N_PTV_over_Dpres95[lROIname]);
-            const auto N_pres = static_cast<double>(N_Body_over_Dpres95);
-
-            CN[lROIname] = (N_T_pres * N_T_pres) / (N_T * N_pres);
-        }
+        CN[lROIname] = (N_T_pres * N_T_pres) / (N_T * N_pres);
     }
 
 
@@ -288,13 +274,16 @@ Drover EvaluateDoseVolumeStats(Drover DICOM_data,
                    << "VoxelCount"
                    << std::endl;
         }
-        for(const auto &av : ud_PTV.accumulated_voxels){
-            const auto lROIname = av.first;
-            const auto DoseMin = Stats::Min( av.second );
-            const auto DoseMean = Stats::Mean( av.second );
-            const auto DoseMedian = Stats::Median( av.second );
-            const auto DoseMax = Stats::Max( av.second );
-            const auto DoseStdDev = std::sqrt(Stats::Unbiased_Var_Est( av.second ));
+        for(const auto &p : PTV_index){
+            const auto lROIname = p.first;
+            const auto &s = stats[p.second];
+            if(s.N_voxels == 0) continue;
+
+            const auto DoseMin = s.D_min;
+            const auto DoseMean = s.Mean();
+            const auto DoseMedian = s.Percentile(0.50);
+            const auto DoseMax = s.D_max;
+            const auto DoseStdDev = s.Std_Dev();
             const auto HeterogeneityIndex = HI[lROIname];
             const auto ConformityNumber = CN[lROIname];
 
@@ -309,7 +298,7 @@ Drover EvaluateDoseVolumeStats(Drover DICOM_data,
                     << DoseMedian         << ","
                     << DoseMax            << ","
                     << DoseStdDev         << ","
-                    << av.second.size()
+                    << s.N_voxels
                     << std::endl;
         }
         FO_tcp.flush();
@@ -86,7 +86,7 @@ OperationDoc OpArgDocExtractPointsWarp(){
     out.args.back().desc = "The alignment algorithm to use."
                            " The following alignment options are available: 'centroid'"
 #ifdef DCMA_USE_EIGEN
-                           ", 'PCA', 'exhaustive_icp', 'TPS', and 'TPS-RPM'"
+                           ", 'PCA', 'exhaustive_icp', 'ICP', 'TPS', and 'TPS-RPM'"
 #endif
                            "."
                            " The 'centroid' option finds a rotationless translation the aligns the centroid"
@@ -130,6 +130,14 @@ OperationDoc OpArgDocExtractPointsWarp(){
                            " It can be used for 2D and 1D degenerate problems, but is not guaranteed to find the"
                            " 'correct' orientation of degenerate or symmetrical point clouds."
                            ""
+                           " The 'ICP' option is similar to 'exhaustive_icp', but correspondence is estimated by"
+                           " querying a spatial index that is built over the stationary point cloud once, so each"
+                           " iteration scales as O(N log M) rather than O(NM) and point clouds consisting of"
+                           " hundreds of thousands of points can be aligned."
+                           " The transformation is refined incrementally each iteration, and either point-to-point or"
+                           " point-to-plane residuals can be minimized (see the 'ICPMetric' parameter)."
+                           " The 'exhaustive_icp' method remains available for verification."
+                           ""
                            " The 'TPS' or Thin-Plate Spline algorithm provides non-rigid"
                            " (i.e., 'deformable') registration between corresponding point sets."
                            " The moving and stationary point sets must have the same number of points, and"
@@ -167,7 +175,7 @@ OperationDoc OpArgDocExtractPointsWarp(){
     out.args.back().default_val = "centroid";
     out.args.back().expected = true;
 #ifdef DCMA_USE_EIGEN
-    out.args.back().examples = { "centroid", "pca", "exhaustive_icp", "tps", "tps_rpm" };
+    out.args.back().examples = { "centroid", "pca", "exhaustive_icp", "icp", "tps", "tps_rpm" };
 #else
     out.args.back().examples = { "centroid" };
 #endif
@@ -448,6 +456,53 @@ OperationDoc OpArgDocExtractPointsWarp(){
     out.args.back().examples = { "true", "false" };
 #endif
 
+#ifdef DCMA_USE_EIGEN
+    out.args.emplace_back();
+    out.args.back().name = "ICPMetric";
+    out.args.back().desc = "The residual that is minimized by the 'ICP' method."
+                           " 'point-to-point' minimizes the distance between each moving point and the nearest"
+                           " stationary point."
+                           " 'point-to-plane' minimizes the distance between each moving point and the plane tangent"
+                           " to the stationary point cloud at the nearest stationary point, which permits points to"
+                           " slide along the surface and generally converges in fewer iterations when the point clouds"
+                           " sample a surface. Tangent planes are estimated from the nearest stationary points."
+                           " Note that this parameter is only used with the ICP method.";
+    out.args.back().default_val = "point-to-plane";
+    out.args.back().expected = true;
+    out.args.back().examples = { "point-to-point", "point-to-plane" };
+#endif
+
+#ifdef DCMA_USE_EIGEN
+    out.args.emplace_back();
+    out.args.back().name = "TPSRPMNearestNeighbours";
+    out.args.back().desc = "The number of nearest stationary points (to each transformed moving point) that are"
+                           " permitted to correspond. All other correspondences are neglected, which permits the"
+                           " correspondence matrix to be stored sparsely and the Sinkhorn procedure to scale linearly"
+                           " with the number of points. This is required for large point clouds (e.g., more than a few"
+                           " thousand points). Truncation is only reasonable when the point clouds are already"
+                           " roughly aligned, so consider a lower starting temperature."
+                           " Setting this to zero disables truncation."
+                           " Note that this parameter is used with the TPS-RPM method, but *not* in the TPS method.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "8", "16", "32" };
+#endif
+
+#ifdef DCMA_USE_EIGEN
+    out.args.emplace_back();
+    out.args.back().name = "TPSRPMControlPoints";
+    out.args.back().desc = "The number of moving points that are used as thin plate spline control points. Control"
+                           " points are selected so they evenly cover the moving point cloud, and the spline is fitted"
+                           " in a least-squares sense. Using fewer control points reduces the size of the linear system"
+                           " that must be solved at every iteration, which is required for large point clouds."
+                           " Reduced control points cannot be used with double-sided outlier handling."
+                           " Setting this to zero uses every moving point as a control point."
+                           " Note that this parameter is used with the TPS-RPM method, but *not* in the TPS method.";
+    out.args.back().default_val = "0";
+    out.args.back().expected = true;
+    out.args.back().examples = { "0", "100", "500", "2000" };
+#endif
+
     out.args.emplace_back();
     out.args.back().name = "MaxIterations";
     out.args.back().desc = "If the method is iterative, only permit this many iterations to occur."
@@ -515,6 +570,11 @@ Drover ExtractPointsWarp(Drover DICOM_data,
     const auto TPSRPMHardContraintsStr = OptArgs.getValueStr("TPSRPMHardConstraints").value();
     const auto TPSRPMPermitMovingOutliersStr = OptArgs.getValueStr("TPSRPMPermitMovingOutliers").value();
     const auto TPSRPMPermitStationaryOutliersStr = OptArgs.getValueStr("TPSRPMPermitStationaryOutliers").value();
+    const auto TPSRPMNearestNeighbours = std::stol( OptArgs.getValueStr("TPSRPMNearestNeighbours").value() );
+    const auto TPSRPMControlPoints = std::stol( OptArgs.getValueStr("TPSRPMControlPoints").value() );
+
+    // ICP params.
+    const auto ICPMetricStr = OptArgs.getValueStr("ICPMetric").value();
 #endif // DCMA_USE_EIGEN
 
     const auto MaxIters = std::stol( OptArgs.getValueStr("MaxIterations").value() );
@@ -526,12 +586,16 @@ Drover ExtractPointsWarp(Drover DICOM_data,
 #ifdef DCMA_USE_EIGEN    
     const auto regex_pca    = Compile_Regex("^pc?a?$");
     const auto regex_exhicp = Compile_Regex("^ex?h?a?u?s?t?i?v?e?[-_]?i?c?p?$");
+    const auto regex_icp    = Compile_Regex("^ic?p?$");
     const auto regex_tps    = Compile_Regex("^tp?s?$");
     const auto regex_tpsrpm = Compile_Regex("^tp?s?[-_]?rp?m?$");
 
     const auto regex_ldlt = Compile_Regex("^LD?L?T?$");
     const auto regex_pinv = Compile_Regex("^ps?e?u?d?o?[-_]?i?n?v?e?r?s?e?$");
 
+    const auto regex_pt2pt = Compile_Regex("^po?i?n?t?[-_]?t?o?[-_]?po?i?n?t?$");
+    const auto regex_pt2pl = Compile_Regex("^po?i?n?t?[-_]?t?o?[-_]?pl?a?n?e?$");
+
     const auto TPSRPMSeedWithCentroidShift = std::regex_match(TPSRPMSeedWithCentroidShiftStr, regex_true);
     const auto TPSRPMDoubleSidedOutliers = std::regex_match(TPSRPMDoubleSidedOutliersStr, regex_true);
     const auto TPSRPMPermitMovingOutliers = std::regex_match(TPSRPMPermitMovingOutliersStr, regex_true);
@@ -618,6 +682,31 @@ Drover ExtractPointsWarp(Drover DICOM_data,
                 throw std::runtime_error("Failed to warp using exhaustive ICP.");
             }
 
+        }else if( std::regex_match(MethodStr, regex_icp) ){
+            AlignViaIndexedICPParams params;
+            params.max_icp_iters = MaxIters;
+            params.f_rel_tol = RelativeTol;
+            if( std::regex_match(ICPMetricStr, regex_pt2pl) ){
+                params.metric = AlignViaIndexedICPParams::Metric::PointToPlane;
+            }else if( std::regex_match(ICPMetricStr, regex_pt2pt) ){
+                params.metric = AlignViaIndexedICPParams::Metric::PointToPoint;
+            }else{
+                throw std::invalid_argument("ICP metric not understood. Cannot continue.");
+            }
+
+            auto t_opt = AlignViaIndexedICP( params,
+                                             (*pcp_it)->pset,
+                                             (*ref_PCs.front())->pset );
+            if(t_opt){
+                FUNCINFO("Successfully found warp using ICP after " << params.N_iterations << " iterations");
+                DICOM_data.trans_data.emplace_back( std::make_shared<Transform3>( ) );
+                DICOM_data.trans_data.back()->transform = t_opt.value();
+                DICOM_data.trans_data.back()->metadata["Name"] = "unspecified";
+                DICOM_data.trans_data.back()->metadata["WarpType"] = "ICP";
+            }else{
+                throw std::runtime_error("Failed to warp using ICP.");
+            }
+
         }else if( std::regex_match(MethodStr, regex_tps) ){
             AlignViaTPSParams params;
             params.lambda = TPSLambda;
@@ -661,6 +750,8 @@ Drover ExtractPointsWarp(Drover DICOM_data,
             params.forced_correspondence    = TPSRPMHardContraints;
             params.permit_move_outliers     = TPSRPMPermitMovingOutliers;
             params.permit_stat_outliers     = TPSRPMPermitStationaryOutliers;
+            params.N_nearest_neighbours     = TPSRPMNearestNeighbours;
+            params.N_control_points         = TPSRPMControlPoints;
 
 /*
 // Debugging...
@@ -65,6 +65,114 @@ struct dose_dist_stats {
 std::function< dose_dist_stats (std::vector<double> &, std::vector<double> &)> global_evaluate_weights;
 std::vector<double> global_working;
 bool generate_dose_dist_stats = false;
+std::function< double (const std::vector<double> &, std::vector<double> &)> global_evaluate_cost_and_gradient;
+
+
+// A sparse voxel-by-beam dose-influence matrix stored in compressed row (CSR) form. Row 'i' holds the dose each beam
+// delivers to voxel 'i' at unit weight, so the total dose for a weighting scheme is a single sparse mat-vec product.
+struct dose_influence_matrix {
+    long int N_voxels = 0;
+    long int N_beams  = 0;
+
+    std::vector<size_t>   row_offsets; // N_voxels + 1 entries.
+    std::vector<long int> beam_index;
+    std::vector<double>   dose;
+};
+
+static
+dose_influence_matrix
+Build_Dose_Influence_Matrix(const std::vector<std::vector<double>> &voxels){
+    dose_influence_matrix out;
+    out.N_beams  = static_cast<long int>(voxels.size());
+    out.N_voxels = voxels.empty() ? 0 : static_cast<long int>(voxels.front().size());
+
+    out.row_offsets.reserve(out.N_voxels + 1);
+    out.row_offsets.push_back(0);
+    for(long int i = 0; i < out.N_voxels; ++i){
+        for(long int b = 0; b < out.N_beams; ++b){
+            const auto d = voxels[b][i];
+            if(d == 0.0) continue; // Voxels outside a field receive no dose from it.
+            out.beam_index.push_back(b);
+            out.dose.push_back(d);
+        }
+        out.row_offsets.push_back(out.dose.size());
+    }
+    return out;
+}
+
+
+// The location of a percentile within a dose distribution. The percentile is linearly interpolated between the voxels
+// with ranks 'rank_L' and 'rank_H'; these voxels are reported so derivatives can be propagated through them.
+struct dvh_percentile {
+    double D      = std::numeric_limits<double>::quiet_NaN();
+    size_t voxel_L = 0;
+    size_t voxel_H = 0;
+    double t      = 0.0; // D = (1 - t) * dose[voxel_L] + t * dose[voxel_H].
+};
+
+// Locates a percentile using a cumulative histogram in linear time. Only the voxels that fall within the histogram
+// bins containing the requested ranks are partially sorted, so the full distribution is never sorted.
+static
+dvh_percentile
+Histogram_Percentile(const std::vector<double> &dose,
+                     double q,
+                     std::vector<size_t> &scratch){
+    dvh_percentile out;
+    const auto N = dose.size();
+    if(N == 0) return out;
+
+    const double x = std::clamp(q, 0.0, 1.0) * static_cast<double>(N - 1);
+    const auto rank_L = static_cast<size_t>(std::floor(x));
+    const auto rank_H = std::min(rank_L + 1, N - 1);
+    out.t = x - static_cast<double>(rank_L);
+
+    const auto [D_min_it, D_max_it] = std::minmax_element(dose.begin(), dose.end());
+    const double D_min = *D_min_it;
+    const double D_max = *D_max_it;
+    if(!(D_min < D_max)){
+        out.D = D_min;
+        out.voxel_L = out.voxel_H = static_cast<size_t>(std::distance(dose.begin(), D_min_it));
+        return out;
+    }
+
+    const size_t N_bins = std::clamp<size_t>(N / 8, 16, 8192);
+    const double bin_scale = static_cast<double>(N_bins) / (D_max - D_min);
+    const auto bin_of = [&](double d) -> size_t {
+        return std::min(N_bins - 1, static_cast<size_t>((d - D_min) * bin_scale));
+    };
+
+    std::vector<size_t> counts(N_bins, 0);
+    for(const auto &d : dose) ++counts[bin_of(d)];
+
+    // Find the bins containing the two ranks.
+    size_t bin_L = 0;
+    size_t below = 0; // Number of voxels in bins below bin_L.
+    while((below + counts[bin_L]) <= rank_L){
+        below += counts[bin_L];
+        ++bin_L;
+    }
+    size_t bin_H = bin_L;
+    size_t below_H = below + counts[bin_L];
+    while(below_H <= rank_H){
+        ++bin_H;
+        below_H += counts[bin_H];
+    }
+
+    scratch.clear();
+    for(size_t i = 0; i < N; ++i){
+        const auto bin = bin_of(dose[i]);
+        if((bin_L <= bin) && (bin <= bin_H)) scratch.push_back(i);
+    }
+    const auto by_dose = [&](size_t A, size_t B){ return dose[A] < dose[B]; };
+    const auto nth_L = std::next(scratch.begin(), rank_L - below);
+    std::nth_element(scratch.begin(), nth_L, scratch.end(), by_dose);
+    out.voxel_L = *nth_L;
+    out.voxel_H = (rank_H == rank_L) ? out.voxel_L
+                                     : *std::min_element(std::next(nth_L), scratch.end(), by_dose);
+
+    out.D = (1.0 - out.t) * dose[out.voxel_L] + out.t * dose[out.voxel_H];
+    return out;
+}
 
 
 // This routine determines the normalization factor required to satisfy the given DVH criteria: $V_{D} \geq V_{min}$.
@@ -205,6 +313,22 @@ OperationDoc OpArgDocOptimizeStaticBeams(){
     out.args.back().expected = true;
     out.args.back().examples = { "48.0", "60.0", "63.3", "70.0", "100.0" };
 
+
+    out.args.emplace_back();
+    out.args.back().name = "Method";
+    out.args.back().desc = "Controls the optimization strategy."
+                           " 'Global' uses a derivative-free global search (DIRECT-L). It is robust but its cost"
+                           " grows rapidly with the number of beams and becomes impractical beyond a handful of beams."
+                           " 'Gradient' builds a sparse voxel-by-beam dose-influence matrix once, evaluates the cost"
+                           " and its exact gradient using sparse matrix-vector products and a histogram-based DVH"
+                           " normalization percentile, and minimizes with a local quasi-Newton method (L-BFGS)."
+                           " 'Gradient' is suitable for plans with many beams. Because it is a local method, the"
+                           " result can depend on the (uniform) initial weighting.";
+    out.args.back().default_val = "global";
+    out.args.back().expected = true;
+    out.args.back().examples = { "global", "gradient" };
+    out.args.back().samples = OpArgSamples::Exhaustive;
+
     return out;
 }
 
@@ -232,6 +356,18 @@ Drover OptimizeStaticBeams(Drover DICOM_data,
     const auto dvh_Vmin_frac = std::stod(  OptArgs.getValueStr("NormalizationV").value() );
     const auto D_Rx = std::stod(  OptArgs.getValueStr("RxDose").value() );
 
+    const auto MethodStr = OptArgs.getValueStr("Method").value();
+
+    //-----------------------------------------------------------------------------------------------------------------
+    const auto regex_global = Compile_Regex("^glo?b?a?l?$");
+    const auto regex_gradient = Compile_Regex("^gra?d?i?e?n?t?$");
+
+    const bool use_gradient = std::regex_match(MethodStr, regex_gradient);
+    if( !use_gradient
+    &&  !std::regex_match(MethodStr, regex_global) ){
+        throw std::invalid_argument("Method not understood. Cannot continue.");
+    }
+
     //-----------------------------------------------------------------------------------------------------------------
 
     if(ResultsSummaryFileName.empty()){
@@ -425,33 +561,129 @@ Drover OptimizeStaticBeams(Drover DICOM_data,
         return res.cost;
     };
 
+    // Gradient-based optimization using a precomputed dose-influence matrix.
+    //
+    // The cost is $C = \sum_{i} (s d_{i} - D_{Rx})^2$ where $d = A w$ is the total dose and $s = D_{norm} / p(d)$ is the
+    // DVH normalization scale, with $p(d)$ the normalization percentile. The percentile is piecewise linear in the
+    // dose of the (at most two) voxels it interpolates between, so the gradient is exact almost everywhere:
+    //
+    //   $\partial C / \partial w_{b} = s (A^{T} r)_{b} + (\sum_{i} r_{i} d_{i}) \partial s / \partial w_{b}$,
+    //
+    // where $r_{i} = 2 (s d_{i} - D_{Rx})$ and $\partial s / \partial w_{b} = -(s / p) \partial p / \partial w_{b}$.
+    //
+    // Note that the cost is invariant to a uniform scaling of the weights, so the gradient is always orthogonal to w.
+    dose_influence_matrix dim;
+    if(use_gradient){
+        dim = Build_Dose_Influence_Matrix(voxels);
+        FUNCINFO("Dose-influence matrix has " << dim.dose.size() << " non-zero entries ("
+                 << (100.0 * static_cast<double>(dim.dose.size()) / static_cast<double>(N_voxels * N_beams))
+                 << "% dense)");
+    }
+    std::vector<double> grad_dose(N_voxels, 0.0);
+    std::vector<size_t> percentile_scratch;
+    global_evaluate_cost_and_gradient = [&](const std::vector<double> &weights,
+                                            std::vector<double> &grad) -> double {
+        // Total dose: d = A w.
+        for(long int i = 0; i < dim.N_voxels; ++i){
+            double d = 0.0;
+            for(auto j = dim.row_offsets[i]; j < dim.row_offsets[i+1]; ++j){
+                d += dim.dose[j] * weights[dim.beam_index[j]];
+            }
+            grad_dose[i] = d;
+        }
+
+        const auto p = Histogram_Percentile(grad_dose, 1.0 - dvh_Vmin_frac, percentile_scratch);
+        if(!std::isfinite(p.D) || (p.D < 1E-3)){
+            std::fill(grad.begin(), grad.end(), 0.0);
+            return std::numeric_limits<double>::max();
+        }
+        const double s = (dvh_D_frac * D_Rx) / p.D;
+
+        double cost = 0.0;
+        double rd = 0.0;
+        if(!grad.empty()) std::fill(grad.begin(), grad.end(), 0.0);
+        for(long int i = 0; i < dim.N_voxels; ++i){
+            const double d = grad_dose[i];
+            const double e = s * d - D_Rx;
+            cost += e * e;
+            if(grad.empty()) continue;
+
+            // Accumulate s A^T r.
+            const double r = 2.0 * e;
+            rd += r * d;
+            for(auto j = dim.row_offsets[i]; j < dim.row_offsets[i+1]; ++j){
+                grad[dim.beam_index[j]] += s * r * dim.dose[j];
+            }
+        }
+
+        if(!grad.empty()){
+            // Propagate through the normalization scale via the percentile voxels.
+            const auto add_percentile_row = [&](size_t voxel, double frac){
+                if(frac == 0.0) return;
+                for(auto j = dim.row_offsets[voxel]; j < dim.row_offsets[voxel+1]; ++j){
+                    grad[dim.beam_index[j]] -= rd * (s / p.D) * frac * dim.dose[j];
+                }
+            };
+            add_percentile_row(p.voxel_L, 1.0 - p.t);
+            add_percentile_row(p.voxel_H, p.t);
+        }
+        return cost;
+    };
+
+    auto f_to_optimize_gradient = [](const std::vector<double> &open_weights,
+                                     std::vector<double> &grad,
+                                     void * ) -> double {
+        return global_evaluate_cost_and_gradient(open_weights, grad);
+    };
+
     std::vector<double> open_weights(N_beams, 0.5);
     std::vector<double> working(N_voxels, 0.0);
     global_working = working;
 
 #ifdef DCMA_USE_NLOPT
-    //nlopt::opt optimizer(nlopt::LN_NELDERMEAD, N_beams);
-    nlopt::opt optimizer(nlopt::GN_DIRECT_L, N_beams);
-    //nlopt::opt optimizer(nlopt::GN_ISRES, N_beams);
-    //nlopt::opt optimizer(nlopt::GN_ESCH, N_beams);
-
-    std::vector<double> lower_bounds(N_beams, 0.0);
-    std::vector<double> upper_bounds(N_beams, 1.0);
-
-    optimizer.set_lower_bounds(lower_bounds);
-    optimizer.set_upper_bounds(upper_bounds);
-    optimizer.set_min_objective(f_to_optimize, nullptr);
-    optimizer.set_ftol_abs(-HUGE_VAL);
-    optimizer.set_ftol_rel(1.0E-8);
-    optimizer.set_xtol_abs(-HUGE_VAL);
-    optimizer.set_xtol_rel(-HUGE_VAL);
-    optimizer.set_maxeval(500'000);
-    double minf;
-
-    generate_dose_dist_stats = false;
-    FUNCINFO("Beginning optimization now..")
-    nlopt::result nlopt_result = optimizer.optimize(open_weights, minf); // open_weights will contain the current-best weights on success.
-    FUNCINFO("Optimizer result: " << nlopt_result);
+    if(use_gradient){
+        nlopt::opt optimizer(nlopt::LD_LBFGS, N_beams);
+
+        optimizer.set_lower_bounds(std::vector<double>(N_beams, 0.0));
+        optimizer.set_upper_bounds(std::vector<double>(N_beams, 1.0));
+        optimizer.set_min_objective(f_to_optimize_gradient, nullptr);
+        optimizer.set_ftol_rel(1.0E-10);
+        optimizer.set_xtol_rel(1.0E-8);
+        optimizer.set_maxeval(20'000);
+        double minf;
+
+        FUNCINFO("Beginning gradient-based optimization now..");
+        try{
+            nlopt::result nlopt_result = optimizer.optimize(open_weights, minf);
+            FUNCINFO("Optimizer result: " << nlopt_result);
+        }catch(const nlopt::roundoff_limited &){
+            // The optimizer has converged as far as numerical precision permits. The weights are still valid.
+            FUNCWARN("Optimization was limited by roundoff");
+        }
+    }else{
+        //nlopt::opt optimizer(nlopt::LN_NELDERMEAD, N_beams);
+        nlopt::opt optimizer(nlopt::GN_DIRECT_L, N_beams);
+        //nlopt::opt optimizer(nlopt::GN_ISRES, N_beams);
+        //nlopt::opt optimizer(nlopt::GN_ESCH, N_beams);
+
+        std::vector<double> lower_bounds(N_beams, 0.0);
+        std::vector<double> upper_bounds(N_beams, 1.0);
+
+        optimizer.set_lower_bounds(lower_bounds);
+        optimizer.set_upper_bounds(upper_bounds);
+        optimizer.set_min_objective(f_to_optimize, nullptr);
+        optimizer.set_ftol_abs(-HUGE_VAL);
+        optimizer.set_ftol_rel(1.0E-8);
+        optimizer.set_xtol_abs(-HUGE_VAL);
+        optimizer.set_xtol_rel(-HUGE_VAL);
+        optimizer.set_maxeval(500'000);
+        double minf;
+
+        generate_dose_dist_stats = false;
+        FUNCINFO("Beginning optimization now..")
+        nlopt::result nlopt_result = optimizer.optimize(open_weights, minf); // open_weights will contain the current-best weights on success.
+        FUNCINFO("Optimizer result: " << nlopt_result);
+    }
 #else // DCMA_USE_NLOPT
     FUNCERR("Unable to optimize -- nlopt was not used");
 #endif // DCMA_USE_NLOPT
@@ -474,6 +706,7 @@ Drover OptimizeStaticBeams(Drover DICOM_data,
     
     summary << "# of voxels = " << N_voxels << std::endl
             << "# of beams  = " << N_beams << std::endl
+            << "method      = " << (use_gradient ? "gradient" : "global") << std::endl
             << std::endl;
 
     summary << "D_min  = " << res.D_min << std::endl
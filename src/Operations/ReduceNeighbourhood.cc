@@ -109,6 +109,8 @@ OperationDoc OpArgDocReduceNeighbourhood(){
                            " the 'dilation' operation."
                            " Note that the morphological 'opening' operation can be accomplished by sequentially"
                            " performing an erosion and then a dilation using the same neighbourhood."
+                           " The 'stddev' reduction method reports the (unbiased) standard deviation of the local"
+                           " neighbourhood."
                            " The 'standardize' reduction method can be used for adaptive rescaling by"
                            " subtracting the local neighbourhood mean and dividing the local neighbourhood"
                            " standard deviation."
@@ -139,6 +141,7 @@ OperationDoc OpArgDocReduceNeighbourhood(){
                                  "max",
                                  "dilate",
                                  "standardize",
+                                 "stddev",
                                  "percentile01",
                                  "is_min",
                                  "is_max",
@@ -207,6 +210,7 @@ Drover ReduceNeighbourhood(Drover DICOM_data,
     const auto regex_dilate  = Compile_Regex("^di?l?a?t?.*"); // 'dilate' and 'dilation'.
 
     const auto regex_stdize  = Compile_Regex("^st?a?n?d?a?r?d?i?z?e?d?$");
+    const auto regex_stddev  = Compile_Regex("^std?[_-]?dev$");
     const auto regex_ptile01 = Compile_Regex("^pe?r?c?e?n?[_-]?t?i?l?e?0?1?$");
 
     const auto regex_is_min = Compile_Regex("^is?_?m?ini?m?u?m?$");
@@ -512,25 +516,36 @@ Drover ReduceNeighbourhood(Drover DICOM_data,
 
         if( std::regex_match(ReductionStr, regex_min)
               ||  std::regex_match(ReductionStr, regex_erode) ){
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::Min;
             ud.f_reduce = [](float, std::vector<float> &shtl, vec3<double>) -> float {
                               return Stats::Min(shtl);
                           };
         }else if( std::regex_match(ReductionStr, regex_median) ){
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::Median;
             ud.f_reduce = [](float, std::vector<float> &shtl, vec3<double>) -> float {
                               return Stats::Median(shtl);
                           };
         }else if( std::regex_match(ReductionStr, regex_mean) ){
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::Mean;
             ud.f_reduce = [](float, std::vector<float> &shtl, vec3<double>) -> float {
                               return Stats::Mean(shtl);
                           };
         }else if( std::regex_match(ReductionStr, regex_max)
               ||  std::regex_match(ReductionStr, regex_dilate) ){
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::Max;
             ud.f_reduce = [](float, std::vector<float> &shtl, vec3<double>) -> float {
                               return Stats::Max(shtl);
                           };
 
+        }else if( std::regex_match(ReductionStr, regex_stddev) ){
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::StdDev;
+            ud.f_reduce = [](float, std::vector<float> &shtl, vec3<double>) -> float {
+                              return std::sqrt( Stats::Unbiased_Var_Est(shtl) );
+                          };
+
         }else if( std::regex_match(ReductionStr, regex_stdize) ){
             const auto nan = std::numeric_limits<double>::quiet_NaN();
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::Standardize;
             ud.f_reduce = [nan](float f, std::vector<float> &shtl, vec3<double>) -> float {
                               if( std::isfinite(f) ){
                                   const auto mean = Stats::Mean(shtl);
@@ -546,6 +561,7 @@ Drover ReduceNeighbourhood(Drover DICOM_data,
 
         }else if( std::regex_match(ReductionStr, regex_ptile01) ){
             const auto nan = std::numeric_limits<double>::quiet_NaN();
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::Percentile01;
             ud.f_reduce = [nan](float f, std::vector<float> &shtl, vec3<double>) -> float {
                               if( !std::isnan(f) ){
                                   // Purge NaNs.
@@ -27,6 +27,10 @@
 #include <utility>            //Needed for std::pair.
 #include <vector>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include <boost/filesystem.hpp>
 
@@ -148,7 +152,10 @@ Drover SDL_Viewer(Drover DICOM_data,
     };
     size_t colour_map = 0;
 
-    const auto nan_colour = std::array<std::byte, 3>{ std::byte{60}, std::byte{0}, std::byte{0} }; // 8-bit colour.
+    //Lookup tables for the colour maps, which are generated on first use.
+    std::vector<std::optional<ColourMapLUT>> colour_map_luts(colour_maps.size());
+
+    const auto nan_colour = std::array<uint8_t, 3>{ 60, 0, 0 }; // 8-bit colour.
 
     //Toggle whether existing contours should be displayed.
     const auto toggle_showing_existing_contours = [&](){
@@ -268,26 +275,71 @@ Drover SDL_Viewer(Drover DICOM_data,
 
     // -------------------------------- Functors for various things ---------------------------------------
 
-    // Create an OpenGL texture from an image.
-    struct opengl_texture_handle_t {
-        GLuint texture_number = 0;
+    // Identifies a rendered image slice. Everything that affects the rendered pixels is part of the key, so stale
+    // renderings are never displayed.
+    struct slice_key_t {
+        long int img_array_num = -1;
+        long int img_num = -1;
+        size_t colour_map = 0;
+        std::optional<double> custom_centre;
+        std::optional<double> custom_width;
+
+        bool operator==(const slice_key_t &rhs) const {
+            return std::tie(img_array_num, img_num, colour_map, custom_centre, custom_width)
+                == std::tie(rhs.img_array_num, rhs.img_num, rhs.colour_map, rhs.custom_centre, rhs.custom_width);
+        }
+    };
+    const auto current_slice_key = [&]() -> slice_key_t {
+        slice_key_t out;
+        out.img_array_num = img_array_num;
+        out.img_num = img_num;
+        out.colour_map = colour_map;
+        out.custom_centre = custom_centre;
+        out.custom_width = custom_width;
+        return out;
+    };
+
+    // A colour-mapped image slice, ready to be uploaded into a texture.
+    struct rendered_slice_t {
+        slice_key_t key;
         int col_count = 0;
         int row_count = 0;
+        std::vector<uint8_t> rgb;
     };
-    const auto Load_OpenGL_Texture = [&custom_centre,
-                                      &custom_width,
-                                      &colour_maps,
-                                      &colour_map,
-                                      &nan_colour]( const planar_image<float,double>& img ) -> opengl_texture_handle_t {
+
+    // Colour-map an image slice. This routine only reads image data and does not touch the OpenGL context, so it can
+    // be invoked from any thread.
+    std::mutex colour_map_luts_mutex;
+    const auto Render_Slice = [&DICOM_data,
+                               &colour_maps,
+                               &colour_map_luts,
+                               &colour_map_luts_mutex,
+                               &nan_colour]( const slice_key_t &key ) -> rendered_slice_t {
+            rendered_slice_t out;
+            out.key = key;
+
+            const long int N_arrays = DICOM_data.image_data.size();
+            if(!isininc(0L, key.img_array_num, N_arrays - 1)) return out;
+            auto img_array_ptr_it = std::next(DICOM_data.image_data.begin(), key.img_array_num);
+            const long int N_images = (*img_array_ptr_it)->imagecoll.images.size();
+            if(!isininc(0L, key.img_num, N_images - 1)) return out;
+            const auto &img = *std::next((*img_array_ptr_it)->imagecoll.images.begin(), key.img_num);
+
             const auto img_cols = img.columns;
             const auto img_rows = img.rows;
 
             if(!isininc(1,img_rows,10000) || !isininc(1,img_cols,10000)){
-                FUNCERR("Image dimensions are not reasonable. Is this a mistake? Refusing to continue");
+                throw std::runtime_error("Image dimensions are not reasonable. Is this a mistake? Refusing to continue");
             }
 
-            std::vector<std::byte> animage;
-            animage.reserve(img_cols * img_rows * 3);
+            const ColourMapLUT *lut = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(colour_map_luts_mutex);
+                if(!colour_map_luts[key.colour_map]){
+                    colour_map_luts[key.colour_map].emplace(colour_maps[key.colour_map].second);
+                }
+                lut = &(colour_map_luts[key.colour_map].value());
+            }
 
             //------------------------------------------------------------------------------------------------
             //Apply a window to the data if it seems like the WindowCenter or WindowWidth specified in the image metadata
@@ -298,66 +350,24 @@ Drover SDL_Viewer(Drover DICOM_data,
             auto img_win_c     = img.GetMetadataValueAs<double>("WindowCenter");
             auto img_win_fw    = img.GetMetadataValueAs<double>("WindowWidth"); //Full width or range. (Diameter, not radius.)
 
-            auto custom_win_c  = custom_centre; 
-            auto custom_win_fw = custom_width; 
+            auto custom_win_c  = key.custom_centre; 
+            auto custom_win_fw = key.custom_width; 
 
             const auto UseCustomWL = (custom_win_c && custom_win_fw);
             const auto UseImgWL = (UseCustomWL) ? false 
                                                 : (  img_win_valid && img_desc && img_win_c 
                                                   && img_win_fw && (img_win_valid.value() == img_desc.value()));
 
+            double win_low;
+            double win_high;
             if( UseCustomWL || UseImgWL ){
-                //Window/linear scaling transformation parameters.
-                //const auto win_r = 0.5*(win_fw.value() - 1.0); //The 'radius' of the range, or half width omitting the centre point.
-
                 //The 'radius' of the range, or half width omitting the centre point.
                 const auto win_r  = (UseCustomWL) ? 0.5*custom_win_fw.value()
                                                   : 0.5*img_win_fw.value();
                 const auto win_c  = (UseCustomWL) ? custom_win_c.value()
                                                   : img_win_c.value();
-                const auto win_fw = (UseCustomWL) ? custom_win_fw.value()
-                                                  : img_win_fw.value();
-
-                //The output range we are targeting. In this case, a commodity 8 bit (2^8 = 256 intensities) display.
-                const auto destmin = static_cast<double>( 0 );
-                const auto destmax = static_cast<double>( std::numeric_limits<uint8_t>::max() );
-
-                for(auto j = 0; j < img_rows; ++j){
-                    for(auto i = 0; i < img_cols; ++i){
-                        const auto val = static_cast<double>( img.value(j,i,0) ); //The first (R or gray) channel.
-                        if(!std::isfinite(val)){
-                            animage.push_back( nan_colour[0] );
-                            animage.push_back( nan_colour[1] );
-                            animage.push_back( nan_colour[2] );
-                        }else{
-                            double x; // range = [0,1].
-                            if(val <= (win_c - win_r)){
-                                x = 0.0;
-                            }else if(val >= (win_c + win_r)){
-                                x = 1.0;
-                            }else{
-                                x = (val - (win_c - win_r)) / win_fw;
-                            }
-
-                            const auto res = colour_maps[colour_map].second(x);
-                            const double x_R = res.R;
-                            const double x_G = res.G;
-                            const double x_B = res.B;
-
-                            const double out_R = x_R * (destmax - destmin) + destmin;
-                            const double out_B = x_B * (destmax - destmin) + destmin;
-                            const double out_G = x_G * (destmax - destmin) + destmin;
-
-                            const auto scaled_R = static_cast<uint8_t>( std::floor(out_R) );
-                            const auto scaled_G = static_cast<uint8_t>( std::floor(out_G) );
-                            const auto scaled_B = static_cast<uint8_t>( std::floor(out_B) );
-
-                            animage.push_back( std::byte{scaled_R} );
-                            animage.push_back( std::byte{scaled_G} );
-                            animage.push_back( std::byte{scaled_B} );
-                        }
-                    }
-                }
+                win_low  = win_c - win_r;
+                win_high = win_c + win_r;
 
             //------------------------------------------------------------------------------------------------
             //Scale pixels to fill the maximum range. None will be clipped or truncated.
@@ -366,84 +376,197 @@ Drover SDL_Viewer(Drover DICOM_data,
                 // If you don't want to window you need to anticipate and ignore the gigantic numbers being 
                 // you might encounter. This is not the place to do this! If you need to do it here, write a
                 // filter routine and *call* it from here.
-                //
-                // NOTE: This routine could definitely use a re-working, especially to make it safe for all
-                //       arithmetical types (i.e., handling negatives, ensuring there is no overflow or wrap-
-                //       around, ensuring there is minimal precision loss).
-                using pixel_value_t = decltype(img.value(0, 0, 0));
                 const auto pixel_minmax_allchnls = img.minmax();
-                const auto lowest = std::get<0>(pixel_minmax_allchnls);
-                const auto highest = std::get<1>(pixel_minmax_allchnls);
-
-                //const auto lowest = Stats::Percentile(img.data, 0.01);
-                //const auto highest = Stats::Percentile(img.data, 0.99);
-
-                const auto pixel_type_max = static_cast<double>(std::numeric_limits<pixel_value_t>::max());
-                const auto pixel_type_min = static_cast<double>(std::numeric_limits<pixel_value_t>::min());
-                const auto dest_type_max = static_cast<double>(std::numeric_limits<uint8_t>::max()); //Min is implicitly 0.
-
-                const double clamped_low  = static_cast<double>(lowest )/pixel_type_max;
-                const double clamped_high = static_cast<double>(highest)/pixel_type_max;
-
-                for(auto j = 0; j < img_rows; ++j){ 
-                    for(auto i = 0; i < img_cols; ++i){ 
-                        const auto val = img.value(j,i,0);
-                        if(!std::isfinite(val)){
-                            animage.push_back( nan_colour[0] );
-                            animage.push_back( nan_colour[1] );
-                            animage.push_back( nan_colour[2] );
-                        }else{
-                            const double clamped_value = (static_cast<double>(val) - pixel_type_min)/(pixel_type_max - pixel_type_min);
-                            auto rescaled_value = (clamped_value - clamped_low)/(clamped_high - clamped_low);
-                            if( rescaled_value < 0.0 ){
-                                rescaled_value = 0.0;
-                            }else if( rescaled_value > 1.0 ){
-                                rescaled_value = 1.0;
-                            }
-
-                            const auto res = colour_maps[colour_map].second(rescaled_value);
-                            const double x_R = res.R;
-                            const double x_G = res.G;
-                            const double x_B = res.B;
-                            
-                            const auto scaled_R = static_cast<uint8_t>(x_R * dest_type_max);
-                            const auto scaled_G = static_cast<uint8_t>(x_G * dest_type_max);
-                            const auto scaled_B = static_cast<uint8_t>(x_B * dest_type_max);
-
-                            animage.push_back( std::byte{scaled_R} );
-                            animage.push_back( std::byte{scaled_G} );
-                            animage.push_back( std::byte{scaled_B} );
-                        }
-                    }
-                }
+                win_low  = static_cast<double>(std::get<0>(pixel_minmax_allchnls));
+                win_high = static_cast<double>(std::get<1>(pixel_minmax_allchnls));
             }
-        
 
-            opengl_texture_handle_t out;
+            //Only the first (R or gray) channel is displayed.
             out.col_count = img_cols;
             out.row_count = img_rows;
+            out.rgb.resize(img_cols * img_rows * 3);
+            Colour_Map_To_RGB8( img.data.data(),
+                                static_cast<size_t>(img_rows * img_cols),
+                                static_cast<size_t>(img.channels),
+                                win_low, win_high,
+                                *lut, nan_colour,
+                                out.rgb.data() );
+            return out;
+    };
 
-            CHECK_FOR_GL_ERRORS();
+    // A small ring of textures that are allocated once and then updated in-place. Textures are only re-allocated when
+    // the image dimensions change. The least-recently displayed texture is recycled first.
+    struct opengl_texture_handle_t {
+        GLuint texture_number = 0;
+        int col_count = 0;
+        int row_count = 0;
+
+        std::optional<slice_key_t> key; // The slice currently held, if any.
+        long int last_used = -1; // Frame number.
+    };
+    const long int prefetch_radius = 4; // Number of neighbouring images to prefetch in each direction.
+    std::vector<opengl_texture_handle_t> texture_ring(2 * prefetch_radius + 2);
 
-            glGenTextures(1, &out.texture_number);
-            glBindTexture(GL_TEXTURE_2D, out.texture_number);
-            if(out.texture_number == 0){
-                throw std::runtime_error("Unable to assign OpenGL texture");
+    const auto Find_Texture = [&texture_ring]( const slice_key_t &key ) -> opengl_texture_handle_t* {
+            for(auto &t : texture_ring){
+                if(t.key && (t.key.value() == key)) return &t;
             }
-            CHECK_FOR_GL_ERRORS();
+            return nullptr;
+    };
 
+    // Upload a rendered slice into the least-recently used texture in the ring, avoiding the given texture.
+    const auto Upload_Texture = [&texture_ring]( const rendered_slice_t &rs,
+                                                 const opengl_texture_handle_t *avoid,
+                                                 long int frame ) -> opengl_texture_handle_t* {
+            opengl_texture_handle_t *out = nullptr;
+            for(auto &t : texture_ring){
+                if(&t == avoid) continue;
+                if((out == nullptr) || (t.last_used < out->last_used)) out = &t;
+            }
+            if(out == nullptr) throw std::logic_error("No texture available for upload");
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
             CHECK_FOR_GL_ERRORS();
+            if(out->texture_number == 0){
+                glGenTextures(1, &out->texture_number);
+                if(out->texture_number == 0){
+                    throw std::runtime_error("Unable to assign OpenGL texture");
+                }
+                glBindTexture(GL_TEXTURE_2D, out->texture_number);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                CHECK_FOR_GL_ERRORS();
+            }
+            glBindTexture(GL_TEXTURE_2D, out->texture_number);
 
             glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, out.col_count, out.row_count, 0, GL_RGB, GL_UNSIGNED_BYTE, static_cast<void*>(animage.data()));
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows of RGB pixels are tightly packed.
+            if( (out->col_count != rs.col_count)
+            ||  (out->row_count != rs.row_count) ){
+                out->col_count = rs.col_count;
+                out->row_count = rs.row_count;
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, out->col_count, out->row_count, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+                CHECK_FOR_GL_ERRORS();
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, out->col_count, out->row_count, GL_RGB, GL_UNSIGNED_BYTE,
+                            static_cast<const void*>(rs.rgb.data()));
             CHECK_FOR_GL_ERRORS();
 
+            out->key = rs.key;
+            out->last_used = frame;
             return out;
     };
 
+    // Neighbouring images are colour-mapped on a background thread so that scrolling only requires a texture update on
+    // the UI thread. OpenGL calls are only ever made on the UI thread.
+    struct prefetch_state_t {
+        std::mutex m;
+        std::condition_variable cv;
+        bool quit = false;
+        std::deque<slice_key_t> pending; // Highest priority first.
+        std::list<rendered_slice_t> completed; // Most recent first.
+    } prefetch;
+    const size_t prefetch_completed_max = 2 * prefetch_radius + 2;
+
+    std::thread prefetch_thread([&prefetch,
+                                 &Render_Slice](){
+            while(true){
+                slice_key_t key;
+                {
+                    std::unique_lock<std::mutex> lock(prefetch.m);
+                    prefetch.cv.wait(lock, [&](){ return prefetch.quit || !prefetch.pending.empty(); });
+                    if(prefetch.quit) return;
+                    key = prefetch.pending.front();
+                    prefetch.pending.pop_front();
+                }
+
+                try{
+                    auto rs = Render_Slice(key);
+                    if(rs.rgb.empty()) continue;
+
+                    std::lock_guard<std::mutex> lock(prefetch.m);
+                    prefetch.completed.push_front(std::move(rs));
+                    while(prefetch_completed_max < prefetch.completed.size()) prefetch.completed.pop_back();
+                }catch(const std::exception &e){
+                    FUNCWARN("Unable to prefetch image: " << e.what());
+                }
+            }
+    });
+
+    // Ensure the background thread is stopped however the viewer exits.
+    struct prefetch_thread_joiner_t {
+        prefetch_state_t &prefetch;
+        std::thread &thread;
+        ~prefetch_thread_joiner_t(){
+            {
+                std::lock_guard<std::mutex> lock(prefetch.m);
+                prefetch.quit = true;
+            }
+            prefetch.cv.notify_all();
+            if(thread.joinable()) thread.join();
+        }
+    } prefetch_thread_joiner{ prefetch, prefetch_thread };
+
+    // Replace any outstanding prefetch requests with the neighbours of the given slice, nearest first.
+    const auto Request_Prefetch = [&]( const slice_key_t &key ){
+            auto img_array_ptr_it = std::next(DICOM_data.image_data.begin(), key.img_array_num);
+            const long int N_images = (*img_array_ptr_it)->imagecoll.images.size();
+
+            std::lock_guard<std::mutex> lock(prefetch.m);
+            prefetch.pending.clear();
+            for(long int d = 1; d <= prefetch_radius; ++d){
+                for(const long int n : { key.img_num + d, key.img_num - d }){
+                    if(!isininc(0L, n, N_images - 1)) continue;
+                    auto k = key;
+                    k.img_num = n;
+                    if(Find_Texture(k) != nullptr) continue;
+                    const auto already_completed = std::any_of(prefetch.completed.begin(), prefetch.completed.end(),
+                                                               [&](const rendered_slice_t &rs){ return rs.key == k; });
+                    if(already_completed) continue;
+                    prefetch.pending.push_back(k);
+                }
+            }
+            prefetch.cv.notify_one();
+    };
+
+    // Make the texture for the given slice available, using prefetched data when possible. If the slice has not been
+    // prefetched it is rendered immediately, which is still fast but occurs on the UI thread.
+    const auto Acquire_Texture = [&]( const slice_key_t &key,
+                                      long int frame ) -> opengl_texture_handle_t* {
+            auto t = Find_Texture(key);
+            if(t == nullptr){
+                std::optional<rendered_slice_t> rs;
+                {
+                    std::lock_guard<std::mutex> lock(prefetch.m);
+                    for(auto it = prefetch.completed.begin(); it != prefetch.completed.end(); ++it){
+                        if(it->key == key){
+                            rs = std::move(*it);
+                            prefetch.completed.erase(it);
+                            break;
+                        }
+                    }
+                }
+                if(!rs) rs = Render_Slice(key);
+                if(rs->rgb.empty()) return nullptr;
+                t = Upload_Texture(rs.value(), nullptr, frame);
+            }
+            t->last_used = frame;
+            return t;
+    };
+
+    // Move at most one completed prefetch into the texture ring, so the upload cost is spread across frames.
+    const auto Upload_One_Prefetched = [&]( const opengl_texture_handle_t *displayed,
+                                            long int frame ){
+            std::optional<rendered_slice_t> rs;
+            {
+                std::lock_guard<std::mutex> lock(prefetch.m);
+                if(prefetch.completed.empty()) return;
+                rs = std::move(prefetch.completed.front());
+                prefetch.completed.pop_front();
+            }
+            if(Find_Texture(rs->key) == nullptr) Upload_Texture(rs.value(), displayed, frame);
+            return;
+    };
+
     // Advance to the specified Image_Array. Also resets necessary display image iterators.
     const auto advance_to_image_array = [&](const long int n){
             const long int N_arrays = DICOM_data.image_data.size();
@@ -491,15 +614,8 @@ Drover SDL_Viewer(Drover DICOM_data,
 
     // ------------------------------------------- Main loop ----------------------------------------------
 
-    // Pre-load the first image.
-    opengl_texture_handle_t current_texture;
-    if( DICOM_data.Has_Image_Data()
-    &&  (0 <= img_array_num)
-    &&  (0 <= img_num) ){
-        auto img_array_ptr_it = std::next(DICOM_data.image_data.begin(), img_array_num);
-        auto disp_img_it = std::next((*img_array_ptr_it)->imagecoll.images.begin(), img_num);
-        current_texture = Load_OpenGL_Texture(*disp_img_it);
-    }
+    // The slice for which neighbours were most recently requested.
+    std::optional<slice_key_t> prefetched_around;
 
 long int frame_count = 0;
     while(true){
@@ -592,14 +708,21 @@ long int frame_count = 0;
                 advance_to_image_array(new_img_array_num);
                 img_array_ptr_it = std::next(DICOM_data.image_data.begin(), img_array_num);
                 disp_img_it = std::next((*img_array_ptr_it)->imagecoll.images.begin(), img_num);
-                current_texture = Load_OpenGL_Texture(*disp_img_it);
 
             }else if( new_img_num != img_num ){
                 advance_to_image(new_img_num);
                 disp_img_it = std::next((*img_array_ptr_it)->imagecoll.images.begin(), img_num);
-                current_texture = Load_OpenGL_Texture(*disp_img_it);
             }
 
+            const auto key = current_slice_key();
+            auto current_texture = Acquire_Texture(key, frame_count);
+            if( !prefetched_around
+            ||  !(prefetched_around.value() == key) ){
+                Request_Prefetch(key);
+                prefetched_around = key;
+            }
+            Upload_One_Prefetched(current_texture, frame_count);
+
             // Note: unhappy with this. Can cause feedback loop and flicker/jumpiness when resizing. Works OK for now
             // though. TODO.
             ImVec2 window_size = ImGui::GetContentRegionAvail();
@@ -607,8 +730,10 @@ long int frame_count = 0;
             // Ensure images have the same aspect ratio as the true image.
             window_size.y = window_size.x * static_cast<float>(disp_img_it->rows) / static_cast<float>(disp_img_it->columns);
             window_size.y = std::isfinite(window_size.y) ? window_size.y : window_size.x;
-            auto gl_tex_ptr = reinterpret_cast<void*>(static_cast<intptr_t>(current_texture.texture_number));
-            ImGui::Image(gl_tex_ptr, window_size);
+            if(current_texture != nullptr){
+                auto gl_tex_ptr = reinterpret_cast<void*>(static_cast<intptr_t>(current_texture->texture_number));
+                ImGui::Image(gl_tex_ptr, window_size);
+            }
 
             ImGui::End();
         }
@@ -750,6 +875,9 @@ if(DICOM_data.Has_Mesh_Data()){
     }
 
     // OpenGL and SDL cleanup.
+    for(auto &t : texture_ring){
+        if(t.texture_number != 0) glDeleteTextures(1, &t.texture_number);
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
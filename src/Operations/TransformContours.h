@@ -10,7 +10,7 @@
 
 OperationDoc OpArgDocTransformContours();
 
-Drover TransformContours(const Drover& DICOM_data,
+Drover TransformContours(Drover DICOM_data,
                          const OperationArgPkg& /*OptArgs*/,
                          const std::map<std::string, std::string>& /*InvocationMetadata*/,
                          const std::string& /*FilenameLex*/);
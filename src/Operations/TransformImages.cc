@@ -15,8 +15,10 @@
 #include <string>    
 #include <utility>            //Needed for std::pair.
 #include <vector>
+#include <variant>
 
 #include "../Structs.h"
+#include "../Alignment_TPSRPM.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
 #include "TransformImages.h"
@@ -34,12 +36,23 @@ OperationDoc OpArgDocTransformImages(){
     out.name = "TransformImages";
 
     out.desc = 
-        "This operation transforms images by translating, scaling, and rotating the positions of voxels.";
+        "This operation transforms images by translating, scaling, and rotating the positions of voxels."
+        " Stored transformations, including thin-plate spline deformations, can also be applied by resampling voxel"
+        " intensities.";
         
     out.notes.emplace_back(
         "A single transformation can be specified at a time. Perform this operation sequentially to enforce order."
     );
 
+    out.notes.emplace_back(
+        "Stored transformations are applied via 'pull-back' resampling: the image geometry is retained, and each"
+        " voxel is assigned the (trilinearly interpolated) intensity found at the transformed voxel position."
+        " The transformation must therefore map the desired output frame onto the current image frame, i.e., it is"
+        " the inverse of the transformation that would be applied to meshes or contours to achieve the same effect."
+        " Voxels that are mapped outside of the original images are assigned the interpolator's out-of-bounds"
+        " value."
+    );
+
     out.args.emplace_back();
     out.args.back() = IAWhitelistOpArgDoc();
     out.args.back().name = "ImageSelection";
@@ -72,6 +85,12 @@ OperationDoc OpArgDocTransformImages(){
                                  "scale(1.23, -2.34, 3.45, 2.7)",
                                  "rotate(4.0, 5.0, 6.0,  1.0, 0.0, 0.0,  3.141592653)" };
 
+    out.args.emplace_back();
+    out.args.back() = T3OverrideOpArgDoc();
+
+    out.args.emplace_back();
+    out.args.back() = T3FieldToleranceOpArgDoc();
+
     return out;
 }
 
@@ -86,6 +105,8 @@ Drover TransformImages(Drover DICOM_data,
     const auto ImageSelectionStr = OptArgs.getValueStr("ImageSelection").value();
 
     const auto TransformStr = OptArgs.getValueStr("Transform").value();
+    const auto TFormSelectionStr = OptArgs.getValueStr("TransformSelection").value();
+    const auto FieldTolerance = std::stod( OptArgs.getValueStr("FieldTolerance").value() );
 
     //-----------------------------------------------------------------------------------------------------------------
 
@@ -120,6 +141,87 @@ Drover TransformImages(Drover DICOM_data,
     auto IAs = Whitelist( IAs_all, ImageSelectionStr );
     FUNCINFO("Selected " << IAs.size() << " image arrays");
 
+    auto T3s_all = All_T3s( DICOM_data );
+    auto T3s = Whitelist( T3s_all, TFormSelectionStr );
+    if(1 < T3s.size()){
+        throw std::invalid_argument("Only a single transformation must be selected to guarantee ordering. Cannot continue.");
+    }
+    if(T3s.size() == 1){
+        // Resample each voxel by sampling the original images at the mapped voxel position.
+        const auto pull_back = [](planar_image_collection<float,double> &imagecoll, const auto &f_map) -> void {
+            // Sample from an unaltered copy, since the images are overwritten in-place.
+            auto source = imagecoll;
+            const auto &first_img = source.images.front();
+            const auto ortho = first_img.row_unit.Cross(first_img.col_unit).unit();
+            planar_image_adjacency<float,double> img_adj( {}, { { std::ref(source) } }, ortho );
+
+            std::vector<planar_image<float,double>*> imgs;
+            for(auto &img : imagecoll.images) imgs.push_back( &img );
+            parallel_for(0, imgs.size(), [&](size_t n) -> void {
+                auto &img = *(imgs[n]);
+                for(long int row = 0; row < img.rows; ++row){
+                    for(long int col = 0; col < img.columns; ++col){
+                        const auto pos = f_map( img.position(row, col) );
+                        for(long int chan = 0; chan < img.channels; ++chan){
+                            img.reference(row, col, chan) = img_adj.trilinearly_interpolate(pos, chan);
+                        }
+                    }
+                }
+            });
+        };
+
+        for(auto & iap_it : IAs){
+            auto &imagecoll = (*iap_it)->imagecoll;
+            if(imagecoll.images.empty()) continue;
+
+            std::visit([&](auto && t){
+                using V = std::decay_t<decltype(t)>;
+                if constexpr (std::is_same_v<V, std::monostate>){
+                    throw std::invalid_argument("Transformation is invalid. Unable to continue.");
+
+                // Affine transformations.
+                }else if constexpr (std::is_same_v<V, affine_transform<double>>){
+                    FUNCINFO("Applying affine transformation now");
+                    pull_back(imagecoll, [&](vec3<double> v) -> vec3<double> {
+                        t.apply_to(v);
+                        return v;
+                    });
+
+                // Thin-plate spline transformations.
+                }else if constexpr (std::is_same_v<V, thin_plate_spline>){
+                    FUNCINFO("Applying thin plate spline transformation now");
+
+                    // Sample the displacement field over the extent of all voxel centres.
+                    const auto inf = std::numeric_limits<double>::infinity();
+                    vec3<double> bb_min( inf, inf, inf );
+                    vec3<double> bb_max( -inf, -inf, -inf );
+                    for(const auto &img : imagecoll.images){
+                        if( (img.rows <= 0) || (img.columns <= 0) ) continue;
+                        for(const auto &v : { img.position(0, 0),
+                                              img.position(img.rows - 1, 0),
+                                              img.position(0, img.columns - 1),
+                                              img.position(img.rows - 1, img.columns - 1) }){
+                            bb_min = vec3<double>( std::min(bb_min.x, v.x), std::min(bb_min.y, v.y), std::min(bb_min.z, v.z) );
+                            bb_max = vec3<double>( std::max(bb_max.x, v.x), std::max(bb_max.y, v.y), std::max(bb_max.z, v.z) );
+                        }
+                    }
+                    if(!bb_min.isfinite()) return;
+
+                    const thin_plate_spline_field field(t, bb_min, bb_max, FieldTolerance);
+                    pull_back(imagecoll, [&](const vec3<double> &v) -> vec3<double> {
+                        return field.transform(v);
+                    });
+
+                }else{
+                    static_assert(std::is_same_v<V,void>, "Transformation not understood.");
+                }
+                return;
+            }, (*(T3s.front()))->transform);
+        }
+
+        return DICOM_data;
+    }
+
     for(auto & iap_it : IAs){
         // Translations.
         if(std::regex_match(TransformStr, regex_trn)){
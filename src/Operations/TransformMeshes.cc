@@ -15,8 +15,10 @@
 #include <string>    
 #include <utility>            //Needed for std::pair.
 #include <vector>
+#include <variant>
 
 #include "../Structs.h"
+#include "../Alignment_TPSRPM.h"
 #include "../Regex_Selectors.h"
 #include "../Thread_Pool.h"
 #include "TransformMeshes.h"
@@ -34,12 +36,18 @@ OperationDoc OpArgDocTransformMeshes(){
     out.name = "TransformMeshes";
 
     out.desc = 
-        "This operation transforms meshes by translating, scaling, and rotating vertices.";
+        "This operation transforms meshes by translating, scaling, and rotating vertices. Stored transformations,"
+        " including thin-plate spline deformations, can also be applied.";
         
     out.notes.emplace_back(
         "A single transformation can be specified at a time. Perform this operation sequentially to enforce order."
     );
 
+    out.notes.emplace_back(
+        "All selected meshes share a single displacement field when a thin-plate spline is applied, so it is more"
+        " efficient to transform many meshes in a single invocation."
+    );
+
     out.args.emplace_back();
     out.args.back() = SMWhitelistOpArgDoc();
     out.args.back().name = "MeshSelection";
@@ -73,6 +81,12 @@ OperationDoc OpArgDocTransformMeshes(){
                                  "scale(1.23, -2.34, 3.45, 2.7)",
                                  "rotate(4.0, 5.0, 6.0,  1.0, 0.0, 0.0,  3.141592653)" };
 
+    out.args.emplace_back();
+    out.args.back() = T3OverrideOpArgDoc();
+
+    out.args.emplace_back();
+    out.args.back() = T3FieldToleranceOpArgDoc();
+
     return out;
 }
 
@@ -87,6 +101,8 @@ Drover TransformMeshes(Drover DICOM_data,
     //---------------------------------------------- User Parameters --------------------------------------------------
     const auto MeshSelectionStr = OptArgs.getValueStr("MeshSelection").value();
     const auto TransformStr = OptArgs.getValueStr("Transform").value();
+    const auto TFormSelectionStr = OptArgs.getValueStr("TransformSelection").value();
+    const auto FieldTolerance = std::stod( OptArgs.getValueStr("FieldTolerance").value() );
 
     //-----------------------------------------------------------------------------------------------------------------
 
@@ -123,6 +139,61 @@ Drover TransformMeshes(Drover DICOM_data,
     const auto sm_count = SMs.size();
     FUNCINFO("Selected " << sm_count << " meshes");
 
+    auto T3s_all = All_T3s( DICOM_data );
+    auto T3s = Whitelist( T3s_all, TFormSelectionStr );
+    if(1 < T3s.size()){
+        throw std::invalid_argument("Only a single transformation must be selected to guarantee ordering. Cannot continue.");
+    }
+    if(T3s.size() == 1){
+        // Determine the extent of all selected vertices so the displacement field can be shared.
+        const auto inf = std::numeric_limits<double>::infinity();
+        vec3<double> bb_min( inf, inf, inf );
+        vec3<double> bb_max( -inf, -inf, -inf );
+        for(auto & smp_it : SMs){
+            for(const auto &v : (*smp_it)->meshes.vertices){
+                bb_min = vec3<double>( std::min(bb_min.x, v.x), std::min(bb_min.y, v.y), std::min(bb_min.z, v.z) );
+                bb_max = vec3<double>( std::max(bb_max.x, v.x), std::max(bb_max.y, v.y), std::max(bb_max.z, v.z) );
+            }
+        }
+        if(!bb_min.isfinite()){
+            FUNCWARN("Selected meshes contain no vertices. Nothing to transform");
+            return DICOM_data;
+        }
+
+        std::visit([&](auto && t){
+            using V = std::decay_t<decltype(t)>;
+            if constexpr (std::is_same_v<V, std::monostate>){
+                throw std::invalid_argument("Transformation is invalid. Unable to continue.");
+
+            // Affine transformations.
+            }else if constexpr (std::is_same_v<V, affine_transform<double>>){
+                FUNCINFO("Applying affine transformation now");
+                for(auto & smp_it : SMs){
+                    for(auto &v : (*smp_it)->meshes.vertices){
+                        t.apply_to(v);
+                    }
+                }
+
+            // Thin-plate spline transformations.
+            }else if constexpr (std::is_same_v<V, thin_plate_spline>){
+                FUNCINFO("Applying thin plate spline transformation now");
+                const thin_plate_spline_field field(t, bb_min, bb_max, FieldTolerance);
+                for(auto & smp_it : SMs){
+                    auto &verts = (*smp_it)->meshes.vertices;
+                    parallel_for(0, verts.size(), [&](size_t i) -> void {
+                        verts[i] = field.transform(verts[i]);
+                    });
+                }
+
+            }else{
+                static_assert(std::is_same_v<V,void>, "Transformation not understood.");
+            }
+            return;
+        }, (*(T3s.front()))->transform);
+
+        return DICOM_data;
+    }
+
     long int completed = 0;
     for(auto & smp_it : SMs){
 
@@ -7,10 +7,12 @@
 #include <list>
 #include <map>
 #include <mutex>
+#include <random>
 #include <memory>
 #include <regex>
 #include <stdexcept>
 #include <string>    
+#include <vector>
 
 /*
 #include <boost/geometry.hpp>
@@ -38,6 +40,7 @@
 #include "YgorStats.h"       //Needed for Stats:: namespace.
 
 #include "../Structs.h"
+#include "../Thread_Pool.h"
 #include "../Regex_Selectors.h"
 #include "../YgorImages_Functors/ConvenienceRoutines.h"
 #include "../YgorImages_Functors/Grouping/Misc_Functors.h"
@@ -471,10 +474,13 @@ std::array<SpatialType, SpatialDimensionCount> Coordinates;
         using RTree_t = boost::geometry::index::rtree<CDat_t,RTreeParameter_t>;
 
 
-        RTree_t rtree;
+        // Note: the tree is bulk-loaded, which is faster and results in a better-balanced tree than repeated insertion.
+        std::vector<CDat_t> cdats;
+        cdats.reserve( p.size() );
         for(const auto &v : p){
-            rtree.insert(CDat_t({ v.x, v.y, v.z }));
+            cdats.emplace_back(CDat_t({ v.x, v.y, v.z }));
         }
+        const RTree_t rtree( cdats );
 
 /*
     OnEachDatum<RTree_t,CDat_t,std::function<void(const typename RTree_t::const_query_iterator &)>>(rtree,
@@ -490,22 +496,27 @@ std::array<SpatialType, SpatialDimensionCount> Coordinates;
         std::sample(std::begin(p), std::end(p), std::back_inserter(samples), 100, re);
 
         // Query the local neighbourhood for the nearest N vertices. Remember that the self will be present and we
-        // cannot derive any useful orientation from it. 
+        // cannot derive any useful orientation from it. Neighbours are visited in order of increasing distance.
         const long int N_neighbours = 6; // legitimate neighbours.
         const double min_separation = 0.1; // minimal distance needed between vertices to consider a pair (in DICOM units; mm).
-        std::vector<vec3<double>> unit_vecs;
-        for(const auto &v : samples){
+        //
+        // Samples are independent, so they are processed in parallel. Each sample writes to its own buffer, and the
+        // buffers are concatenated in sample order so the result does not depend on the number of threads.
+        std::vector<std::vector<vec3<double>>> sample_unit_vecs( samples.size() );
+        parallel_for(0, samples.size(), [&](size_t i) -> void {
+            const auto &v = samples[i];
+            auto &l_unit_vecs = sample_unit_vecs[i];
+
             long int actual_neighbours = 0;
-            constexpr auto RTreeSpatialQueryGetAll = [](const CDat_t &) -> bool { return true; };
             RTree_t::const_query_iterator it;
-            it = rtree.qbegin(boost::geometry::index::satisfies( RTreeSpatialQueryGetAll ));
+            it = rtree.qbegin(boost::geometry::index::nearest( CDat_t({ v.x, v.y, v.z }), rtree.size() ));
             for( ; it != rtree.qend(); ++it){
                 const auto l_v = vec3<double>( std::get<0>(it->Coordinates),
                                                std::get<1>(it->Coordinates),
                                                std::get<2>(it->Coordinates) );
                 // Check if the point is separated a reasonable distance away.
                 const auto d = v.distance(l_v);
-                if(d > min_separation) continue;
+                if(d < min_separation) continue;
                 
                 // Estimate the unit vector between vertices.
                 auto U = (v - l_v).unit();
@@ -516,11 +527,16 @@ std::array<SpatialType, SpatialDimensionCount> Coordinates;
                 if(U.y < 0.0) U.y *= -1.0;
                 if(U.z < 0.0) U.z *= -1.0;
 
-                unit_vecs.push_back(U);
+                l_unit_vecs.push_back(U);
 
                 ++actual_neighbours;
                 if(actual_neighbours >= N_neighbours) break;
             }
+        });
+
+        std::vector<vec3<double>> unit_vecs;
+        for(auto &l_unit_vecs : sample_unit_vecs){
+            unit_vecs.insert( std::end(unit_vecs), std::begin(l_unit_vecs), std::end(l_unit_vecs) );
         }
 
         FUNCINFO("The number of unit vectors to analyze: " << unit_vecs.size());
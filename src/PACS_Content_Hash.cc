@@ -0,0 +1,191 @@
+//PACS_Content_Hash.cc.
+
+#ifdef DCMA_USE_POSTGRES
+#else
+    #error "Attempted to compile without PostgreSQL support, which is required."
+#endif
+
+#include <algorithm>
+#include <array>
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <pqxx/pqxx>         //PostgreSQL C++ interface.
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PACS_Content_Hash.h"
+
+namespace {
+
+const uint64_t prime_1 = 11400714785074694791ULL;
+const uint64_t prime_2 = 14029467366897019727ULL;
+const uint64_t prime_3 =  1609587929392839161ULL;
+const uint64_t prime_4 =  9650029242287828579ULL;
+const uint64_t prime_5 =  2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r){
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read_u64(const unsigned char *p){
+    uint64_t x = 0;
+    for(int i = 7; 0 <= i; --i) x = (x << 8) | static_cast<uint64_t>(p[i]); // Little-endian, regardless of host.
+    return x;
+}
+
+inline uint64_t hash_round(uint64_t acc, uint64_t w){
+    acc += w * prime_2;
+    acc = rotl(acc, 31);
+    return acc * prime_1;
+}
+
+inline uint64_t merge(uint64_t h, uint64_t lane){
+    h ^= hash_round(0, lane);
+    return h * prime_1 + prime_4;
+}
+
+// A streaming multiply-rotate hash in the style of xxHash. Input is consumed in 32-byte stripes spread over four
+// independent lanes, so throughput is limited by I/O rather than hashing.
+class stream_hasher {
+    std::array<uint64_t, 4> lanes = {{ prime_1 + prime_2, prime_2, 0, 0 - prime_1 }};
+    std::array<unsigned char, 32> pending;
+    size_t N_pending = 0;
+    uint64_t N_total = 0;
+
+  public:
+    void update(const unsigned char *p, size_t N){
+        N_total += N;
+        if(N_pending != 0){
+            const size_t n = std::min(N, pending.size() - N_pending);
+            std::memcpy(pending.data() + N_pending, p, n);
+            N_pending += n;
+            p += n;
+            N -= n;
+            if(N_pending < pending.size()) return;
+            this->stripe(pending.data());
+            N_pending = 0;
+        }
+        for( ; pending.size() <= N; p += pending.size(), N -= pending.size()) this->stripe(p);
+        std::memcpy(pending.data(), p, N);
+        N_pending = N;
+    }
+
+    uint64_t digest() const {
+        uint64_t h = (N_total < pending.size()) ? prime_5
+                                                : rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        if(pending.size() <= N_total){
+            for(const auto &l : lanes) h = merge(h, l);
+        }
+        h += N_total;
+
+        const unsigned char *p = pending.data();
+        size_t N = N_pending;
+        for( ; 8 <= N; p += 8, N -= 8){
+            h ^= hash_round(0, read_u64(p));
+            h = rotl(h, 27) * prime_1 + prime_4;
+        }
+        for( ; 0 < N; ++p, --N){
+            h ^= static_cast<uint64_t>(*p) * prime_5;
+            h = rotl(h, 11) * prime_1;
+        }
+
+        h ^= h >> 33;
+        h *= prime_2;
+        h ^= h >> 29;
+        h *= prime_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    uint64_t size() const {
+        return N_total;
+    }
+
+  private:
+    void stripe(const unsigned char *p){
+        for(size_t i = 0; i < lanes.size(); ++i) lanes[i] = hash_round(lanes[i], read_u64(p + 8 * i));
+    }
+};
+
+const size_t block_size = 1024 * 1024;
+
+} // namespace
+
+
+std::string PACS_Content_Hash(const std::string &filename){
+    std::ifstream fi(filename, std::ios::in | std::ios::binary);
+    if(!fi) throw std::runtime_error("Unable to read file '" + filename + "'. Cannot continue.");
+
+    stream_hasher h;
+    std::vector<char> buf(block_size);
+    while(fi){
+        fi.read(buf.data(), buf.size());
+        const auto n = fi.gcount();
+        if(0 < n) h.update(reinterpret_cast<const unsigned char *>(buf.data()), static_cast<size_t>(n));
+    }
+    if(!fi.eof()) throw std::runtime_error("Unable to read file '" + filename + "'. Cannot continue.");
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << h.digest() << std::dec << "-" << h.size();
+    return ss.str();
+}
+
+
+bool PACS_Files_Are_Identical(const std::string &filename_A, const std::string &filename_B){
+    std::ifstream fa(filename_A, std::ios::in | std::ios::binary);
+    std::ifstream fb(filename_B, std::ios::in | std::ios::binary);
+    if(!fa || !fb) return false;
+
+    std::vector<char> buf_a(block_size);
+    std::vector<char> buf_b(block_size);
+    while(true){
+        fa.read(buf_a.data(), buf_a.size());
+        fb.read(buf_b.data(), buf_b.size());
+        const auto n_a = fa.gcount();
+        const auto n_b = fb.gcount();
+        if(n_a != n_b) return false;
+        if(std::memcmp(buf_a.data(), buf_b.data(), static_cast<size_t>(n_a)) != 0) return false;
+        if(fa.eof() || fb.eof()) return (fa.eof() && fb.eof());
+        if(!fa || !fb) return false;
+    }
+}
+
+
+PACS_Stored_Match PACS_Find_Stored_Duplicate(const std::string &filename,
+                                             const std::vector<std::string> &stored_files,
+                                             const std::function<void(const std::string &)> &on_mismatch){
+    PACS_Stored_Match out;
+
+    //The file must be checked against every candidate before any comparison, since an identical twin of a stored file
+    // would otherwise be matched first.
+    for(const auto &s : stored_files){
+        boost::system::error_code ec;
+        if(boost::filesystem::equivalent(filename, s, ec)){
+            out.is_stored_file = true;
+            return out;
+        }
+    }
+
+    for(const auto &s : stored_files){
+        if(PACS_Files_Are_Identical(filename, s)){
+            out.stored_file = s;
+            return out;
+        }
+        if(on_mismatch) on_mismatch(s);
+    }
+    return out;
+}
+
+
+void PACS_Ensure_Content_Hash_Column(pqxx::transaction_base &txn){
+    txn.exec("ALTER TABLE metadata ADD COLUMN IF NOT EXISTS ContentHash TEXT;");
+    txn.exec("CREATE INDEX IF NOT EXISTS metadata_contenthash_idx ON metadata (ContentHash);");
+    return;
+}
+
@@ -0,0 +1,43 @@
+//PACS_Content_Hash.h.
+//
+// Routines for indexing the contents of files in the PACS DB filestore.
+//
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace pqxx {
+class transaction_base;
+}
+
+// Computes a digest of a file's contents by streaming it in large blocks. The digest consists of a 64-bit
+// non-cryptographic hash (16 hexadecimal digits) followed by the file size in bytes, e.g., '0123456789abcdef-1024'.
+//
+// Files with differing digests are certainly different. Files with matching digests are almost certainly identical,
+// but must be compared with PACS_Files_Are_Identical() before acting destructively.
+//
+// Throws if the file cannot be read.
+std::string PACS_Content_Hash(const std::string &filename);
+
+// Compares two files byte-by-byte. Returns false if either cannot be read.
+bool PACS_Files_Are_Identical(const std::string &filename_A, const std::string &filename_B);
+
+// The outcome of comparing a file against the stored files that share its content hash.
+struct PACS_Stored_Match {
+    bool is_stored_file = false; // The file is itself one of the stored files, possibly reached via another path.
+    std::string stored_file;     // A distinct stored file with identical contents. Empty if none, or if is_stored_file.
+};
+
+// Compares a file against stored files that share its content hash. A file that is itself stored is never matched
+// against its identical twins, so it is safe to remove the file whenever 'stored_file' is non-empty. Candidates that
+// share the hash but differ are reported via 'on_mismatch', if provided.
+PACS_Stored_Match PACS_Find_Stored_Duplicate(const std::string &filename,
+                                             const std::vector<std::string> &stored_files,
+                                             const std::function<void(const std::string &)> &on_mismatch = {});
+
+// Adds the 'ContentHash' column and its index to the 'metadata' table, if they are not already present.
+void PACS_Ensure_Content_Hash_Column(pqxx::transaction_base &txn);
+
@@ -2,39 +2,50 @@
 //
 //This program de-duplicates DICOM files that are already in the PACS DB, deleting them.
 //
-// Note: A full, exact byte-wise comparison is not performed. Rather, the DICOM tags that
-//       are required to be unique are compared against the DB. If a match is found the file
-//       is deleted. Be careful not to run this on the PACS DB itself, since the DB files 
-//       will be deleted! (This is not checked because the PACS DB might be mounted in some
-//       exotic way that will confuse such efforts, such as sshfs.)
+// Files are compared by content. Each file is hashed and the hash is looked up in the PACS DB 'ContentHash' index. If
+// a match is found, the file is compared byte-by-byte against the stored file and deleted only if they are identical.
+// Be careful not to run this on the PACS DB itself, since the DB files will be deleted! (This is not checked because
+// the PACS DB might be mounted in some exotic way that will confuse such efforts, such as sshfs.)
 //
 // Note: The file is NOT ingressed if it is not yet in the PACS DB.
 //
+// Note: Records lacking a content hash (e.g., those ingressed before content hashes were recorded) are not matched.
+//       Use the '--scan-store' option or pacs_refresh to hash them.
+//
 
 #ifdef DCMA_USE_POSTGRES
 #else
     #error "Attempted to compile without PostgreSQL support, which is required."
 #endif
 
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <iostream>
 #include <list>
 #include <map>
 #include <pqxx/pqxx>            //PostgreSQL C++ interface.
+#include <sstream>
 #include <string>
 #include <tuple>
+#include <vector>
 
-#include "Imebra_Shim.h"        //Wrapper for Imebra library. Black-boxed to speed up compilation.
+#include "PACS_Content_Hash.h"
+#include "Thread_Pool.h"
 #include "YgorArguments.h"
 #include "YgorFilesDirs.h"
 #include "YgorMisc.h"           //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
+#include "YgorString.h"         //Needed for stringtoX(), X_to_string().
 
 int main(int argc, char **argv){
     //std::string db_params("dbname=pacs user=hal host=localhost port=63443");
     std::string db_params("dbname=pacs user=hal host=localhost");
-    const std::string DICOMFileSystemStoreBase("/home/pacs_store");
-    std::string DICOMFile;  //The filename to use.
+    std::list<std::string> InputPaths; //Files and directories to check.
+    long int BatchSize = 1000; //The number of files hashed and looked up at a time.
+    bool ScanStore = false; //Hash any unhashed PACS DB files and report duplicates within the PACS DB.
     bool dryrun = false;    //Do not actually insert the file into the db, just test for errors.
     bool verbose = false;   //Print extra information. Normally successful info is suppresed.
 
@@ -44,17 +55,20 @@ int main(int argc, char **argv){
     class ArgumentHandler arger;
     const std::string progname(argv[0]);
     //----
-    arger.description = "Given a DICOM file, check if it is in the PACS DB. If so, delete the file."
-                        " Note that a full, byte-by-byte comparison is NOT performed -- rather only the top-level"
-                        " DICOM unique identifiers are (currently) compared. No other metadata is considered."
-                        " So this program is not suitable if DICOM files have been modified without re-assigning"
-                        " unique identifiers! (Which is non-standard behaviour.) Note that if an /exact/ comparison"
-                        " is desired, using a traditional file de-duplicator will work.";
+    arger.description = "Given DICOM files, check if they are in the PACS DB. If so, delete the files."
+                        " Files are compared by content: a hash of each file is looked up in the PACS DB and"
+                        " candidate matches are compared byte-by-byte, so only exact duplicates are deleted."
+                        " Directories are searched recursively."
+                        " Optionally, duplicates within the PACS DB itself can be reported.";
 
     arger.examples = { { " -f '/path/to/a/dicom/file.dcm'" ,
                          "Check if 'file.dcm' is already in the PACS DB. If so, delete it ('file.dcm')." },
                        { " -f '/path/to/a/dicom/file.dcm' -n " ,
-                         "Check if 'file.dcm' is already in the PACS DB, but do not delete anything." }
+                         "Check if 'file.dcm' is already in the PACS DB, but do not delete anything." },
+                       { " '/path/to/incoming/' " ,
+                         "Delete all files within '/path/to/incoming/' that are already in the PACS DB." },
+                       { " -S " ,
+                         "Hash any PACS DB files that have not yet been hashed, and report duplicates within the PACS DB." }
     };
     //----
 
@@ -62,11 +76,7 @@ int main(int argc, char **argv){
         FUNCERR("Unrecognized option with argument: '" << optarg << "'");
     };
     arger.optionless_callback = [&](const std::string &optarg) -> void {
-        if(!DICOMFile.empty()){
-            FUNCERR("This program can only handle a single file at a time."
-                    " Earlier file: '" << DICOMFile << "'. This file: '" << optarg << "'");
-        }
-        DICOMFile = optarg;
+        InputPaths.push_back(optarg);
         return;
     };
     //----
@@ -78,13 +88,10 @@ int main(int argc, char **argv){
         return;
     }));
     arger.push_back( std::make_tuple(2, 'f', "dicom-file", true, "afile.dcm",
-                                     "(req'd) The DICOM file to use.",
+                                     "A DICOM file, or a directory of DICOM files, to check."
+                                     " Can be specified multiple times.",
                                      [&](const std::string &optarg) -> void {
-        if(!DICOMFile.empty()){
-            FUNCERR("This program can only handle a single file at a time."
-                    " Earlier file: '" << DICOMFile << "'. This file: '" << optarg << "'");
-        }
-        DICOMFile = optarg;
+        InputPaths.push_back(optarg);
         return;
     }));
     arger.push_back( std::make_tuple(2, 'n', "dry-run", false, "",
@@ -93,91 +100,214 @@ int main(int argc, char **argv){
         dryrun = true;
         return;
     }));
+    arger.push_back( std::make_tuple(2, 'S', "scan-store", false, "",
+                                     "Hash all PACS DB files that have not yet been hashed, and then report any"
+                                     " duplicates within the PACS DB. Nothing in the PACS DB is deleted.",
+                                     [&](const std::string &optarg) -> void {
+        ScanStore = true;
+        return;
+    }));
+    arger.push_back( std::make_tuple(3, 's', "batch-size", true, Xtostring(BatchSize),
+                                     "The number of files to hash and look up at a time.",
+                                     [&](const std::string &optarg) -> void {
+        if(!Is_String_An_X<long int>(optarg)) FUNCERR("'" << optarg << "' is not a valid batch size");
+        BatchSize = stringtoX<long int>(optarg);
+        if(BatchSize < 1) FUNCERR("Batch size must be positive");
+        return;
+    }));
 
     arger.Launch(argc, argv);
 
     //---------------------------------------------------------------------------------------------------------
     //--------------------------------------- Requirement Verification ----------------------------------------
     //---------------------------------------------------------------------------------------------------------
-    if(DICOMFile.empty()) FUNCERR("Cannot read DICOM file '" << DICOMFile << "'. Cannot continue");
+    if(InputPaths.empty() && !ScanStore) FUNCERR("No DICOM files provided. Cannot continue");
 
-    //---------------------------------------------------------------------------------------------------------
-    //----------------------------------------- Data Loading & Prep -------------------------------------------
-    //---------------------------------------------------------------------------------------------------------
-    //Process the file.
-    auto mmap = get_metadata_top_level_tags(DICOMFile);
-
-    //Basic information check.
-    {
-        const auto PatientID         = mmap["PatientID"];
-        const auto StudyInstanceUID  = mmap["StudyInstanceUID"];
-        const auto StudyDate         = mmap["StudyDate"];
-        const auto StudyTime         = mmap["StudyTime"];
-        const auto SeriesInstanceUID = mmap["SeriesInstanceUID"];
-        const auto SeriesNumber      = mmap["SeriesNumber"];
-        const auto SOPInstanceUID    = mmap["SOPInstanceUID"];
-
-        if(PatientID.empty() || StudyInstanceUID.empty()  || StudyDate.empty()    || StudyTime.empty() 
-        || SeriesInstanceUID.empty() || SeriesNumber.empty() || SOPInstanceUID.empty() ){
-            FUNCERR("File '" << DICOMFile << "' is absent, missing information, or not a DICOM file.");
+    //Expand directories. Directory contents are sorted so the order of processing is stable.
+    std::vector<std::string> DICOMFiles;
+    for(const auto &p : InputPaths){
+        if(Does_Dir_Exist_And_Can_Be_Read(p)){
+            std::vector<std::string> dir_files;
+            try{
+                for(const auto &e : boost::filesystem::recursive_directory_iterator(p)){
+                    if(boost::filesystem::is_regular_file(e.status())) dir_files.push_back(e.path().string());
+                }
+            }catch(const std::exception &e){
+                FUNCERR("Unable to search directory '" << p << "': " << e.what());
+            }
+            std::sort(dir_files.begin(), dir_files.end());
+            DICOMFiles.insert(DICOMFiles.end(), dir_files.begin(), dir_files.end());
+        }else{
+            if(!Does_File_Exist_And_Can_Be_Read(p)) FUNCERR("Cannot read DICOM file '" << p << "'. Cannot continue");
+            DICOMFiles.push_back(p);
         }
     }
 
+    const auto t_start = std::chrono::steady_clock::now();
+    const auto per_second = [&](size_t N) -> double {
+        const auto t_now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(t_now - t_start).count();
+        return static_cast<double>(N) / std::max(elapsed, 1.0E-9);
+    };
+
+    //Hashes files in parallel. Files that cannot be read are assigned an empty hash.
+    const auto hash_files = [](const std::vector<std::string> &filenames) -> std::vector<std::string> {
+        std::vector<std::string> hashes(filenames.size());
+        parallel_for(0, filenames.size(), [&](size_t i) -> void {
+            try{
+                hashes[i] = PACS_Content_Hash(filenames[i]);
+            }catch(const std::exception &e){
+                FUNCWARN("Unable to hash file '" << filenames[i] << "': " << e.what());
+            }
+        }, 1);
+        return hashes;
+    };
+
+    size_t N_removed = 0;
+    size_t N_failed = 0;
+
     //---------------------------------------------------------------------------------------------------------
     //------------------------------------------- Database Querying -------------------------------------------
     //---------------------------------------------------------------------------------------------------------
-    //Query the DB using the uniquely-identifying DICOM information.
-
     try{
         pqxx::connection c(db_params);
-        pqxx::work txn(c);
-        std::stringstream tb1, tb2;
-        pqxx::result r;
-
-        //----------------------------- Determine if a record already exists ----------------------------------
-
-        tb1.str(""); //Clear stringstream.
-        tb2.str(""); //Clear stringstream.
-        tb1 << "SELECT StoreFullPathName FROM metadata WHERE ( ";
-        tb1 << "       ( PatientID         = " << txn.quote(mmap["PatientID"])         << " ) ";
-        tb1 << "   AND ( StudyInstanceUID  = " << txn.quote(mmap["StudyInstanceUID"])  << " ) ";
-        tb1 << "   AND ( SeriesInstanceUID = " << txn.quote(mmap["SeriesInstanceUID"]) << " ) ";
-        tb1 << "   AND ( SOPInstanceUID    = " << txn.quote(mmap["SOPInstanceUID"])    << " ) ";
-        tb1 << " );";
-
-        r = txn.exec(tb1.str());
-        if(r.empty()){
-            if(verbose) FUNCINFO("File '" << DICOMFile << "' is NOT in the DB");
-            return 0;
+        {
+            pqxx::work txn(c);
+            PACS_Ensure_Content_Hash_Column(txn);
+            txn.commit();
         }
 
-        //---------------------------------- Ensure existing file is accessible ----------------------------------
-        //Also ensure that the basic DICOM unique identifiers match the DB record.
+        //------------------------------------ Hash any unhashed store files --------------------------------------
+        if(ScanStore){
+            std::vector<long int> pacsids;
+            std::vector<std::string> store_files;
+            {
+                pqxx::work txn(c);
+                pqxx::result r = txn.exec("SELECT pacsid, StoreFullPathName FROM metadata "
+                                          "WHERE (ContentHash IS NULL) AND (StoreFullPathName IS NOT NULL) "
+                                          "ORDER BY pacsid;");
+                for(pqxx::result::size_type i = 0; i != r.size(); ++i){
+                    pacsids.push_back( r[i]["pacsid"].as<long int>() );
+                    store_files.push_back( r[i]["StoreFullPathName"].as<std::string>() );
+                }
+            }
+            FUNCINFO("Found " << pacsids.size() << " PACS DB files that have not been hashed");
 
-        if(r.size() != 1){
-            FUNCERR("Multiple StoreFullPathName found for file '" << DICOMFile << "'. There should be 0 or 1");
-        }
-        const auto StoreFullPathName = (r[0]["StoreFullPathName"].is_null()) ? "" :
-                                                                               r[0]["StoreFullPathName"].as<std::string>();
-
-        auto pmmap = get_metadata_top_level_tags(StoreFullPathName);
-        if((mmap["PatientID"]         != pmmap["PatientID"])
-        || (mmap["StudyInstanceUID"]  != pmmap["StudyInstanceUID"])
-        || (mmap["SeriesInstanceUID"] != pmmap["SeriesInstanceUID"])
-        || (mmap["SOPInstanceUID"]    != pmmap["SOPInstanceUID"]) ){
-            FUNCERR("PACS DB file '" << StoreFullPathName << "' does not match the DB record! Aborting");
+            for(size_t b_begin = 0; b_begin < pacsids.size(); b_begin += static_cast<size_t>(BatchSize)){
+                const size_t b_end = std::min(pacsids.size(), b_begin + static_cast<size_t>(BatchSize));
+                const std::vector<std::string> batch_files(std::next(store_files.begin(), b_begin),
+                                                           std::next(store_files.begin(), b_end));
+                const auto hashes = hash_files(batch_files);
+
+                pqxx::work txn(c);
+                std::stringstream ss;
+                size_t N_values = 0;
+                for(size_t i = b_begin; i < b_end; ++i){
+                    const auto &h = hashes[i - b_begin];
+                    if(h.empty()) continue;
+                    ss << ((N_values++ == 0) ? "" : ", ") << "(" << pacsids[i] << ", " << txn.quote(h) << ")";
+                }
+                if(N_values != 0){
+                    txn.exec("UPDATE metadata SET ContentHash = v.ContentHash "
+                             "FROM (VALUES " + ss.str() + ") AS v(pacsid, ContentHash) "
+                             "WHERE (metadata.pacsid = v.pacsid);");
+                }
+                txn.commit();
+
+                FUNCINFO("Hashed " << b_end << "/" << pacsids.size() << " PACS DB files"
+                         << " (" << per_second(b_end) << " files/s)");
+            }
+
+            //Report duplicates within the store.
+            pqxx::work txn(c);
+            pqxx::result r = txn.exec("SELECT ContentHash, pacsid, StoreFullPathName FROM metadata "
+                                      "WHERE ContentHash IN ( "
+                                      "    SELECT ContentHash FROM metadata "
+                                      "    WHERE ContentHash IS NOT NULL "
+                                      "    GROUP BY ContentHash HAVING (COUNT(*) > 1) "
+                                      ") ORDER BY ContentHash, pacsid;");
+            size_t N_groups = 0;
+            std::string prev_hash;
+            for(pqxx::result::size_type i = 0; i != r.size(); ++i){
+                const auto h = r[i]["ContentHash"].as<std::string>();
+                if(h != prev_hash) ++N_groups;
+                prev_hash = h;
+                FUNCINFO("PACS DB file with pacsid = " << r[i]["pacsid"].as<long int>()
+                         << " at location '" << (r[i]["StoreFullPathName"].is_null() ? "" : r[i]["StoreFullPathName"].as<std::string>())
+                         << "' has content hash '" << h << "', which is shared with other PACS DB files");
+            }
+            FUNCINFO("Found " << N_groups << " groups of PACS DB files with identical content hashes");
         }
 
-        //---------------------------------- Ensure existing file is accessible ----------------------------------
+        //----------------------------- Determine if records already exist ----------------------------------
+        for(size_t b_begin = 0; b_begin < DICOMFiles.size(); b_begin += static_cast<size_t>(BatchSize)){
+            const size_t b_end = std::min(DICOMFiles.size(), b_begin + static_cast<size_t>(BatchSize));
+            const std::vector<std::string> batch_files(std::next(DICOMFiles.begin(), b_begin),
+                                                       std::next(DICOMFiles.begin(), b_end));
+            const auto hashes = hash_files(batch_files);
 
-        if(dryrun){
-            FUNCINFO("File '" << DICOMFile << "' is a duplicate (not removed due to dry-run)");
-        }else{
-            //Remove the file.
-            if(RemoveFile(DICOMFile)){
-                if(verbose) FUNCINFO("Deleted file '" << DICOMFile << "' which duplicated PACS DB file '" << StoreFullPathName << "'");
-            }else{
-                FUNCERR("Unable to delete file '" << DICOMFile << "' which duplicates PACS DB file '" << StoreFullPathName << "'");
+            //Look up all hashes in a single query.
+            std::multimap<std::string, std::string> stored; // ContentHash --> StoreFullPathName.
+            {
+                pqxx::work txn(c);
+                std::stringstream ss;
+                size_t N_values = 0;
+                for(const auto &h : hashes){
+                    if(h.empty()) continue;
+                    ss << ((N_values++ == 0) ? "" : ", ") << txn.quote(h);
+                }
+                if(N_values != 0){
+                    pqxx::result r = txn.exec("SELECT ContentHash, StoreFullPathName FROM metadata "
+                                              "WHERE (ContentHash IN (" + ss.str() + ")) AND (StoreFullPathName IS NOT NULL);");
+                    for(pqxx::result::size_type i = 0; i != r.size(); ++i){
+                        stored.emplace( r[i]["ContentHash"].as<std::string>(),
+                                        r[i]["StoreFullPathName"].as<std::string>() );
+                    }
+                }
+            }
+
+            for(size_t i = 0; i < batch_files.size(); ++i){
+                const auto &DICOMFile = batch_files[i];
+                if(hashes[i].empty()){
+                    ++N_failed;
+                    continue;
+                }
+
+                //---------------------------------- Ensure existing file is identical ----------------------------------
+                std::vector<std::string> candidates;
+                const auto range = stored.equal_range(hashes[i]);
+                for(auto it = range.first; it != range.second; ++it) candidates.push_back(it->second);
+
+                const auto match = PACS_Find_Stored_Duplicate(DICOMFile, candidates, [&](const std::string &s){
+                    FUNCWARN("File '" << DICOMFile << "' has the same content hash as PACS DB file '"
+                             << s << "', but the files differ");
+                });
+                if(match.is_stored_file){
+                    if(verbose) FUNCINFO("File '" << DICOMFile << "' is a PACS DB file. Not removing it");
+                    continue;
+                }
+                const auto &StoreFullPathName = match.stored_file;
+                if(StoreFullPathName.empty()){
+                    if(verbose) FUNCINFO("File '" << DICOMFile << "' is NOT in the DB");
+                    continue;
+                }
+
+                if(dryrun){
+                    FUNCINFO("File '" << DICOMFile << "' is a duplicate (not removed due to dry-run)");
+                }else{
+                    //Remove the file.
+                    if(RemoveFile(DICOMFile)){
+                        ++N_removed;
+                        if(verbose) FUNCINFO("Deleted file '" << DICOMFile << "' which duplicated PACS DB file '" << StoreFullPathName << "'");
+                    }else{
+                        FUNCERR("Unable to delete file '" << DICOMFile << "' which duplicates PACS DB file '" << StoreFullPathName << "'");
+                    }
+                }
+            }
+
+            if(1 < DICOMFiles.size()){
+                FUNCINFO("Checked " << b_end << "/" << DICOMFiles.size() << " files"
+                         << " (" << per_second(b_end) << " files/s)");
             }
         }
 
@@ -185,5 +315,9 @@ int main(int argc, char **argv){
         FUNCERR("Unable to query database:\n" << e.what() << "\nCannot continue");
     }
 
-    return 0;
+    if(1 < DICOMFiles.size()){
+        FUNCINFO("Removed " << N_removed << " duplicate files; " << N_failed << " files could not be read");
+    }
+
+    return (N_failed == 0) ? 0 : 1;
 }
@@ -1,11 +1,14 @@
 //PACS_Ingress.h - DICOMautomaton 2015. Written by hal clark.
 //
-//This program is suitable for importing individual DICOM files into a PACS-like database.
+//This program is suitable for importing DICOM files into a PACS-like database.
 // The modality and linkage is ignored for the purposes of ingress. Files can be properly
 // linked, queried, and further examined after they have been imported.
 //
 // Note that, because this program essentially just distills files down to a collection of
-// DICOM key-values, routines are tightly coupled with the DICOM parser. 
+// DICOM key-values, routines are tightly coupled with the DICOM parser.
+//
+// Many files (or directories of files) can be ingressed by a single invocation. Files are parsed in parallel and
+// inserted in batches, each of which is committed as a single transaction over a single connection.
 //
 
 #ifdef DCMA_USE_POSTGRES
@@ -13,29 +16,109 @@
     #error "Attempted to compile without PostgreSQL support, which is required."
 #endif
 
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <iostream>
 #include <list>
 #include <map>
 #include <pqxx/pqxx> //PostgreSQL C++ interface.
+#include <set>
+#include <stdexcept>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "Imebra_Shim.h"     //Wrapper for Imebra library. Black-boxed to speed up compilation.
+#include "PACS_Content_Hash.h"
+#include "Thread_Pool.h"
 #include "YgorArguments.h"
 #include "YgorFilesDirs.h"
 #include "YgorMisc.h"           //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorString.h"         //Needed for stringtoX(), X_to_string().
 
+//A single file to be ingressed, along with everything needed to register it in the database.
+struct ingress_item {
+    std::string DICOMFile;
+    std::string GDCMDump;         //Empty if not available.
+    std::map<std::string,std::string> mmap;
+    std::string ContentHash;
+
+    std::string NewFullDir;
+    std::string StoreFullPathName;
+    std::string StoreGDCMDumpFileName;
+
+    std::string error;            //Non-empty if the file cannot be ingressed.
+};
+
+//Parses the file and figures out a reasonable place to keep the file in the filesystem store. It isn't so important
+// except to be reasonably human-readable, fairly balanced in the filesystem, and not already present.
+static void prepare_item(ingress_item &item, const std::string &DICOMFileSystemStoreBase){
+    try{
+        item.mmap = get_metadata_top_level_tags(item.DICOMFile);
+    }catch(const std::exception &e){
+        item.error = "Unable to parse file: "_s + e.what();
+        return;
+    }
+    auto &mmap = item.mmap;
+
+    try{
+        item.ContentHash = PACS_Content_Hash(item.DICOMFile);
+    }catch(const std::exception &e){
+        item.error = e.what();
+        return;
+    }
+
+    const auto StudyInstanceUID  = mmap["StudyInstanceUID"];
+    const auto StudyDate         = mmap["StudyDate"];
+    const auto StudyTime         = mmap["StudyTime"];
+    const auto SeriesInstanceUID = mmap["SeriesInstanceUID"];
+    const auto SeriesNumber      = mmap["SeriesNumber"];
+    const auto SOPInstanceUID    = mmap["SOPInstanceUID"];
+
+    if(StudyInstanceUID.empty()  || StudyDate.empty()    || StudyTime.empty()
+    || SeriesInstanceUID.empty() || SeriesNumber.empty() || SOPInstanceUID.empty() ){
+        item.error = "File is missing information and cannot be imported into the database";
+        return;
+    }
+
+    const auto TopDirName = Detox_String(StudyDate) + "-"_s
+                          + Detox_String(StudyTime) + "_"_s
+                          + Detox_String(StudyInstanceUID);
+
+    const auto MidDirName = Detox_String(SeriesNumber) + "-"_s
+                          + Detox_String(SeriesInstanceUID);
+
+    item.NewFullDir = DICOMFileSystemStoreBase + "/"_s
+                    + TopDirName + "/"_s
+                    + MidDirName + "/";    //Not the full path, just the complete directory.
+
+    const auto NewFileName = Detox_String(SOPInstanceUID) + ".dcm";
+    item.StoreFullPathName = item.NewFullDir + NewFileName;
+
+    const auto NewGDCMDumpFileName = Detox_String(SOPInstanceUID) + ".gdcmdump";
+    item.StoreGDCMDumpFileName = item.NewFullDir + NewGDCMDumpFileName;
+
+    //If no gdcmdump was explicitly provided, look for one alongside the file.
+    if(item.GDCMDump.empty()){
+        const auto SiblingGDCMDump = item.DICOMFile + ".gdcmdump";
+        if(Does_File_Exist_And_Can_Be_Read(SiblingGDCMDump)) item.GDCMDump = LoadFileToString(SiblingGDCMDump);
+    }
+    return;
+}
+
 int main(int argc, char **argv){
     //std::string db_params("dbname=pacs user=hal host=localhost port=63443");
     std::string db_params("dbname=pacs user=hal host=localhost");
     std::string DICOMFileSystemStoreBase("/home/pacs_store");
-    std::string DICOMFile;  //The filename to use.
+    std::list<std::string> InputPaths; //Files and directories to ingress.
     std::string Project;    //Human-readable project of data origin. MSc, PhD, Special_Project_...
     std::string Comments;   //Human-readable general comments.
     std::string GDCMDump;   //Text of executing `gdcmdump` if available.
+    long int CommitSize = 500; //Number of files to insert per transaction.
     bool dryrun = false;    //Do not actually insert the file into the db, just test for errors.
     bool verbose = false;   //Print extra information. Normally successful info is suppresed.
 
@@ -45,12 +128,19 @@ int main(int argc, char **argv){
     class ArgumentHandler arger;
     const std::string progname(argv[0]);
     //----
-    arger.description = "Given a DICOM file and some additional metadata, insert the data    "
-                        " into the PACs system database. The file itself will be copied into "
-                        " the database and various bits of data will be deciphered.          ";
+    arger.description = "Given DICOM files and some additional metadata, insert the data     "
+                        " into the PACs system database. The files themselves will be copied "
+                        " into the database and various bits of data will be deciphered.     "
+                        " Directories are searched recursively. When ingressing many files,  "
+                        " a 'gdcmdump' file is taken from alongside each DICOM file (i.e.,   "
+                        " '/tmp/a.dcm.gdcmdump' for '/tmp/a.dcm') if one is present.         ";
 
     arger.examples = { { " -f '/tmp/a.dcm' -g '/tmp/a.gdcmdump' -p 'XYZ Study 2017' -c 'Bulk insert for XYZ.'" ,
-                         "Insert the file '/tmp/a.dcm' into the database." } 
+                         "Insert the file '/tmp/a.dcm' into the database." },
+                       { " -p 'XYZ Study 2017' -c 'Bulk insert for XYZ.' -s 1000 '/tmp/archive/'" ,
+                         "Insert all files within '/tmp/archive/', committing after every 1000 files." },
+                       { " -d 'dbname=pacs_test host=localhost' -n -p 'Test' -c 'Test.' '/tmp/a.dcm' '/tmp/b.dcm'" ,
+                         "Test ingress of two files into a local test database without modifying it." }
     };
     //----
 
@@ -58,20 +148,16 @@ int main(int argc, char **argv){
         FUNCERR("Unrecognized option with argument: '" << optarg << "'");
     };
     arger.optionless_callback = [&](const std::string &optarg) -> void {
-        if(!DICOMFile.empty()){
-            FUNCERR("This program can only handle a single file at a time."
-                    " Earlier file: '" << DICOMFile << "'. This file: '" << optarg << "'");
-        }
-        DICOMFile = optarg;
+        InputPaths.push_back(optarg);
         return;
     };
     //----
 
     arger.push_back( std::make_tuple(1, 'f', "dicom-file", true, "/tmp/a",
-                                     "(req'd) The DICOM file to use.",
+                                     "(req'd) A DICOM file, or a directory of DICOM files, to use."
+                                     " Can be specified multiple times.",
                                      [&](const std::string &optarg) -> void {
-        if(!DICOMFile.empty()) FUNCERR("This program can only handle a single file at a time");
-        DICOMFile = optarg;
+        InputPaths.push_back(optarg);
         return;
     }));
     arger.push_back( std::make_tuple(2, 'p', "project", true, "MSc",
@@ -87,7 +173,7 @@ int main(int argc, char **argv){
         return;
     }));
     arger.push_back( std::make_tuple(1, 'g', "gdcmdump-file", true, "/tmp/a.dcm.gdcmdump",
-                                     "File containing output from `gdcmdump`.",
+                                     "File containing output from `gdcmdump`. Only valid when a single file is ingressed.",
                                      [&](const std::string &optarg) -> void {
         if(!Does_File_Exist_And_Can_Be_Read(optarg)) FUNCERR("Cannot read file '" << optarg << "'");
         GDCMDump = LoadFileToString(optarg);
@@ -112,176 +198,256 @@ int main(int argc, char **argv){
         DICOMFileSystemStoreBase = optarg;
         return;
     }));
+    arger.push_back( std::make_tuple(1, 'd', "db-params", true, db_params,
+                                     "PostgreSQL connection parameters.",
+                                     [&](const std::string &optarg) -> void {
+        db_params = optarg;
+        return;
+    }));
+    arger.push_back( std::make_tuple(3, 's', "commit-size", true, Xtostring(CommitSize),
+                                     "The number of files to parse and insert per transaction.",
+                                     [&](const std::string &optarg) -> void {
+        if(!Is_String_An_X<long int>(optarg)) FUNCERR("'" << optarg << "' is not a valid commit size");
+        CommitSize = stringtoX<long int>(optarg);
+        if(CommitSize < 1) FUNCERR("Commit size must be positive");
+        return;
+    }));
 
     arger.Launch(argc, argv);
 
     //---------------------------------------------------------------------------------------------------------
     //--------------------------------------- Requirement Verification ----------------------------------------
     //---------------------------------------------------------------------------------------------------------
-    if(DICOMFile.empty()) FUNCERR("Cannot read DICOM file '" << DICOMFile << "'. Cannot continue");
+    if(InputPaths.empty()) FUNCERR("No DICOM files provided. Cannot continue");
     if(Project.empty())   FUNCERR("The 'project' string is mandatory. Cannot continue");
     if(Comments.empty())  FUNCERR("The 'comments' string is mandatory. Cannot continue");
-    if(GDCMDump.empty())  FUNCERR("The 'gdcmdump' string is strongly suggested. Refusing to continue");
 
-    //---------------------------------------------------------------------------------------------------------
-    //----------------------------------------- Data Loading & Prep -------------------------------------------
-    //---------------------------------------------------------------------------------------------------------
-    //Process the file.
-    auto mmap = get_metadata_top_level_tags(DICOMFile);
-
-    //Figure out a reasonable place to keep the file in the filesystem store. It isn't so important except to
-    // be reasonably human-readable, fairly balanced in the filesystem, and not already present.
-    const auto StudyInstanceUID  = mmap["StudyInstanceUID"];
-    const auto StudyDate         = mmap["StudyDate"];
-    const auto StudyTime         = mmap["StudyTime"];
-    const auto SeriesInstanceUID = mmap["SeriesInstanceUID"];
-    const auto SeriesNumber      = mmap["SeriesNumber"];
-    const auto SOPInstanceUID    = mmap["SOPInstanceUID"];
-
-    if(StudyInstanceUID.empty()  || StudyDate.empty()    || StudyTime.empty() 
-    || SeriesInstanceUID.empty() || SeriesNumber.empty() || SOPInstanceUID.empty() ){
-        FUNCERR("File is '" << DICOMFile << "' missing information and cannot be imported into the database");
+    //Expand directories, ignoring any gdcmdump sidecar files. Directory contents are sorted so ingress order is stable.
+    std::vector<ingress_item> items;
+    bool single_file_mode = (InputPaths.size() == 1);
+    for(const auto &p : InputPaths){
+        if(Does_Dir_Exist_And_Can_Be_Read(p)){
+            single_file_mode = false;
+            std::vector<std::string> dir_files;
+            try{
+                for(const auto &e : boost::filesystem::recursive_directory_iterator(p)){
+                    if(!boost::filesystem::is_regular_file(e.status())) continue;
+                    if(e.path().extension() == ".gdcmdump") continue;
+                    dir_files.push_back(e.path().string());
+                }
+            }catch(const std::exception &e){
+                FUNCERR("Unable to search directory '" << p << "': " << e.what());
+            }
+            std::sort(dir_files.begin(), dir_files.end());
+            for(const auto &f : dir_files){
+                items.emplace_back();
+                items.back().DICOMFile = f;
+            }
+        }else{
+            if(!Does_File_Exist_And_Can_Be_Read(p)) FUNCERR("Cannot read DICOM file '" << p << "'. Cannot continue");
+            items.emplace_back();
+            items.back().DICOMFile = p;
+        }
     }
 
-    const auto TopDirName = Detox_String(StudyDate) + "-"_s
-                          + Detox_String(StudyTime) + "_"_s
-                          + Detox_String(StudyInstanceUID);
-
-    const auto MidDirName = Detox_String(SeriesNumber) + "-"_s
-                          + Detox_String(SeriesInstanceUID);
-
-    const auto NewFullDir = DICOMFileSystemStoreBase + "/"_s
-                          + TopDirName + "/"_s
-                          + MidDirName + "/";    //Not the full path, just the complete directory.
-
-    const auto NewFileName = Detox_String(SOPInstanceUID) + ".dcm";
-    const auto StoreFullPathName = NewFullDir + NewFileName;
-
-    const auto NewGDCMDumpFileName = Detox_String(SOPInstanceUID) + ".gdcmdump";
-    const auto StoreGDCMDumpFileName = NewFullDir + NewGDCMDumpFileName;
+    if(single_file_mode){
+        items.front().GDCMDump = GDCMDump;
+    }else if(!GDCMDump.empty()){
+        FUNCERR("A 'gdcmdump' file can only be provided when a single file is ingressed. Cannot continue");
+    }
 
     //---------------------------------------------------------------------------------------------------------
     //----------------------------------------- Database Registration -----------------------------------------
     //---------------------------------------------------------------------------------------------------------
     //Now we convert the data into a format the database can use to verify/cast into the proper format. In some
     // cases we cast to a REAL before an INT. This is because I've encountered INT fields printed in strings or
-    // reported by Imebra as '16.0000' which PostgreSQL doesn't like. Casting to REAL and then INT is a 
+    // reported by Imebra as '16.0000' which PostgreSQL doesn't like. Casting to REAL and then INT is a
     // logical workaround.
+    //
+    //Files are parsed in parallel, one batch at a time, and then registered serially. Each batch is committed as a
+    // single transaction. Statements are prepared once per connection.
+
+    const auto N_items = items.size();
+    size_t N_ingressed = 0;
+    size_t N_duplicates = 0;
+    size_t N_failed = 0;
+    const auto t_start = std::chrono::steady_clock::now();
+    const auto files_per_second = [&](size_t N) -> double {
+        const auto t_now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(t_now - t_start).count();
+        return static_cast<double>(N) / std::max(elapsed, 1.0E-9);
+    };
 
-    try{
-        pqxx::connection c(db_params);
-        pqxx::work txn(c);
-        std::stringstream tb1, tb2;
-        pqxx::result r;
-
-        //----------------------------- Determine if a record already exists ----------------------------------
-        //This is not a conclusive test, but will stop many unneccesary file insertion into the store.
-
-        tb1.str(""); //Clear stringstream.
-        tb2.str(""); //Clear stringstream.
-        tb1 << "SELECT PatientID FROM metadata WHERE ( ";
+    //Used to catch duplicates within the input itself, which the database cannot see until they are committed.
+    std::set<std::tuple<std::string,std::string,std::string,std::string>> seen_uids;
 
-        tb1 << "       ( PatientID         = " << txn.quote(mmap["PatientID"])         << " ) ";
-        tb1 << "   AND ( StudyInstanceUID  = " << txn.quote(mmap["StudyInstanceUID"])  << " ) ";
-        tb1 << "   AND ( SeriesInstanceUID = " << txn.quote(mmap["SeriesInstanceUID"]) << " ) ";
-        tb1 << "   AND ( SOPInstanceUID    = " << txn.quote(mmap["SOPInstanceUID"])    << " ) ";
-        tb1 << " );";
+    //Files written into the filesystem store by the current (uncommitted) batch. They are removed if the batch fails.
+    std::vector<std::string> uncommitted_files;
 
-        r = txn.exec(tb1.str());
-        if(!r.empty()){
-            FUNCWARN("Conflicting file already present. Treating as a duplicate and NOT ingressing");
-            return 0;
+    try{
+        pqxx::connection c(db_params);
+        {
+            pqxx::work txn(c);
+            PACS_Ensure_Content_Hash_Column(txn);
+            txn.commit();
         }
 
-        //-------------------------------------- Import the files ---------------------------------------------
-        if(!dryrun){
-            //Ensure the destination location can be created and the file copied.
-            if(!Does_Dir_Exist_And_Can_Be_Read(NewFullDir) && !Create_Dir_and_Necessary_Parents(NewFullDir)){
-                FUNCERR("Unable to create directory '" << NewFullDir << "'. Cannot continue");
+        //This is not a conclusive test, but will stop many unneccesary file insertion into the store.
+        c.prepare("find_duplicate",
+                  "SELECT PatientID FROM metadata WHERE ( "
+                  "       ( PatientID         = $1 ) "
+                  "   AND ( StudyInstanceUID  = $2 ) "
+                  "   AND ( SeriesInstanceUID = $3 ) "
+                  "   AND ( SOPInstanceUID    = $4 ) "
+                  " ) LIMIT 1;");
+
+        //Claim a new pacsid and push the metadata in a single round-trip.
+        //
+        //Don't worry about iterating the nidus unnecessarily. There is plenty of room to skip ids, and we can
+        // always squash holes at a later time (as required).
+        c.prepare("insert_metadata",
+                  "WITH nidus AS ( "
+                  "    INSERT INTO pacsid_nidus "
+                  "        (pacsid) VALUES (nextval('pacsid_nidus_seq')) "
+                  "    RETURNING pacsid "
+                  ") "
+                  "INSERT INTO metadata ( "
+                  "    pacsid, "
+                  "    PatientID, "          //DICOM logical hierarchy fields.
+                  "    StudyInstanceUID, "
+                  "    SeriesInstanceUID, "
+                  "    SOPInstanceUID, "
+                  "    Project, "            //Non-DICOM metadata fields.
+                  "    Comments, "
+                  "    FullPathName, "
+                  "    ImportTimepoint, "
+                  "    StoreFullPathName, "
+                  "    ContentHash "
+                  ") SELECT "
+                  "    nidus.pacsid, "
+                  "    NULLIF($1,''), "
+                  "    NULLIF($2,''), "
+                  "    NULLIF($3,''), "
+                  "    NULLIF($4,''), "
+                  "    NULLIF($5,''), "
+                  "    NULLIF($6,''), "
+                  "    NULLIF($7,''), "
+                  "    now(), "
+                  "    $8, "
+                  "    $9 "
+                  "FROM nidus "
+                  "RETURNING pacsid;");
+
+        for(size_t b_begin = 0; b_begin < N_items; b_begin += static_cast<size_t>(CommitSize)){
+            const size_t b_end = std::min(N_items, b_begin + static_cast<size_t>(CommitSize));
+
+            //-------------------------------------- Parse the files ----------------------------------------------
+            parallel_for(b_begin, b_end, [&](size_t i) -> void {
+                prepare_item(items[i], DICOMFileSystemStoreBase);
+            }, 1);
+
+            pqxx::work txn(c);
+            for(size_t i = b_begin; i < b_end; ++i){
+                auto &item = items[i];
+                auto &mmap = item.mmap;
+
+                if(item.error.empty() && item.GDCMDump.empty() && single_file_mode){
+                    item.error = "The 'gdcmdump' string is strongly suggested. Refusing to continue";
+                }
+                if(!item.error.empty()){
+                    FUNCWARN("Not ingressing file '" << item.DICOMFile << "': " << item.error);
+                    ++N_failed;
+                    continue;
+                }
+
+                //----------------------------- Determine if a record already exists ----------------------------------
+                const auto uids = std::make_tuple(mmap["PatientID"], mmap["StudyInstanceUID"],
+                                                  mmap["SeriesInstanceUID"], mmap["SOPInstanceUID"]);
+                pqxx::result r = txn.exec_prepared("find_duplicate", std::get<0>(uids), std::get<1>(uids),
+                                                                     std::get<2>(uids), std::get<3>(uids));
+                if(!r.empty() || !seen_uids.insert(uids).second){
+                    FUNCWARN("Conflicting file already present. Treating '" << item.DICOMFile << "' as a duplicate and NOT ingressing");
+                    ++N_duplicates;
+                    continue;
+                }
+
+                //-------------------------------------- Import the files ---------------------------------------------
+                if(!dryrun){
+                    //Ensure the destination location can be created and the file copied.
+                    if(!Does_Dir_Exist_And_Can_Be_Read(item.NewFullDir) && !Create_Dir_and_Necessary_Parents(item.NewFullDir)){
+                        throw std::runtime_error("Unable to create directory '" + item.NewFullDir + "'");
+                    }
+
+                    //Copy the file. The destination is recorded first so that a partial copy is also removed.
+                    uncommitted_files.push_back(item.StoreFullPathName);
+                    if(!CopyFile(item.DICOMFile, item.StoreFullPathName)){
+                        throw std::runtime_error("Unable to copy file '" + item.DICOMFile + "' to filesystem store destination '"
+                                                 + item.StoreFullPathName + "'");
+                    }
+
+                    //Write the GDCMDump file into the store.
+                    if(!item.GDCMDump.empty()){
+                        uncommitted_files.push_back(item.StoreGDCMDumpFileName);
+                        if(!WriteStringToFile(item.GDCMDump, item.StoreGDCMDumpFileName)){
+                            throw std::runtime_error("Unable to write GDCMDump file '" + item.StoreGDCMDumpFileName
+                                                     + "' into the filesystem store");
+                        }
+                    }
+
+                    //Set the permissions ...
+                    // ... TODO ...
+                }
+
+                //------------------------------- Push the metadata to the database -----------------------------------
+                r = txn.exec_prepared("insert_metadata",
+                                      std::get<0>(uids), std::get<1>(uids), std::get<2>(uids), std::get<3>(uids),
+                                      Project,
+                                      Comments,
+                                      Fully_Expand_Filename(item.DICOMFile),
+                                      item.StoreFullPathName,
+                                      item.ContentHash);
+                if(r.affected_rows() != 1){
+                    //Copied files are removed below. Remove directory ... IFF nothing else is in it... TODO FIXME.
+                    throw std::runtime_error("DB insertion affected " + std::to_string(r.affected_rows())
+                                             + " rows. Since != 1 the insertion was aborted");
+                }else{
+                    if(verbose) FUNCINFO("Success! PACS id=" << r[0]["pacsid"].as<long int>()
+                                         << " and StoreFullPathName='" << item.StoreFullPathName << "'");
+                }
+                ++N_ingressed;
             }
 
-            //if(!TouchFile(StoreFullPathName)){
-            //    FUNCERR("Unable to touch file '" << StoreFullPathName << "'. Cannot continue");
-            //}
+            if(!dryrun) txn.commit();
+            uncommitted_files.clear();
 
-            //Copy the file.
-            if(!CopyFile(DICOMFile, StoreFullPathName)){
-                FUNCERR("Unable to copy file '" << DICOMFile << "' to filesystem store destination '" << StoreFullPathName << "'");
-            }
+            //Release the parsed metadata; only the counts are needed hereafter.
+            for(size_t i = b_begin; i < b_end; ++i) items[i] = ingress_item();
 
-            //Write the GDCMDump file into the store.
-            if(!WriteStringToFile(GDCMDump, StoreGDCMDumpFileName)){
-                FUNCERR("Unable to write GDCMDump file '" << StoreGDCMDumpFileName << "' into the filesystem store");
+            if(1 < N_items){
+                FUNCINFO("Processed " << b_end << "/" << N_items << " files"
+                         << " (" << files_per_second(b_end) << " files/s)");
             }
-
-            //Set the permissions ...
-            // ... TODO ...
-        }
-
-        //------------------------------------- Claim a new pacsid --------------------------------------------
-        //Don't worry about iterating the nidus unnecessarily. There is plenty of room to skip ids, and we can
-        // always squash holes at a later time (as required).
-        tb1.str(""); //Clear stringstream.
-        tb2.str(""); //Clear stringstream.
-        tb1 << "INSERT INTO pacsid_nidus                          ";
-        tb1 << "    (pacsid) VALUES (nextval('pacsid_nidus_seq')) ";
-        tb1 << "RETURNING pacsid;                                 ";
-
-        r = txn.exec(tb1.str());
-        if(r.affected_rows() != 1) FUNCERR("Unable to create new pacsid. Cannot continue");
-        const auto pacsid = r[0]["pacsid"].as<long int>(); 
-
-        //------------------------------- Push the metadata to the database -----------------------------------
-        tb1.str(""); //Clear stringstream.
-        tb2.str(""); //Clear stringstream.
-        tb1 << "INSERT INTO metadata ( ";
-
-        tb1 << "    pacsid,                      ";        tb2 << pacsid << ",";
-
-        //DICOM logical hierarchy fields.
-        tb1 << "    PatientID,                   ";        tb2 << "NULLIF(" << txn.quote(mmap["PatientID"]) << ",''),";
-        tb1 << "    StudyInstanceUID,            ";        tb2 << "NULLIF(" << txn.quote(mmap["StudyInstanceUID"]) << ",''),";
-        tb1 << "    SeriesInstanceUID,           ";        tb2 << "NULLIF(" << txn.quote(mmap["SeriesInstanceUID"]) << ",''),";
-        tb1 << "    SOPInstanceUID,              ";        tb2 << "NULLIF(" << txn.quote(mmap["SOPInstanceUID"]) << ",''),";
-
-/*
-        tb1 << "    StudyDate,                   ";        tb2 << "CAST( NULLIF(" << txn.quote(mmap["StudyDate"]) << ",'') AS DATE),";
-        tb1 << "    StudyTime,                   ";        tb2 << "CAST( NULLIF(" << txn.quote(mmap["StudyTime"]) << ",'') AS TIME),";
-        tb1 << "    SeriesNumber,                ";        tb2 << "CAST( CAST( NULLIF(" << txn.quote(mmap["SeriesNumber"]) << ",'') AS REAL) AS BIGINT),";
-*/
-
-        //Non-DICOM metadata fields.
-        tb1 << "    Project,                     ";        tb2 << "NULLIF(" << txn.quote(Project) << ",''),";
-        tb1 << "    Comments,                    ";        tb2 << "NULLIF(" << txn.quote(Comments) << ",''),";
-        tb1 << "    FullPathName,                ";        tb2 << "NULLIF(" << txn.quote(Fully_Expand_Filename(DICOMFile)) << ",''),";
-//        tb1 << "    gdcmdump,                    ";        tb2 << "NULLIF(" << txn.quote(GDCMDump) << ",''),";
-        tb1 << "    ImportTimepoint,             ";        tb2 << "now(),";
-        tb1 << "    StoreFullPathName            ";        tb2 << txn.quote(StoreFullPathName);
-
-        tb1 << ") VALUES (" << tb2.str() << ");";
-
-        r = txn.exec(tb1.str());
-        if(r.affected_rows() != 1){
-
-            //Remove filesystem store copied files! TODO FIXME.
-            //Remove directory ... IFF nothing else is in it... TODO FIXME.
-            // ...
-
-            FUNCERR("DB insertion affected " << r.affected_rows() << " rows. Since != 1 the insertion was aborted");
-        }else{
-            if(verbose) FUNCINFO("Success! PACS id=" << pacsid << " and StoreFullPathName='" << StoreFullPathName << "'");
         }
 
-        if(dryrun){
-            if(verbose) FUNCINFO("Dry run successful. No errors encountered");
-            return 0;
-        }else{
-            txn.commit(); 
+    }catch(const std::exception &e){
+        //The failed batch was rolled back, so files copied into the store for it are orphans.
+        for(const auto &f : uncommitted_files){
+            boost::system::error_code ec;
+            boost::filesystem::remove(f, ec);
+            if(ec) FUNCWARN("Unable to remove orphaned file '" << f << "' from the filesystem store: " << ec.message());
         }
+        FUNCERR("Unable to push to database:\n" << e.what() << "\n"
+                << N_ingressed << " files were ingressed before the failure. Cannot continue");
+    }
 
-    }catch(const std::exception &e){
-        FUNCERR("Unable to push to database:\n" << e.what() << "\n" << "Cannot continue");
+    if(dryrun && (N_failed == 0)){
+        if(verbose) FUNCINFO("Dry run successful. No errors encountered");
+    }
+    if((1 < N_items) || verbose){
+        FUNCINFO((dryrun ? "Tested " : "Ingressed ") << N_ingressed << " files, skipped " << N_duplicates
+                 << " duplicates, and failed to ingress " << N_failed << " files"
+                 << " (" << files_per_second(N_items) << " files/s)");
     }
 
-    return 0;
+    return (N_failed == 0) ? 0 : 1;
 }
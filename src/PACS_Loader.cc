@@ -31,16 +31,6 @@
 #include "YgorMisc.h"         //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 
 
-static
-std::unique_ptr<Contour_Data> 
-Concatenate_Contour_Data(std::unique_ptr<Contour_Data> A,
-                         std::unique_ptr<Contour_Data> B){
-    //This routine concatenates A and B's contour collections. No internal checking is performed.
-    // No copying is performed, but A and B are consumed. A is returned as if it were a new pointer.
-    A->ccs.splice( A->ccs.end(), std::move(B->ccs) );
-    return A;
-}
-
 
 bool Load_From_PACS_DB( Drover &DICOM_data,
                         std::map<std::string,std::string> & /* InvocationMetadata */,
@@ -115,9 +105,10 @@ bool Load_From_PACS_DB( Drover &DICOM_data,
                 if(boost::iequals(Modality,"RTSTRUCT")){
                     const auto preloadcount = loaded_contour_data_storage->ccs.size();
                     try{
-                        auto combined = Concatenate_Contour_Data( loaded_contour_data_storage->Duplicate(),
-                                                                  get_Contour_Data(StoreFullPathName));
-                        loaded_contour_data_storage = std::move(combined);
+                        //The storage is not shared yet, so contours can be spliced in without copying.
+                        auto loaded = get_Contour_Data(StoreFullPathName);
+                        loaded_contour_data_storage->ccs.splice( loaded_contour_data_storage->ccs.end(),
+                                                                 std::move(loaded->ccs) );
                     }catch(const std::exception &e){
                         FUNCWARN("Difficulty encountered during contour data loading: '" << e.what() <<
                                  "'. Ignoring file and continuing");
@@ -287,10 +278,13 @@ bool Load_From_PACS_DB( Drover &DICOM_data,
 
     //Concatenate contour data into the Drover instance.
     {
+        //Existing contours are only duplicated if they are shared with another owner.
         if(DICOM_data.contour_data == nullptr) DICOM_data.contour_data = std::make_shared<Contour_Data>();
-        auto combined = Concatenate_Contour_Data( DICOM_data.contour_data->Duplicate(),
-                                                  loaded_contour_data_storage->Duplicate());
-        DICOM_data.contour_data = std::move(combined);
+        if(DICOM_data.contour_data.use_count() != 1){
+            DICOM_data.contour_data = DICOM_data.contour_data->Duplicate();
+        }
+        DICOM_data.contour_data->ccs.splice( DICOM_data.contour_data->ccs.end(),
+                                             std::move(loaded_contour_data_storage->ccs) );
     }
 
     //Collate each group of images into a single set, if possible. Also stuff the correct contour data in the same set.
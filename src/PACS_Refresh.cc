@@ -3,26 +3,243 @@
 // This program is designed to update the database whenever the table structure has
 // been tweaked.
 //
+// Records are processed in batches. Files are parsed in parallel, the raw metadata is staged in a temporary table,
+// and each batch is applied with a single set-based UPDATE. The modification time and size of each file are recorded
+// in the 'metadata_refresh' table so that an interrupted or repeated refresh can skip files that have not changed.
+// The content hash of each refreshed file is also recorded (see PACS_Content_Hash.h).
+//
 
 #ifdef DCMA_USE_POSTGRES
 #else
     #error "Attempted to compile without PostgreSQL support, which is required."
 #endif
 
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <exception>
 #include <fstream>
 #include <functional>
 #include <list>
 #include <map>
 #include <pqxx/pqxx>         //PostgreSQL C++ interface.
+#include <sstream>
+#include <stdexcept>
 #include <string>    
+#include <vector>
 
 #include "Imebra_Shim.h"     //Wrapper for Imebra library. Black-boxed to speed up compilation.
+#include "PACS_Content_Hash.h"
+#include "Thread_Pool.h"
 #include "YgorArguments.h"   //Needed for ArgumentHandler class.
 #include "YgorMisc.h"        //Needed for FUNCINFO, FUNCWARN, FUNCERR macros.
 #include "YgorString.h"      //Needed for GetFirstRegex(...)
 
+//How the raw DICOM string is converted into the column's type.
+enum class column_kind {
+    text,
+    bigint,
+    bigint_via_real,
+    bigint_via_real_zero_is_null,
+    int_via_real,
+    real,
+    real_zero_is_null,
+    dbl,
+    date,
+    time,
+    real_array,
+    dbl_array,
+    int_array,
+};
+
+struct refresh_column {
+    std::string name;
+    column_kind kind;
+};
+
+//The columns that are refreshed. Non-DICOM metadata and 'pacsid' are skipped.
+static const std::vector<refresh_column> refresh_columns = {
+        //DICOM logical hierarchy fields.
+        { "PatientID",                      column_kind::text },
+        { "StudyInstanceUID",               column_kind::text },
+        { "SeriesInstanceUID",              column_kind::text },
+        { "SOPInstanceUID",                 column_kind::text },
+        //DICOM data collection, additional or fallback linkage metadata.
+        { "InstanceNumber",                 column_kind::bigint },
+        { "InstanceCreationDate",           column_kind::date },
+        { "InstanceCreationTime",           column_kind::time },
+        { "StudyDate",                      column_kind::date },
+        { "StudyTime",                      column_kind::time },
+        { "StudyID",                        column_kind::text },
+        { "StudyDescription",               column_kind::text },
+        { "SeriesDate",                     column_kind::date },
+        { "SeriesTime",                     column_kind::time },
+        { "SeriesNumber",                   column_kind::bigint_via_real },
+        { "SeriesDescription",              column_kind::text },
+        { "AcquisitionDate",                column_kind::date },
+        { "AcquisitionTime",                column_kind::time },
+        { "AcquisitionNumber",              column_kind::bigint_via_real },
+        { "ContentDate",                    column_kind::date },
+        { "ContentTime",                    column_kind::time },
+        { "BodyPartExamined",               column_kind::text },
+        { "ScanningSequence",               column_kind::text },
+        { "SequenceVariant",                column_kind::text },
+        { "ScanOptions",                    column_kind::text },
+        { "MRAcquisitionType",              column_kind::text },
+        //DICOM image, dose map specifications and metadata.
+        { "SliceThickness",                 column_kind::real },
+        { "SliceNumber",                    column_kind::bigint_via_real },
+        { "SliceLocation",                  column_kind::real_zero_is_null },
+        { "ImageIndex",                     column_kind::bigint_via_real },
+        { "SpacingBetweenSlices",           column_kind::real },
+        { "ImagePositionPatient",           column_kind::real_array },
+        { "ImageOrientationPatient",        column_kind::real_array },
+        { "FrameOfReferenceUID",            column_kind::text },
+        { "PositionReferenceIndicator",     column_kind::text },
+        { "SamplesPerPixel",                column_kind::int_via_real },
+        { "PhotometricInterpretation",      column_kind::text },
+        { "NumberofFrames",                 column_kind::int_via_real },
+        { "FrameIncrementPointer",          column_kind::int_array },
+        { "Rows",                           column_kind::int_via_real },
+        { "Columns",                        column_kind::int_via_real },
+        { "PixelSpacing",                   column_kind::real_array },
+        { "BitsAllocated",                  column_kind::int_via_real },
+        { "BitsStored",                     column_kind::int_via_real },
+        { "HighBit",                        column_kind::int_via_real },
+        { "PixelRepresentation",            column_kind::int_via_real },
+        { "DoseUnits",                      column_kind::text },
+        { "DoseType",                       column_kind::text },
+        { "DoseSummationType",              column_kind::text },
+        { "DoseGridScaling",                column_kind::real },
+        { "GridFrameOffsetVector",          column_kind::real_array },
+        { "TemporalPositionIdentifier",     column_kind::int_via_real },
+        { "NumberofTemporalPositions",      column_kind::int_via_real },
+        { "TemporalResolution",             column_kind::real },
+        { "TemporalPositionIndex",          column_kind::int_via_real },
+        { "FrameReferenceTime",             column_kind::bigint_via_real_zero_is_null }, //Not a true time. Integer number of msec.
+        { "FrameTime",                      column_kind::bigint_via_real },
+        { "TriggerTime",                    column_kind::bigint_via_real },
+        { "TriggerTimeOffset",              column_kind::bigint_via_real },
+        { "PerformedProcedureStepStartDate",  column_kind::date },
+        { "PerformedProcedureStepStartTime",  column_kind::time },
+        { "PerformedProcedureStepEndDate",  column_kind::date },
+        { "PerformedProcedureStepEndTime",  column_kind::time },
+        { "Exposure",                       column_kind::real },
+        { "ExposureTime",                   column_kind::real },
+        { "ExposureInMicroAmpereSeconds",   column_kind::real },
+        { "XRayTubeCurrent",                column_kind::real },
+        { "RepetitionTime",                 column_kind::dbl },
+        { "EchoTime",                       column_kind::real },
+        { "NumberofAverages",               column_kind::dbl },
+        { "ImagingFrequency",               column_kind::dbl },
+        { "ImagedNucleus",                  column_kind::text },
+        { "EchoNumbers",                    column_kind::dbl },
+        { "MagneticFieldStrength",          column_kind::real },
+        { "NumberofPhaseEncodingSteps",     column_kind::dbl },
+        { "EchoTrainLength",                column_kind::dbl },
+        { "PercentSampling",                column_kind::dbl },
+        { "PercentPhaseFieldofView",        column_kind::dbl },
+        { "PixelBandwidth",                 column_kind::real },
+        { "DeviceSerialNumber",             column_kind::text },
+        { "ProtocolName",                   column_kind::text },
+        { "ReceiveCoilName",                column_kind::text },
+        { "TransmitCoilName",               column_kind::text },
+        { "InplanePhaseEncodingDirection",  column_kind::text },
+        { "FlipAngle",                      column_kind::real },
+        { "SAR",                            column_kind::dbl },
+        { "dB_dt",                          column_kind::dbl },
+        { "PatientPosition",                column_kind::text },
+        { "AcquisitionDuration",            column_kind::dbl },
+        { "Diffusion_bValue",               column_kind::dbl },
+        { "DiffusionGradientOrientation",   column_kind::dbl_array },
+        { "DiffusionDirection",             column_kind::text },
+        { "WindowCenter",                   column_kind::dbl },
+        { "WindowWidth",                    column_kind::dbl },
+        { "RescaleIntercept",               column_kind::dbl },
+        { "RescaleSlope",                   column_kind::dbl },
+        { "RescaleType",                    column_kind::text },
+        //DICOM radiotherapy plan metadata.
+        { "RTPlanLabel",                    column_kind::text },
+        { "RTPlanName",                     column_kind::text },
+        { "RTPlanDescription",              column_kind::text },
+        { "RTPlanDate",                     column_kind::date },
+        { "RTPlanTime",                     column_kind::time },
+        { "RTPlanGeometry",                 column_kind::text },
+        //DICOM patient, physician, operator metadata.
+        { "PatientsName",                   column_kind::text },
+        { "PatientsBirthDate",              column_kind::date },
+        { "PatientsGender",                 column_kind::text },
+        { "PatientsWeight",                 column_kind::real },
+        { "OperatorsName",                  column_kind::text },
+        { "ReferringPhysicianName",         column_kind::text },
+        //DICOM categorical fields.
+        { "SOPClassUID",                    column_kind::text },
+        { "Modality",                       column_kind::text },
+        //DICOM machine/device, institution fields.
+        { "Manufacturer",                   column_kind::text },
+        { "StationName",                    column_kind::text },
+        { "ManufacturersModelName",         column_kind::text },
+        { "SoftwareVersions",               column_kind::text },
+        { "InstitutionName",                column_kind::text },
+        { "InstitutionalDepartmentName",    column_kind::text },
+        //Non-DICOM metadata fields.
+        // - skipping "Project"
+        // - skipping "Comments"
+        // - skipping "FullPathName"
+        // - skipping "gdcmdump"
+        // - skipping "ImportTimepoint"
+};
+
+static bool is_array_kind(column_kind k){
+    return (k == column_kind::real_array)
+        || (k == column_kind::dbl_array)
+        || (k == column_kind::int_array);
+}
+
+//Converts the staged text (or text array) expression 'src' into the column's type. In some cases we cast to a REAL
+// before an INT. This is because I've encountered INT fields printed in strings or reported by Imebra as '16.0000'
+// which PostgreSQL doesn't like. Casting to REAL and then INT is a logical workaround.
+static std::string conversion_expr(column_kind k, const std::string &src){
+    const std::string null_if_empty = " NULLIF( " + src + " ,'') ";
+    switch(k){
+        case column_kind::text:                         return null_if_empty;
+        case column_kind::bigint:                       return " CAST( " + null_if_empty + " AS BIGINT) ";
+        case column_kind::bigint_via_real:              return " CAST( CAST( " + null_if_empty + " AS REAL) AS BIGINT) ";
+        case column_kind::bigint_via_real_zero_is_null: return " CAST( CAST( NULLIF( " + null_if_empty + " ,'0') AS REAL) AS BIGINT) ";
+        case column_kind::int_via_real:                 return " CAST( CAST( " + null_if_empty + " AS REAL) AS INT) ";
+        case column_kind::real:                         return " CAST( " + null_if_empty + " AS REAL) ";
+        case column_kind::real_zero_is_null:            return " CAST( NULLIF( " + null_if_empty + " ,'0') AS REAL) ";
+        case column_kind::dbl:                          return " CAST( " + null_if_empty + " AS DOUBLE PRECISION) ";
+        case column_kind::date:                         return " CAST( NULLIF( " + null_if_empty + " ,'0000-00-00') AS DATE) ";
+        case column_kind::time:                         return " CAST( " + null_if_empty + " AS TIME) ";
+        case column_kind::real_array:                   return " CAST( " + src + " AS REAL[]) ";
+        case column_kind::dbl_array:                    return " CAST( CAST( " + src + " AS REAL[]) AS DOUBLE PRECISION[]) ";
+        case column_kind::int_array:                    return " CAST( CAST( " + src + " AS REAL[]) AS INT[]) ";
+    }
+    throw std::logic_error("Unrecognized column kind. Cannot continue.");
+}
+
+//A record selected for refreshing.
+struct refresh_record {
+    long int pacsid = -1;
+    std::string storefullpathname;
+
+    bool previously_refreshed = false;
+    bool has_content_hash = false;
+    int64_t previous_mtime = 0;
+    int64_t previous_size = 0;
+
+    int64_t mtime = 0;
+    int64_t size = 0;
+
+    bool unchanged = false;   //The file has not changed since it was last refreshed.
+    std::string error;        //Non-empty if the file could not be inspected or parsed.
+    std::map<std::string,std::string> mmap;
+    std::string content_hash;
+};
+
 int main(int argc, char* argv[]){
 //---------------------------------------------------------------------------------------------------------------------
 //------------------------------------------- Instances used throughout -----------------------------------------------
@@ -32,6 +249,10 @@ int main(int argc, char* argv[]){
 
     long int NumberOfDaysRecent = 7; //Only update records imported within the specified days.
 
+    long int BatchSize = 1000; //The number of records parsed and updated per transaction.
+
+    bool RefreshUnchanged = false; //Whether to refresh records even if the file has not changed since the last refresh.
+
 //---------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------ Option parsing -----------------------------------------------------
 //---------------------------------------------------------------------------------------------------------------------
@@ -39,7 +260,8 @@ int main(int argc, char* argv[]){
 
     class ArgumentHandler arger;
     const std::string progname(argv[0]);
-    arger.examples = { { "--help" , "Show the help screen and some info about the program." } };
+    arger.examples = { { "--help" , "Show the help screen and some info about the program." },
+                       { "-d 7 -a" , "Refresh all records imported within the last week, even if previously refreshed." } };
     arger.description = "A program for trying to replace database NULLs, if possible.";
 
     arger.default_callback = [](int, const std::string &optarg) -> void {
@@ -60,6 +282,25 @@ int main(int argc, char* argv[]){
       })
     );
 
+    arger.push_back( ygor_arg_handlr_t(1, 's', "batch-size", true, Xtostring(BatchSize), 
+      "The number of records to parse and update per transaction.",
+      [&](const std::string &optarg) -> void {
+        if(!Is_String_An_X<long int>(optarg)) FUNCERR("'" << optarg << "' is not a valid batch size");
+        BatchSize = stringtoX<long int>(optarg);
+        if(BatchSize < 1) FUNCERR("Batch size must be positive");
+        return;
+      })
+    );
+
+    arger.push_back( ygor_arg_handlr_t(1, 'a', "all", false, "", 
+      "Refresh records even if their file has not been modified since the last refresh."
+      " (Files are considered unmodified if their modification time and size are unchanged.)",
+      [&](const std::string &) -> void {
+        RefreshUnchanged = true;
+        return;
+      })
+    );
+
     arger.Launch(argc, argv);
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -74,650 +315,214 @@ int main(int argc, char* argv[]){
 //----------------------------------------------- Database Initiation -------------------------------------------------
 //---------------------------------------------------------------------------------------------------------------------
  
+    size_t N_updated = 0;
+    size_t N_unchanged = 0;
+    size_t N_failed = 0;
+
     try{
         pqxx::connection c(db_params);
-        pqxx::work txn(c);
-        std::stringstream tb1, tb2;
+
+        //-------------------------------------------------------------------------------------------------------------
+        //Prepare the tables used for tracking and staging. The staging table only lives as long as this connection and
+        // is emptied after each batch.
+        {
+            pqxx::work txn(c);
+            PACS_Ensure_Content_Hash_Column(txn);
+            txn.exec("CREATE TABLE IF NOT EXISTS metadata_refresh ( "
+                     "    pacsid      BIGINT PRIMARY KEY, "
+                     "    FileMTime   BIGINT, "
+                     "    FileSize    BIGINT, "
+                     "    RefreshTimepoint TIMESTAMP "
+                     ");");
+
+            std::stringstream ss;
+            ss << "CREATE TEMPORARY TABLE refresh_stage ( ";
+            ss << "    pacsid BIGINT, ";
+            ss << "    FileMTime BIGINT, ";
+            ss << "    FileSize BIGINT, ";
+            ss << "    ContentHash TEXT";
+            for(const auto &col : refresh_columns){
+                ss << ", " << col.name << (is_array_kind(col.kind) ? " TEXT[]" : " TEXT");
+            }
+            ss << ") ON COMMIT DELETE ROWS;";
+            txn.exec(ss.str());
+            txn.commit();
+        }
+
+        //Apply the staged metadata. Existing values are not altered; only NULLs are replaced. The content hash is always
+        // replaced since it reflects the file as it currently exists.
+        std::string apply_update;
+        {
+            std::stringstream ss;
+            ss << "UPDATE metadata SET ContentHash = refresh_stage.ContentHash";
+            for(const auto &col : refresh_columns){
+                ss << ", " << col.name << " = COALESCE(metadata." << col.name << ", "
+                   << conversion_expr(col.kind, "refresh_stage." + col.name) << ")";
+            }
+            ss << " FROM refresh_stage WHERE (metadata.pacsid = refresh_stage.pacsid);";
+            apply_update = ss.str();
+        }
+        const std::string record_refresh = 
+            "INSERT INTO metadata_refresh (pacsid, FileMTime, FileSize, RefreshTimepoint) "
+            "    SELECT pacsid, FileMTime, FileSize, now() FROM refresh_stage "
+            "ON CONFLICT (pacsid) DO UPDATE SET "
+            "    FileMTime = EXCLUDED.FileMTime, "
+            "    FileSize = EXCLUDED.FileSize, "
+            "    RefreshTimepoint = EXCLUDED.RefreshTimepoint;";
 
         //-------------------------------------------------------------------------------------------------------------
         //Select records from the system pacs database.
         
-        pqxx::result r1;
+        std::vector<refresh_record> records;
         {
-          std::stringstream ss;
-          ss << "SELECT * FROM metadata "
-             << "WHERE (metadata.ImportTimepoint > (now() - INTERVAL '" << NumberOfDaysRecent << " days'));"; 
-          r1 = txn.exec(ss.str());
+            pqxx::work txn(c);
+            std::stringstream ss;
+            ss << "SELECT metadata.pacsid, metadata.StoreFullPathName, (metadata.ContentHash IS NOT NULL) AS HasContentHash, "
+               << "       metadata_refresh.FileMTime, metadata_refresh.FileSize "
+               << "FROM metadata LEFT JOIN metadata_refresh ON (metadata_refresh.pacsid = metadata.pacsid) "
+               << "WHERE (metadata.ImportTimepoint > (now() - INTERVAL '" << NumberOfDaysRecent << " days')) "
+               << "ORDER BY metadata.pacsid;"; 
+            pqxx::result r1 = txn.exec(ss.str());
+            if(r1.empty()) FUNCERR("Database table 'metadata' contains no records. Nothing to do");
+            FUNCINFO("Found " << r1.size() << " records to inspect");
+
+            records.resize(r1.size());
+            for(pqxx::result::size_type i = 0; i != r1.size(); ++i){
+                auto &rec = records[i];
+                rec.pacsid = r1[i]["pacsid"].as<long int>();
+                rec.storefullpathname = r1[i]["StoreFullPathName"].as<std::string>();
+                rec.has_content_hash = r1[i]["HasContentHash"].as<bool>();
+                if(!r1[i]["FileMTime"].is_null() && !r1[i]["FileSize"].is_null()){
+                    rec.previously_refreshed = true;
+                    rec.previous_mtime = r1[i]["FileMTime"].as<int64_t>();
+                    rec.previous_size = r1[i]["FileSize"].as<int64_t>();
+                }
+            }
         }
-        if(r1.empty()) FUNCERR("Database table 'metadata' contains no records. Nothing to do");
-        FUNCINFO("Found " << r1.size() << " records to inspect");
 
         //-------------------------------------------------------------------------------------------------------------
-        //Process each record, parsing the file, saving metadata, and walking over the columns to see if they are null.
-        for(pqxx::result::size_type i = 0; i != r1.size(); ++i){
-            //Get the returned pacsid.
-            const auto pacsid = r1[i]["pacsid"].as<long int>();
-
-            //Get the store filename and check if the file has been validated.
-            const auto storefullpathname = r1[i]["StoreFullPathName"].as<std::string>();
-
-            // TODO: if checksum non-NULL, verify it is correct. Fail with lots of info if not correct!
-            //       if checksum is NULL, compute it and update the db.
+        //Process the records in batches, parsing the files in parallel and then updating all records at once.
+        const auto t_start = std::chrono::steady_clock::now();
+        const size_t N_records = records.size();
+        for(size_t b_begin = 0; b_begin < N_records; b_begin += static_cast<size_t>(BatchSize)){
+            const size_t b_end = std::min(N_records, b_begin + static_cast<size_t>(BatchSize));
+
+            parallel_for(b_begin, b_end, [&](size_t i) -> void {
+                auto &rec = records[i];
+                try{
+                    const boost::filesystem::path p(rec.storefullpathname);
+                    rec.mtime = static_cast<int64_t>(boost::filesystem::last_write_time(p));
+                    rec.size = static_cast<int64_t>(boost::filesystem::file_size(p));
+                    rec.unchanged = !RefreshUnchanged
+                                 && rec.previously_refreshed
+                                 && rec.has_content_hash
+                                 && (rec.previous_mtime == rec.mtime)
+                                 && (rec.previous_size == rec.size);
+                    if(rec.unchanged) return;
+
+                    rec.content_hash = PACS_Content_Hash(rec.storefullpathname);
+
+                    //Harvest the metadata of interest.
+                    rec.mmap = get_metadata_top_level_tags(rec.storefullpathname);
+                    if(rec.mmap.empty()) rec.error = "Unable to parse file";
+                }catch(const std::exception &e){
+                    rec.error = e.what();
+                }
+                return;
+            }, 1);
 
-            //Print to screen what the original filename was, so the user can inspect what files are being processed.
-            FUNCINFO("About to parse file with pacsid = " << pacsid << " at location '" << storefullpathname << "'");
-            FUNCINFO("Completion: " << i << "/" << r1.size() << " == " << static_cast<double>(10000*i/r1.size())/100.0 << "%");
+            pqxx::work txn(c);
 
-            //Harvest the metadata of interest.
-            auto mmap = get_metadata_top_level_tags(storefullpathname);
+            //Stage the raw metadata, several records per statement.
+            const auto stage_value = [&](const refresh_column &col, const std::map<std::string,std::string> &mmap) -> std::string {
+                const auto it = mmap.find(col.name);
+                const std::string raw = (it == mmap.end()) ? "" : it->second;
+                if(!is_array_kind(col.kind)) return txn.quote(raw);
 
-            //Generate some conveniences for later.
-            pqxx::result r3;
-            const auto update_boilerplate = [&](const std::string &colname, const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " UPDATE metadata ";
-                ss << " SET (" << colname << ") ";
-                ss << " = (COALESCE(" << colname << "," << value << ")) ";  //Avoid changing if something is already present.
-                ss << " WHERE pacsid = " << pacsid << " ";
-                ss << " RETURNING pacsid; ";
-                return ss.str();
-            };
-            const auto check_update_ok = [&](const std::string &colname) -> void {
-                if((r3.size() != 1) || (r3[0]["pacsid"].as<long int>() != pacsid)){
-                    FUNCERR("Update of column name '" << colname << "' failed. Refusing to continue");
-                }
-                return;
-            };
-            const auto null_if_empty_str = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " NULLIF( " << value << " ,'') ";
-                return ss.str();
-            };
-            const auto null_if_given_str = [](const std::string &value, const std::string &given) -> std::string {
-                std::stringstream ss;
-                ss << " NULLIF( " << value << " , " << given << " ) ";
-                return ss.str();
-            };
-            const auto cast_to_bigint = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " CAST( " << value << " AS BIGINT) ";
-                return ss.str();
-            };
-            const auto cast_to_int = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " CAST( " << value << " AS INT) ";
-                return ss.str();
-            };
-            const auto cast_to_real = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " CAST( " << value << " AS REAL) ";
-                return ss.str();
-            };
-            const auto cast_to_double = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " CAST( " << value << " AS DOUBLE PRECISION) ";
-                return ss.str();
-            };
-            const auto cast_to_date = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " CAST( " << value << " AS DATE) ";
-                return ss.str();
-            };
-            const auto cast_to_time = [](const std::string &value) -> std::string {
-                std::stringstream ss;
-                ss << " CAST( " << value << " AS TIME) ";
-                return ss.str();
-            };
-            const auto dicom_string_to_real_array = [&](const std::string &values) -> std::string {
-                auto tokens = SplitStringToVector(values, '\\', 'd');
-                bool first = true;
-                std::stringstream ss;
-                ss << " CAST( ARRAY[ ";
-                for(auto &x : tokens){
-                    if(!first) ss << " , ";
-                    first = false;
-                    ss << cast_to_real( null_if_empty_str( txn.quote(x) ) );
-                }
-                ss << " ] AS REAL[]) ";
-                return ss.str();
-            };
-            const auto dicom_string_to_double_array = [&](const std::string &values) -> std::string {
-                auto tokens = SplitStringToVector(values, '\\', 'd');
-                bool first = true;
+                auto tokens = SplitStringToVector(raw, '\\', 'd');
                 std::stringstream ss;
                 ss << " CAST( ARRAY[ ";
-                for(auto &x : tokens){
-                    if(!first) ss << " , ";
-                    first = false;
-                    ss << cast_to_real( null_if_empty_str( txn.quote(x) ) );
-                }
-                ss << " ] AS DOUBLE PRECISION[]) ";
-                return ss.str();
-            };
-            const auto dicom_string_to_int_array = [&](const std::string &values) -> std::string {
-                auto tokens = SplitStringToVector(values, '\\', 'd');
                 bool first = true;
-                std::stringstream ss;
-                ss << " CAST( ARRAY[ ";
                 for(auto &x : tokens){
                     if(!first) ss << " , ";
                     first = false;
-                    ss << cast_to_int( cast_to_real( null_if_empty_str( txn.quote(x) ) ) );
+                    ss << (x.empty() ? "NULL" : txn.quote(x));
                 }
-                ss << " ] AS INT[]) ";
+                ss << " ] AS TEXT[]) ";
                 return ss.str();
             };
-            std::string colname, value;
 
-            //---------------------------------------------------------------------------------------------------------
-            //Push the data to the database.
-
-            //skipping "pacsid". (If it is NULL we could not have found it!)
-
-            //DICOM logical hierarchy fields.
-            colname = "PatientID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "StudyInstanceUID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SeriesInstanceUID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SOPInstanceUID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //DICOM data collection, additional or fallback linkage metadata.
-            colname = "InstanceNumber";
-            value   = cast_to_bigint( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "InstanceCreationDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            //value   = cast_to_date( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "InstanceCreationTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "StudyDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            //value   = cast_to_date( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "StudyTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "StudyID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "StudyDescription";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SeriesDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            //value   = cast_to_date( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SeriesTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SeriesNumber";
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SeriesDescription";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "AcquisitionDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            //value   = cast_to_date( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "AcquisitionTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "AcquisitionNumber";
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ContentDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            //value   = cast_to_date( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ContentTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "BodyPartExamined";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ScanningSequence";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SequenceVariant";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ScanOptions";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "MRAcquisitionType";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //DICOM image, dose map specifications and metadata.
-            colname = "SliceThickness";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SliceNumber";
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SliceLocation";
-            value   = cast_to_real( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ) , txn.quote("0") ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ImageIndex";
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SpacingBetweenSlices";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ImagePositionPatient";
-            value   = dicom_string_to_real_array( mmap[colname] );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ImageOrientationPatient";
-            value   = dicom_string_to_real_array( mmap[colname] );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "FrameOfReferenceUID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PositionReferenceIndicator";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SamplesPerPixel";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PhotometricInterpretation";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "NumberofFrames";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "FrameIncrementPointer";
-            value   = dicom_string_to_int_array( mmap[colname] );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-
-            colname = "Rows";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "Columns";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PixelSpacing";
-            value   = dicom_string_to_real_array( mmap[colname] );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "BitsAllocated";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "BitsStored";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "HighBit";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PixelRepresentation";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DoseUnits";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DoseType";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DoseSummationType";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DoseGridScaling";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "GridFrameOffsetVector";
-            value   = dicom_string_to_real_array( mmap[colname] );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "TemporalPositionIdentifier";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "NumberofTemporalPositions";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "TemporalResolution";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-
-            colname = "TemporalPositionIndex";
-            value   = cast_to_int( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "FrameReferenceTime"; //Not a true time. Integer number of msec.
-            value   = cast_to_bigint( cast_to_real( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0") ) ) );
-            //value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "FrameTime";
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "TriggerTime";
-            //value   = cast_to_bigint( cast_to_real( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0") ) ) );
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "TriggerTimeOffset";
-            value   = cast_to_bigint( cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PerformedProcedureStepStartDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PerformedProcedureStepStartTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PerformedProcedureStepEndDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PerformedProcedureStepEndTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "Exposure";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ExposureTime";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ExposureInMicroAmpereSeconds";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "XRayTubeCurrent";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RepetitionTime";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "EchoTime";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "NumberofAverages";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ImagingFrequency";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ImagedNucleus";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "EchoNumbers";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "MagneticFieldStrength";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "NumberofPhaseEncodingSteps";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-
-            colname = "EchoTrainLength";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PercentSampling";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PercentPhaseFieldofView";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PixelBandwidth";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DeviceSerialNumber";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ProtocolName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ReceiveCoilName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "TransmitCoilName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "InplanePhaseEncodingDirection";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "FlipAngle";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SAR";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "dB_dt";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
+            size_t N_staged = 0;
+            size_t N_pending = 0;
+            std::stringstream ss;
+            const auto flush_stage = [&]() -> void {
+                if(N_pending == 0) return;
+                ss << ";";
+                txn.exec(ss.str());
+                ss.str("");
+                N_pending = 0;
+            };
+            for(size_t i = b_begin; i < b_end; ++i){
+                auto &rec = records[i];
+                if(rec.unchanged){
+                    ++N_unchanged;
+                    continue;
+                }
+                if(!rec.error.empty()){
+                    FUNCWARN("Unable to refresh record with pacsid = " << rec.pacsid
+                             << " at location '" << rec.storefullpathname << "': " << rec.error);
+                    ++N_failed;
+                    continue;
+                }
 
-            colname = "PatientPosition";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "AcquisitionDuration";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "Diffusion_bValue";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DiffusionGradientOrientation";
-            value   = dicom_string_to_double_array( mmap[colname] );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "DiffusionDirection";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "WindowCenter";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "WindowWidth";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RescaleIntercept";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RescaleSlope";
-            value   = cast_to_double( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RescaleType";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //DICOM radiotherapy plan metadata.
-            colname = "RTPlanLabel";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RTPlanName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RTPlanDescription";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RTPlanDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            //value   = cast_to_date( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RTPlanTime";
-            value   = cast_to_time( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "RTPlanGeometry";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //DICOM patient, physician, operator metadata.
-            colname = "PatientsName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PatientsBirthDate";
-            value   = cast_to_date( null_if_given_str( null_if_empty_str( txn.quote(mmap[colname]) ), txn.quote("0000-00-00")) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PatientsGender";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "PatientsWeight";
-            value   = cast_to_real( null_if_empty_str( txn.quote(mmap[colname]) ) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "OperatorsName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ReferringPhysicianName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //DICOM categorical fields.
-            colname = "SOPClassUID";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "Modality";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //DICOM machine/device, institution fields.
-            colname = "Manufacturer";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "StationName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "ManufacturersModelName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "SoftwareVersions";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "InstitutionName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            colname = "InstitutionalDepartmentName";
-            value   = null_if_empty_str( txn.quote(mmap[colname]) );
-            r3 = txn.exec(update_boilerplate(colname, value));            check_update_ok(colname);
-
-            //Non-DICOM metadata fields.
-            // - skipping "Project"
-            // - skipping "Comments"
-            // - skipping "FullPathName"
-            // - skipping "gdcmdump"
-            // - skipping "ImportTimepoint"
-
-            //---------------------------------------------------------------------------------------------------------
+                if(N_pending == 0){
+                    ss << "INSERT INTO refresh_stage (pacsid, FileMTime, FileSize, ContentHash";
+                    for(const auto &col : refresh_columns) ss << ", " << col.name;
+                    ss << ") VALUES ";
+                }else{
+                    ss << ", ";
+                }
+                ss << "(" << rec.pacsid << ", " << rec.mtime << ", " << rec.size << ", " << txn.quote(rec.content_hash);
+                for(const auto &col : refresh_columns) ss << ", " << stage_value(col, rec.mmap);
+                ss << ")";
+
+                rec.mmap.clear();
+                ++N_staged;
+                if(100 <= ++N_pending) flush_stage();
+            }
+            flush_stage();
+
+            if(N_staged != 0){
+                pqxx::result r3 = txn.exec(apply_update);
+                if(static_cast<size_t>(r3.affected_rows()) != N_staged){
+                    FUNCERR("Update affected " << r3.affected_rows() << " records, but " << N_staged
+                            << " were expected. Refusing to continue");
+                }
+                txn.exec(record_refresh);
+            }
+
+            //Commit each batch so an interrupted refresh can be resumed.
+            txn.commit();
+            N_updated += N_staged;
+
+            const auto t_now = std::chrono::steady_clock::now();
+            const double elapsed = std::chrono::duration<double>(t_now - t_start).count();
+            FUNCINFO("Completion: " << b_end << "/" << N_records << " == "
+                     << static_cast<double>(10000*b_end/N_records)/100.0 << "%"
+                     << " (" << static_cast<double>(b_end) / std::max(elapsed, 1.0E-9) << " records/s)");
         }
 
-        //-------------------------------------------------------------------------------------------------------------
-        //Finish the transaction and drop the connection.
-        txn.commit();
-
     }catch(const std::exception &e){
         FUNCERR("Unable to push to database: " << e.what());
     }
 
+    FUNCINFO("Refreshed " << N_updated << " records, skipped " << N_unchanged
+             << " unchanged records, and failed to refresh " << N_failed << " records");
+
 //---------------------------------------------------------------------------------------------------------------------
 //---------------------------------------------------- Cleanup --------------------------------------------------------
 //---------------------------------------------------------------------------------------------------------------------
     //Attempt to delete the DICOMTempFile if it exists.
     // Probably safest NOT to attempt to delete it until I have a safer interface (std::filesystem).
-    return 0;
+    return (N_failed == 0) ? 0 : 1;
 }
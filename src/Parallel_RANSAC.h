@@ -0,0 +1,151 @@
+//Parallel_RANSAC.h.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Thread_Pool.h"
+
+
+// Derives the random seed for a single RANSAC trial.
+//
+// Every trial receives its own stream, derived only from the user-provided seed and the trial number, so the outcome of
+// a trial does not depend on which thread executes it or on the order in which trials are executed. A SplitMix64
+// finalizer is used so that adjacent trial numbers produce uncorrelated streams.
+inline uint64_t
+RANSAC_Trial_Seed(uint64_t base_seed, uint64_t trial){
+    uint64_t z = base_seed + 0x9E3779B97F4A7C15ULL * (trial + 1ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+struct Parallel_RANSAC_Params {
+    // Seed for the per-trial random number generator streams.
+    uint64_t random_seed = 0;
+
+    // The number of trials that must succeed. Failed trials are retried (using a new trial number) until this many
+    // trials have succeeded or the number of failures exceeds the limit below, in which case an exception is thrown.
+    long int max_trials = 100;
+    long int max_failures = 100;
+
+    // Trials are launched in batches of (at most) this many trials. Batches are reduced in trial order before the next
+    // batch is launched, so the batch size (and NOT the number of threads) determines which trials are performed.
+    // Larger batches expose more parallelism, but the incumbent model (see below) is updated less frequently.
+    long int batch_size = 32;
+
+    // The maximum number of trials that execute concurrently, e.g., to bound the memory used by trials. Zero means no
+    // limit beyond the scheduler's thread cap. This does not affect which trials are performed or the returned model.
+    long int max_concurrency = 0;
+
+    // Early termination. No further batches are launched once a model with a score at or below this is found.
+    double acceptable_score = -std::numeric_limits<double>::infinity();
+};
+
+
+// State provided to each trial.
+template <class M>
+struct Parallel_RANSAC_Trial {
+    long int trial = 0;    // The trial number. Unique for every invocation.
+    std::mt19937 re;       // A random number generator stream dedicated to this trial.
+
+    // The best model found in previously completed batches, or nullptr if there is none. It is constant for all trials
+    // in a batch, so it can be used to seed the trial deterministically.
+    const M *incumbent = nullptr;
+
+    // The best score reported by any trial so far, including trials still running in the current batch.
+    const std::atomic<double> *best_score = nullptr;
+
+    // Whether a trial can stop early. This should only be used with a partial score that can only increase as the trial
+    // continues, so that an abandoned trial could not have produced the best model. Under this condition the selected
+    // model is unaffected by timing, even though the shared score is.
+    bool can_abandon(double partial_score) const {
+        return (best_score != nullptr)
+            && (best_score->load() < partial_score);
+    }
+};
+
+
+// Executes independent RANSAC trials in parallel, returning the model with the lowest score.
+//
+// The trial functor has the signature
+//
+//   std::optional<std::pair<M, double>> f(Parallel_RANSAC_Trial<M> &);
+//
+// and returns the fitted model and its score (lower is better), or std::nullopt if the trial failed. Abandoned trials
+// should return a non-finite score; they count as successful trials but are never selected.
+//
+// Results are reduced in trial order with ties favouring the earlier trial, so the returned model is identical
+// regardless of the number of threads. std::nullopt is returned if no trial produced a finite score.
+template <class M, class F>
+std::optional<std::pair<M, double>>
+Parallel_RANSAC(const Parallel_RANSAC_Params &params, F f){
+    if(params.max_trials <= 0) return std::nullopt;
+    const auto batch_size = std::max<long int>(1L, params.batch_size);
+
+    std::optional<std::pair<M, double>> best;
+    std::atomic<double> best_score( std::numeric_limits<double>::infinity() );
+
+    long int next_trial = 0;
+    long int N_successes = 0;
+    long int N_failures = 0;
+    while(N_successes < params.max_trials){
+        // Do not launch more trials than are needed, so the number of successful trials is exact.
+        const auto N_batch = std::min(batch_size, params.max_trials - N_successes);
+        std::vector<std::optional<std::pair<M, double>>> results(N_batch);
+
+        // Trials are executed in at most 'max_concurrency' chunks, each of which runs its trials serially.
+        const auto grain = (0 < params.max_concurrency) ? (N_batch + params.max_concurrency - 1) / params.max_concurrency
+                                                        : 1L;
+
+        parallel_for(0, N_batch, [&](size_t i) -> void {
+            Parallel_RANSAC_Trial<M> t;
+            t.trial = next_trial + static_cast<long int>(i);
+            t.re.seed( static_cast<std::mt19937::result_type>( RANSAC_Trial_Seed(params.random_seed, t.trial) ) );
+            t.incumbent = (best) ? &(best->first) : nullptr;
+            t.best_score = &best_score;
+
+            results[i] = f(t);
+
+            if( results[i]
+            &&  std::isfinite(results[i]->second) ){
+                double current = best_score.load();
+                while( (results[i]->second < current)
+                   &&  !best_score.compare_exchange_weak(current, results[i]->second) ){ }
+            }
+        }, static_cast<size_t>(grain));
+        next_trial += N_batch;
+
+        for(auto &r : results){
+            if(!r){
+                ++N_failures;
+                if(params.max_failures < N_failures){
+                    throw std::runtime_error("Encountered too many RANSAC failures. Cannot continue.");
+                }
+                continue;
+            }
+            ++N_successes;
+            if( std::isfinite(r->second)
+            &&  (!best || (r->second < best->second)) ){
+                best = std::move(r);
+            }
+        }
+
+        if( best
+        &&  (best->second <= params.acceptable_score) ){
+            break;
+        }
+    }
+    return best;
+}
+
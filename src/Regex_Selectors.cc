@@ -993,4 +993,35 @@ OperationArgDoc T3WhitelistOpArgDoc(){
     return out;
 }
 
+// Utility function documenting an optional transform selection that supersedes an operation's explicit transformation.
+OperationArgDoc T3OverrideOpArgDoc(){
+    OperationArgDoc out = T3WhitelistOpArgDoc();
+
+    out.default_val = "none";
+    out.desc = "A stored transformation (e.g., a thin-plate spline deformation) that will be applied"
+               " instead of the 'Transform' parameter, which is ignored when a transformation is"
+               " selected. "_s
+             + out.desc;
+
+    return out;
+}
+
+// Utility function documenting the tolerance of displacement fields used to apply selected transforms.
+OperationArgDoc T3FieldToleranceOpArgDoc(){
+    OperationArgDoc out;
+
+    out.name = "FieldTolerance";
+    out.desc = "Thin-plate spline transformations are applied via a displacement field that is sampled"
+               " once on a regular lattice and interpolated trilinearly, which is much faster than"
+               " evaluating the spline directly. The lattice is refined until the estimated"
+               " interpolation error is below this tolerance (in DICOM units; mm). The error is estimated"
+               " from a sample of lattice cell centres, so it is not a strict bound. Smaller values are"
+               " more accurate, but require more memory and time to sample the field.";
+    out.default_val = "0.1";
+    out.expected = true;
+    out.examples = { "1.0", "0.1", "0.01" };
+
+    return out;
+}
+
 
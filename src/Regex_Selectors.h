@@ -265,4 +265,10 @@ Whitelist( std::list<std::list<std::shared_ptr<Transform3>>::iterator> lss,
 // Utility function documenting the transform whitelist routines for operations.
 OperationArgDoc T3WhitelistOpArgDoc();
 
+// Utility function documenting an optional transform selection that supersedes an operation's explicit transformation.
+OperationArgDoc T3OverrideOpArgDoc();
+
+// Utility function documenting the tolerance of displacement fields used to apply selected transforms.
+OperationArgDoc T3FieldToleranceOpArgDoc();
+
 
@@ -30,6 +30,7 @@
 
 #include "Structs.h"
 #include "Dose_Meld.h"
+#include "Dose_Volume_Stats.h"
 
 //This is a mapping from the segmentation history to a human-readable description.
 // Try avoid using commas or tabs to make dumping as csv easier. This should in
@@ -1027,6 +1028,8 @@ Drover::Drover() = default;
 
 Drover::Drover( const Drover &in ) = default;
 
+Drover::Drover( Drover &&in ) noexcept = default;
+
 //Member functions.
 void Drover::operator=(const Drover &rhs){
     if(this != &rhs){
@@ -1041,6 +1044,62 @@ void Drover::operator=(const Drover &rhs){
     return;
 }
 
+void Drover::operator=(Drover &&rhs) noexcept {
+    if(this != &rhs){
+        this->contour_data    = std::move(rhs.contour_data);
+        this->image_data      = std::move(rhs.image_data);
+        this->point_data      = std::move(rhs.point_data);
+        this->smesh_data      = std::move(rhs.smesh_data);
+        this->tplan_data      = std::move(rhs.tplan_data);
+        this->lsamp_data      = std::move(rhs.lsamp_data);
+        this->trans_data      = std::move(rhs.trans_data);
+    }
+    return;
+}
+
+//Computes dose statistics for each contour collection with the single-pass histogram engine. The keys of the
+// returned map are iterators into this->contour_data->ccs, so the same caveats as Drover::Bounded_Dose_Means() apply.
+//
+// Multiple dose arrays are only melded when requested, since extrema are only meaningful for melded dose. Otherwise
+// statistics are computed separately for each dose array, and are provided in the order of the dose arrays. All
+// statistics share the same binning, so they can be merged.
+static std::map<bnded_dose_map_key_t, std::vector<Dose_Volume_Stats>, bnded_dose_map_cmp_func_t>
+Bounded_Dose_Stats(const Drover &DICOM_data, bool meld){
+    auto d = Isolate_Dose_Data(DICOM_data);
+    if(!DICOM_data.Has_Contour_Data() || !d.Has_Image_Data()){
+        FUNCERR("Attempted to use bounded dose routine, but we do not have contours and/or dose");
+    }
+
+    std::list<std::shared_ptr<Image_Array>> dose_data_to_use(d.image_data);
+    if(meld && (dose_data_to_use.size() > 1)){
+        dose_data_to_use = Meld_Image_Data(d.image_data);
+        if(dose_data_to_use.size() != 1){
+            FUNCERR("This routine cannot handle multiple dose data which cannot be melded. This has " << dose_data_to_use.size());
+        }
+    }
+
+    std::vector<std::list<std::reference_wrapper<const planar_image<float,double>>>> dose_arrays;
+    for(const auto &ia_ptr : dose_data_to_use){
+        dose_arrays.emplace_back();
+        for(const auto &img : ia_ptr->imagecoll.images) dose_arrays.back().push_back( std::cref(img) );
+    }
+
+    std::vector<bnded_dose_map_key_t> cc_its;
+    std::vector<std::list<std::reference_wrapper<contour_collection<double>>>> rois;
+    for(auto cc_it = DICOM_data.contour_data->ccs.begin(); cc_it != DICOM_data.contour_data->ccs.end(); ++cc_it){
+        cc_its.push_back(cc_it);
+        rois.push_back({ std::ref(*cc_it) });
+    }
+    const auto stats = Compute_Dose_Volume_Stats(dose_arrays, rois);
+
+    std::map<bnded_dose_map_key_t, std::vector<Dose_Volume_Stats>, bnded_dose_map_cmp_func_t> out(bnded_dose_map_cmp_lambda);
+    for(size_t i = 0; i < cc_its.size(); ++i){
+        auto &v = out[cc_its[i]];
+        for(const auto &array_stats : stats) v.push_back(array_stats[i]);
+    }
+    return out;
+}
+
 void Drover::Bounded_Dose_General( std::list<double> *pixel_doses, 
                                    drover_bnded_dose_bulk_doses_map_t *bulk_doses, //NOTE: similar to pixel_doses but not all grouped together...
                                    drover_bnded_dose_mean_dose_map_t *mean_doses, 
@@ -1101,6 +1160,29 @@ void Drover::Bounded_Dose_General( std::list<double> *pixel_doses,
         //Since we have to normalize them at the end, we have to begin with empty space.
     }
 
+    //Means and extrema do not need individual voxels, so they are computed in a single pass over the dose.
+    if((pixel_doses == nullptr) && (bulk_doses == nullptr) && (pos_doses == nullptr) && (cent_moms == nullptr)){
+        for(const auto &s : Bounded_Dose_Stats(*this, (min_max_doses != nullptr))){
+            //The mean is the sum of the mean dose from each dose array. Dose arrays that do not overlap the contours
+            // do not contribute. If there was no dose present, this is not an error.
+            if(mean_doses != nullptr){
+                double mean = 0.0;
+                for(const auto &a : s.second){
+                    if(a.N_voxels != 0) mean += a.Mean();
+                }
+                (*mean_doses)[s.first] = mean;
+            }
+
+            //Extrema are only computed for melded dose, so there is a single dose array.
+            if(min_max_doses != nullptr){
+                const auto &a = s.second.front();
+                (*min_max_doses)[s.first] = (a.N_voxels == 0) ? std::pair<double,double>(0.0, 0.0)
+                                                              : std::pair<double,double>(a.D_min, a.D_max);
+            }
+        }
+        return;
+    }
+
     std::list<std::shared_ptr<Image_Array>> dose_data_to_use(d.image_data);
     if((min_max_doses != nullptr) && (d.image_data.size() > 1)){ //Only dose data meld when needed. Moments, for instance, probably don't need to be melded!
         dose_data_to_use = Meld_Image_Data(d.image_data);
@@ -1356,24 +1438,17 @@ drover_bnded_dose_min_mean_max_dose_map_t Drover::Bounded_Dose_Min_Mean_Max() co
 
 drover_bnded_dose_min_mean_median_max_dose_map_t Drover::Bounded_Dose_Min_Mean_Median_Max() const {
     //NOTE: See note in Drover::Bounded_Dose_Means() regarding invalidation of this map.
+    //
+    //NOTE: The median is derived from a fine dose histogram, so it is accurate to within a small fraction of the dose
+    //      range rather than exact.
     auto outgoing = drover_bnded_dose_min_mean_median_max_dose_map_factory();
-
-    auto means   = drover_bnded_dose_mean_dose_map_factory();
-    auto minmaxs = drover_bnded_dose_min_max_dose_map_factory();
-    auto bulks   = drover_bnded_dose_bulk_doses_map_factory();
-    this->Bounded_Dose_General(nullptr,&bulks,&means,&minmaxs,nullptr,nullptr,nullptr);
-
-    if(means.size() != minmaxs.size()){
-        FUNCERR("Number of means did not match number of min/maxs. Must have encountered a computational error");
-    }
-
-    for(auto & it : means){
-        const auto theiter = it.first;
-        const auto min    = minmaxs[theiter].first;
-        const auto mean   = it.second;
-        const auto median = Stats::Median(bulks[theiter]);
-        const auto max    = minmaxs[theiter].second;
-        outgoing[theiter] = std::make_tuple(min, mean, median, max);
+    for(const auto &s : Bounded_Dose_Stats(*this, true)){
+        const auto &a = s.second.front();
+        if(a.N_voxels == 0){
+            outgoing[s.first] = std::make_tuple(0.0, 0.0, 0.0, 0.0);
+        }else{
+            outgoing[s.first] = std::make_tuple(a.D_min, a.Mean(), a.Dx(0.5), a.D_max);
+        }
     }
     return outgoing;
 }
@@ -1491,18 +1566,41 @@ Drover Drover::Segment_Contours_Heuristically(const std::function<bool(bnded_dos
 }
 
 std::pair<double,double> Drover::Bounded_Dose_Limits() const {
-    std::list<double> doses;
-    this->Bounded_Dose_General(&doses,nullptr,nullptr,nullptr,nullptr,nullptr,nullptr);
-    if(doses.empty()) return std::pair<double,double>(-1.0,-1.0);
-
-    return std::pair<double,double>(*std::min_element(doses.begin(),doses.end()), *std::max_element(doses.begin(),doses.end()));
+    //Voxels of every dose array are considered individually; dose arrays are not summed.
+    std::pair<double,double> out(-1.0,-1.0);
+    bool found = false;
+    for(const auto &s : Bounded_Dose_Stats(*this, false)){
+        for(const auto &a : s.second){
+            if(a.N_voxels == 0) continue;
+            if(!found){
+                out = std::pair<double,double>(a.D_min, a.D_max);
+                found = true;
+            }else{
+                out.first  = std::min(out.first,  a.D_min);
+                out.second = std::max(out.second, a.D_max);
+            }
+        }
+    }
+    return out;
 }
 
 std::map<double,double>  Drover::Get_DVH() const {
     std::map<double,double> output;
 
-    std::list<double> pixel_doses = this->Bounded_Dose_Bulk_Values();
-    if(pixel_doses.empty()){
+    //All contour collections and dose arrays share the same dose binning, so their histograms can be pooled directly.
+    // As with the bounded dose limits, the voxels of every dose array are considered individually.
+    Dose_Volume_Stats pooled;
+    for(const auto &s : Bounded_Dose_Stats(*this, false)){
+        for(const auto &a : s.second){
+            if(pooled.N_voxels == 0){
+                pooled.D_shift   = a.D_shift;
+                pooled.bin_low   = a.bin_low;
+                pooled.bin_width = a.bin_width;
+            }
+            pooled.Merge(a);
+        }
+    }
+    if(pooled.N_voxels == 0){
         //FUNCERR("Unable to compute DVH: There was no data in the pixel_doses structure!");
         FUNCWARN("Asked to compute DVH when no voxels appear to have any dose. This is physically possible, but please be sure it is what you expected");
         //Could be due to:
@@ -1513,19 +1611,13 @@ std::map<double,double>  Drover::Get_DVH() const {
         return output;
     }
 
-    double cumulative;
+    double frac;
     double test_dose = 0.0;
     do{
-        cumulative = 0.0;
-        for(double & pixel_dose : pixel_doses){
-            if(pixel_dose > test_dose) cumulative += 1.0;
-        }
-
-        const auto dose = test_dose;
-        const auto frac = static_cast<double>(cumulative) / static_cast<double>(pixel_doses.size());
-        output[dose] = frac;
+        frac = pooled.Vx(test_dose);
+        output[test_dose] = frac;
         test_dose += 0.5;
-    }while(cumulative != 0.0);
+    }while(frac != 0.0);
     return output;
 }
 
@@ -1651,12 +1743,12 @@ void Drover::Concatenate(std::list<std::shared_ptr<Transform3>> in){
 
 void Drover::Concatenate(Drover in){
     this->Concatenate(in.contour_data);
-    this->Concatenate(in.image_data);
-    this->Concatenate(in.point_data);
-    this->Concatenate(in.smesh_data);
-    this->Concatenate(in.tplan_data);
-    this->Concatenate(in.lsamp_data);
-    this->Concatenate(in.trans_data);
+    this->Concatenate(std::move(in.image_data));
+    this->Concatenate(std::move(in.point_data));
+    this->Concatenate(std::move(in.smesh_data));
+    this->Concatenate(std::move(in.tplan_data));
+    this->Concatenate(std::move(in.lsamp_data));
+    this->Concatenate(std::move(in.trans_data));
     return;
 }
 
@@ -419,9 +419,11 @@ class Drover {
         //Constructors.
         Drover();
         Drover(const Drover &in);
+        Drover(Drover &&in) noexcept;
     
         //Member functions.
         void operator = (const Drover &rhs);
+        void operator = (Drover &&rhs) noexcept;
         void Bounded_Dose_General( std::list<double> *pixel_doses, 
                                    drover_bnded_dose_bulk_doses_map_t *bulk_doses, //NOTE: Similar to pixel_doses, but not all in a single bunch.
                                    drover_bnded_dose_mean_dose_map_t *mean_doses, 
@@ -2,49 +2,346 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
+#include <utility>
+#include <vector>
 
-#include <asio.hpp>
-#include <boost/thread.hpp> // For class thread_group.
-#include <boost/bind.hpp>
-
-//#include <boost/asio/io_service.hpp>
-//#include <boost/thread/thread.hpp>
 
+// A process-wide, persistent work-stealing scheduler.
+//
+// Workers are created once, on first use, and persist for the remainder of the process. Each worker owns a deque of
+// tasks: it pushes and pops its own tasks at the back, and steals from the front of other workers' deques when idle.
+// Tasks submitted from threads outside the pool are placed in a shared injection queue.
+//
+// Threads waiting on a group of tasks help execute pending tasks from that group instead of blocking. This permits task
+// groups to be nested (e.g., a parallel loop within a parallel loop) without oversubscribing the machine or deadlocking.
+// Helping is restricted to the waited-on group so that a waiting thread never runs unrelated work, which could attempt
+// to re-acquire locks the waiting thread holds or grow its stack without bound.
+//
+// Threads outside the pool share a single execution slot, so the workers plus a helping thread never exceed the thread
+// cap.
+class work_stealing_scheduler {
+  public:
+    using task_t = std::function<void(void)>;
 
-class asio_thread_pool {
   private:
+    struct queued_task {
+        const void *owner = nullptr; // Identifies the group the task belongs to, if any.
+        task_t task;
+    };
+
+    struct worker_queue {
+        std::mutex m;
+        std::deque<queued_task> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues; // One per worker.
+    std::mutex injection_m;
+    std::deque<queued_task> injection; // Tasks submitted from outside the pool.
+    std::atomic<bool> helper_slot_taken; // Whether a thread outside the pool is currently executing a task.
+
+    std::vector<std::thread> workers;
+    std::mutex sleep_m;
+    std::condition_variable sleep_cv;
+    std::atomic<size_t> pending;  // Number of queued tasks that have not yet been started.
+    std::atomic<bool> stopping;
+
+    // The (1-based) index of the worker that the calling thread is, or 0 if the calling thread is not a worker.
+    static size_t & this_worker(){
+        thread_local size_t idx = 0;
+        return idx;
+    }
+
+    // Whether the calling thread, which is not a worker, currently holds the helper slot.
+    static bool & holds_helper_slot(){
+        thread_local bool held = false;
+        return held;
+    }
+
+    static std::atomic<size_t> & thread_cap(){
+        static std::atomic<size_t> cap(0);
+        return cap;
+    }
+
+    static std::atomic<bool> & started(){
+        static std::atomic<bool> s(false);
+        return s;
+    }
+
+    // Removes a pending task belonging to the owner, or any pending task if no owner is specified.
+    bool pop_task(queued_task &t, const void *owner){
+        const auto me = this_worker();
+        const auto N = this->queues.size();
+
+        // Own queue first (most recently submitted, likely cache-warm), then the injection queue, then steal.
+        if(me != 0){
+            auto &q = *(this->queues[me - 1]);
+            std::lock_guard<std::mutex> lock(q.m);
+            for(auto it = std::rbegin(q.tasks); it != std::rend(q.tasks); ++it){
+                if( (owner == nullptr) || (it->owner == owner) ){
+                    t = std::move(*it);
+                    q.tasks.erase( std::next(it).base() );
+                    --(this->pending);
+                    return true;
+                }
+            }
+        }
+        const auto take_front = [&](std::deque<queued_task> &tasks) -> bool {
+            for(auto it = std::begin(tasks); it != std::end(tasks); ++it){
+                if( (owner == nullptr) || (it->owner == owner) ){
+                    t = std::move(*it);
+                    tasks.erase(it);
+                    --(this->pending);
+                    return true;
+                }
+            }
+            return false;
+        };
+        {
+            std::lock_guard<std::mutex> lock(this->injection_m);
+            if(take_front(this->injection)) return true;
+        }
+        for(size_t k = 0; k < N; ++k){
+            const auto i = (me + k) % N;
+            if((i + 1) == me) continue;
+            auto &q = *(this->queues[i]);
+            std::lock_guard<std::mutex> lock(q.m);
+            if(take_front(q.tasks)) return true;
+        }
+        return false;
+    }
+
+    void worker_loop(size_t idx){
+        this_worker() = idx;
+        while(true){
+            if(this->try_run_one(nullptr)) continue;
 
-    asio::io_service _io_service;
-    boost::thread_group _thread_pool;
-    using work_t = std::unique_ptr<asio::io_service::work>;
-    work_t _work;
+            std::unique_lock<std::mutex> lock(this->sleep_m);
+            this->sleep_cv.wait(lock, [&]{ return this->stopping.load() || (0 < this->pending.load()); });
+            if(this->stopping.load() && (this->pending.load() == 0)) return;
+        }
+    }
 
   public:
 
     //Constructor and destructor.
-    asio_thread_pool(const size_t num_threads = 0) : _io_service(), 
-                                                     _work(new work_t::element_type(_io_service)) {
-        auto n = (num_threads == 0) ? std::thread::hardware_concurrency()
-                                    : num_threads;
+    //
+    // Zero workers is permitted, in which case all tasks are executed by the threads that wait on them.
+    explicit work_stealing_scheduler(size_t num_workers) : helper_slot_taken(false), pending(0), stopping(false) {
+        for(size_t i = 0; i < num_workers; ++i){
+            this->queues.emplace_back( std::make_unique<worker_queue>() );
+        }
+        for(size_t i = 0; i < num_workers; ++i){
+            this->workers.emplace_back( &work_stealing_scheduler::worker_loop, this, i + 1 );
+        }
+    }
+    ~work_stealing_scheduler(){
+        this->stopping.store(true);
+        {
+            std::lock_guard<std::mutex> lock(this->sleep_m);
+        }
+        this->sleep_cv.notify_all();
+        for(auto &w : this->workers) w.join();
+    }
+
+    work_stealing_scheduler(const work_stealing_scheduler &) = delete;
+    work_stealing_scheduler & operator=(const work_stealing_scheduler &) = delete;
+
+    //Limit the number of threads that concurrently perform work, including threads that wait on a task group.
+    // Must be called before the scheduler is first used. Zero means use all available hardware threads.
+    static void set_thread_cap(size_t n){
+        if(started().load()){
+            throw std::logic_error("The thread cap cannot be changed after the scheduler has started");
+        }
+        thread_cap().store(n);
+    }
+
+    //The number of threads that concurrently perform work.
+    static size_t concurrency(){
+        size_t n = thread_cap().load();
+        if(n == 0) n = std::thread::hardware_concurrency();
         if(n == 0) n = 2;
-        for(size_t i = 0 ; i < n; ++i){
-            this->_thread_pool.create_thread(
-                boost::bind(&asio::io_service::run, &this->_io_service)
-            );
+        return n;
+    }
+
+    //The process-wide instance. Created on first use.
+    static work_stealing_scheduler & global(){
+        static work_stealing_scheduler sched( [](){
+            started().store(true);
+            // A thread waiting on a task group will also perform work, so one fewer dedicated worker is needed.
+            return concurrency() - 1;
+        }() );
+        return sched;
+    }
+
+    //Work submission routine. The owner identifies the group the task belongs to, if any.
+    void submit(task_t t, const void *owner = nullptr){
+        const auto me = this_worker();
+        if(me != 0){
+            auto &q = *(this->queues[me - 1]);
+            std::lock_guard<std::mutex> lock(q.m);
+            q.tasks.emplace_back( queued_task{ owner, std::move(t) } );
+        }else{
+            std::lock_guard<std::mutex> lock(this->injection_m);
+            this->injection.emplace_back( queued_task{ owner, std::move(t) } );
+        }
+        ++(this->pending);
+        {
+            std::lock_guard<std::mutex> lock(this->sleep_m);
+        }
+        this->sleep_cv.notify_one();
+    }
+
+    //Execute a single pending task on the calling thread, if one is available. If an owner is specified, only tasks
+    // belonging to that owner are considered.
+    //
+    // Threads outside the pool must hold the helper slot while executing a task. A nested call on a thread that already
+    // holds the slot (e.g., a task that waits on another group) reuses it.
+    bool try_run_one(const void *owner = nullptr){
+        const bool needs_slot = (this_worker() == 0) && !holds_helper_slot();
+        if(needs_slot){
+            bool expected = false;
+            if(!this->helper_slot_taken.compare_exchange_strong(expected, true)) return false;
+            holds_helper_slot() = true;
+        }
+        struct slot_releaser {
+            work_stealing_scheduler *sched;
+            bool release;
+            ~slot_releaser(){
+                if(!release) return;
+                holds_helper_slot() = false;
+                sched->helper_slot_taken.store(false);
+            }
+        } releaser{ this, needs_slot };
+
+        queued_task t;
+        if(!this->pop_task(t, owner)) return false;
+        t.task();
+        return true;
+    }
+};
+
+
+// A group of tasks that can be waited on together. Waiting threads help execute pending tasks from the group.
+//
+// An exception thrown by a task is captured and rethrown by wait(). Destroying a group with an unclaimed exception
+// terminates the program, since it would otherwise be silently lost.
+class task_group {
+  private:
+    work_stealing_scheduler &sched;
+    std::mutex m;
+    std::condition_variable cv;
+    size_t outstanding = 0;
+    std::exception_ptr eptr;
+
+    void wait_for_tasks(){
+        std::unique_lock<std::mutex> lock(this->m);
+        while(this->outstanding != 0){
+            lock.unlock();
+            const bool ran = this->sched.try_run_one(this);
+            lock.lock();
+            if(!ran && (this->outstanding != 0)){
+                // Tasks are in flight elsewhere, or the helper slot is taken. Sleep briefly, but wake to help if more
+                // work becomes available.
+                this->cv.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+  public:
+    task_group() : sched(work_stealing_scheduler::global()) {}
+    ~task_group(){
+        this->wait_for_tasks();
+        if(this->eptr) std::terminate();
+    }
+
+    task_group(const task_group &) = delete;
+    task_group & operator=(const task_group &) = delete;
+
+    template<class T>
+    void submit(T atask){
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+            ++(this->outstanding);
+        }
+        this->sched.submit([this, atask]() mutable -> void {
+            try{
+                atask();
+            }catch(...){
+                std::lock_guard<std::mutex> lock(this->m);
+                if(!this->eptr) this->eptr = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(this->m);
+            --(this->outstanding);
+            this->cv.notify_all();
+        }, this);
+    }
+
+    //Wait for all submitted tasks to complete, rethrowing the first exception thrown by any task.
+    void wait(){
+        this->wait_for_tasks();
+        std::exception_ptr e;
+        {
+            std::lock_guard<std::mutex> lock(this->m);
+            std::swap(e, this->eptr);
         }
+        if(e) std::rethrow_exception(e);
     }
-    ~asio_thread_pool(){
-        this->_work.reset();
-        this->_thread_pool.join_all();
-        this->_io_service.stop();
+};
+
+
+// Invoke f(i) for each i in [begin, end), in parallel. Indices are processed in contiguous chunks of 'grain' indices.
+// If 'grain' is zero a chunk size is chosen so that there are several chunks per thread for load balancing.
+//
+// Exceptions thrown by f are rethrown after all chunks have completed.
+template<class F>
+void parallel_for(size_t begin, size_t end, F f, size_t grain = 0){
+    if(end <= begin) return;
+    const size_t N = end - begin;
+    if(grain == 0){
+        grain = std::max<size_t>(1, N / (8 * work_stealing_scheduler::concurrency()));
+    }
+
+    task_group tg;
+    for(size_t b = begin; b < end; b += std::min(grain, end - b)){
+        const size_t e = b + std::min(grain, end - b);
+        tg.submit([b, e, &f]() -> void {
+            for(size_t i = b; i < e; ++i) f(i);
+        });
     }
+    tg.wait();
+}
+
+
+// Adapter for code that submits independent tasks and waits for them when the pool goes out of scope.
+//
+// Note: No threads are created; tasks are executed by the process-wide work-stealing scheduler. The number of threads
+//       is governed by work_stealing_scheduler::set_thread_cap().
+class asio_thread_pool {
+  private:
+    task_group _tasks;
+
+  public:
+
+    //Constructor and destructor.
+    asio_thread_pool(const size_t /*num_threads*/ = 0) {}
+    ~asio_thread_pool() = default; // Waits for all submitted tasks.
 
     //Work submission routine.
     template<class T>
     void submit_task(T atask){
-        this->_io_service.post(atask);
+        this->_tasks.submit(std::move(atask));
     }
-}; 
-
+};
 
@@ -7,6 +7,8 @@
 #include <list>
 #include <map>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <random>
 #include <ostream>
 #include <stdexcept>
@@ -14,7 +16,9 @@
 #include "../../Thread_Pool.h"
 #include "../Grouping/Misc_Functors.h"
 #include "../ConvenienceRoutines.h"
+#include "../ROI_Mask_Cache.h"
 #include "Compare_Images.h"
+#include "Gamma_Index_Engine.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
 #include "YgorMisc.h"
@@ -101,6 +105,7 @@ bool ComputeCompareImages(planar_image_collection<float,double> &imagecoll,
 
     // Determine how discrepancy should be estimated.
     std::function< double (const double &, const double &) > estimate_discrepancy;
+    double pinned_max_val = 1.0;
     if(user_data_s->discrepancy_type == ComputeCompareImagesUserData::DiscrepancyType::Relative){
         estimate_discrepancy = relative_diff;
 
@@ -123,6 +128,7 @@ bool ComputeCompareImages(planar_image_collection<float,double> &imagecoll,
 
         const auto max_val = rmm.Current_Max();
         FUNCINFO("Maximum intensity found: " << max_val);
+        pinned_max_val = max_val;
         estimate_discrepancy = [max_val](const double &A, const double &B) -> double {
             return std::abs( (A - B) / max_val );
         };
@@ -139,9 +145,100 @@ bool ComputeCompareImages(planar_image_collection<float,double> &imagecoll,
     mv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
     mv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
 
+    const auto ccsl_fp = Fingerprint_ROI_Contours(ccsl);
+
+
+    // Use the dedicated gamma engine, if requested and the reference images form a regular grid.
+    std::list<std::reference_wrapper<planar_image<float,double>>> ref_imgs;
+    for(auto &imgcoll_refw : external_imgs){
+        for(auto &img : imgcoll_refw.get().images){
+            ref_imgs.push_back( std::ref(img) );
+        }
+    }
+    bool use_gamma_engine = (user_data_s->comparison_method == ComputeCompareImagesUserData::ComparisonMethod::GammaIndex)
+                         && (user_data_s->gamma_engine == ComputeCompareImagesUserData::GammaEngine::Fast);
+    if(use_gamma_engine && !Gamma_Index_Engine::Supports(ref_imgs)){
+        FUNCWARN("Reference images do not form a regular grid; falling back to the wavefront gamma implementation");
+        use_gamma_engine = false;
+    }
+    if(use_gamma_engine){
+        Gamma_Index_Engine_Params params;
+        if(user_data_s->discrepancy_type == ComputeCompareImagesUserData::DiscrepancyType::Relative){
+            params.discrepancy_type = Gamma_Index_Engine_Params::DiscrepancyType::Relative;
+        }else if(user_data_s->discrepancy_type == ComputeCompareImagesUserData::DiscrepancyType::Difference){
+            params.discrepancy_type = Gamma_Index_Engine_Params::DiscrepancyType::Difference;
+        }else{
+            params.discrepancy_type = Gamma_Index_Engine_Params::DiscrepancyType::Scaled;
+            params.discrepancy_scale = pinned_max_val;
+        }
+        params.DTA_threshold = user_data_s->gamma_DTA_threshold;
+        params.Dis_threshold = user_data_s->gamma_Dis_threshold;
+        params.search_radius = user_data_s->DTA_max;
+        params.interpolate = (user_data_s->interpolation_method != ComputeCompareImagesUserData::InterpolationMethod::None);
+        params.terminate_when_max_exceeded = user_data_s->gamma_terminate_when_max_exceeded;
+        params.terminated_early = user_data_s->gamma_terminated_early;
+        params.ref_lower_threshold = user_data_s->ref_img_inc_lower_threshold;
+        params.ref_upper_threshold = user_data_s->ref_img_inc_upper_threshold;
+
+        const auto t_start = std::chrono::steady_clock::now();
+        const Gamma_Index_Engine engine(ref_imgs, ud_channel, params);
+        FUNCINFO("Gamma engine search table contains " << engine.search_table_size() << " voxel offsets");
+
+        std::atomic<long int> evaluated(0);
+        std::atomic<long int> passed(0);
+        {
+            asio_thread_pool tp;
+            for(auto &img : imagecoll.images){
+                std::reference_wrapper< planar_image<float, double>> img_refw( std::ref(img) );
+
+                tp.submit_task([&,img_refw]() -> void {
+                    long int l_evaluated = 0;
+                    long int l_passed = 0;
+                    auto f_bounded = [&](long int E_row, long int E_col, long int channel, std::reference_wrapper<planar_image<float,double>> /*img_refw*/, float &voxel_val) {
+                        if( !isininc( user_data_s->inc_lower_threshold, voxel_val, user_data_s->inc_upper_threshold) ){
+                            return; // No-op if outside of the thresholds.
+                        }
+                        if( channel != ud_channel){
+                            return; // No-op if this is the wrong channel.
+                        }
+                        const auto gamma = engine.evaluate( img_refw.get().position(E_row, E_col), voxel_val );
+                        voxel_val = static_cast<float>(gamma);
+                        if(std::isfinite(gamma)){
+                            ++l_evaluated;
+                            if(gamma < 1.0) ++l_passed;
+                        }
+                        return;
+                    };
+
+                    Mutate_Voxels_Cached( img_refw,
+                                          { img_refw },
+                                          ccsl, 
+                                          ccsl_fp,
+                                          mv_opts, 
+                                          f_bounded );
+
+                    UpdateImageDescription( img_refw, "Compared (gamma-index)" );
+                    UpdateImageWindowCentreWidth( img_refw );
+                    evaluated += l_evaluated;
+                    passed += l_passed;
+                }); // thread pool task closure.
+            }
+        } // Wait for all tasks to complete.
+
+        const auto t_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+        FUNCINFO("Gamma engine evaluated " << evaluated.load() << " voxels in " << t_elapsed << " s ("
+                 << static_cast<long int>( (0.0 < t_elapsed) ? evaluated.load() / t_elapsed : 0.0 ) << " voxels/s)");
+
+        user_data_s->count += evaluated.load();
+        user_data_s->passed += passed.load();
+        return true;
+    }
 
     std::mutex passing_counter; // Used to tally the gamma passing rate.
 
+    //The adjacency index over the external images is shared by all tasks, and built only once per orientation.
+    Image_Adjacency_Cache img_adj_cache( external_imgs );
+
     asio_thread_pool tp;
     std::mutex saver_printer; // Who gets to save generated contours, print to the console, and iterate the counter.
     long int completed = 0;
@@ -153,7 +250,8 @@ bool ComputeCompareImages(planar_image_collection<float,double> &imagecoll,
         tp.submit_task([&,img_refw]() -> void {
             const auto orientation_normal = img_refw.get().image_plane().N_0.unit();
 
-            planar_image_adjacency<float,double> img_adj( {}, external_imgs, orientation_normal );
+            const auto img_adj_ptr = img_adj_cache.get( orientation_normal );
+            const auto &img_adj = *img_adj_ptr;
 
             using img_ptr_t = planar_image<float,double> *;
 
@@ -610,11 +708,12 @@ bool ComputeCompareImages(planar_image_collection<float,double> &imagecoll,
                 return;
             };
 
-            Mutate_Voxels<float,double>( img_refw,
-                                         { img_refw },
-                                         ccsl, 
-                                         mv_opts, 
-                                         f_bounded );
+            Mutate_Voxels_Cached( img_refw,
+                                  { img_refw },
+                                  ccsl, 
+                                  ccsl_fp,
+                                  mv_opts, 
+                                  f_bounded );
 
             if(user_data_s->comparison_method == ComputeCompareImagesUserData::ComparisonMethod::Discrepancy){
                 UpdateImageDescription( img_refw, "Compared (discrepancy)" );
@@ -132,6 +132,19 @@ struct ComputeCompareImagesUserData {
     double gamma_terminate_when_max_exceeded = true;
     double gamma_terminated_early = std::nextafter(1.0, std::numeric_limits<double>::infinity());
 
+    // Which implementation to use for gamma comparisons.
+    //
+    // The wavefront implementation grows shells of voxels around each voxel using generic image accessors. The fast
+    // implementation resamples the reference images into a contiguous volume and traverses a distance-sorted search
+    // table, stopping as soon as no remaining reference voxel can improve the result. Both honour the DTA_max search
+    // cut-off and interpolation settings, but the fast implementation interpolates along voxel edges only where doing
+    // so could lower the gamma index.
+    enum class
+    GammaEngine {
+        Wavefront,
+        Fast,
+    } gamma_engine = GammaEngine::Fast;
+
     // Outgoing gamma passing counts.
     //
     // These can be read by the caller after performing a gamma analysis.
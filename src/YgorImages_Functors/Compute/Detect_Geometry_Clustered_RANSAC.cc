@@ -8,11 +8,13 @@
 #include <map>
 #include <algorithm>
 #include <random>
+#include <vector>
 #include <ostream>
 #include <stdexcept>
 
 #include "../Grouping/Misc_Functors.h"
 #include "../ConvenienceRoutines.h"
+#include "../../Thread_Pool.h"
 #include "Detect_Geometry_Clustered_RANSAC.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -181,8 +183,24 @@ bool ComputeDetectGeometryClusteredRANSAC(planar_image_collection<float,double>
 
 
         // ----- Fit the clusters -----
-        for(const auto &cluster_p : Segregated){
-            const auto ClusterID = cluster_p.first;
+        //
+        // Clusters are fitted independently, so they are processed in parallel. Each cluster uses its own random stream
+        // and the results are reported in cluster order, so the output does not depend on the number of threads.
+        struct cluster_fit_t {
+            uint32_t ClusterID = 0;
+            std::optional<sphere<double>> asphere;
+            std::optional<plane<double>> aplane;
+            bool failed = false;
+        };
+        std::vector<const decltype(Segregated)::value_type *> clusters;
+        clusters.reserve( Segregated.size() );
+        for(const auto &cluster_p : Segregated) clusters.push_back( &cluster_p );
+        std::vector<cluster_fit_t> fits( clusters.size() );
+
+        parallel_for(0, clusters.size(), [&](size_t i) -> void {
+            const auto &cluster_p = *(clusters[i]);
+            auto &fit = fits[i];
+            fit.ClusterID = cluster_p.first;
 
             std::vector<vec3<double>> positions;
             positions.reserve( cluster_p.second.size() );
@@ -226,19 +244,30 @@ bool ComputeDetectGeometryClusteredRANSAC(planar_image_collection<float,double>
                     }
 
                     // Fit a sphere.
-                    const auto asphere = Sphere_Orthogonal_Regression( sampled, max_iters, centre_stopping_tol, radius_stopping_tol );
-                    FUNCINFO("The fitted sphere for cluster " << ClusterID << " has"
-                          << " centre = " << asphere.C_0 << " and radius = " << asphere.r_0);
+                    fit.asphere = Sphere_Orthogonal_Regression( sampled, max_iters, centre_stopping_tol, radius_stopping_tol );
 
-
-                    const auto aplane = Plane_Orthogonal_Regression( sampled );
-                    FUNCINFO("The fitted plane for cluster " << ClusterID << " has"
-                          << " anchor = " << aplane.R_0 << " and normal = " << aplane.N_0);
+                    // Fit a plane.
+                    fit.aplane = Plane_Orthogonal_Regression( sampled );
 
                 }catch(const std::exception &e){
-                    FUNCWARN("Fitting of cluster " << ClusterID << " failed to converge. Ignoring it");
+                    fit.failed = true;
                 };
             }
+        });
+
+        for(const auto &fit : fits){
+            if(fit.failed){
+                FUNCWARN("Fitting of cluster " << fit.ClusterID << " failed to converge. Ignoring it");
+                continue;
+            }
+            if(fit.asphere){
+                FUNCINFO("The fitted sphere for cluster " << fit.ClusterID << " has"
+                      << " centre = " << fit.asphere->C_0 << " and radius = " << fit.asphere->r_0);
+            }
+            if(fit.aplane){
+                FUNCINFO("The fitted plane for cluster " << fit.ClusterID << " has"
+                      << " anchor = " << fit.aplane->R_0 << " and normal = " << fit.aplane->N_0);
+            }
         }
 
 
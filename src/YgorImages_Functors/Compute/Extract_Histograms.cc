@@ -14,6 +14,7 @@
 #include "../../Thread_Pool.h"
 #include "../Grouping/Misc_Functors.h"
 #include "../ConvenienceRoutines.h"
+#include "../ROI_Mask_Cache.h"
 #include "Extract_Histograms.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -99,6 +100,12 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
         }
     }
 
+    // The contours are shared by all images, so they are fingerprinted only once.
+    std::map<std::string, ROI_Contours_Fingerprint> named_ccsl_fps;
+    for(const auto &named_ccsl : named_ccsls){
+        named_ccsl_fps[named_ccsl.first] = Fingerprint_ROI_Contours(named_ccsl.second);
+    }
+
     // Determine voxel value extrema for each logical partition.
     std::map<std::string,               // ROIName.
              std::pair<double,          // Minimum voxel value (within the user's inclusive range).
@@ -136,11 +143,12 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                         return;
                     };
 
-                    Mutate_Voxels<float,double>( img_refw,
-                                                 { img_refw },
-                                                 named_ccsl.second, 
-                                                 user_data_s->mutation_opts, 
-                                                 f_bounded );
+                    Mutate_Voxels_Cached( img_refw,
+                                          { img_refw },
+                                          named_ccsl.second, 
+                                          named_ccsl_fps.at(named_ccsl.first),
+                                          user_data_s->mutation_opts, 
+                                          f_bounded );
 
                     // Merge the results.
                     if( std::isfinite(local_minimum) 
@@ -273,11 +281,12 @@ bool ComputeExtractHistograms(planar_image_collection<float,double> &imagecoll,
                         return;
                     };
 
-                    Mutate_Voxels<float,double>( img_refw,
-                                                 { img_refw },
-                                                 named_ccsl.second, 
-                                                 user_data_s->mutation_opts, 
-                                                 f_bounded );
+                    Mutate_Voxels_Cached( img_refw,
+                                          { img_refw },
+                                          named_ccsl.second, 
+                                          named_ccsl_fps.at(named_ccsl.first),
+                                          user_data_s->mutation_opts, 
+                                          f_bounded );
 
                     add_counts(); // Commit all remaining bins from the shuttle.
                 } // Loop over all named ccs.
@@ -0,0 +1,307 @@
+//Gamma_Index_Engine.cc.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <list>
+#include <stdexcept>
+#include <vector>
+
+#include "../../Thread_Pool.h"
+#include "Gamma_Index_Engine.h"
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+
+namespace {
+
+using img_refw_t = std::reference_wrapper<planar_image<float,double>>;
+
+// Orders the slices along the image normal.
+std::vector<img_refw_t>
+sort_slices(const std::list<img_refw_t> &ref_imgs){
+    const auto N = ref_imgs.front().get().image_plane().N_0.unit();
+    std::vector<img_refw_t> imgs( std::begin(ref_imgs), std::end(ref_imgs) );
+    std::stable_sort(std::begin(imgs), std::end(imgs), [&N](const auto &A, const auto &B){
+        return A.get().position(0,0).Dot(N) < B.get().position(0,0).Dot(N);
+    });
+    return imgs;
+}
+
+// Grid geometry. Adjacent voxel positions are used where available so the layout follows the images exactly.
+struct grid_t {
+    vec3<double> origin;
+    vec3<double> e_r;
+    vec3<double> e_c;
+    vec3<double> e_k;
+};
+
+grid_t
+derive_grid(const std::vector<img_refw_t> &imgs){
+    const auto &img0 = imgs.front().get();
+    const auto N = img0.image_plane().N_0.unit();
+    grid_t g;
+    g.origin = img0.position(0,0);
+    g.e_r = (1 < img0.rows)    ? img0.position(1,0) - g.origin : img0.row_unit * img0.pxl_dx;
+    g.e_c = (1 < img0.columns) ? img0.position(0,1) - g.origin : img0.col_unit * img0.pxl_dy;
+    g.e_k = (1 < imgs.size())  ? imgs[1].get().position(0,0) - g.origin
+                               : N * std::max( img0.pxl_dz, std::min(g.e_r.length(), g.e_c.length()) );
+    return g;
+}
+
+// Verifies that every slice shares the extent, orientation, and voxel dimensions of the first, and that the slices are
+// uniformly spaced and aligned, so that every voxel lies on the grid (within a small fraction of a voxel).
+bool
+slices_lie_on_grid(const std::vector<img_refw_t> &imgs, const grid_t &g){
+    const auto &img0 = imgs.front().get();
+    const auto tol = 1.0E-3 * std::min({ g.e_r.length(), g.e_c.length(), g.e_k.length() });
+    if(!(0.0 < tol)) return false;
+
+    for(size_t k = 0; k < imgs.size(); ++k){
+        const auto &img = imgs[k].get();
+        if( (img.rows != img0.rows) || (img.columns != img0.columns) ) return false;
+
+        // Compare the extreme voxels, which also verifies the orientation and voxel dimensions.
+        const auto kd = static_cast<double>(k);
+        const auto R = img.rows - 1;
+        const auto C = img.columns - 1;
+        const auto e_r = (0 < R) ? g.e_r : vec3<double>(0.0, 0.0, 0.0);
+        const auto e_c = (0 < C) ? g.e_c : vec3<double>(0.0, 0.0, 0.0);
+        const auto o = g.origin + g.e_k * kd;
+        if( (tol < img.position(0,0).distance(o))
+        ||  (tol < img.position(R,0).distance(o + e_r * static_cast<double>(R)))
+        ||  (tol < img.position(0,C).distance(o + e_c * static_cast<double>(C))) ) return false;
+        if( (R == 0) && (tol < (img.row_unit * img.pxl_dx).distance(g.e_r)) ) return false;
+        if( (C == 0) && (tol < (img.col_unit * img.pxl_dy).distance(g.e_c)) ) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+
+bool Gamma_Index_Engine::Supports(const std::list<std::reference_wrapper<planar_image<float,double>>> &ref_imgs){
+    if(ref_imgs.empty()) return false;
+    for(const auto &img_refw : ref_imgs){
+        if( (img_refw.get().rows < 1) || (img_refw.get().columns < 1) ) return false;
+    }
+    const auto imgs = sort_slices(ref_imgs);
+    return slices_lie_on_grid(imgs, derive_grid(imgs));
+}
+
+
+Gamma_Index_Engine::Gamma_Index_Engine(std::list<std::reference_wrapper<planar_image<float,double>>> ref_imgs,
+                                       long int channel,
+                                       const Gamma_Index_Engine_Params &p) : params(p) {
+    if(ref_imgs.empty()){
+        throw std::invalid_argument("No reference images provided. Cannot continue.");
+    }
+    if( !(0.0 < this->params.DTA_threshold) || !(0.0 < this->params.Dis_threshold) ){
+        throw std::invalid_argument("Gamma criteria must be positive. Cannot continue.");
+    }
+
+    const auto imgs = sort_slices(ref_imgs);
+
+    const auto &img0 = imgs.front().get();
+    this->rows    = img0.rows;
+    this->columns = img0.columns;
+    this->slices  = static_cast<long int>(imgs.size());
+    for(const auto &img_refw : imgs){
+        if( (img_refw.get().rows != this->rows)
+        ||  (img_refw.get().columns != this->columns) ){
+            throw std::invalid_argument("Reference images do not form a rectilinear grid. Cannot continue.");
+        }
+        if(img_refw.get().channels <= channel){
+            throw std::invalid_argument("Reference images do not have the requested channel. Cannot continue.");
+        }
+    }
+    if( (this->rows < 1) || (this->columns < 1) ){
+        throw std::invalid_argument("Reference images contain no voxels. Cannot continue.");
+    }
+
+    const auto g = derive_grid(imgs);
+    if(!slices_lie_on_grid(imgs, g)){
+        throw std::invalid_argument("Reference images do not form a regular grid. Cannot continue.");
+    }
+    this->origin = g.origin;
+    this->e_r = g.e_r;
+    this->e_c = g.e_c;
+    this->e_k = g.e_k;
+
+    const auto det = this->e_r.Dot( this->e_c.Cross(this->e_k) );
+    if( !std::isfinite(det) || (std::abs(det) < std::numeric_limits<double>::min()) ){
+        throw std::invalid_argument("Reference image grid is degenerate. Cannot continue.");
+    }
+    this->inv_r = this->e_c.Cross(this->e_k) / det;
+    this->inv_c = this->e_k.Cross(this->e_r) / det;
+    this->inv_k = this->e_r.Cross(this->e_c) / det;
+    this->max_edge_length = std::max({ this->e_r.length(), this->e_c.length(), this->e_k.length() });
+
+    // Resample the reference images into a contiguous volume.
+    this->vol.resize( static_cast<size_t>(this->rows * this->columns * this->slices) );
+    const auto nan = std::numeric_limits<float>::quiet_NaN();
+    parallel_for(0, static_cast<size_t>(this->slices), [&](size_t k) -> void {
+        const auto &img = imgs[k].get();
+        for(long int r = 0; r < this->rows; ++r){
+            for(long int c = 0; c < this->columns; ++c){
+                const auto v = img.value(r, c, channel);
+                this->vol[ (static_cast<long int>(k) * this->rows + r) * this->columns + c ]
+                    = isininc(this->params.ref_lower_threshold, v, this->params.ref_upper_threshold) ? v : nan;
+            }
+        }
+    }, 1);
+
+    // Build the search table. Any grid voxel within the search radius (plus an edge, for interpolation) of the test
+    // position is within this radius of the grid voxel nearest the test position.
+    const auto half_cell = 0.5 * (this->e_r.length() + this->e_c.length() + this->e_k.length());
+    const auto radius = this->params.search_radius + this->max_edge_length + half_cell;
+    const auto r_max = std::min<long int>(this->rows - 1,    static_cast<long int>(std::ceil(radius * this->inv_r.length())));
+    const auto c_max = std::min<long int>(this->columns - 1, static_cast<long int>(std::ceil(radius * this->inv_c.length())));
+    const auto k_max = std::min<long int>(this->slices - 1,  static_cast<long int>(std::ceil(radius * this->inv_k.length())));
+    for(long int dk = -k_max; dk <= k_max; ++dk){
+        for(long int dr = -r_max; dr <= r_max; ++dr){
+            for(long int dc = -c_max; dc <= c_max; ++dc){
+                const auto dist = (this->e_r * static_cast<double>(dr)
+                                 + this->e_c * static_cast<double>(dc)
+                                 + this->e_k * static_cast<double>(dk)).length();
+                if(dist <= radius) this->offsets.push_back( offset_t{ dr, dc, dk, dist } );
+            }
+        }
+    }
+    std::stable_sort(std::begin(this->offsets), std::end(this->offsets),
+                     [](const offset_t &A, const offset_t &B){ return A.dist < B.dist; });
+}
+
+vec3<double> Gamma_Index_Engine::grid_position(long int r, long int c, long int k) const {
+    return this->origin + this->e_r * static_cast<double>(r)
+                        + this->e_c * static_cast<double>(c)
+                        + this->e_k * static_cast<double>(k);
+}
+
+double Gamma_Index_Engine::discrepancy(double test_val, double ref_val) const {
+    const auto diff = std::abs(test_val - ref_val);
+    if(this->params.discrepancy_type == Gamma_Index_Engine_Params::DiscrepancyType::Relative){
+        const auto max_abs = std::max( std::abs(test_val), std::abs(ref_val) );
+        const auto machine_eps = std::sqrt(std::numeric_limits<double>::epsilon());
+        return (max_abs < machine_eps) ? 0.0 : diff / max_abs;
+    }else if(this->params.discrepancy_type == Gamma_Index_Engine_Params::DiscrepancyType::Scaled){
+        return diff / this->params.discrepancy_scale;
+    }
+    return diff;
+}
+
+double Gamma_Index_Engine::evaluate(const vec3<double> &pos, double test_val) const {
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    if(!std::isfinite(test_val)) return nan;
+
+    // Locate the nearest reference voxel.
+    const auto d = pos - this->origin;
+    const auto nr = static_cast<long int>(std::lround(this->inv_r.Dot(d)));
+    const auto nc = static_cast<long int>(std::lround(this->inv_c.Dot(d)));
+    const auto nk = static_cast<long int>(std::lround(this->inv_k.Dot(d)));
+    if( !isininc(0, nr, this->rows - 1)
+    ||  !isininc(0, nc, this->columns - 1)
+    ||  !isininc(0, nk, this->slices - 1)
+    ||  !std::isfinite(this->at(nr, nc, nk)) ){
+        return nan;
+    }
+    const auto off = pos.distance( this->grid_position(nr, nc, nk) );
+
+    const auto inv_dta2 = 1.0 / (this->params.DTA_threshold * this->params.DTA_threshold);
+    const auto inv_dis  = 1.0 / this->params.Dis_threshold;
+    const auto sr2      = this->params.search_radius * this->params.search_radius;
+    const auto slack    = this->params.interpolate ? this->max_edge_length : 0.0;
+    const auto stop2    = this->params.terminate_when_max_exceeded ? 1.0 : std::numeric_limits<double>::infinity();
+
+    const bool linear_dis = (this->params.discrepancy_type != Gamma_Index_Engine_Params::DiscrepancyType::Relative);
+    const auto S = this->params.Dis_threshold
+                 * ( (this->params.discrepancy_type == Gamma_Index_Engine_Params::DiscrepancyType::Scaled)
+                     ? this->params.discrepancy_scale : 1.0 );
+    const auto inv_S2 = 1.0 / (S * S);
+
+    double best2 = std::numeric_limits<double>::infinity();
+    for(const auto &o : this->offsets){
+        // Lower bound on the distance to any candidate reachable from this offset (including along its edges).
+        // Offsets are sorted, so once the DTA term alone cannot improve the result, no later offset can either.
+        const auto lb = o.dist - off - slack;
+        if(0.0 < lb){
+            const auto lb2 = lb * lb * inv_dta2;
+            if( (best2 <= lb2) || (stop2 <= lb2) ) break;
+            if(sr2 < lb * lb) break;
+        }
+
+        const auto r = nr + o.dr;
+        const auto c = nc + o.dc;
+        const auto k = nk + o.dk;
+        if( !isininc(0, r, this->rows - 1)
+        ||  !isininc(0, c, this->columns - 1)
+        ||  !isininc(0, k, this->slices - 1) ) continue;
+
+        const double v = this->at(r, c, k);
+        if(!std::isfinite(v)) continue;
+
+        const auto x = this->grid_position(r, c, k);
+        const auto dist2 = pos.sq_dist(x);
+        const bool is_nearest = (o.dr == 0) && (o.dc == 0) && (o.dk == 0);
+        if( is_nearest || (dist2 <= sr2) ){
+            const auto dis = this->discrepancy(test_val, v) * inv_dis;
+            best2 = std::min(best2, dist2 * inv_dta2 + dis * dis);
+        }
+        if(!this->params.interpolate) continue;
+
+        // Interpolate along the edges to the adjacent voxels, but only where the edge could improve the result.
+        const auto dist = std::sqrt(dist2);
+        const std::array<std::array<long int, 3>, 3> edges = {{ {{ 1, 0, 0 }}, {{ 0, 1, 0 }}, {{ 0, 0, 1 }} }};
+        for(const auto &e : edges){
+            const auto r2 = r + e[0];
+            const auto c2 = c + e[1];
+            const auto k2 = k + e[2];
+            if( (this->rows <= r2) || (this->columns <= c2) || (this->slices <= k2) ) continue;
+
+            const double w = this->at(r2, c2, k2);
+            if(!std::isfinite(w)) continue;
+
+            const auto b = this->grid_position(r2, c2, k2) - x;
+            const auto b_len = b.length();
+            const auto edge_lb = dist - b_len;
+            if( (0.0 < edge_lb) && (best2 <= edge_lb * edge_lb * inv_dta2) ) continue;
+
+            const auto dv = v - test_val;
+            const auto dw = w - v;
+
+            // If the edge straddles the test value, the reference matches it exactly somewhere along the edge.
+            if( ((dv < 0.0) && (0.0 < dv + dw))
+            ||  ((0.0 < dv) && (dv + dw < 0.0)) ){
+                const auto t = -dv / dw;
+                const auto q2 = pos.sq_dist( x + b * t );
+                if(q2 <= sr2) best2 = std::min(best2, q2 * inv_dta2);
+            }
+
+            // For linearly-normalized discrepancies the minimum along the edge can be found exactly.
+            if(linear_dis){
+                const auto a = x - pos;
+                const auto denom = b.Dot(b) * inv_dta2 + dw * dw * inv_S2;
+                if(0.0 < denom){
+                    const auto t = std::clamp( -(a.Dot(b) * inv_dta2 + dv * dw * inv_S2) / denom, 0.0, 1.0 );
+                    const auto q2 = pos.sq_dist( x + b * t );
+                    if(q2 <= sr2){
+                        const auto dis = dv + t * dw;
+                        best2 = std::min(best2, q2 * inv_dta2 + dis * dis * inv_S2);
+                    }
+                }
+            }
+        }
+    }
+
+    if(!std::isfinite(best2)) return nan;
+    if(stop2 <= best2) return this->params.terminated_early;
+    return std::sqrt(best2);
+}
+
+size_t Gamma_Index_Engine::search_table_size() const {
+    return this->offsets.size();
+}
+
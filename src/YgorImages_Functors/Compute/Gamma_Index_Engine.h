@@ -0,0 +1,106 @@
+//Gamma_Index_Engine.h.
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <list>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+
+// A dedicated gamma-index engine.
+//
+// The reference image array is resampled once into a contiguous volume, and the search neighbourhood is expressed as
+// a table of voxel offsets sorted by physical distance. For each test voxel the table is traversed in order of
+// increasing distance, and traversal stops as soon as the distance-to-agreement term alone guarantees that no
+// remaining reference voxel can improve on the best gamma found so far (or, optionally, once gamma must exceed 1).
+// Sub-voxel interpolation along voxel edges is only performed when an edge could possibly improve the result.
+//
+// The reference images must form a regular grid: every slice must share the same extent, orientation, and voxel
+// dimensions, and the slices must be uniformly spaced and aligned. Use Gamma_Index_Engine::Supports() to check.
+struct Gamma_Index_Engine_Params {
+
+    // The type of discrepancy comparison, which determines how the dose-difference term is normalized.
+    enum class
+    DiscrepancyType {
+        Difference,  // |A - B|.
+        Relative,    // |A - B| / max(|A|, |B|).
+        Scaled,      // |A - B| / discrepancy_scale.
+    } discrepancy_type = DiscrepancyType::Relative;
+    double discrepancy_scale = 1.0;
+
+    // Gamma criteria. The DTA threshold is in DICOM units (mm); the discrepancy threshold depends on the type.
+    double DTA_threshold = 3.0;
+    double Dis_threshold = 3.0 / 100.0;
+
+    // The maximum search distance (in DICOM units: mm).
+    double search_radius = 5.0;
+
+    // Whether to interpolate along the edges between adjacent reference voxels.
+    bool interpolate = true;
+
+    // Halt searching once the gamma index will necessarily exceed 1, reporting the following value instead.
+    bool terminate_when_max_exceeded = true;
+    double terminated_early = std::nextafter(1.0, std::numeric_limits<double>::infinity());
+
+    // Reference voxels outside of these thresholds (inclusive) are excluded from the comparison.
+    double ref_lower_threshold = -(std::numeric_limits<double>::infinity());
+    double ref_upper_threshold = std::numeric_limits<double>::infinity();
+};
+
+class Gamma_Index_Engine {
+    private:
+        Gamma_Index_Engine_Params params;
+
+        // Contiguous reference volume, indexed as ((k * rows) + r) * columns + c. Excluded voxels are NaN.
+        std::vector<float> vol;
+        long int rows = 0;
+        long int columns = 0;
+        long int slices = 0;
+
+        // Grid geometry: position(r,c,k) = origin + e_r * r + e_c * c + e_k * k.
+        vec3<double> origin;
+        vec3<double> e_r;
+        vec3<double> e_c;
+        vec3<double> e_k;
+        vec3<double> inv_r; // Rows of the inverse of [e_r e_c e_k], used to map positions to grid coordinates.
+        vec3<double> inv_c;
+        vec3<double> inv_k;
+        double max_edge_length = 0.0;
+
+        struct offset_t {
+            long int dr;
+            long int dc;
+            long int dk;
+            double dist;
+        };
+        std::vector<offset_t> offsets; // Sorted by increasing distance.
+
+        float at(long int r, long int c, long int k) const {
+            return this->vol[ (k * this->rows + r) * this->columns + c ];
+        }
+        vec3<double> grid_position(long int r, long int c, long int k) const;
+        double discrepancy(double test_val, double ref_val) const;
+
+    public:
+        // Whether the images form a grid the engine can represent. Small deviations (a fraction of a voxel) are
+        // tolerated.
+        static bool Supports(const std::list<std::reference_wrapper<planar_image<float,double>>> &ref_imgs);
+
+        // Throws if the images do not form a supported grid.
+        Gamma_Index_Engine(std::list<std::reference_wrapper<planar_image<float,double>>> ref_imgs,
+                           long int channel,
+                           const Gamma_Index_Engine_Params &params);
+
+        // Evaluate the gamma index for a test voxel with the given position and value.
+        //
+        // Returns NaN if the position falls outside the reference volume or the nearest reference voxel is excluded.
+        double evaluate(const vec3<double> &pos, double test_val) const;
+
+        // The number of reference voxels within the search radius.
+        size_t search_table_size() const;
+};
+
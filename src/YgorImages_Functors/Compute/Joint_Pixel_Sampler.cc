@@ -14,6 +14,7 @@
 #include "../../Thread_Pool.h"
 #include "../Grouping/Misc_Functors.h"
 #include "../ConvenienceRoutines.h"
+#include "../ROI_Mask_Cache.h"
 #include "Joint_Pixel_Sampler.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -90,6 +91,8 @@ bool ComputeJointPixelSampler(planar_image_collection<float,double> &imagecoll,
 
     std::mutex passing_counter; // Used to tally the gamma passing rate.
 
+    const auto ccsl_fp = Fingerprint_ROI_Contours(ccsl);
+
     asio_thread_pool tp;
     std::mutex saver_printer; // Who gets to save generated contours, print to the console, and iterate the counter.
     long int completed = 0;
@@ -233,11 +236,12 @@ bool ComputeJointPixelSampler(planar_image_collection<float,double> &imagecoll,
                 return;
             };
 
-            Mutate_Voxels<float,double>( img_refw,
-                                         { img_refw },
-                                         ccsl, 
-                                         mv_opts, 
-                                         f_bounded );
+            Mutate_Voxels_Cached( img_refw,
+                                  { img_refw },
+                                  ccsl, 
+                                  ccsl_fp,
+                                  mv_opts, 
+                                  f_bounded );
 
             UpdateImageDescription( img_refw, user_data_s->description );
             UpdateImageWindowCentreWidth( img_refw );
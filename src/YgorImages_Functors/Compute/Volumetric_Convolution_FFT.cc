@@ -0,0 +1,493 @@
+//Volumetric_Convolution_FFT.cc.
+
+#include <algorithm>
+#include <any>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <list>
+#include <stdexcept>
+#include <vector>
+
+#include "../../Thread_Pool.h"
+#include "../ConvenienceRoutines.h"
+#include "../ROI_Mask_Cache.h"
+#include "Volumetric_Convolution_FFT.h"
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+
+namespace {
+
+using cplx = std::complex<double>;
+
+// Iterative radix-2 FFT for a fixed power-of-two length.
+class fft_plan {
+    private:
+        size_t N;
+        std::vector<size_t> rev;
+        std::vector<cplx> twiddle;
+
+    public:
+        explicit fft_plan(size_t n) : N(n), rev(n, 0), twiddle(n / 2) {
+            size_t bits = 0;
+            while((static_cast<size_t>(1) << bits) < this->N) ++bits;
+            for(size_t i = 0; i < this->N; ++i){
+                size_t r = 0;
+                for(size_t b = 0; b < bits; ++b){
+                    if(i & (static_cast<size_t>(1) << b)) r |= (static_cast<size_t>(1) << (bits - 1 - b));
+                }
+                this->rev[i] = r;
+            }
+            const auto pi = std::acos(-1.0);
+            for(size_t j = 0; j < this->twiddle.size(); ++j){
+                this->twiddle[j] = std::polar(1.0, -2.0 * pi * static_cast<double>(j) / static_cast<double>(this->N));
+            }
+        }
+
+        // Unnormalized transform of N contiguous elements.
+        void transform(cplx *a, bool inverse) const {
+            for(size_t i = 0; i < this->N; ++i){
+                const auto j = this->rev[i];
+                if(i < j) std::swap(a[i], a[j]);
+            }
+            for(size_t len = 2; len <= this->N; len <<= 1){
+                const auto half = len / 2;
+                const auto step = this->N / len;
+                for(size_t i = 0; i < this->N; i += len){
+                    for(size_t j = 0; j < half; ++j){
+                        const auto w = inverse ? std::conj(this->twiddle[j * step]) : this->twiddle[j * step];
+                        const auto u = a[i + j];
+                        const auto v = a[i + j + half] * w;
+                        a[i + j] = u + v;
+                        a[i + j + half] = u - v;
+                    }
+                }
+            }
+        }
+};
+
+size_t next_pow2(size_t n){
+    size_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+}
+
+// Unnormalized 3D transform of a block stored as ((a0 * B[1]) + a1) * B[2] + a2.
+void fft_3d(std::vector<cplx> &data,
+            const std::array<size_t, 3> &B,
+            const std::vector<fft_plan> &plans,
+            bool inverse,
+            std::vector<cplx> &line){
+    const std::array<size_t, 3> stride = {{ B[1] * B[2], B[2], 1 }};
+    for(size_t a = 0; a < 3; ++a){
+        const auto n = B[a];
+        const auto s = stride[a];
+        if(n < 2) continue;
+        const auto outer = data.size() / (n * s);
+        for(size_t o = 0; o < outer; ++o){
+            for(size_t i = 0; i < s; ++i){
+                const auto base = o * n * s + i;
+                if(s == 1){
+                    plans[a].transform(&data[base], inverse);
+                    continue;
+                }
+                line.resize(n);
+                for(size_t j = 0; j < n; ++j) line[j] = data[base + j * s];
+                plans[a].transform(line.data(), inverse);
+                for(size_t j = 0; j < n; ++j) data[base + j * s] = line[j];
+            }
+        }
+    }
+    return;
+}
+
+// Replace each element with the sum of the w[a] elements starting at it along every axis. Only elements where the
+// window fits within the block are meaningful afterward.
+void box_sum_3d(std::vector<double> &data,
+                const std::array<size_t, 3> &B,
+                const std::array<size_t, 3> &w,
+                std::vector<double> &line){
+    const std::array<size_t, 3> stride = {{ B[1] * B[2], B[2], 1 }};
+    for(size_t a = 0; a < 3; ++a){
+        const auto n = B[a];
+        const auto s = stride[a];
+        if( (w[a] < 2) || (n < w[a]) ) continue;
+        const auto outer = data.size() / (n * s);
+        line.resize(n);
+        for(size_t o = 0; o < outer; ++o){
+            for(size_t i = 0; i < s; ++i){
+                const auto base = o * n * s + i;
+                for(size_t j = 0; j < n; ++j) line[j] = data[base + j * s];
+                double sum = 0.0;
+                for(size_t j = 0; j < w[a]; ++j) sum += line[j];
+                data[base] = sum;
+                for(size_t p = 1; (p + w[a]) <= n; ++p){
+                    sum += line[p + w[a] - 1] - line[p - 1];
+                    data[base + p * s] = sum;
+                }
+            }
+        }
+    }
+    return;
+}
+
+} // namespace
+
+
+std::vector<float> Convolve_Dense_Volume_FFT(const std::vector<float> &vol,
+                                             long int rows,
+                                             long int columns,
+                                             long int images,
+                                             const std::vector<float> &kernel,
+                                             long int kernel_rows,
+                                             long int kernel_columns,
+                                             long int kernel_images,
+                                             ComputeVolumetricConvolutionFFTUserData::Operation op,
+                                             const std::vector<unsigned char> *needed){
+    if( (rows < 1) || (columns < 1) || (images < 1)
+    ||  (vol.size() != static_cast<size_t>(rows * columns * images)) ){
+        throw std::invalid_argument("Volume dimensions are not consistent. Cannot continue.");
+    }
+    if( (kernel_rows < 1) || (kernel_columns < 1) || (kernel_images < 1)
+    ||  (kernel.size() != static_cast<size_t>(kernel_rows * kernel_columns * kernel_images)) ){
+        throw std::invalid_argument("Kernel dimensions are not consistent. Cannot continue.");
+    }
+    if( (needed != nullptr) && (needed->size() != vol.size()) ){
+        throw std::invalid_argument("Voxel mask dimensions are not consistent. Cannot continue.");
+    }
+
+    const bool is_conv = (op == ComputeVolumetricConvolutionFFTUserData::Operation::Convolution);
+    const bool is_mtch = (op == ComputeVolumetricConvolutionFFTUserData::Operation::PatternMatch);
+
+    // Axes are ordered (image, row, column) throughout.
+    const std::array<long int, 3> ext = {{ images, rows, columns }};
+    const std::array<long int, 3> ks  = {{ kernel_images, kernel_rows, kernel_columns }};
+    const std::array<long int, 3> d   = {{ kernel_images / 2, kernel_rows / 2, kernel_columns / 2 }};
+
+    // Express every operation as a correlation with an effective kernel: out(R) = sum_j Kc[j] * vol(R + o + j).
+    // Outgoing voxels are only valid where the whole neighbourhood is within the volume, i.e., R in [lo, hi].
+    std::array<long int, 3> o;
+    std::array<long int, 3> lo;
+    std::array<long int, 3> hi;
+    for(size_t a = 0; a < 3; ++a){
+        o[a] = is_conv ? -(ks[a] - 1 - d[a]) : -d[a];
+        lo[a] = -o[a];
+        hi[a] = ext[a] - ks[a] - o[a];
+    }
+
+    const auto vidx = [&](long int i, long int r, long int c) -> size_t {
+        return static_cast<size_t>((i * rows + r) * columns + c);
+    };
+    const auto kidx = [&](long int i, long int r, long int c) -> size_t {
+        return static_cast<size_t>((i * kernel_rows + r) * kernel_columns + c);
+    };
+    const auto is_needed = [&](long int i, long int r, long int c) -> bool {
+        return (needed == nullptr) || ((*needed)[vidx(i, r, c)] != 0);
+    };
+
+    std::vector<float> out(vol.size(), std::numeric_limits<float>::quiet_NaN());
+    for(size_t a = 0; a < 3; ++a){
+        if(hi[a] < lo[a]) return out; // Kernel is larger than the volume.
+    }
+
+    // Direct evaluation of a single voxel. The order and precision of the arithmetic mirror the voxel-triplet
+    // implementation so non-finite values propagate identically.
+    const auto direct = [&](long int i, long int r, long int c) -> float {
+        const long int sign = is_conv ? -1L : 1L;
+        if(is_mtch){
+            float val = 0.0;
+            for(long int kr = 0; kr < kernel_rows; ++kr){
+                for(long int kc = 0; kc < kernel_columns; ++kc){
+                    for(long int ki = 0; ki < kernel_images; ++ki){
+                        const auto s = vol[vidx(i + (ki - d[0]), r + (kr - d[1]), c + (kc - d[2]))];
+                        val += std::pow(s - kernel[kidx(ki, kr, kc)], 2.0);
+                    }
+                }
+            }
+            return std::sqrt(val);
+        }
+        double val = 0.0;
+        for(long int kr = 0; kr < kernel_rows; ++kr){
+            for(long int kc = 0; kc < kernel_columns; ++kc){
+                for(long int ki = 0; ki < kernel_images; ++ki){
+                    const auto s = vol[vidx(i + sign * (ki - d[0]), r + sign * (kr - d[1]), c + sign * (kc - d[2]))];
+                    val = val + kernel[kidx(ki, kr, kc)] * s;
+                }
+            }
+        }
+        return static_cast<float>(val);
+    };
+
+    // Non-finite kernels contaminate every voxel, so fall back to direct evaluation.
+    const bool kernel_is_finite = std::all_of(std::begin(kernel), std::end(kernel),
+                                              [](float k){ return std::isfinite(k); });
+    if(!kernel_is_finite){
+        parallel_for(static_cast<size_t>(lo[0]), static_cast<size_t>(hi[0] + 1), [&](size_t i) -> void {
+            for(long int r = lo[1]; r <= hi[1]; ++r){
+                for(long int c = lo[2]; c <= hi[2]; ++c){
+                    const auto li = static_cast<long int>(i);
+                    if(is_needed(li, r, c)) out[vidx(li, r, c)] = direct(li, r, c);
+                }
+            }
+        }, 1);
+        return out;
+    }
+
+    // Select block dimensions. Each block yields L = B - ks + 1 valid outputs along each axis, so blocks are made
+    // a few kernel widths across where the volume permits it.
+    std::array<size_t, 3> B;
+    std::array<size_t, 3> L;
+    std::array<size_t, 3> N_blocks;
+    std::array<size_t, 3> w;
+    for(size_t a = 0; a < 3; ++a){
+        const auto valid = hi[a] - lo[a] + 1;
+        const auto want = std::min<long int>(valid, std::max<long int>(ks[a], 32L));
+        B[a] = next_pow2(static_cast<size_t>(ks[a] + want - 1));
+        L[a] = B[a] - static_cast<size_t>(ks[a]) + 1;
+        N_blocks[a] = (static_cast<size_t>(valid) + L[a] - 1) / L[a];
+        w[a] = static_cast<size_t>(ks[a]);
+    }
+    const size_t B_total = B[0] * B[1] * B[2];
+    const auto bidx = [&](size_t p0, size_t p1, size_t p2) -> size_t {
+        return (p0 * B[1] + p1) * B[2] + p2;
+    };
+
+    std::vector<fft_plan> plans;
+    for(size_t a = 0; a < 3; ++a) plans.emplace_back(B[a]);
+
+    // Transform the effective kernel once. It is shared by all blocks.
+    std::vector<cplx> K_spec(B_total, cplx(0.0, 0.0));
+    double K_sq_sum = 0.0;
+    for(long int ki = 0; ki < kernel_images; ++ki){
+        for(long int kr = 0; kr < kernel_rows; ++kr){
+            for(long int kc = 0; kc < kernel_columns; ++kc){
+                const double k = kernel[kidx(ki, kr, kc)];
+                K_sq_sum += k * k;
+                const auto ji = static_cast<size_t>(is_conv ? (kernel_images  - 1 - ki) : ki);
+                const auto jr = static_cast<size_t>(is_conv ? (kernel_rows    - 1 - kr) : kr);
+                const auto jc = static_cast<size_t>(is_conv ? (kernel_columns - 1 - kc) : kc);
+                K_spec[bidx(ji, jr, jc)] = cplx(k, 0.0);
+            }
+        }
+    }
+    {
+        std::vector<cplx> line;
+        fft_3d(K_spec, B, plans, false, line);
+        for(auto &z : K_spec) z = std::conj(z); // Correlation rather than convolution.
+    }
+
+    const size_t total_blocks = N_blocks[0] * N_blocks[1] * N_blocks[2];
+    parallel_for(0, total_blocks, [&](size_t b) -> void {
+        const std::array<size_t, 3> b_n = {{ b / (N_blocks[1] * N_blocks[2]),
+                                             (b / N_blocks[2]) % N_blocks[1],
+                                             b % N_blocks[2] }};
+        std::array<long int, 3> R0;
+        std::array<long int, 3> R1;
+        for(size_t a = 0; a < 3; ++a){
+            R0[a] = lo[a] + static_cast<long int>(b_n[a] * L[a]);
+            R1[a] = std::min<long int>(hi[a], R0[a] + static_cast<long int>(L[a]) - 1);
+        }
+
+        // Skip blocks that contain no voxels of interest.
+        if(needed != nullptr){
+            bool any_needed = false;
+            for(long int i = R0[0]; (i <= R1[0]) && !any_needed; ++i){
+                for(long int r = R0[1]; (r <= R1[1]) && !any_needed; ++r){
+                    for(long int c = R0[2]; (c <= R1[2]) && !any_needed; ++c){
+                        any_needed = is_needed(i, r, c);
+                    }
+                }
+            }
+            if(!any_needed) return;
+        }
+
+        // Load the block. Non-finite voxels are zeroed and tallied so affected outputs can be evaluated directly.
+        std::vector<cplx> X(B_total, cplx(0.0, 0.0));
+        std::vector<double> non_finite(B_total, 0.0);
+        std::vector<double> sq(is_mtch ? B_total : 0, 0.0);
+        for(size_t p0 = 0; p0 < B[0]; ++p0){
+            const auto i = R0[0] + o[0] + static_cast<long int>(p0);
+            if(ext[0] <= i) break;
+            for(size_t p1 = 0; p1 < B[1]; ++p1){
+                const auto r = R0[1] + o[1] + static_cast<long int>(p1);
+                if(ext[1] <= r) break;
+                for(size_t p2 = 0; p2 < B[2]; ++p2){
+                    const auto c = R0[2] + o[2] + static_cast<long int>(p2);
+                    if(ext[2] <= c) break;
+                    const double v = vol[vidx(i, r, c)];
+                    const auto n = bidx(p0, p1, p2);
+                    if(!std::isfinite(v)){
+                        non_finite[n] = 1.0;
+                        continue;
+                    }
+                    X[n] = cplx(v, 0.0);
+                    if(is_mtch) sq[n] = v * v;
+                }
+            }
+        }
+
+        std::vector<cplx> line;
+        fft_3d(X, B, plans, false, line);
+        for(size_t n = 0; n < B_total; ++n) X[n] *= K_spec[n];
+        fft_3d(X, B, plans, true, line);
+        const auto norm = 1.0 / static_cast<double>(B_total);
+
+        std::vector<double> sum_line;
+        box_sum_3d(non_finite, B, w, sum_line);
+        if(is_mtch) box_sum_3d(sq, B, w, sum_line);
+
+        for(long int i = R0[0]; i <= R1[0]; ++i){
+            for(long int r = R0[1]; r <= R1[1]; ++r){
+                for(long int c = R0[2]; c <= R1[2]; ++c){
+                    if(!is_needed(i, r, c)) continue;
+                    const auto n = bidx(static_cast<size_t>(i - R0[0]),
+                                        static_cast<size_t>(r - R0[1]),
+                                        static_cast<size_t>(c - R0[2]));
+                    if(0.5 < non_finite[n]){
+                        out[vidx(i, r, c)] = direct(i, r, c);
+                        continue;
+                    }
+                    const auto corr = X[n].real() * norm;
+                    if(is_mtch){
+                        // sum (I - K)^2 = sum I^2 - 2 sum I*K + sum K^2.
+                        out[vidx(i, r, c)] = static_cast<float>( std::sqrt( std::max(0.0, sq[n] - 2.0 * corr + K_sq_sum) ) );
+                    }else{
+                        out[vidx(i, r, c)] = static_cast<float>(corr);
+                    }
+                }
+            }
+        }
+    }, 1);
+
+    return out;
+}
+
+
+bool ComputeVolumetricConvolutionFFT(planar_image_collection<float,double> &imagecoll,
+                      std::list<std::reference_wrapper<planar_image_collection<float,double>>> /*external_imgs*/,
+                      std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+                      std::any user_data ){
+
+    // This routine produces the same outcome as sampling the voxel neighbourhood with an explicit list of voxel
+    // triplets and reducing with an inner product or Euclidean distance, but the cost does not scale with the number
+    // of kernel voxels. It is therefore preferable for large kernels.
+    //
+    // Note: Voxel values are copied into a dense volume before any are modified, so the provided image collection can
+    //       be updated in-place.
+
+    //We require a valid ComputeVolumetricConvolutionFFTUserData struct packed into the user_data.
+    ComputeVolumetricConvolutionFFTUserData *user_data_s;
+    try{
+        user_data_s = std::any_cast<ComputeVolumetricConvolutionFFTUserData *>(user_data);
+    }catch(const std::exception &e){
+        FUNCWARN("Unable to cast user_data to appropriate format. Cannot continue with computation");
+        return false;
+    }
+
+    if( ccsl.empty() ){
+        FUNCWARN("Missing needed contour information. Cannot continue with computation");
+        return false;
+    }
+    if(user_data_s->channel < 0){
+        throw std::invalid_argument("A specific channel must be selected. Cannot continue.");
+    }
+
+    std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs;
+    for(auto &img : imagecoll.images){
+        selected_imgs.push_back( std::ref(img) );
+    }
+    if(selected_imgs.empty()) return true;
+    if(!Images_Form_Rectilinear_Grid(selected_imgs)){
+        FUNCWARN("Images do not form a rectilinear grid. Cannot continue");
+        return false;
+    }
+
+    const auto orientation_normal = Average_Contour_Normals(ccsl);
+    planar_image_adjacency<float,double> img_adj( {}, { { std::ref(imagecoll) } }, orientation_normal );
+    const auto N_imgs = static_cast<long int>(img_adj.int_to_img.size());
+    const auto rows = imagecoll.images.front().rows;
+    const auto columns = imagecoll.images.front().columns;
+    const auto channel = user_data_s->channel;
+
+    // Gather the voxels into a dense volume ordered along the contour normal.
+    std::vector<float> vol( static_cast<size_t>(rows * columns * N_imgs) );
+    for(long int i = 0; i < N_imgs; ++i){
+        if(!img_adj.index_present(i)){
+            throw std::logic_error("Image adjacency indices are not contiguous. Cannot continue.");
+        }
+        const auto &img = img_adj.index_to_image(i).get();
+        if(img.channels <= channel){
+            throw std::invalid_argument("Images do not have the requested channel. Cannot continue.");
+        }
+        for(long int r = 0; r < rows; ++r){
+            for(long int c = 0; c < columns; ++c){
+                vol[ static_cast<size_t>((i * rows + r) * columns + c) ] = img.value(r, c, channel);
+            }
+        }
+    }
+
+    // Determine which voxels are bounded by the contours.
+    Mutate_Voxels_Opts mv_opts;
+    mv_opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace;
+    mv_opts.inclusivity    = Mutate_Voxels_Opts::Inclusivity::Centre;
+    mv_opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::Ignore;
+    mv_opts.aggregate      = Mutate_Voxels_Opts::Aggregate::First;
+    mv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
+    mv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
+
+    std::vector<std::reference_wrapper<planar_image<float,double>>> imgs( std::begin(selected_imgs), std::end(selected_imgs) );
+    std::vector<unsigned char> needed(vol.size(), 0);
+    const auto ccsl_fp = Fingerprint_ROI_Contours(ccsl);
+    parallel_for(0, imgs.size(), [&](size_t n) -> void {
+        auto img_refw = imgs[n];
+        const auto i = img_adj.image_to_index( img_refw );
+        auto f_bounded = [&](long int E_row, long int E_col, long int E_chnl,
+                             std::reference_wrapper<planar_image<float,double>> /*img_refw*/, float &/*voxel_val*/) {
+            if(E_chnl != channel) return;
+            needed[ static_cast<size_t>((i * rows + E_row) * columns + E_col) ] = 1;
+        };
+        Mutate_Voxels_Cached( img_refw,
+                              { img_refw },
+                              ccsl,
+                              ccsl_fp,
+                              mv_opts,
+                              f_bounded );
+    }, 1);
+
+    const auto N_needed = std::count(std::begin(needed), std::end(needed), static_cast<unsigned char>(1));
+    FUNCINFO("Convolving " << N_needed << " voxels with a "
+             << user_data_s->kernel_rows << "x" << user_data_s->kernel_columns << "x" << user_data_s->kernel_images
+             << " kernel via FFT");
+
+    const auto res = Convolve_Dense_Volume_FFT(vol, rows, columns, N_imgs,
+                                               user_data_s->kernel,
+                                               user_data_s->kernel_rows,
+                                               user_data_s->kernel_columns,
+                                               user_data_s->kernel_images,
+                                               user_data_s->operation,
+                                               &needed);
+
+    // Write the results back.
+    for(auto &img_refw : imgs){
+        const auto i = img_adj.image_to_index( img_refw );
+        for(long int r = 0; r < rows; ++r){
+            for(long int c = 0; c < columns; ++c){
+                const auto n = static_cast<size_t>((i * rows + r) * columns + c);
+                if(needed[n] != 0) img_refw.get().reference(r, c, channel) = res[n];
+            }
+        }
+
+        if(!(user_data_s->description.empty())){
+            UpdateImageDescription( img_refw, user_data_s->description );
+        }
+        UpdateImageWindowCentreWidth( img_refw );
+    }
+
+    return true;
+}
+
@@ -0,0 +1,69 @@
+//Volumetric_Convolution_FFT.h.
+#pragma once
+
+#include <any>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+
+template <class T, class R> class planar_image_collection;
+template <class T> class contour_collection;
+
+struct ComputeVolumetricConvolutionFFTUserData {
+
+    // The way the kernel is applied and the reduction is tallied.
+    //
+    // Note: The semantics exactly mirror the voxel-triplet implementation in the ConvolveImages operation. The kernel
+    //       is (approximately) centred, i.e., kernel voxel (r,c,i) is paired with the voxel at offset
+    //       (r - rows/2, c - columns/2, i - images/2) for correlation and pattern-matching, and the negated offset
+    //       for convolution. Outgoing voxels whose neighbourhood extends beyond the image array become NaN.
+    enum class
+    Operation {
+        Convolution,   // Inner product with the spatially-inverted kernel.
+        Correlation,   // Inner product with the kernel as-is.
+        PatternMatch,  // Euclidean distance between the kernel and the neighbourhood.
+    } operation = Operation::Convolution;
+
+    // The kernel, stored contiguously as ((image * kernel_rows) + row) * kernel_columns + column.
+    std::vector<float> kernel;
+    long int kernel_rows = 0;
+    long int kernel_columns = 0;
+    long int kernel_images = 0;
+
+    // The channel to operate on. Must be non-negative.
+    long int channel = 0;
+
+    // Outgoing image description to imbue.
+    std::string description;
+
+};
+
+// Convolves, correlates, or pattern-matches the image collection with a kernel in voxel number space using blocked
+// (overlap-save) fast Fourier transforms. Only voxels within the provided contours are altered.
+//
+// Note: The image collection must be rectilinear.
+bool ComputeVolumetricConvolutionFFT(planar_image_collection<float,double> &,
+                          std::list<std::reference_wrapper<planar_image_collection<float,double>>>,
+                          std::list<std::reference_wrapper<contour_collection<double>>>,
+                          std::any ud );
+
+// The dense-volume core of the above. Both the volume and the kernel are stored contiguously as
+// ((image * rows) + row) * columns + column, and the result uses the same layout as the volume.
+//
+// If provided, the 'needed' mask (same layout as the volume) limits which outgoing voxels are computed; the rest are
+// left as NaN and blocks containing no needed voxels are skipped entirely.
+//
+// Neighbourhoods containing non-finite voxels are evaluated directly so that NaNs and infinities propagate exactly
+// as they would for a direct evaluation.
+std::vector<float> Convolve_Dense_Volume_FFT(const std::vector<float> &vol,
+                                             long int rows,
+                                             long int columns,
+                                             long int images,
+                                             const std::vector<float> &kernel,
+                                             long int kernel_rows,
+                                             long int kernel_columns,
+                                             long int kernel_images,
+                                             ComputeVolumetricConvolutionFFTUserData::Operation op,
+                                             const std::vector<unsigned char> *needed = nullptr);
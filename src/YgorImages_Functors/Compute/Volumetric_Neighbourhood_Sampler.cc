@@ -2,8 +2,12 @@
 
 #include <exception>
 #include <any>
+#include <array>
+#include <memory>
+#include <set>
 #include <optional>
 #include <functional>
+#include <iterator>
 #include <list>
 #include <map>
 #include <algorithm>
@@ -14,6 +18,7 @@
 #include "../../Thread_Pool.h"
 #include "../Grouping/Misc_Functors.h"
 #include "../ConvenienceRoutines.h"
+#include "../ROI_Mask_Cache.h"
 #include "Volumetric_Neighbourhood_Sampler.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -23,6 +28,334 @@
 #include "YgorClustering.hpp"
 
 
+namespace {
+
+using triplet_t = std::array<long int, 3>; // (row, column, image) offsets.
+
+// A fixed neighbourhood shape, along with the voxels that enter and leave it when it slides by one voxel.
+//
+// All offsets are relative to the voxel the neighbourhood is centred on before sliding.
+struct window_geometry {
+    std::vector<triplet_t> offsets;
+    triplet_t lo;
+    triplet_t hi;
+
+    std::vector<triplet_t> leave_col; // Sliding to the next column.
+    std::vector<triplet_t> enter_col;
+    std::vector<triplet_t> leave_row; // Sliding to the next row.
+    std::vector<triplet_t> enter_row;
+};
+
+std::unique_ptr<window_geometry> make_window_geometry(const std::vector<triplet_t> &offsets){
+    if(offsets.empty()) return nullptr;
+    const std::set<triplet_t> S( std::begin(offsets), std::end(offsets) );
+    if(S.size() != offsets.size()) return nullptr; // Duplicated voxels cannot be slid consistently.
+
+    auto out = std::make_unique<window_geometry>();
+    out->offsets = offsets;
+    out->lo = offsets.front();
+    out->hi = offsets.front();
+    for(const auto &t : offsets){
+        for(size_t a = 0; a < 3; ++a){
+            out->lo[a] = std::min(out->lo[a], t[a]);
+            out->hi[a] = std::max(out->hi[a], t[a]);
+        }
+    }
+
+    const auto deltas = [&](const triplet_t &e, std::vector<triplet_t> &leave, std::vector<triplet_t> &enter){
+        for(const auto &t : offsets){
+            if(S.count( triplet_t{{ t[0] - e[0], t[1] - e[1], t[2] - e[2] }} ) == 0) leave.push_back(t);
+            const triplet_t n = {{ t[0] + e[0], t[1] + e[1], t[2] + e[2] }};
+            if(S.count(n) == 0) enter.push_back(n);
+        }
+    };
+    deltas( triplet_t{{ 0, 1, 0 }}, out->leave_col, out->enter_col );
+    deltas( triplet_t{{ 1, 0, 0 }}, out->leave_row, out->enter_row );
+    return out;
+}
+
+// Direct access to the voxels of the images adjacent to the image being edited.
+struct window_source {
+    std::vector<const planar_image<float,double>*> imgs; // Indexed by (image offset - lo). nullptr if not present.
+    bool all_present = false;
+    long int lo = 0;
+    long int rows = 0;
+    long int columns = 0;
+    long int channel = 0;
+
+    float at(long int row, long int col, long int img_offset) const {
+        return this->imgs[img_offset - this->lo]->value(row, col, this->channel);
+    }
+
+    // Whether the neighbourhood centred on the given voxel is wholly contained in the image array.
+    bool contains(const window_geometry &g, long int row, long int col) const {
+        if( (row + g.lo[0] < 0) || (this->rows <= row + g.hi[0])
+        ||  (col + g.lo[1] < 0) || (this->columns <= col + g.hi[1]) ) return false;
+        return this->all_present;
+    }
+};
+
+// Reducers. Only finite values are provided.
+struct mean_reducer {
+    double sum = 0.0;
+    long int N = 0;
+
+    void clear(){ this->sum = 0.0; this->N = 0; }
+    void add(float x){ this->sum += x; ++(this->N); }
+    void remove(float x){ this->sum -= x; --(this->N); }
+    bool stale() const { return false; }
+    float value(float){ return static_cast<float>(this->sum / static_cast<double>(this->N)); }
+};
+
+struct moments_reducer {
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    long int N = 0;
+
+    void clear(){ this->sum = 0.0; this->sum_sq = 0.0; this->N = 0; }
+    void add(float x){ this->sum += x; this->sum_sq += static_cast<double>(x) * x; ++(this->N); }
+    void remove(float x){ this->sum -= x; this->sum_sq -= static_cast<double>(x) * x; --(this->N); }
+    bool stale() const { return false; }
+    double mean() const { return this->sum / static_cast<double>(this->N); }
+    double std_dev() const {
+        const auto var = (this->sum_sq - this->sum * this->mean()) / static_cast<double>(this->N - 1);
+        return std::sqrt( std::max(0.0, var) );
+    }
+};
+
+struct std_dev_reducer : moments_reducer {
+    float value(float){ return static_cast<float>(this->std_dev()); }
+};
+
+struct standardize_reducer : moments_reducer {
+    float value(float v){
+        if(!std::isfinite(v)) return v;
+        const auto f = static_cast<float>( (v - this->mean()) / this->std_dev() );
+        return std::isfinite(f) ? f : std::numeric_limits<float>::quiet_NaN();
+    }
+};
+
+// Tracks the extremum and its multiplicity. The state only needs to be rebuilt when every copy of the extremum
+// leaves the neighbourhood.
+template <class Compare>
+struct extremum_reducer {
+    float ext = 0.0f;
+    long int count = 0;
+    bool invalid = false;
+
+    void clear(){ this->count = 0; this->invalid = false; }
+    void add(float x){
+        if( (this->count == 0) || Compare()(x, this->ext) ){
+            this->ext = x;
+            this->count = 1;
+        }else if(x == this->ext){
+            ++(this->count);
+        }
+    }
+    void remove(float x){
+        if( (x == this->ext) && (--(this->count) == 0) ) this->invalid = true;
+    }
+    bool stale() const { return this->invalid; }
+    float value(float){ return this->ext; }
+};
+
+// Maintains the neighbourhood in sorted order. Changes are batched and merged in a single pass.
+struct order_reducer {
+    std::vector<float> sorted;
+    std::vector<float> merged;
+    std::vector<float> entering;
+    std::vector<float> leaving;
+    std::vector<float> cancelled;
+
+    void clear(){
+        this->sorted.clear();
+        this->entering.clear();
+        this->leaving.clear();
+    }
+    void add(float x){ this->entering.push_back(x); }
+    void remove(float x){ this->leaving.push_back(x); }
+    bool stale() const { return false; }
+
+    void flush(){
+        if(this->entering.empty() && this->leaving.empty()) return;
+        std::sort(std::begin(this->entering), std::end(this->entering));
+        std::sort(std::begin(this->leaving), std::end(this->leaving));
+
+        // Values may have entered and left again since the last flush, so cancel them first.
+        this->merged.clear();
+        std::set_difference(std::begin(this->entering), std::end(this->entering),
+                            std::begin(this->leaving), std::end(this->leaving),
+                            std::back_inserter(this->merged));
+        this->cancelled.clear();
+        std::set_difference(std::begin(this->leaving), std::end(this->leaving),
+                            std::begin(this->entering), std::end(this->entering),
+                            std::back_inserter(this->cancelled));
+        std::swap(this->entering, this->merged);
+        std::swap(this->leaving, this->cancelled);
+
+        this->merged.clear();
+        auto l_it = std::begin(this->leaving);
+        auto e_it = std::begin(this->entering);
+        for(const auto &x : this->sorted){
+            while( (l_it != std::end(this->leaving)) && (*l_it < x) ) ++l_it;
+            if( (l_it != std::end(this->leaving)) && (*l_it == x) ){
+                ++l_it;
+                continue;
+            }
+            while( (e_it != std::end(this->entering)) && (*e_it < x) ) this->merged.push_back(*(e_it++));
+            this->merged.push_back(x);
+        }
+        this->merged.insert(std::end(this->merged), e_it, std::end(this->entering));
+        std::swap(this->sorted, this->merged);
+        this->entering.clear();
+        this->leaving.clear();
+    }
+};
+
+struct median_reducer : order_reducer {
+    float value(float){
+        this->flush();
+        const auto N = this->sorted.size();
+        if(N == 0) return std::numeric_limits<float>::quiet_NaN();
+        if((N % 2) == 1) return this->sorted[N / 2];
+        return static_cast<float>( 0.5 * (static_cast<double>(this->sorted[N / 2 - 1]) + this->sorted[N / 2]) );
+    }
+};
+
+struct percentile01_reducer : order_reducer {
+    float value(float f){
+        if(std::isnan(f)) return f;
+        this->flush();
+        const auto nan = std::numeric_limits<float>::quiet_NaN();
+        const auto bounds = std::equal_range(std::begin(this->sorted), std::end(this->sorted), f);
+        if(bounds.first == bounds.second) return nan;
+        const auto N_lhs = static_cast<long int>( std::distance(std::begin(this->sorted), bounds.first) );
+        const auto N_rhs = static_cast<long int>( std::distance(std::begin(this->sorted), bounds.second) ) - 1;
+        return 0.5 * static_cast<float>(N_rhs + N_lhs) / (static_cast<float>(this->sorted.size()) - 1.0);
+    }
+};
+
+// A neighbourhood reduction evaluated directly from the image. Returns false if the reduction cannot be evaluated
+// for the given voxel, in which case the generic reduction should be used instead.
+class neighbourhood_window {
+    public:
+        virtual ~neighbourhood_window() = default;
+        virtual bool evaluate(long int row, long int col, float centre, float &out) = 0;
+};
+
+template <class Reducer>
+class sliding_window : public neighbourhood_window {
+    private:
+        const window_geometry &geom;
+        window_source src;
+        Reducer reducer;
+        long int non_finite = 0;
+
+        bool valid = false;
+        long int prev_row = 0;
+        long int prev_col = 0;
+
+        void include(float x){
+            if(std::isfinite(x)){
+                this->reducer.add(x);
+            }else{
+                ++(this->non_finite);
+            }
+        }
+        void exclude(float x){
+            if(std::isfinite(x)){
+                this->reducer.remove(x);
+            }else{
+                --(this->non_finite);
+            }
+        }
+        void rebuild(long int row, long int col){
+            this->reducer.clear();
+            this->non_finite = 0;
+            for(const auto &t : this->geom.offsets) this->include( this->src.at(row + t[0], col + t[1], t[2]) );
+        }
+        void slide(const std::vector<triplet_t> &leave, const std::vector<triplet_t> &enter){
+            for(const auto &t : leave) this->exclude( this->src.at(this->prev_row + t[0], this->prev_col + t[1], t[2]) );
+            for(const auto &t : enter) this->include( this->src.at(this->prev_row + t[0], this->prev_col + t[1], t[2]) );
+        }
+
+    public:
+        sliding_window(const window_geometry &g, window_source s) : geom(g), src(std::move(s)) {}
+
+        bool evaluate(long int row, long int col, float centre, float &out) override {
+            if(!this->src.contains(this->geom, row, col)){
+                this->valid = false;
+                return false;
+            }
+            if(this->valid && (row == this->prev_row) && (col == this->prev_col + 1)){
+                this->slide(this->geom.leave_col, this->geom.enter_col);
+            }else if(this->valid && (row == this->prev_row + 1) && (col == this->prev_col)){
+                this->slide(this->geom.leave_row, this->geom.enter_row);
+            }else if(!this->valid || (row != this->prev_row) || (col != this->prev_col)){
+                this->rebuild(row, col);
+            }
+            this->valid = true;
+            this->prev_row = row;
+            this->prev_col = col;
+            if(this->reducer.stale()) this->rebuild(row, col);
+
+            if(this->non_finite != 0) return false;
+            out = this->reducer.value(centre);
+            return true;
+        }
+};
+
+// Weighted sums cannot be slid, but can still be evaluated without a shuttle.
+class weighted_window : public neighbourhood_window {
+    private:
+        const window_geometry &geom;
+        window_source src;
+        const std::vector<double> &weights;
+
+    public:
+        weighted_window(const window_geometry &g, window_source s, const std::vector<double> &w)
+            : geom(g), src(std::move(s)), weights(w) {}
+
+        bool evaluate(long int row, long int col, float, float &out) override {
+            if(!this->src.contains(this->geom, row, col)) return false;
+            double f = 0.0;
+            double w = 0.0;
+            for(size_t i = 0; i < this->geom.offsets.size(); ++i){
+                const auto &t = this->geom.offsets[i];
+                const auto x = this->src.at(row + t[0], col + t[1], t[2]);
+                if(!std::isfinite(x)) return false;
+                w += this->weights[i];
+                f += this->weights[i] * x;
+            }
+            if(w < 1E-3) f = std::numeric_limits<double>::quiet_NaN();
+            out = static_cast<float>(f / w);
+            return true;
+        }
+};
+
+std::unique_ptr<neighbourhood_window>
+make_neighbourhood_window(ComputeVolumetricNeighbourhoodSamplerUserData::Reduction reduction,
+                          const window_geometry &geom,
+                          window_source src,
+                          const std::vector<double> &weights){
+    using red_t = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction;
+    switch(reduction){
+        case red_t::Mean:         return std::make_unique<sliding_window<mean_reducer>>(geom, std::move(src));
+        case red_t::Min:          return std::make_unique<sliding_window<extremum_reducer<std::less<float>>>>(geom, std::move(src));
+        case red_t::Max:          return std::make_unique<sliding_window<extremum_reducer<std::greater<float>>>>(geom, std::move(src));
+        case red_t::Median:       return std::make_unique<sliding_window<median_reducer>>(geom, std::move(src));
+        case red_t::StdDev:       return std::make_unique<sliding_window<std_dev_reducer>>(geom, std::move(src));
+        case red_t::Standardize:  return std::make_unique<sliding_window<standardize_reducer>>(geom, std::move(src));
+        case red_t::Percentile01: return std::make_unique<sliding_window<percentile01_reducer>>(geom, std::move(src));
+        case red_t::WeightedMean: return std::make_unique<weighted_window>(geom, std::move(src), weights);
+        default: break;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+
 bool ComputeVolumetricNeighbourhoodSampler(planar_image_collection<float,double> &imagecoll,
                       std::list<std::reference_wrapper<planar_image_collection<float,double>>> /*external_imgs*/,
                       std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
@@ -63,6 +396,13 @@ bool ComputeVolumetricNeighbourhoodSampler(planar_image_collection<float,double>
         throw std::invalid_argument("User-provided reduction functor not valid. Cannot proceed.");
     }
 
+    using red_t = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction;
+    if( (user_data_s->reduction == red_t::WeightedMean)
+    &&  (  (user_data_s->neighbourhood != ComputeVolumetricNeighbourhoodSamplerUserData::Neighbourhood::Selection)
+        || (user_data_s->weights.size() != user_data_s->voxel_triplets.size()) ) ){
+        throw std::invalid_argument("Weighted mean reduction requires one weight per voxel triplet. Cannot proceed.");
+    }
+
     // Ensure the images form a regular grid.
     auto ref_imagecoll = imagecoll;
     
@@ -88,6 +428,7 @@ bool ComputeVolumetricNeighbourhoodSampler(planar_image_collection<float,double>
     mv_opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
     mv_opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
 
+    const auto ccsl_fp = Fingerprint_ROI_Contours(ccsl);
 
     asio_thread_pool tp;
     std::mutex saver_printer; // Who gets to save generated contours, print to the console, and iterate the counter.
@@ -113,9 +454,56 @@ bool ComputeVolumetricNeighbourhoodSampler(planar_image_collection<float,double>
             const auto pxl_dy = ref_img_refw.get().pxl_dy;
             const auto pxl_dz = ref_img_refw.get().pxl_dz;
 
+            if(!img_adj.image_present( ref_img_refw )){
+                throw std::logic_error("One or more images were not included in the image adjacency determination. Refusing to continue.");
+            }
+            const auto R_num = img_adj.image_to_index( ref_img_refw );
+
             std::vector<float> shtl;
             shtl.reserve(100); // An arbitrary guess.
 
+            // Prepare the dedicated reduction kernel, if one applies to this neighbourhood.
+            std::unique_ptr<window_geometry> geom;
+            if(user_data_s->reduction != red_t::Generic){
+                if(user_data_s->neighbourhood == ComputeVolumetricNeighbourhoodSamplerUserData::Neighbourhood::Selection){
+                    geom = make_window_geometry(user_data_s->voxel_triplets);
+
+                }else if( (user_data_s->neighbourhood == ComputeVolumetricNeighbourhoodSamplerUserData::Neighbourhood::Cubic)
+                          && is_regular_grid ){
+                    // Mirrors the extent of the cubic neighbourhood sampled below.
+                    const auto dx_u = static_cast<long int>( std::floor( user_data_s->maximum_distance / pxl_dx ) );
+                    const auto dy_u = static_cast<long int>( std::floor( user_data_s->maximum_distance / pxl_dy ) );
+                    const auto dz_u = static_cast<long int>( std::floor( user_data_s->maximum_distance / pxl_dz ) );
+                    std::vector<triplet_t> box;
+                    for(long int i = -dx_u; i <= dx_u; ++i){
+                        for(long int j = -dy_u; j <= dy_u; ++j){
+                            for(long int k = -dz_u; k <= dz_u; ++k){
+                                box.push_back( triplet_t{{ i, j, k }} );
+                            }
+                        }
+                    }
+                    geom = make_window_geometry(box);
+                }
+            }
+            std::vector<std::unique_ptr<neighbourhood_window>> windows; // One per channel, created on demand.
+            const auto make_source = [&](long int chnl) -> window_source {
+                window_source src;
+                src.lo = geom->lo[2];
+                src.rows = ref_img_refw.get().rows;
+                src.columns = ref_img_refw.get().columns;
+                src.channel = chnl;
+                src.all_present = true;
+                for(long int k = geom->lo[2]; k <= geom->hi[2]; ++k){
+                    if(img_adj.index_present(R_num + k)){
+                        src.imgs.push_back( std::addressof( img_adj.index_to_image(R_num + k).get() ) );
+                    }else{
+                        src.imgs.push_back( nullptr );
+                        src.all_present = false;
+                    }
+                }
+                return src;
+            };
+
             auto f_bounded = [&,ref_img_refw](long int E_row, long int E_col, long int channel, std::reference_wrapper<planar_image<float,double>> /*img_refw*/, float &voxel_val) {
                 // No-op if this is the wrong channel.
                 if( (user_data_s->channel >= 0) && (channel != user_data_s->channel) ){
@@ -136,10 +524,19 @@ bool ComputeVolumetricNeighbourhoodSampler(planar_image_collection<float,double>
                 const auto rcc = ref_img_refw.get().row_column_channel_from_index(index);
                 const auto R_row = std::get<0>(rcc);
                 const auto R_col = std::get<1>(rcc);
-                if(!img_adj.image_present( ref_img_refw )){
-                    throw std::logic_error("One or more images were not included in the image adjacency determination. Refusing to continue.");
+
+                // Use the dedicated reduction kernel where possible.
+                if(geom && (0 <= channel)){
+                    const auto c_num = static_cast<size_t>(channel);
+                    if(windows.size() <= c_num) windows.resize(c_num + 1);
+                    if(!windows[c_num]){
+                        windows[c_num] = make_neighbourhood_window(user_data_s->reduction, *geom, make_source(channel),
+                                                                   user_data_s->weights);
+                    }
+                    if(windows[c_num] && windows[c_num]->evaluate(R_row, R_col, E_val, voxel_val)){
+                        return;
+                    }
                 }
-                const auto R_num = img_adj.image_to_index( ref_img_refw );
 
                 shtl.clear();
 
@@ -273,11 +670,12 @@ bool ComputeVolumetricNeighbourhoodSampler(planar_image_collection<float,double>
                 return;
             };
 
-            Mutate_Voxels<float,double>( img_refw,
-                                         { img_refw },
-                                         ccsl, 
-                                         mv_opts, 
-                                         f_bounded );
+            Mutate_Voxels_Cached( img_refw,
+                                  { img_refw },
+                                  ccsl, 
+                                  ccsl_fp,
+                                  mv_opts, 
+                                  f_bounded );
 
             if(!(user_data_s->description.empty())){
                 UpdateImageDescription( img_refw, user_data_s->description );
@@ -64,6 +64,33 @@ struct ComputeVolumetricNeighbourhoodSamplerUserData {
         return v; // Effectively does nothing.
     };
 
+    // -----------------------------
+    // Dedicated reduction kernel.
+    //
+    // If not 'Generic', the named reduction is computed directly from the image without collecting a shuttle or
+    // invoking f_reduce. For fixed-shape neighbourhoods (i.e., specific-voxel sampling and cubic neighbourhoods on
+    // regular grids) the reduction state is updated incrementally as the neighbourhood slides to an adjacent voxel,
+    // so only the voxels entering and leaving the neighbourhood are visited.
+    //
+    // Note: f_reduce is still used wherever the dedicated kernel does not apply, i.e., for spherical neighbourhoods,
+    //       neighbourhoods clipped by the image boundaries, and neighbourhoods containing non-finite voxels.
+    //       It must therefore implement the same reduction.
+    enum class
+    Reduction {
+        Generic,       // Always use f_reduce.
+        Mean,
+        Min,
+        Max,
+        Median,
+        StdDev,        // Square root of the unbiased variance estimate.
+        Standardize,   // The existing voxel value minus the mean, divided by the standard deviation.
+        Percentile01,  // The percentile (in [0,1]) of the existing voxel value, using the middle for duplicates.
+        WeightedMean,  // Weighted mean using the weights below. Only applicable to specific-voxel sampling.
+    } reduction = Reduction::Generic;
+
+    // Weights for the WeightedMean reduction, one per voxel triplet (in the same order).
+    std::vector<double> weights;
+
     // -----------------------------
     // Outgoing image description to imbue.
     std::string description;
@@ -56,40 +56,19 @@ bool ComputeVolumetricSpatialBlur(planar_image_collection<float,double> &imageco
     }
 
     if(user_data_s->estimator == VolumetricSpatialBlurEstimator::Gaussian){
-        auto f_reduce = [](float, std::vector<float> &shtl, vec3<double>) -> float {
+        // Note: The following weights come from the 1D Gaussian with sigma=1 integrated over the length of each voxel.
+        //       These weights are normalized to 1, so the w summation in f_reduce is only necessary in case some voxels
+        //       are inaccessible. The dedicated reduction kernel uses them wherever all voxels are accessible.
+        const std::vector<double> weights = { 0.006, 0.061, 0.242, 0.382, 0.242, 0.061, 0.006 };
+
+        auto f_reduce = [weights](float, std::vector<float> &shtl, vec3<double>) -> float {
                           double f = 0.0;
                           double w = 0.0;
-
-                          // Note: The following weights come from the 1D Gaussian with sigma=1 integrated over the
-                          //       length of each voxel. These weights are normalized to 1, so the w summation is only
-                          //       necessary in case some voxels are inaccessible.
-                          if(std::isfinite(shtl[0])){
-                              w += 0.006;
-                              f += 0.006 * shtl[0];
-                          }
-                          if(std::isfinite(shtl[1])){
-                              w += 0.061;
-                              f += 0.061 * shtl[1];
-                          }
-                          if(std::isfinite(shtl[2])){
-                              w += 0.242;
-                              f += 0.242 * shtl[2];
-                          }
-                          if(std::isfinite(shtl[3])){
-                              w += 0.382;
-                              f += 0.382 * shtl[3];
-                          }
-                          if(std::isfinite(shtl[4])){
-                              w += 0.242;
-                              f += 0.242 * shtl[4];
-                          }
-                          if(std::isfinite(shtl[5])){
-                              w += 0.061;
-                              f += 0.061 * shtl[5];
-                          }
-                          if(std::isfinite(shtl[6])){
-                              w += 0.006;
-                              f += 0.006 * shtl[6];
+                          for(size_t i = 0; i < weights.size(); ++i){
+                              if(std::isfinite(shtl[i])){
+                                  w += weights[i];
+                                  f += weights[i] * shtl[i];
+                              }
                           }
                           
                           if(w < 1E-3){
@@ -105,6 +84,8 @@ bool ComputeVolumetricSpatialBlur(planar_image_collection<float,double> &imageco
             ud.channel = user_data_s->channel;
             ud.neighbourhood = ComputeVolumetricNeighbourhoodSamplerUserData::Neighbourhood::Selection;
             ud.f_reduce = f_reduce;
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::WeightedMean;
+            ud.weights = weights;
 
             ud.voxel_triplets = {{ std::array<long int, 3>{ -3,  0,  0 },    // 0
                                    std::array<long int, 3>{ -2,  0,  0 },    // 1
@@ -129,6 +110,8 @@ bool ComputeVolumetricSpatialBlur(planar_image_collection<float,double> &imageco
             ud.channel = user_data_s->channel;
             ud.neighbourhood = ComputeVolumetricNeighbourhoodSamplerUserData::Neighbourhood::Selection;
             ud.f_reduce = f_reduce;
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::WeightedMean;
+            ud.weights = weights;
 
             ud.voxel_triplets = {{ std::array<long int, 3>{  0, -3,  0 },    // 0
                                    std::array<long int, 3>{  0, -2,  0 },    // 1
@@ -152,6 +135,8 @@ bool ComputeVolumetricSpatialBlur(planar_image_collection<float,double> &imageco
             ud.channel = user_data_s->channel;
             ud.neighbourhood = ComputeVolumetricNeighbourhoodSamplerUserData::Neighbourhood::Selection;
             ud.f_reduce = f_reduce;
+            ud.reduction = ComputeVolumetricNeighbourhoodSamplerUserData::Reduction::WeightedMean;
+            ud.weights = weights;
 
             ud.voxel_triplets = {{ std::array<long int, 3>{  0,  0, -3 },    // 0
                                    std::array<long int, 3>{  0,  0, -2 },    // 1
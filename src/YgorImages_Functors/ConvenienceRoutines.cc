@@ -3,6 +3,8 @@
 #include <exception>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 
@@ -68,3 +70,21 @@ void UpdateImageWindowCentreWidth(std::reference_wrapper<planar_image<float,doub
 void UpdateImageWindowCentreWidth(planar_image_collection<float,double>::images_list_it_t img_it){
     return UpdateImageWindowCentreWidth( std::ref(*img_it) );
 }
+
+
+Image_Adjacency_Cache::Image_Adjacency_Cache(std::list<std::reference_wrapper<planar_image_collection<float,double>>> in)
+    : imgs(std::move(in)) {}
+
+std::shared_ptr<const Image_Adjacency_Cache::adjacency_t>
+Image_Adjacency_Cache::get(const vec3<double> &orientation_normal){
+    std::lock_guard<std::mutex> lock(this->m);
+    const auto N = orientation_normal.unit();
+    for(const auto &p : this->cache){
+        if(p.first.distance(N) < 1E-6) return p.second;
+    }
+
+    auto adj = std::make_shared<const adjacency_t>( std::list<std::reference_wrapper<planar_image<float,double>>>(),
+                                                    this->imgs, N );
+    this->cache.emplace_back(N, adj);
+    return adj;
+}
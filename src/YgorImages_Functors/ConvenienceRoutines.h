@@ -3,9 +3,14 @@
 #pragma once
 
 #include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 
 #include "YgorImages.h"
+#include "YgorMath.h"
 
 namespace Stats {
 template <class C> class Running_MinMax;
@@ -39,3 +44,24 @@ void UpdateImageWindowCentreWidth(
 void UpdateImageWindowCentreWidth(
         planar_image_collection<float,double>::images_list_it_t img_it);
 
+
+//A thread-safe memo of image adjacency indices over a fixed set of image collections. An index is built once per
+// orientation and shared read-only by all callers, so concurrent tasks need not each build their own. The image
+// collections must not be altered while the memo is in use.
+class Image_Adjacency_Cache {
+    public:
+        using adjacency_t = planar_image_adjacency<float,double>;
+
+    private:
+        std::list<std::reference_wrapper<planar_image_collection<float,double>>> imgs;
+
+        std::mutex m;
+        std::list<std::pair<vec3<double>, std::shared_ptr<const adjacency_t>>> cache; // Keyed on orientation normal.
+
+    public:
+        explicit Image_Adjacency_Cache(std::list<std::reference_wrapper<planar_image_collection<float,double>>> imgs);
+
+        //Retrieve (building if needed) the index for the given orientation normal.
+        std::shared_ptr<const adjacency_t> get(const vec3<double> &orientation_normal);
+};
+
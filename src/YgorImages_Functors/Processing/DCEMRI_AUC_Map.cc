@@ -10,6 +10,7 @@
 #include <stdexcept>
 
 #include "../ConvenienceRoutines.h"
+#include "../Time_Series_Volume.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
 
@@ -20,36 +21,41 @@ bool DCEMRIAUCMap(planar_image_collection<float,double>::images_list_it_t first_
                   std::any ){
 
     //This routine integrates pixel channel values over time.
-    const bool InhibitSort = true; //We will explicitly sort once to speed up data ingress.
+    const bool InhibitSort = true; //The time series is already sorted.
+
+    //Harvest the time courses of all voxels at once. This also parses the timestamps once rather than per-voxel.
+    const Time_Series_Volume tsv(selected_img_its);
+    if( (tsv.slices != 1) || (tsv.rows != first_img_it->rows)
+    ||  (tsv.columns != first_img_it->columns) || (tsv.channels != first_img_it->channels) ){
+        throw std::invalid_argument("Images do not form a single time series. Cannot continue.");
+    }
+    const auto *t = tsv.time_points(0);
 
     //Record the min and max actual pixel values for windowing purposes.
     Stats::Running_MinMax<float> minmax_pixel;
 
     //Loop over the rows, columns, channels, and finally images.
+    samples_1D<double> channel_time_course;
     for(auto row = 0; row < first_img_it->rows; ++row){
         for(auto col = 0; col < first_img_it->columns; ++col){
             for(auto chan = 0; chan < first_img_it->channels; ++chan){
 
-                //Harvest the time course.
-                samples_1D<double> channel_time_course;
-                for(auto & img_it : selected_img_its){
-                    const auto val = static_cast<double>(img_it->value(row, col, chan));
-                    if(auto dt = img_it->GetMetadataValueAs<double>("dt")){
-                        channel_time_course.push_back(dt.value(), val, InhibitSort);
-                    }else{
-                        throw std::invalid_argument("Image missing timestamp. Cannot integrate. Cannot continue");
+                //Harvest the time course, purging NaNs (i.e., assume the data point is unknown but finite -- so
+                // interpolate to guess it).
+                const auto *c = tsv.time_course(0, row, col, chan);
+                channel_time_course.samples.clear();
+                for(long int i = 0; i < tsv.times; ++i){
+                    const auto val = static_cast<double>(c[i]);
+                    if(std::isfinite(t[i]) && std::isfinite(val)){
+                        channel_time_course.push_back(t[i], val, InhibitSort);
                     }
                 }
 
                 //'Prime' the pixel to default to NaN.
                 first_img_it->reference(row, col, chan) = std::numeric_limits<double>::quiet_NaN();
  
-                //Purge NaNs (i.e., assume the data point is unknown but finite -- so interpolate to guess it).
-                channel_time_course = channel_time_course.Purge_Nonfinite_Samples();
-
                 //Integrate.
                 if( channel_time_course.size() > 1 ){
-                    channel_time_course.stable_sort();
                     //const std::array<double,2> integ = channel_time_course.Integrate_Over_Kernel_unit(0.0, 600.0);
                     const std::array<double,2> integ = channel_time_course.Integrate_Over_Kernel_unit();
 
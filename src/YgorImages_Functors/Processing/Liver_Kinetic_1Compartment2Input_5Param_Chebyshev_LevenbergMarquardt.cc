@@ -2,7 +2,6 @@
 
 #ifdef DCMA_USE_GNU_GSL
 
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/iterator/iterator_traits.hpp>
 #include <cstddef>
 #include <array>
@@ -30,6 +29,7 @@
 #include "../ConvenienceRoutines.h"
 #include "Liver_Kinetic_1Compartment2Input_5Param_Chebyshev_Common.h"
 #include "Liver_Kinetic_1Compartment2Input_5Param_Chebyshev_LevenbergMarquardt.h"
+#include "Liver_Kinetic_Batch.h"
 #include "Liver_Kinetic_Common.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -148,11 +148,6 @@ KineticModel_Liver_1C2I_5Param_Chebyshev_LevenbergMarquardt(planar_image_collect
                    return !(std::regex_match(ROIName,user_data_s->TargetROIs));
     });
 
-    //This routine performs a number of calculations. It is experimental and excerpts you plan to rely on should be
-    // made into their own analysis functors.
-    const bool InhibitSort = true; //Disable continuous sorting (defer to single sort later) to speed up data ingress.
-
-
     //Figure out if there are any contours for which are within the spatial extent of the image. 
     // There are many ways to do this! Since we are merely highlighting the contours, we scan 
     // all specified collections and treat them homogeneously.
@@ -166,12 +161,13 @@ KineticModel_Liver_1C2I_5Param_Chebyshev_LevenbergMarquardt(planar_image_collect
     }
 
 
-    //Loop over the rois, rows, columns, channels, and finally any selected images (if applicable).
-    const auto row_unit   = first_img_it->row_unit;
-    const auto col_unit   = first_img_it->col_unit;
-    const auto ortho_unit = row_unit.Cross( col_unit ).unit();
-
-    size_t Minimization_Failure_Count = 0;
+    //Harvest the time course of every voxel within the ROI, and then fit the model to all voxels in parallel.
+    //
+    // This routine fits a pharmacokinetic model to the observed liver perfusion data using a 
+    // Chebyshev polynomial approximation scheme.
+    auto batch = KineticModel_Gather_Voxel_Batch(first_img_it, selected_img_its, cc_ROIs, ContrastInjectionLeadTime);
+    const size_t Minimization_Failure_Count = KineticModel_Fit_Voxel_Batch(batch, model_state,
+                                                  [](auto state){ return Optimize_LevenbergMarquardt_5Param(state); });
 
 
     //Record the min and max actual pixel values for windowing purposes.
@@ -181,287 +177,62 @@ KineticModel_Liver_1C2I_5Param_Chebyshev_LevenbergMarquardt(planar_image_collect
     Stats::Running_MinMax<float> minmax_tauV;
     Stats::Running_MinMax<float> minmax_k2;
 
-
-    //Perform a loop with no payload to determine how many optimizations will be needed.
-    //
-    // NOTE: We expect optimization to take far longer than cycling through the contours and images.
-    double Expected_Operation_Count = 0.0;
-    for(auto &ccs : cc_ROIs){
-        for(auto & contour : ccs.get().contours){
-            if(contour.points.empty()) continue;
-            if(! first_img_it->encompasses_contour_of_points(contour)) continue;
-
-            const auto ROIName =  contour.GetMetadataValueAs<std::string>("ROIName");
-            if(!ROIName){
-                FUNCWARN("Missing necessary tags for reporting analysis results. Cannot continue");
-                return false;
-            }
-            
-    /*
-            //Construct a bounding box to reduce computational demand of checking every voxel.
-            auto BBox = roi_it->Bounding_Box_Along(row_unit, 1.0);
-            auto BBoxBestFitPlane = BBox.Least_Squares_Best_Fit_Plane(vec3<double>(0.0,0.0,1.0));
-            auto BBoxProjectedContour = BBox.Project_Onto_Plane_Orthogonally(BBoxBestFitPlane);
-            const bool BBoxAlreadyProjected = true;
-    */
-    
-            //Prepare a contour for fast is-point-within-the-polygon checking.
-            auto BestFitPlane = contour.Least_Squares_Best_Fit_Plane(ortho_unit);
-            auto ProjectedContour = contour.Project_Onto_Plane_Orthogonally(BestFitPlane);
-            const bool AlreadyProjected = true;
-    
-            for(auto row = 0; row < first_img_it->rows; ++row){
-                for(auto col = 0; col < first_img_it->columns; ++col){
-                    //Figure out the spatial location of the present voxel.
-                    const auto point = first_img_it->position(row,col);
-    
-    /*
-                    //Check if within the bounding box. It will generally be cheaper than the full contour (4 points vs. ? points).
-                    auto BBoxProjectedPoint = BBoxBestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                    if(!BBoxProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BBoxBestFitPlane,
-                                                                                        BBoxProjectedPoint,
-                                                                                        BBoxAlreadyProjected)) continue;
-    */
-    
-                    //Perform a more detailed check to see if we are in the ROI.
-                    auto ProjectedPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                    if(ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                   ProjectedPoint,
-                                                                                   AlreadyProjected)){
-                        for(auto chan = 0; chan < first_img_it->channels; ++chan){
-   
-                            Expected_Operation_Count += 1.0;
-                        }//Loop over channels.
-    
-                    //If we're in the bounding box but not the ROI, do something.
-                    }else{
-                        //for(auto chan = 0; chan < first_img_it->channels; ++chan){
-                        //    const auto curr_val = working.value(row, col, chan);
-                        //    if(curr_val != 0) FUNCERR("There are overlapping ROI bboxes. This code currently cannot handle this. "
-                        //                              "You will need to run the functor individually on the overlapping ROIs.");
-                        //    working.reference(row, col, chan) = static_cast<float>(10);
-                        //}
-                    } // If is in ROI or ROI bbox.
-                } //Loop over cols
-            } //Loop over rows
-        } //Loop over ROIs.
-    } //Loop over contour_collections.
-
-
-
-    //Loop over the cc_ROIs, rois, rows, columns, channels, and finally any selected images (if applicable).
-    //for(const auto &roi : rois){
-    boost::posix_time::ptime start_t = boost::posix_time::microsec_clock::local_time();
-    double Actual_Operation_Count = 0.0;
-    for(auto &ccs : cc_ROIs){
-        for(auto & contour : ccs.get().contours){
-            if(contour.points.empty()) continue;
-            //if(first_img_it->encompasses_contour_of_points(*it)) rois.push_back(it);
-
-            //auto roi = *it;
-            if(! first_img_it->encompasses_contour_of_points(contour)) continue;
-
-            const auto ROIName =  contour.GetMetadataValueAs<std::string>("ROIName");
-            if(!ROIName){
-                FUNCWARN("Missing necessary tags for reporting analysis results. Cannot continue");
-                return false;
+    for(size_t v = 0; v < batch.size(); ++v){
+        const auto row  = batch.rows[v];
+        const auto col  = batch.columns[v];
+        const auto chan = batch.channels[v];
+
+        //==============================================================================
+        // Plot the fitted model with the ROI time course.
+        if(PixelsToPlot.count( {row, col}) != 0){ 
+            KineticModel_1Compartment2Input_5Param_Chebyshev_Parameters after_state = model_state;
+            after_state.cROI = std::make_shared<samples_1D<double>>( batch.time_course(v) );
+            after_state.k1A  = batch.k1A[v];
+            after_state.tauA = batch.tauA[v];
+            after_state.k1V  = batch.k1V[v];
+            after_state.tauV = batch.tauV[v];
+            after_state.k2   = batch.k2[v];
+            after_state.RSS  = batch.RSS[v];
+
+            std::map<std::string, samples_1D<double>> time_courses;
+            std::string title;
+            //Add the ROI.
+            title = "Chebyshev Approximation: ROI time course: row = " + std::to_string(row) + ", col = " + std::to_string(col);
+            time_courses[title] = *(after_state.cROI);
+            samples_1D<double> fitted_model;
+            KineticModel_1Compartment2Input_5Param_Chebyshev_Results eval_res;
+            for(const auto &P : after_state.cROI->samples){
+                const double t = P[0];
+                Evaluate_Model(after_state,t,eval_res);
+                fitted_model.push_back(t, 0.0, eval_res.I, 0.0);
             }
- 
-    /*
-            //Construct a bounding box to reduce computational demand of checking every voxel.
-            auto BBox = roi_it->Bounding_Box_Along(row_unit, 1.0);
-            auto BBoxBestFitPlane = BBox.Least_Squares_Best_Fit_Plane(vec3<double>(0.0,0.0,1.0));
-            auto BBoxProjectedContour = BBox.Project_Onto_Plane_Orthogonally(BBoxBestFitPlane);
-            const bool BBoxAlreadyProjected = true;
-    */
-    
-            //Prepare a contour for fast is-point-within-the-polygon checking.
-            auto BestFitPlane = contour.Least_Squares_Best_Fit_Plane(ortho_unit);
-            auto ProjectedContour = contour.Project_Onto_Plane_Orthogonally(BestFitPlane);
-            const bool AlreadyProjected = true;
-    
-            for(auto row = 0; row < first_img_it->rows; ++row){
-                for(auto col = 0; col < first_img_it->columns; ++col){
-                    //Figure out the spatial location of the present voxel.
-                    const auto point = first_img_it->position(row,col);
-    
-    /*
-                    //Check if within the bounding box. It will generally be cheaper than the full contour (4 points vs. ? points).
-                    auto BBoxProjectedPoint = BBoxBestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                    if(!BBoxProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BBoxBestFitPlane,
-                                                                                        BBoxProjectedPoint,
-                                                                                        BBoxAlreadyProjected)) continue;
-    */
-    
-                    //Perform a more detailed check to see if we are in the ROI.
-                    auto ProjectedPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(point);
-                    if(ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                   ProjectedPoint,
-                                                                                   AlreadyProjected)){
-                        for(auto chan = 0; chan < first_img_it->channels; ++chan){
-
-                            //Provide a prediction time.
-                            if(Actual_Operation_Count > 0.5){
-                                boost::posix_time::ptime current_t = boost::posix_time::microsec_clock::local_time();
-                                auto elapsed_dt = (current_t - start_t).total_milliseconds();
-                                auto expected_dt_f = static_cast<double>(elapsed_dt) * (Expected_Operation_Count/Actual_Operation_Count);
-                                auto expected_dt = static_cast<long int>(expected_dt_f);
-                                boost::posix_time::ptime predicted_dt( start_t + boost::posix_time::milliseconds(expected_dt) );
-                                FUNCINFO("Progress: " 
-                                    << Actual_Operation_Count << "/" << Expected_Operation_Count << " = " 
-                                    << static_cast<double>(static_cast<size_t>(1000.0*Actual_Operation_Count/Expected_Operation_Count))/10.0 
-                                    << "%. Expected finish time: " << predicted_dt);
-                            }
-                            Actual_Operation_Count += 1.0;
-
-                            //Cycle over the grouped images (temporal slices, or whatever the user has decided).
-                            // Harvest the time course or any other voxel-specific numbers.
-                            auto channel_time_course = std::make_shared<samples_1D<double>>();
-                            channel_time_course->uncertainties_known_to_be_independent_and_random = true;
-                            for(auto & img_it : selected_img_its){
-                                //Collect the datum of voxels and nearby voxels for an average.
-                                std::list<double> in_pixs;
-                                const auto boxr = 0;
-                                const auto min_datum = 1;
-    
-                                for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
-                                    for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
-                                        //Check if the coordinates are legal and in the ROI.
-                                        if( !isininc(0,lrow,img_it->rows-1) || !isininc(0,lcol,img_it->columns-1) ) continue;
-    
-                                        //const auto boxpoint = first_img_it->spatial_location(row,col);  //For standard contours(?).
-                                        //const auto neighbourpoint = vec3<double>(lrow*1.0, lcol*1.0, SliceLocation*1.0);  //For the pixel integer contours.
-                                        const auto neighbourpoint = first_img_it->position(lrow,lcol);
-                                        auto ProjectedNeighbourPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(neighbourpoint);
-                                        if(!ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                                        ProjectedNeighbourPoint,
-                                                                                                        AlreadyProjected)) continue;
-                                        const auto val = static_cast<double>(img_it->value(lrow, lcol, chan));
-                                        in_pixs.push_back(val);
-                                    }
-                                }
-                                auto dt = img_it->GetMetadataValueAs<double>("dt");
-                                if(!dt) FUNCERR("Image is missing time metadata. Bailing");
-
-                                const auto avg_val = Stats::Mean(in_pixs);
-                                if(in_pixs.size() < min_datum) continue; //If contours are too narrow so that there is too few datum for meaningful results.
-                                //const auto avg_val_sigma = std::sqrt(Stats::Unbiased_Var_Est(in_pixs))/std::sqrt(1.0*in_pixs.size());
-                                //channel_time_course.push_back(dt.value(), 0.0, avg_val, avg_val_sigma, InhibitSort);
-                                channel_time_course->push_back(dt.value(), 0.0, avg_val, 0.0, InhibitSort);
-                            }
-                            channel_time_course->stable_sort();
-                            if(channel_time_course->empty()) continue;
-  
-                            //Correct any unaccounted-for contrast enhancement shifts. 
-                            // (If we don't do this, the optimizer goes crazy because the model has to be zero at t=0.)
-                            if(true){
-                                //Subtract the minimum over the full time course.
-                                if(false){
-                                    const auto Cmin = channel_time_course->Get_Extreme_Datum_y().first;
-                                    *channel_time_course = channel_time_course->Sum_With(0.0-Cmin[2]);
-
-                                //Subtract the mean from the pre-injection period.
-                                }else{
-                                    const auto preinject = channel_time_course->Select_Those_Within_Inc(-1E99,ContrastInjectionLeadTime);
-                                    const auto themean = preinject.Mean_y()[0];
-                                    *channel_time_course = channel_time_course->Sum_With(0.0-themean);
-                                }
-                            }
-
-
-                            //==============================================================================
-                            //Fit the model.
-
-                            // This routine fits a pharmacokinetic model to the observed liver perfusion data using a 
-                            // Chebyshev polynomial approximation scheme.
-
-                            model_state.FittingPerformed = false;
-                            model_state.cROI = channel_time_course;
-                            model_state.k1A  = std::numeric_limits<double>::quiet_NaN();
-                            model_state.tauA = std::numeric_limits<double>::quiet_NaN();
-                            model_state.k1V  = std::numeric_limits<double>::quiet_NaN();
-                            model_state.tauV = std::numeric_limits<double>::quiet_NaN();
-                            model_state.k2   = std::numeric_limits<double>::quiet_NaN();
-
-                            //KineticModel_1Compartment2Input_5Param_Chebyshev_Parameters after_state = Optimize_LevenbergMarquardt_3Param(model_state);
-                            KineticModel_1Compartment2Input_5Param_Chebyshev_Parameters after_state = Optimize_LevenbergMarquardt_5Param(model_state);
-
-                            if(!after_state.FittingSuccess) ++Minimization_Failure_Count;
-
-                            const double RSS  = after_state.RSS;
-                            const double k1A  = after_state.k1A;
-                            const double tauA = after_state.tauA;
-                            const double k1V  = after_state.k1V;
-                            const double tauV = after_state.tauV;
-                            const double k2   = after_state.k2;
-                            if(true) FUNCINFO("k1A,tauA,k1V,tauV,k2,RSS = " << k1A << ", " << tauA << ", " 
-                                              << k1V << ", " << tauV << ", " << k2 << ", " << RSS);
-
-                            const auto LiverPerfusion = (k1A + k1V);
-                            const auto MeanTransitTime = 1.0 / k2;
-                            const auto ArterialFraction = 100.0 * k1A / LiverPerfusion;
-                            const auto DistributionVolume = 100.0 * LiverPerfusion * MeanTransitTime;
-
-                            //==============================================================================
-                            // Plot the fitted model with the ROI time course.
-                            if(PixelsToPlot.count( {row, col}) != 0){ 
-                                std::map<std::string, samples_1D<double>> time_courses;
-                                std::string title;
-                                //Add the ROI.
-                                title = "Chebyshev Approximation: ROI time course: row = " + std::to_string(row) + ", col = " + std::to_string(col);
-                                time_courses[title] = *(after_state.cROI);
-                                samples_1D<double> fitted_model;
-                                KineticModel_1Compartment2Input_5Param_Chebyshev_Results eval_res;
-                                for(const auto &P : after_state.cROI->samples){
-                                    const double t = P[0];
-                                    Evaluate_Model(after_state,t,eval_res);
-                                    fitted_model.push_back(t, 0.0, eval_res.I, 0.0);
-                                }
-                                title = "Fitted model";
-                                time_courses[title] = fitted_model;
-
-                                PlotTimeCourses("Raw ROI and Fitted Model", time_courses, {});
-                            }
-                            
-                            //==============================================================================
- 
-                            //Update pixel values.
-                            const auto k1A_f  = static_cast<float>(k1A);
-                            const auto tauA_f = static_cast<float>(tauA);
-                            const auto k1V_f  = static_cast<float>(k1V);
-                            const auto tauV_f = static_cast<float>(tauV);
-                            const auto k2_f   = static_cast<float>(k2);
-
-                            minmax_k1A.Digest(k1A_f);
-                            minmax_tauA.Digest(tauA_f);
-                            minmax_k1V.Digest(k1V_f);
-                            minmax_tauV.Digest(tauV_f);
-                            minmax_k2.Digest(k2_f);
-
-                            {
-                                out_img_k1A.get().reference(row, col, chan)  = k1A_f;
-                                out_img_tauA.get().reference(row, col, chan) = tauA_f;
-                                out_img_k1V.get().reference(row, col, chan)  = k1V_f;
-                                out_img_tauV.get().reference(row, col, chan) = tauV_f;
-                                out_img_k2.get().reference(row, col, chan)   = k2_f;
-                            }
-                            // ----------------------------------------------------------------------------
-    
-                        }//Loop over channels.
-    
-                    //If we're in the bounding box but not the ROI, do something.
-                    }else{
-                        //for(auto chan = 0; chan < first_img_it->channels; ++chan){
-                        //    const auto curr_val = working.value(row, col, chan);
-                        //    if(curr_val != 0) FUNCERR("There are overlapping ROI bboxes. This code currently cannot handle this. "
-                        //                              "You will need to run the functor individually on the overlapping ROIs.");
-                        //    working.reference(row, col, chan) = static_cast<float>(10);
-                        //}
-                    } // If is in ROI or ROI bbox.
-                } //Loop over cols
-            } //Loop over rows
-        } //Loop over ROIs.
-    } //Loop over contour_collections.
+            title = "Fitted model";
+            time_courses[title] = fitted_model;
+
+            PlotTimeCourses("Raw ROI and Fitted Model", time_courses, {});
+        }
+
+        //==============================================================================
+
+        //Update pixel values.
+        const auto k1A_f  = static_cast<float>(batch.k1A[v]);
+        const auto tauA_f = static_cast<float>(batch.tauA[v]);
+        const auto k1V_f  = static_cast<float>(batch.k1V[v]);
+        const auto tauV_f = static_cast<float>(batch.tauV[v]);
+        const auto k2_f   = static_cast<float>(batch.k2[v]);
+
+        minmax_k1A.Digest(k1A_f);
+        minmax_tauA.Digest(tauA_f);
+        minmax_k1V.Digest(k1V_f);
+        minmax_tauV.Digest(tauV_f);
+        minmax_k2.Digest(k2_f);
+
+        out_img_k1A.get().reference(row, col, chan)  = k1A_f;
+        out_img_tauA.get().reference(row, col, chan) = tauA_f;
+        out_img_k1V.get().reference(row, col, chan)  = k1V_f;
+        out_img_tauV.get().reference(row, col, chan) = tauV_f;
+        out_img_k2.get().reference(row, col, chan)   = k2_f;
+    }
 
     FUNCWARN("Minimization failure count: " << Minimization_Failure_Count);
 
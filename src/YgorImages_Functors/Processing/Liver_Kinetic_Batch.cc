@@ -0,0 +1,125 @@
+//Liver_Kinetic_Batch.cc.
+
+#ifdef DCMA_USE_GNU_GSL
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+#include "../../Thread_Pool.h"
+#include "../Time_Series_Volume.h"
+#include "Liver_Kinetic_Batch.h"
+
+
+samples_1D<double>
+KineticModel_Voxel_Batch::time_course(size_t voxel) const {
+    const size_t N_t = this->t.size();
+    samples_1D<double> out;
+    out.uncertainties_known_to_be_independent_and_random = true;
+    const bool InhibitSort = true;
+    for(size_t i = 0; i < N_t; ++i){
+        out.push_back(this->t[i], 0.0, this->values[voxel * N_t + i], 0.0, InhibitSort);
+    }
+    return out;
+}
+
+
+KineticModel_Voxel_Batch
+KineticModel_Gather_Voxel_Batch(planar_image_collection<float,double>::images_list_it_t first_img_it,
+                                const std::list<planar_image_collection<float,double>::images_list_it_t> &selected_img_its,
+                                const std::list<std::reference_wrapper<contour_collection<double>>> &cc_ROIs,
+                                double ContrastInjectionLeadTime){
+    KineticModel_Voxel_Batch batch;
+
+    const long int N_rows = first_img_it->rows;
+    const long int N_cols = first_img_it->columns;
+    const long int N_chns = first_img_it->channels;
+
+    //Harvest the time series, which orders the images temporally. Images acquired at the same time retain their
+    // relative order.
+    if(selected_img_its.empty()) return batch;
+    const Time_Series_Volume tsv(selected_img_its);
+    if( (tsv.slices != 1) || (tsv.rows != N_rows) || (tsv.columns != N_cols) || (tsv.channels != N_chns) ){
+        throw std::invalid_argument("Images do not form a single time series. Cannot continue.");
+    }
+    batch.t.assign(tsv.time_points(0), tsv.time_points(0) + tsv.times);
+    const size_t N_t = batch.t.size();
+    if(N_t == 0) return batch;
+
+    //Determine which voxels are within any of the contours, performing the point-in-polygon test once per voxel.
+    const auto row_unit   = first_img_it->row_unit;
+    const auto col_unit   = first_img_it->col_unit;
+    const auto ortho_unit = row_unit.Cross( col_unit ).unit();
+
+    std::vector<unsigned char> in_ROI(N_rows * N_cols, 0);
+    for(const auto &ccs : cc_ROIs){
+        for(const auto &contour : ccs.get().contours){
+            if(contour.points.empty()) continue;
+            if(! first_img_it->encompasses_contour_of_points(contour)) continue;
+
+            //Prepare a contour for fast is-point-within-the-polygon checking.
+            const auto BestFitPlane = contour.Least_Squares_Best_Fit_Plane(ortho_unit);
+            const auto ProjectedContour = contour.Project_Onto_Plane_Orthogonally(BestFitPlane);
+            const bool AlreadyProjected = true;
+
+            parallel_for(0, static_cast<size_t>(N_rows), [&](size_t row) -> void {
+                for(long int col = 0; col < N_cols; ++col){
+                    auto &m = in_ROI[row * N_cols + col];
+                    if(m != 0) continue;
+
+                    const auto point = first_img_it->position(row,col);
+                    const auto ProjectedPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(point);
+                    if(ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
+                                                                                   ProjectedPoint,
+                                                                                   AlreadyProjected)){
+                        m = 1;
+                    }
+                }
+            });
+        }
+    }
+
+    for(long int row = 0; row < N_rows; ++row){
+        for(long int col = 0; col < N_cols; ++col){
+            if(in_ROI[row * N_cols + col] == 0) continue;
+            for(long int chan = 0; chan < N_chns; ++chan){
+                batch.rows.push_back(row);
+                batch.columns.push_back(col);
+                batch.channels.push_back(chan);
+            }
+        }
+    }
+
+    //Harvest the time courses.
+    //
+    // Unaccounted-for contrast enhancement shifts are removed by subtracting the mean of the pre-injection period.
+    // (If we don't do this, the optimizer goes crazy because the model has to be zero at t=0.)
+    const size_t N_pre = static_cast<size_t>( std::distance(batch.t.begin(),
+                                                            std::upper_bound(batch.t.begin(), batch.t.end(),
+                                                                             ContrastInjectionLeadTime)) );
+    const size_t N_v = batch.size();
+    batch.values.resize(N_v * N_t);
+    parallel_for(0, N_v, [&](size_t v) -> void {
+        double *c = &(batch.values[v * N_t]);
+        const float *in = tsv.time_course(0, batch.rows[v], batch.columns[v], batch.channels[v]);
+        std::copy(in, in + N_t, c);
+        if(N_pre != 0){
+            const double baseline = std::accumulate(c, c + N_pre, 0.0) / static_cast<double>(N_pre);
+            for(size_t i = 0; i < N_t; ++i) c[i] -= baseline;
+        }
+    });
+
+    return batch;
+}
+
+#endif // DCMA_USE_GNU_GSL
+
@@ -0,0 +1,165 @@
+//Liver_Kinetic_Batch.h.
+#pragma once
+
+#ifdef DCMA_USE_GNU_GSL
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+#include "../../Thread_Pool.h"
+
+template <class T> class contour_collection;
+
+
+// A block of voxel time courses harvested from a group of images, stored as a structure of arrays.
+//
+// Voxels are gathered in raster order (row, then column, then channel), so consecutive voxels are usually spatial
+// neighbours. All time courses share the same sample times.
+struct KineticModel_Voxel_Batch {
+
+    // Sample times shared by all time courses, in increasing order.
+    std::vector<double> t;
+
+    // Voxel coordinates, one entry per voxel.
+    std::vector<long int> rows;
+    std::vector<long int> columns;
+    std::vector<long int> channels;
+
+    // Time courses, stored contiguously as (voxel * t.size()) + sample. The mean of the pre-injection period has
+    // already been subtracted.
+    std::vector<double> values;
+
+    // Fitted parameters and fit status, one entry per voxel. Populated by KineticModel_Fit_Voxel_Batch().
+    std::vector<double> k1A;
+    std::vector<double> tauA;
+    std::vector<double> k1V;
+    std::vector<double> tauV;
+    std::vector<double> k2;
+    std::vector<double> RSS;
+    std::vector<unsigned char> success;
+
+    size_t size() const { return this->rows.size(); }
+
+    // Reconstructs the time course of a single voxel.
+    samples_1D<double> time_course(size_t voxel) const;
+};
+
+
+// Harvests the time course of every voxel within the provided contours. The first image defines the voxel grid and
+// the contour membership test is performed once per voxel. Images must have 'dt' metadata.
+KineticModel_Voxel_Batch
+KineticModel_Gather_Voxel_Batch(planar_image_collection<float,double>::images_list_it_t first_img_it,
+                                const std::list<planar_image_collection<float,double>::images_list_it_t> &selected_img_its,
+                                const std::list<std::reference_wrapper<contour_collection<double>>> &cc_ROIs,
+                                double ContrastInjectionLeadTime);
+
+
+// Fits a kinetic model to every voxel time course in the batch using all available threads. Returns the number of
+// fits that did not report success.
+//
+// The prototype state provides the input time courses and any computation adjustments; it is copied into a workspace
+// once per run of consecutive voxels, along with a single ROI time course buffer that is overwritten for each voxel.
+// Each fit is seeded with the parameters of the preceding voxel when that voxel is an adjacent neighbour that was
+// fitted successfully. If a seeded fit fails, the voxel is re-fitted from the optimizer's default initial guesses.
+//
+// The optimizer is any routine with the signature 'Parameters optimize(Parameters)', e.g.,
+// Optimize_LevenbergMarquardt_5Param().
+template <class Parameters, class Optimizer>
+size_t
+KineticModel_Fit_Voxel_Batch(KineticModel_Voxel_Batch &batch,
+                             const Parameters &prototype,
+                             Optimizer optimize){
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    const size_t N_v = batch.size();
+    const size_t N_t = batch.t.size();
+
+    batch.k1A.assign(N_v, nan);
+    batch.tauA.assign(N_v, nan);
+    batch.k1V.assign(N_v, nan);
+    batch.tauV.assign(N_v, nan);
+    batch.k2.assign(N_v, nan);
+    batch.RSS.assign(N_v, nan);
+    batch.success.assign(N_v, 0);
+    if((N_v == 0) || (N_t == 0)) return 0;
+
+    std::atomic<size_t> failures(0);
+    const auto t_start = std::chrono::steady_clock::now();
+
+    const size_t run_length = 32;
+    const size_t N_runs = (N_v + run_length - 1) / run_length;
+    parallel_for(0, N_runs, [&](size_t run) -> void {
+        const size_t v_begin = run * run_length;
+        const size_t v_end = std::min(N_v, v_begin + run_length);
+
+        // Per-run workspace.
+        Parameters state = prototype;
+        state.cROI = std::make_shared<samples_1D<double>>();
+        state.cROI->uncertainties_known_to_be_independent_and_random = true;
+        const bool InhibitSort = true;
+        for(const auto &t : batch.t) state.cROI->push_back(t, 0.0, 0.0, 0.0, InhibitSort);
+
+        const auto fit = [&](size_t v, bool seeded) -> Parameters {
+            state.FittingPerformed = false;
+            state.FittingSuccess = false;
+            state.RSS = nan;
+            if(seeded){
+                state.k1A  = batch.k1A[v - 1];
+                state.tauA = batch.tauA[v - 1];
+                state.k1V  = batch.k1V[v - 1];
+                state.tauV = batch.tauV[v - 1];
+                state.k2   = batch.k2[v - 1];
+            }else{
+                state.k1A  = nan;
+                state.tauA = nan;
+                state.k1V  = nan;
+                state.tauV = nan;
+                state.k2   = nan;
+            }
+            return optimize(state);
+        };
+
+        for(size_t v = v_begin; v < v_end; ++v){
+            const double *c = &(batch.values[v * N_t]);
+            for(size_t i = 0; i < N_t; ++i) state.cROI->samples[i][2] = c[i];
+
+            const bool seeded = (v != v_begin)
+                             && (batch.success[v - 1] != 0)
+                             && (batch.channels[v - 1] == batch.channels[v])
+                             && (batch.rows[v - 1] == batch.rows[v])
+                             && (batch.columns[v - 1] + 1 == batch.columns[v]);
+
+            Parameters after_state = fit(v, seeded);
+            if(seeded && !after_state.FittingSuccess) after_state = fit(v, false);
+            if(!after_state.FittingSuccess) ++failures;
+
+            batch.k1A[v]     = after_state.k1A;
+            batch.tauA[v]    = after_state.tauA;
+            batch.k1V[v]     = after_state.k1V;
+            batch.tauV[v]    = after_state.tauV;
+            batch.k2[v]      = after_state.k2;
+            batch.RSS[v]     = after_state.RSS;
+            batch.success[v] = after_state.FittingSuccess ? 1 : 0;
+        }
+    }, 1);
+
+    const auto t_stop = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(t_stop - t_start).count();
+    FUNCINFO("Fitted " << N_v << " voxel time courses in " << elapsed << " s"
+             << " (" << static_cast<double>(N_v) / std::max(elapsed, 1.0E-9) << " fits/s)");
+    return failures.load();
+}
+
+#endif // DCMA_USE_GNU_GSL
+
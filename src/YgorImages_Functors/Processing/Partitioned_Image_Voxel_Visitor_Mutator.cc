@@ -5,6 +5,7 @@
 #include <stdexcept>
 
 #include "../ConvenienceRoutines.h"
+#include "../ROI_Mask_Cache.h"
 #include "Partitioned_Image_Voxel_Visitor_Mutator.h"
 #include "YgorImages.h"
 #include "YgorMisc.h"
@@ -47,13 +48,13 @@ bool PartitionedImageVoxelVisitorMutator(planar_image_collection<float,double>::
     std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs;
     for(auto &img_it : selected_img_its) selected_imgs.push_back( std::ref(*img_it) );
 
-    Mutate_Voxels<float,double>( std::ref(*first_img_it),
-                                 selected_imgs, 
-                                 ccsl, 
-                                 user_data_s->mutation_opts, 
-                                 user_data_s->f_bounded,
-                                 user_data_s->f_unbounded,
-                                 user_data_s->f_visitor );
+    Mutate_Voxels_Cached( std::ref(*first_img_it),
+                          selected_imgs, 
+                          ccsl, 
+                          user_data_s->mutation_opts, 
+                          user_data_s->f_bounded,
+                          user_data_s->f_unbounded,
+                          user_data_s->f_visitor );
 
 
     //Alter the first image's metadata to reflect that averaging has occurred. You might want to consider
@@ -6,8 +6,10 @@
 #include <functional>
 #include <list>
 #include <map>
+#include <stdexcept>
 
 #include "../ConvenienceRoutines.h"
+#include "../Time_Series_Volume.h"
 #include "Per_ROI_Time_Courses.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
@@ -38,7 +40,6 @@ bool PerROITimeCourses(planar_image_collection<float,double>::images_list_it_t f
 
     //This routine performs a number of calculations. It is experimental and excerpts you plan to rely on should be
     // made into their own analysis functors.
-    const bool InhibitSort = true; //Disable continuous sorting (defer to single sort later) to speed up data ingress.
 
 
     //Figure out if there are any contours for which are within the spatial extent of the image. 
@@ -71,6 +72,13 @@ bool PerROITimeCourses(planar_image_collection<float,double>::images_list_it_t f
     //Paint all pixels black.
     working.fill_pixels(static_cast<float>(0));
 
+    //Harvest the time courses of all voxels at once. This also parses the timestamps once rather than per-voxel.
+    const Time_Series_Volume tsv(selected_img_its);
+    if( (tsv.slices != 1) || (tsv.rows != first_img_it->rows)
+    ||  (tsv.columns != first_img_it->columns) || (tsv.channels != first_img_it->channels) ){
+        throw std::invalid_argument("Images do not form a single time series. Cannot continue.");
+    }
+
     //Loop over the rois, rows, columns, channels, and finally any selected images (if applicable).
     const auto row_unit   = first_img_it->row_unit;
     const auto col_unit   = first_img_it->col_unit;
@@ -149,41 +157,8 @@ bool PerROITimeCourses(planar_image_collection<float,double>::images_list_it_t f
                                                           "You will need to run the functor individually on the overlapping ROIs.");
                             }
     
-                            //Cycle over the grouped images (temporal slices, or whatever the user has decided).
-                            // Harvest the time course or any other voxel-specific numbers.
-                            samples_1D<double> channel_time_course;
-                            channel_time_course.uncertainties_known_to_be_independent_and_random = true;
-                            for(auto & img_it : selected_img_its){
-                                //Collect the datum of voxels and nearby voxels for an average.
-                                std::list<double> in_pixs;
-                                const auto boxr = 0;
-                                const auto min_datum = 1;
-    
-                                for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
-                                    for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
-                                        //Check if the coordinates are legal and in the ROI.
-                                        if( !isininc(0,lrow,img_it->rows-1) || !isininc(0,lcol,img_it->columns-1) ) continue;
-    
-                                        //const auto boxpoint = first_img_it->spatial_location(row,col);  //For standard contours(?).
-                                        //const auto neighbourpoint = vec3<double>(lrow*1.0, lcol*1.0, SliceLocation*1.0);  //For the pixel integer contours.
-                                        const auto neighbourpoint = first_img_it->position(lrow,lcol);
-                                        auto ProjectedNeighbourPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(neighbourpoint);
-                                        if(!ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                                        ProjectedNeighbourPoint,
-                                                                                                        AlreadyProjected)) continue;
-                                        const auto val = static_cast<double>(img_it->value(lrow, lcol, chan));
-                                        in_pixs.push_back(val);
-                                    }
-                                }
-                                const auto avg_val = Stats::Mean(in_pixs);
-                                if(in_pixs.size() < min_datum) continue; //If contours are too narrow so that there is too few datum for meaningful results.
-                                const auto avg_val_sigma = std::sqrt(Stats::Unbiased_Var_Est(in_pixs))/std::sqrt(1.0*in_pixs.size());
-    
-                                auto dt = img_it->GetMetadataValueAs<double>("dt");
-                                if(!dt) FUNCERR("Image is missing time metadata. Bailing");
-                                channel_time_course.push_back(dt.value(), 0.0, avg_val, avg_val_sigma, InhibitSort);
-                            }
-                            channel_time_course.stable_sort();
+                            //Harvest the time course. (The voxel is within the ROI, so no neighbourhood is needed.)
+                            const auto channel_time_course = tsv.time_course_samples(0, row, col, chan);
                             if(channel_time_course.empty()) continue;
     
                             //Fill in some basic time course metadata.
@@ -1,10 +1,15 @@
 
+#include <algorithm>
 #include <any>
 #include <optional>
 #include <functional>
 #include <list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "../ConvenienceRoutines.h"
+#include "../Time_Series_Volume.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
 #include "YgorMisc.h"
@@ -28,7 +33,7 @@ bool TimeCourseSlopeDifference(planar_image_collection<float,double>::images_lis
     //This routine computes a map of the difference of slopes fit over two time periods:
     //    (slope over t2range) - (slope over t1range).
     // The ranges may overlap if you want.
-    const bool InhibitSort = true; //Disable continuous sorting (defer to single sort later) to speed up data ingress.
+    const bool InhibitSort = true; //The time series is already sorted.
 
     //Figure out if there are any contours for which are within the spatial extent of the image. 
     // There are many ways to do this! Since we are merely highlighting the contours, we scan 
@@ -54,6 +59,16 @@ bool TimeCourseSlopeDifference(planar_image_collection<float,double>::images_lis
     //Paint all pixels black.
     working.fill_pixels(static_cast<float>(0));
 
+    //Harvest the time courses of all voxels at once. This also parses the timestamps once rather than per-voxel.
+    const Time_Series_Volume tsv(selected_img_its);
+    if( (tsv.slices != 1) || (tsv.rows != first_img_it->rows)
+    ||  (tsv.columns != first_img_it->columns) || (tsv.channels != first_img_it->channels) ){
+        throw std::invalid_argument("Images do not form a single time series. Cannot continue.");
+    }
+    const auto *t = tsv.time_points(0);
+    std::vector<double> sums(tsv.times);
+    std::vector<std::pair<long int, long int>> neighbours;
+
     //Record the min and max actual pixel values for windowing purposes.
     Stats::Running_MinMax<float> minmax_pixel;
 
@@ -96,42 +111,39 @@ bool TimeCourseSlopeDifference(planar_image_collection<float,double>::images_lis
                 if(ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
                                                                                ProjectedPoint,
                                                                                AlreadyProjected)){
+                    //Collect the nearby voxels that are also in the ROI, which are the same for every image.
+                    neighbours.clear();
+                    for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
+                        for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
+                            //Check if the coordinates are legal and in the ROI.
+                            if( !isininc(0,lrow,tsv.rows-1) || !isininc(0,lcol,tsv.columns-1) ) continue;
+
+                            //const auto boxpoint = first_img_it->spatial_location(row,col);  //For standard contours(?).
+                            //const auto neighbourpoint = vec3<double>(lrow*1.0, lcol*1.0, SliceLocation*1.0);  //For the pixel integer contours.
+                            const auto neighbourpoint = first_img_it->position(lrow,lcol);
+                            auto ProjectedNeighbourPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(neighbourpoint);
+                            if(!ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
+                                                                                            ProjectedNeighbourPoint,
+                                                                                            AlreadyProjected)) continue;
+                            neighbours.emplace_back(lrow, lcol);
+                        }
+                    }
+                    if(neighbours.size() < min_datum) continue; //If contours are too narrow so that there is too few datum for meaningful results.
+
                     for(auto chan = 0; chan < first_img_it->channels; ++chan){
-                        //Cycle over the grouped images (temporal slices, or whatever the user has decided).
-                        // Harvest the time course or any other voxel-specific numbers.
+                        //Average the time courses of the voxel and nearby voxels.
+                        std::fill(sums.begin(), sums.end(), 0.0);
+                        for(const auto &n : neighbours){
+                            const auto *c = tsv.time_course(0, n.first, n.second, chan);
+                            for(long int i = 0; i < tsv.times; ++i) sums[i] += static_cast<double>(c[i]);
+                        }
+
                         samples_1D<double> channel_time_course;
                         channel_time_course.uncertainties_known_to_be_independent_and_random = true;
-                        for(auto & img_it : selected_img_its){
-                            //Collect the datum of voxels and nearby voxels for an average.
-                            std::list<double> in_pixs;
-                            for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
-                                for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
-                                    //Check if the coordinates are legal and in the ROI.
-                                    if( !isininc(0,lrow,img_it->rows-1) || !isininc(0,lcol,img_it->columns-1) ) continue;
-
-                                    //const auto boxpoint = first_img_it->spatial_location(row,col);  //For standard contours(?).
-                                    //const auto neighbourpoint = vec3<double>(lrow*1.0, lcol*1.0, SliceLocation*1.0);  //For the pixel integer contours.
-                                    const auto neighbourpoint = first_img_it->position(lrow,lcol);
-                                    auto ProjectedNeighbourPoint = BestFitPlane.Project_Onto_Plane_Orthogonally(neighbourpoint);
-                                    if(!ProjectedContour.Is_Point_In_Polygon_Projected_Orthogonally(BestFitPlane,
-                                                                                                    ProjectedNeighbourPoint,
-                                                                                                    AlreadyProjected)) continue;
-                                    const auto val = static_cast<double>(img_it->value(lrow, lcol, chan));
-                                    in_pixs.push_back(val);
-                                }
-                            }
-                            const auto avg_val = Stats::Mean(in_pixs);
-                            if(in_pixs.size() < min_datum) continue; //If contours are too narrow so that there is too few datum for meaningful results.
-                            //const auto avg_val_sigma = std::sqrt(Stats::Unbiased_Var_Est(in_pixs))/std::sqrt(1.0*in_pixs.size());
-
-                            if(auto dt = img_it->GetMetadataValueAs<double>("dt")){
-                                //channel_time_course.push_back(dt.value(), 0.0, avg_val, avg_val_sigma, InhibitSort);
-                                channel_time_course.push_back(dt.value(), 0.0, avg_val, 0.0, InhibitSort);
-                            }else{
-                                FUNCERR("Image is missing time metadata. Bailing");
-                            }
+                        for(long int i = 0; i < tsv.times; ++i){
+                            const auto avg_val = sums[i] / static_cast<double>(neighbours.size());
+                            channel_time_course.push_back(t[i], 0.0, avg_val, 0.0, InhibitSort);
                         }
-                        channel_time_course.stable_sort();
                         if(channel_time_course.empty()) continue;
        
                         // --------------- Perform some calculations on the time course ---------------
@@ -6,8 +6,11 @@
 #include <functional>
 #include <list>
 #include <map>
+#include <stdexcept>
+#include <vector>
 
 #include "../ConvenienceRoutines.h"
+#include "../Time_Series_Volume.h"
 #include "YgorImages.h"
 #include "YgorMath.h"
 #include "YgorMisc.h"
@@ -24,7 +27,7 @@ bool TimeCourseSlopeMap(planar_image_collection<float,double>::images_list_it_t
 
     //This routine collects voxel time series, fits a line (or computes a Spearman's rank correlation coefficient), and
     // produces a map of the resulting slope over the speecified time.
-    const bool InhibitSort = true; //Disable continuous sorting (defer to single sort later) to speed up data ingress.
+    const bool InhibitSort = true; //The time series is already sorted.
 
     //Make a 'working' image which we can edit. Start by duplicating the first image.
     planar_image<float,double> working;
@@ -40,6 +43,15 @@ bool TimeCourseSlopeMap(planar_image_collection<float,double>::images_list_it_t
         return false;
     }
 
+    //Harvest the time courses of all voxels at once. This also parses the timestamps once rather than per-voxel.
+    const Time_Series_Volume tsv(selected_img_its);
+    if( (tsv.slices != 1) || (tsv.rows != first_img_it->rows)
+    ||  (tsv.columns != first_img_it->columns) || (tsv.channels != first_img_it->channels) ){
+        throw std::invalid_argument("Images do not form a single time series. Cannot continue.");
+    }
+    const auto *t = tsv.time_points(0);
+    std::vector<double> sums(tsv.times);
+
     //Record the min and max actual pixel values for windowing purposes.
     Stats::Running_MinMax<float> minmax_pixel;
 
@@ -47,36 +59,29 @@ bool TimeCourseSlopeMap(planar_image_collection<float,double>::images_list_it_t
     for(auto row = 0; row < first_img_it->rows; ++row){
         for(auto col = 0; col < first_img_it->columns; ++col){
             for(auto chan = 0; chan < first_img_it->channels; ++chan){
-                //Cycle over the grouped images (temporal slices, or whatever the user has decided).
-                // Harvest the time course or any other voxel-specific numbers.
-                samples_1D<double> channel_time_course;
-                channel_time_course.uncertainties_known_to_be_independent_and_random = true;
-                for(auto & img_it : selected_img_its){
-                    //Collect the datum of voxels and nearby voxels for an average.
-                    std::list<double> in_pixs;
-                    auto boxr = 1; //The inclusive 'radius' of the square box to use to average nearby pixels.
-                    for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
-                        for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
-                            //Check if the coordinates are legal.
-                            if( isininc(0,lrow,img_it->rows-1) 
-                            &&  isininc(0,lcol,img_it->columns-1) ){ 
-                                const auto val = static_cast<double>(img_it->value(lrow, lcol, chan));
-                                in_pixs.push_back(val);
-                            }
+                //Average the time courses of the voxel and nearby voxels.
+                const auto boxr = 1; //The inclusive 'radius' of the square box to use to average nearby pixels.
+                std::fill(sums.begin(), sums.end(), 0.0);
+                long int N_pixs = 0;
+                for(auto lrow = (row-boxr); lrow <= (row+boxr); ++lrow){
+                    for(auto lcol = (col-boxr); lcol <= (col+boxr); ++lcol){
+                        //Check if the coordinates are legal.
+                        if( isininc(0,lrow,tsv.rows-1) 
+                        &&  isininc(0,lcol,tsv.columns-1) ){ 
+                            const auto *c = tsv.time_course(0, lrow, lcol, chan);
+                            for(long int i = 0; i < tsv.times; ++i) sums[i] += static_cast<double>(c[i]);
+                            ++N_pixs;
                         }
                     }
-                    if(in_pixs.size() < 3) continue; //Too few to bother with.
-                    const auto avg_val = Stats::Mean(in_pixs);
-                    //const auto avg_val_sigma = std::sqrt(Stats::Unbiased_Var_Est(in_pixs))/std::sqrt(1.0*in_pixs.size());
-
-                    if(auto dt = img_it->GetMetadataValueAs<double>("dt")){
-                        //channel_time_course.push_back(dt.value(), 0.0, avg_val, avg_val_sigma, InhibitSort);
-                        channel_time_course.push_back(dt.value(), 0.0, avg_val, 0.0, InhibitSort);
-                    }else{
-                        FUNCERR("Image is missing time metadata. Bailing");
-                    }
                 }
-                channel_time_course.stable_sort();
+                if(N_pixs < 3) continue; //Too few to bother with.
+
+                samples_1D<double> channel_time_course;
+                channel_time_course.uncertainties_known_to_be_independent_and_random = true;
+                for(long int i = 0; i < tsv.times; ++i){
+                    const auto avg_val = sums[i] / static_cast<double>(N_pixs);
+                    channel_time_course.push_back(t[i], 0.0, avg_val, 0.0, InhibitSort);
+                }
                 if(channel_time_course.empty()) continue;
 
                 //Keep only the requested part of the time course.
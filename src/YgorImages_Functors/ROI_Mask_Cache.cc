@@ -0,0 +1,294 @@
+//ROI_Mask_Cache.cc.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+#include "../FNV_Hash.h"
+#include "ROI_Mask_Cache.h"
+
+
+uint64_t
+ROI_Mask::count() const {
+    uint64_t N = 0;
+    for(const auto &r : this->runs) N += (r.second - r.first);
+    return N;
+}
+
+
+namespace {
+
+using mask_key_t = std::tuple< std::array<double, 15>,            // Voxel dimensions, anchor, offset, and orientation.
+                               std::array<long int, 3>,           // Rows, columns, and channels.
+                               std::array<uint64_t, 3>,           // Number of contours, number of vertices, and fingerprint.
+                               std::array<int, 2> >;              // Inclusivity and contour overlap options.
+
+mask_key_t
+make_mask_key(const planar_image<float,double> &img,
+              const ROI_Contours_Fingerprint &fp,
+              const Mutate_Voxels_Opts &opts){
+    std::array<double, 15> geom = {{ img.pxl_dx, img.pxl_dy, img.pxl_dz,
+                                     img.anchor.x, img.anchor.y, img.anchor.z,
+                                     img.offset.x, img.offset.y, img.offset.z,
+                                     img.row_unit.x, img.row_unit.y, img.row_unit.z,
+                                     img.col_unit.x, img.col_unit.y, img.col_unit.z }};
+
+    return std::make_tuple( geom,
+                            std::array<long int, 3>{{ img.rows, img.columns, img.channels }},
+                            std::array<uint64_t, 3>{{ fp.N_contours, fp.N_vertices, fp.hash }},
+                            std::array<int, 2>{{ static_cast<int>(opts.inclusivity),
+                                                 static_cast<int>(opts.contouroverlap) }} );
+}
+
+// Masks are small compared with the images they describe, but every distinct image geometry yields a distinct
+// entry, so the cache is emptied once it grows beyond this many entries.
+const size_t max_cached_masks = 16384;
+
+struct cached_mask {
+    std::shared_ptr<const std::vector<double>> content; // The contours the mask was rasterized from.
+    std::shared_ptr<const ROI_Mask> mask;
+};
+
+std::mutex mask_cache_mutex;
+std::map<mask_key_t, cached_mask> mask_cache;
+
+// Contours are compared bitwise so that the comparison is exact and consistent with the hash, even for NaNs.
+bool
+same_content(const std::shared_ptr<const std::vector<double>> &A,
+             const std::shared_ptr<const std::vector<double>> &B){
+    if(!A || !B) return false;
+    if(A == B) return true;
+    return (A->size() == B->size())
+        && (std::memcmp(A->data(), B->data(), A->size() * sizeof(double)) == 0);
+}
+
+
+// Rasterizes the contours onto a geometry-only copy of the image. Mutate_Voxels() remains the single source of truth
+// for which voxels are bounded; it is simply consulted once per geometry instead of once per operation.
+std::shared_ptr<const ROI_Mask>
+rasterize_mask(const planar_image<float,double> &img,
+               const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+               const Mutate_Voxels_Opts &in_opts){
+    planar_image<float,double> probe;
+    probe.init_orientation(img.row_unit, img.col_unit);
+    probe.init_buffer(img.rows, img.columns, img.channels);
+    probe.init_spatial(img.pxl_dx, img.pxl_dy, img.pxl_dz, img.anchor, img.offset);
+
+    Mutate_Voxels_Opts opts;
+    opts.editstyle      = Mutate_Voxels_Opts::EditStyle::InPlace;
+    opts.inclusivity    = in_opts.inclusivity;
+    opts.contouroverlap = in_opts.contouroverlap;
+    opts.aggregate      = Mutate_Voxels_Opts::Aggregate::First;
+    opts.adjacency      = Mutate_Voxels_Opts::Adjacency::SingleVoxel;
+    opts.maskmod        = Mutate_Voxels_Opts::MaskMod::Noop;
+
+    auto mask = std::make_shared<ROI_Mask>();
+    mask->rows     = img.rows;
+    mask->columns  = img.columns;
+    mask->channels = img.channels;
+
+    std::vector<uint64_t> bounded;
+    auto f_bounded = [&](long int E_row, long int E_col, long int E_chnl,
+                         std::reference_wrapper<planar_image<float,double>>, float &) -> void {
+        bounded.push_back( static_cast<uint64_t>((E_row * mask->columns + E_col) * mask->channels + E_chnl) );
+    };
+
+    auto probe_refw = std::ref(probe);
+    Mutate_Voxels<float,double>( probe_refw,
+                                 { probe_refw },
+                                 ccsl,
+                                 opts,
+                                 f_bounded );
+
+    std::sort(bounded.begin(), bounded.end());
+    for(const auto &i : bounded){
+        if(!mask->runs.empty() && (i <= mask->runs.back().second)){
+            mask->runs.back().second = std::max(mask->runs.back().second, i + 1);
+        }else{
+            mask->runs.emplace_back(i, i + 1);
+        }
+    }
+    return mask;
+}
+
+} // namespace
+
+
+ROI_Contours_Fingerprint
+Fingerprint_ROI_Contours(const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl){
+    // Contours are flattened in order, so the same contours provided in a different order produce a distinct key; this
+    // only costs an additional cache entry. Each contour is preceded by its closedness (0 or 1) and vertex count, and
+    // each collection is terminated by -1, so distinct contour sets cannot flatten to the same data.
+    ROI_Contours_Fingerprint fp;
+    auto content = std::make_shared<std::vector<double>>();
+    const auto append = [&](double x) -> void {
+        if(x == 0.0) x = 0.0; // Normalize the sign of zero, which does not affect the mask.
+        content->push_back(x);
+    };
+    for(const auto &cc_refw : ccsl){
+        for(const auto &c : cc_refw.get().contours){
+            ++fp.N_contours;
+            append(c.closed ? 1.0 : 0.0);
+            append(static_cast<double>(c.points.size()));
+            for(const auto &p : c.points){
+                append(p.x);
+                append(p.y);
+                append(p.z);
+                ++fp.N_vertices;
+            }
+        }
+        append(-1.0); // Collection boundary.
+    }
+
+    fnv1a_hash h;
+    for(const auto &x : *content) h.add(x);
+    fp.hash = h.h;
+    fp.content = content;
+    return fp;
+}
+
+
+std::shared_ptr<const ROI_Mask>
+Get_ROI_Mask(const planar_image<float,double> &img,
+             const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+             const Mutate_Voxels_Opts &opts){
+    return Get_ROI_Mask(img, ccsl, Fingerprint_ROI_Contours(ccsl), opts);
+}
+
+std::shared_ptr<const ROI_Mask>
+Get_ROI_Mask(const planar_image<float,double> &img,
+             const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+             const ROI_Contours_Fingerprint &fp,
+             const Mutate_Voxels_Opts &opts){
+    const auto key = make_mask_key(img, fp, opts);
+    {
+        std::lock_guard<std::mutex> lock(mask_cache_mutex);
+        const auto it = mask_cache.find(key);
+        if( (it != mask_cache.end())
+        &&  same_content(it->second.content, fp.content) ) return it->second.mask;
+    }
+
+    // Rasterize without holding the lock so that other images can be processed concurrently. If two threads race on the
+    // same key and contours, both produce the same mask and the first one is kept. An entry for colliding contours is
+    // replaced.
+    auto mask = rasterize_mask(img, ccsl, opts);
+    if(!fp.content) return mask;
+
+    std::lock_guard<std::mutex> lock(mask_cache_mutex);
+    if(max_cached_masks <= mask_cache.size()) mask_cache.clear();
+    auto &entry = mask_cache[key];
+    if(!same_content(entry.content, fp.content)){
+        entry.content = fp.content;
+        entry.mask = mask;
+    }
+    return entry.mask;
+}
+
+
+void
+Clear_ROI_Mask_Cache(){
+    std::lock_guard<std::mutex> lock(mask_cache_mutex);
+    mask_cache.clear();
+    return;
+}
+
+
+namespace {
+
+bool
+is_cacheable(const std::reference_wrapper<planar_image<float,double>> &img_refw,
+             const std::list<std::reference_wrapper<planar_image<float,double>>> &selected_imgs,
+             const Mutate_Voxels_Opts &opts){
+    return (selected_imgs.size() == 1)
+        && (&(selected_imgs.front().get()) == &(img_refw.get()))
+        && (opts.editstyle == Mutate_Voxels_Opts::EditStyle::InPlace)
+        && (opts.aggregate == Mutate_Voxels_Opts::Aggregate::First)
+        && (opts.adjacency == Mutate_Voxels_Opts::Adjacency::SingleVoxel)
+        && (opts.maskmod   == Mutate_Voxels_Opts::MaskMod::Noop);
+}
+
+} // namespace
+
+
+void Mutate_Voxels_Cached(
+        std::reference_wrapper<planar_image<float,double>> img_refw,
+        std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs,
+        std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+        Mutate_Voxels_Opts opts,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_bounded,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_unbounded,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_visitor ){
+
+    if(!is_cacheable(img_refw, selected_imgs, opts)){
+        Mutate_Voxels<float,double>( img_refw, selected_imgs, ccsl, opts, f_bounded, f_unbounded, f_visitor );
+        return;
+    }
+    const auto fp = Fingerprint_ROI_Contours(ccsl);
+    Mutate_Voxels_Cached( img_refw, selected_imgs, ccsl, fp, opts, f_bounded, f_unbounded, f_visitor );
+    return;
+}
+
+void Mutate_Voxels_Cached(
+        std::reference_wrapper<planar_image<float,double>> img_refw,
+        std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs,
+        std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+        const ROI_Contours_Fingerprint &fp,
+        Mutate_Voxels_Opts opts,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_bounded,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_unbounded,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_visitor ){
+
+    if(!is_cacheable(img_refw, selected_imgs, opts)){
+        Mutate_Voxels<float,double>( img_refw, selected_imgs, ccsl, opts, f_bounded, f_unbounded, f_visitor );
+        return;
+    }
+    if(!f_bounded && !f_unbounded && !f_visitor) return;
+
+    auto &img = img_refw.get();
+    const auto mask = Get_ROI_Mask(img, ccsl, fp, opts);
+
+    // Replay the mask, visiting every voxel when the unbounded or visitor functors need them.
+    const bool visit_all = (f_unbounded || f_visitor);
+    const long int N_chns = img.channels;
+    const long int N_cols = img.columns;
+    const auto apply = [&](uint64_t i, bool is_bounded) -> void {
+        const auto chan = static_cast<long int>(i % N_chns);
+        const auto col  = static_cast<long int>((i / N_chns) % N_cols);
+        const auto row  = static_cast<long int>((i / N_chns) / N_cols);
+        float &voxel_val = img.reference(row, col, chan);
+        if(is_bounded){
+            if(f_bounded) f_bounded(row, col, chan, img_refw, voxel_val);
+        }else{
+            if(f_unbounded) f_unbounded(row, col, chan, img_refw, voxel_val);
+        }
+        if(f_visitor) f_visitor(row, col, chan, img_refw, voxel_val);
+    };
+
+    const uint64_t N_voxels = static_cast<uint64_t>(img.rows * N_cols * N_chns);
+    uint64_t i = 0;
+    for(const auto &r : mask->runs){
+        if(visit_all){
+            for( ; i < r.first; ++i) apply(i, false);
+        }
+        for(i = r.first; i < r.second; ++i) apply(i, true);
+    }
+    if(visit_all){
+        for( ; i < N_voxels; ++i) apply(i, false);
+    }
+    return;
+}
+
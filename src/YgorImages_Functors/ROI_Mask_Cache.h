@@ -0,0 +1,97 @@
+//ROI_Mask_Cache.h.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+template <class T> class contour_collection;
+
+
+// The set of voxels of an image that are bounded by a contour collection, stored as half-open runs over the linear
+// voxel index ((row * columns) + column) * channels + channel.
+struct ROI_Mask {
+    long int rows     = 0;
+    long int columns  = 0;
+    long int channels = 0;
+
+    std::vector<std::pair<uint64_t, uint64_t>> runs; // Ascending and non-overlapping.
+
+    uint64_t count() const;
+};
+
+
+// A summary of the content of a set of contour collections, used to key cached masks. Computing it visits every
+// vertex, so callers that apply the same contours to many images should compute it once and reuse it. A fingerprint
+// must only be used with the contours it was computed from, and only while they remain unaltered.
+struct ROI_Contours_Fingerprint {
+    uint64_t N_contours = 0;
+    uint64_t N_vertices = 0;
+    uint64_t hash = 0;
+
+    // A flattened copy of the contour data. Cached masks are only returned when this matches exactly, so hash
+    // collisions cannot alias distinct contours. Copies of a fingerprint share it, which makes the check trivial when
+    // the same fingerprint is reused across images.
+    std::shared_ptr<const std::vector<double>> content;
+};
+
+ROI_Contours_Fingerprint
+Fingerprint_ROI_Contours(const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl);
+
+
+// Returns the mask of voxels that Mutate_Voxels() would treat as bounded for the given image geometry, contours, and
+// options. Only the 'inclusivity' and 'contouroverlap' options affect the mask.
+//
+// Masks are cached process-wide and keyed on the image geometry (orientation, position, voxel dimensions, and number of
+// rows, columns, and channels), a hash of the contours, and the relevant options. Pixel values and metadata are not part
+// of the key. On a hit, the contours are compared against those the mask was rasterized from, so altered or colliding
+// contours are rasterized anew; stale entries are never returned.
+std::shared_ptr<const ROI_Mask>
+Get_ROI_Mask(const planar_image<float,double> &img,
+             const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+             const Mutate_Voxels_Opts &opts);
+
+std::shared_ptr<const ROI_Mask>
+Get_ROI_Mask(const planar_image<float,double> &img,
+             const std::list<std::reference_wrapper<contour_collection<double>>> &ccsl,
+             const ROI_Contours_Fingerprint &fp,
+             const Mutate_Voxels_Opts &opts);
+
+// Drops all cached masks. The operation dispatcher calls this when the outermost run begins and ends.
+void Clear_ROI_Mask_Cache();
+
+
+// A drop-in replacement for Mutate_Voxels() that reuses cached masks.
+//
+// The cache is only used when the image is the only selected image and the options are in-place, single-voxel, and
+// unmodified (i.e., EditStyle::InPlace, Aggregate::First, Adjacency::SingleVoxel, and MaskMod::Noop), which covers most
+// callers. Otherwise the call is forwarded to Mutate_Voxels() unaltered. Voxels are visited in row, column, channel
+// order.
+void Mutate_Voxels_Cached(
+        std::reference_wrapper<planar_image<float,double>> img_refw,
+        std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs,
+        std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+        Mutate_Voxels_Opts opts,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_bounded,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_unbounded = nullptr,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_visitor = nullptr );
+
+// As above, but reuses a fingerprint of the contours computed with Fingerprint_ROI_Contours().
+void Mutate_Voxels_Cached(
+        std::reference_wrapper<planar_image<float,double>> img_refw,
+        std::list<std::reference_wrapper<planar_image<float,double>>> selected_imgs,
+        std::list<std::reference_wrapper<contour_collection<double>>> ccsl,
+        const ROI_Contours_Fingerprint &fp,
+        Mutate_Voxels_Opts opts,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_bounded,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_unbounded = nullptr,
+        std::function<void(long int, long int, long int, std::reference_wrapper<planar_image<float,double>>, float &)> f_visitor = nullptr );
+
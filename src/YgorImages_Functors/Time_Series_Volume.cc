@@ -0,0 +1,108 @@
+//Time_Series_Volume.cc.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <list>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+#include "YgorMisc.h"
+
+#include "../Thread_Pool.h"
+#include "Time_Series_Volume.h"
+
+
+Time_Series_Volume::Time_Series_Volume(const std::list<img_it_t> &in_imgs){
+    if(in_imgs.empty()) return;
+
+    const auto &first = *(in_imgs.front());
+    this->rows     = first.rows;
+    this->columns  = first.columns;
+    this->channels = first.channels;
+    const auto ortho = first.row_unit.Cross( first.col_unit ).unit();
+    // Spatially-overlapping images (see GroupSpatiallyOverlappingImages) are offset by less than half a slice.
+    const double slice_tol = (0.0 < first.pxl_dz) ? 0.5 * first.pxl_dz : 1.0E-3;
+
+    //Parse the time metadata once and note each image's position along the image normal.
+    struct entry {
+        img_it_t img_it;
+        double dt;
+        double pos;
+        size_t order;
+    };
+    std::vector<entry> entries;
+    entries.reserve(in_imgs.size());
+    for(const auto &img_it : in_imgs){
+        if( (img_it->rows != this->rows)
+        ||  (img_it->columns != this->columns)
+        ||  (img_it->channels != this->channels) ){
+            throw std::invalid_argument("Images have differing number of rows, columns, or channels. Cannot continue.");
+        }
+        const auto dt = img_it->GetMetadataValueAs<double>("dt");
+        if(!dt){
+            throw std::invalid_argument("Image is missing time metadata. Cannot continue.");
+        }
+        entries.push_back({ img_it, dt.value(), img_it->center().Dot(ortho), entries.size() });
+    }
+
+    //Group into slices along the image normal.
+    std::stable_sort(entries.begin(), entries.end(), [](const entry &a, const entry &b){ return a.pos < b.pos; });
+    std::vector<size_t> slice_begins = { 0 };
+    for(size_t i = 1; i < entries.size(); ++i){
+        if(slice_tol < std::abs(entries[i].pos - entries[slice_begins.back()].pos)) slice_begins.push_back(i);
+    }
+    slice_begins.push_back(entries.size());
+
+    this->slices = static_cast<long int>(slice_begins.size() - 1);
+    this->times  = static_cast<long int>(slice_begins[1] - slice_begins[0]);
+    for(long int z = 0; z < this->slices; ++z){
+        const auto b = std::next(entries.begin(), slice_begins[z]);
+        const auto e = std::next(entries.begin(), slice_begins[z + 1]);
+        if(std::distance(b, e) != this->times){
+            throw std::invalid_argument("Slices contain differing numbers of images. Cannot continue.");
+        }
+        std::sort(b, e, [](const entry &l, const entry &r){
+            return std::tie(l.dt, l.order) < std::tie(r.dt, r.order);
+        });
+        for(auto it = b; it != e; ++it){
+            this->t.push_back(it->dt);
+            this->imgs.push_back(it->img_it);
+        }
+    }
+
+    //Transpose the voxel values so that time is the fastest-varying index.
+    this->data.resize( static_cast<size_t>(this->times * this->slices * this->rows * this->columns * this->channels) );
+    parallel_for(0, static_cast<size_t>(this->slices * this->rows), [&](size_t zr) -> void {
+        const auto z   = static_cast<long int>(zr) / this->rows;
+        const auto row = static_cast<long int>(zr) % this->rows;
+        for(long int tn = 0; tn < this->times; ++tn){
+            const auto &img = *(this->image(tn, z));
+            for(long int col = 0; col < this->columns; ++col){
+                for(long int chan = 0; chan < this->channels; ++chan){
+                    this->data[ this->index(z, row, col, chan) + tn ] = img.value(row, col, chan);
+                }
+            }
+        }
+    });
+}
+
+
+samples_1D<double>
+Time_Series_Volume::time_course_samples(long int z, long int row, long int column, long int channel) const {
+    const bool InhibitSort = true; // Already sorted.
+    const auto *tp = this->time_points(z);
+    const auto *c = this->time_course(z, row, column, channel);
+
+    samples_1D<double> out;
+    out.uncertainties_known_to_be_independent_and_random = true;
+    for(long int tn = 0; tn < this->times; ++tn){
+        out.push_back(tp[tn], 0.0, static_cast<double>(c[tn]), 0.0, InhibitSort);
+    }
+    return out;
+}
+
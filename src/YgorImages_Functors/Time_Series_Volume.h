@@ -0,0 +1,71 @@
+//Time_Series_Volume.h.
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+
+// A dense, read-only 4D view of a time series of images.
+//
+// Images are grouped into slices by their position along the image normal and, within each slice, ordered by their
+// 'dt' metadata, which is parsed once. Voxel values are copied into a single buffer in which time is the
+// fastest-varying index, so the time course of any voxel is a contiguous read:
+//
+//     value(t, z, row, column, channel) = data[((((z * rows) + row) * columns + column) * channels + channel) * times + t]
+//
+// Slices are ordered along the image normal. Images acquired at the same time retain their relative order.
+//
+// Every slice must contain the same number of images, and all images must have the same number of rows, columns, and
+// channels. The view is not updated if the source images are altered afterward.
+class Time_Series_Volume {
+  public:
+    using img_it_t = planar_image_collection<float,double>::images_list_it_t;
+
+    long int times    = 0;
+    long int slices   = 0;
+    long int rows     = 0;
+    long int columns  = 0;
+    long int channels = 0;
+
+    // Accepts any set of images, e.g., a group of spatially-overlapping images (which becomes a single slice) or all
+    // images in a collection.
+    explicit Time_Series_Volume(const std::list<img_it_t> &imgs);
+
+    // The acquisition times of slice z, in increasing order ('times' contiguous values).
+    const double *
+    time_points(long int z) const {
+        return &(this->t[static_cast<size_t>(z) * this->times]);
+    }
+
+    // The time course of a voxel ('times' contiguous values), ordered like time_points().
+    const float *
+    time_course(long int z, long int row, long int column, long int channel) const {
+        return &(this->data[ this->index(z, row, column, channel) ]);
+    }
+
+    // The image that supplied time point t of slice z.
+    img_it_t
+    image(long int t, long int z) const {
+        return this->imgs[static_cast<size_t>(z) * this->times + t];
+    }
+
+    // The time course of a voxel as (time, value) samples.
+    samples_1D<double> time_course_samples(long int z, long int row, long int column, long int channel) const;
+
+  private:
+    std::vector<double> t;       // Indexed as (z * times) + t.
+    std::vector<img_it_t> imgs;  // Indexed as (z * times) + t.
+    std::vector<float> data;
+
+    size_t
+    index(long int z, long int row, long int column, long int channel) const {
+        return static_cast<size_t>(((z * this->rows + row) * this->columns + column) * this->channels + channel)
+               * static_cast<size_t>(this->times);
+    }
+};
+
@@ -0,0 +1,67 @@
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "YgorMath.h"
+
+#include "doctest/doctest.h"
+
+#include "Point_Cloud_Fixtures.h"
+
+#include "Structs.h"
+#include "Alignment_Rigid.h"
+
+
+#ifdef DCMA_USE_EIGEN
+// A rigid transformation.
+static vec3<double> move(const vec3<double> &p){
+    const auto axis = vec3<double>(1.0, 2.0, 3.0).unit();
+    return p.rotate_around_unit(axis, 0.15) + vec3<double>(5.0, -3.0, 2.0);
+}
+
+TEST_CASE( "AlignViaIndexedICP" ){
+    // The clouds sample the same surface, but not at the same locations.
+    const auto moving = make_surface(1500, true);
+    auto stationary = make_surface(6000, true);
+    for(auto &p : stationary.points) p = move(p);
+
+    const auto mean_error = [&](affine_transform<double> t) -> double {
+        double sum = 0.0;
+        for(const auto &p : moving.points){
+            auto v = p;
+            t.apply_to(v);
+            sum += v.distance( move(p) );
+        }
+        return sum / static_cast<double>(moving.points.size());
+    };
+
+    AlignViaIndexedICPParams params;
+    params.max_icp_iters = 50;
+    params.f_rel_tol = 1.0E-6;
+
+    SUBCASE("point-to-point"){
+        params.metric = AlignViaIndexedICPParams::Metric::PointToPoint;
+        const auto t = AlignViaIndexedICP(params, moving, stationary);
+        REQUIRE( t );
+        REQUIRE( mean_error(t.value()) < 1.0 );
+    }
+
+    SUBCASE("point-to-plane"){
+        params.metric = AlignViaIndexedICPParams::Metric::PointToPlane;
+        const auto t = AlignViaIndexedICP(params, moving, stationary);
+        REQUIRE( t );
+        REQUIRE( mean_error(t.value()) < 0.5 );
+    }
+
+    SUBCASE("agrees with exhaustive correspondence"){
+        params.metric = AlignViaIndexedICPParams::Metric::PointToPoint;
+        const auto t_idx = AlignViaIndexedICP(params, moving, stationary);
+        const auto t_exh = AlignViaExhaustiveICP(moving, stationary, params.max_icp_iters, params.f_rel_tol);
+        REQUIRE( t_idx );
+        REQUIRE( t_exh );
+        REQUIRE( std::abs(mean_error(t_idx.value()) - mean_error(t_exh.value())) < 0.5 );
+    }
+}
+#endif // DCMA_USE_EIGEN
+
@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <utility>
 #include <iostream>
@@ -7,6 +9,8 @@
 
 #include "doctest/doctest.h"
 
+#include "Point_Cloud_Fixtures.h"
+
 #include "Structs.h"
 #include "Alignment_TPSRPM.h"
 
@@ -44,3 +48,115 @@ TEST_CASE( "thin_plate_spline class" ){
     }
 }
 
+
+TEST_CASE( "thin_plate_spline_field class" ){
+    // A spline with a non-trivial warp component.
+    point_set<double> ps;
+    for(long int i = 0; i < 27; ++i){
+        ps.points.emplace_back( vec3<double>( 10.0 * (i % 3), 10.0 * ((i / 3) % 3), 10.0 * (i / 9) ) );
+    }
+    thin_plate_spline tps(ps, 2);
+    for(long int i = 0; i < 27; ++i){
+        tps.W_A.coeff(i, 0) = 1.0E-3 * std::sin(1.0 * i);
+        tps.W_A.coeff(i, 1) = 1.0E-3 * std::cos(2.0 * i);
+        tps.W_A.coeff(i, 2) = 1.0E-3 * std::sin(3.0 * i);
+    }
+
+    const vec3<double> lower(-5.0, -5.0, -5.0);
+    const vec3<double> upper(25.0, 25.0, 25.0);
+    const double tol = 0.01;
+    thin_plate_spline_field field(tps, lower, upper, tol);
+    REQUIRE( field.estimated_max_error <= tol );
+
+    SUBCASE("interpolation error is bounded within the lattice"){
+        double worst = 0.0;
+        for(long int i = 0; i < 1000; ++i){
+            const vec3<double> p( -5.0 + 30.0 * std::fmod(0.618034 * i, 1.0),
+                                  -5.0 + 30.0 * std::fmod(0.414214 * i, 1.0),
+                                  -5.0 + 30.0 * std::fmod(0.732051 * i, 1.0) );
+            worst = std::max(worst, field.transform(p).distance( tps.transform(p) ));
+        }
+        REQUIRE( worst <= 2.0 * tol );
+    }
+
+    SUBCASE("lattice nodes and exterior points are exact"){
+        REQUIRE( field.transform(lower).distance( tps.transform(lower) ) < 1.0E-9 );
+        const vec3<double> outside(100.0, 0.0, 0.0);
+        REQUIRE( field.transform(outside).distance( tps.transform(outside) ) < 1.0E-9 );
+    }
+
+    SUBCASE("planar regions are supported"){
+        thin_plate_spline_field planar(tps, vec3<double>(0.0, 0.0, 5.0), vec3<double>(20.0, 20.0, 5.0), tol);
+        REQUIRE( planar.N_z == 1 );
+        const vec3<double> p(3.3, 17.1, 5.0);
+        REQUIRE( planar.transform(p).distance( tps.transform(p) ) <= 2.0 * tol );
+    }
+}
+
+
+#ifdef DCMA_USE_EIGEN
+// A smooth, non-affine deformation.
+static vec3<double> warp(const vec3<double> &p){
+    return p + vec3<double>( 3.0 * std::sin(p.y / 20.0) + 2.0,
+                             2.0 * std::cos(p.x / 25.0),
+                             1.5 * std::sin(p.z / 15.0) );
+}
+
+TEST_CASE( "AlignViaTPSRPM scalable mode" ){
+    AlignViaTPSRPMParams params;
+    params.T_end_scale = 0.1;
+    params.T_step = 0.8;
+    params.N_iters_at_fixed_T = 3;
+    params.N_nearest_neighbours = 8;
+
+    const auto mean_error = [](const thin_plate_spline &t, const point_set<double> &moving,
+                               const point_set<double> &stationary){
+        double sum = 0.0;
+        for(size_t i = 0; i < moving.points.size(); ++i){
+            sum += t.transform(moving.points[i]).distance(stationary.points[i]);
+        }
+        return sum / static_cast<double>(moving.points.size());
+    };
+
+    SUBCASE("sparse correspondence with reduced control points recovers a smooth warp"){
+        const auto moving = make_surface(300);
+        point_set<double> stationary;
+        for(const auto &p : moving.points) stationary.points.emplace_back( warp(p) );
+
+        params.N_control_points = 60;
+        params.forced_correspondence = { {0, 0}, {5, -1} };
+        params.report_final_correspondence = true;
+        auto t_opt = AlignViaTPSRPM(params, moving, stationary);
+        REQUIRE( t_opt );
+        REQUIRE( t_opt.value().control_points.points.size() == 60 );
+        REQUIRE( mean_error(t_opt.value(), moving, stationary) < 0.5 );
+        REQUIRE( params.final_move_correspondence.at(0).second == 0 );
+        REQUIRE( params.final_move_correspondence.at(5).second == 300 );
+    }
+}
+
+// A larger problem for gauging performance. It is slow, so it is skipped unless '--no-skip' is given.
+TEST_CASE( "AlignViaTPSRPM scalable mode benchmark" * doctest::skip() ){
+    AlignViaTPSRPMParams params;
+    params.T_end_scale = 0.1;
+    params.T_step = 0.8;
+    params.N_iters_at_fixed_T = 3;
+    params.N_nearest_neighbours = 8;
+    params.N_control_points = 200;
+
+    const long int N = 3000;
+    const auto moving = make_surface(N);
+    point_set<double> stationary;
+    for(const auto &p : moving.points) stationary.points.emplace_back( warp(p) );
+
+    auto t_opt = AlignViaTPSRPM(params, moving, stationary);
+    REQUIRE( t_opt );
+    REQUIRE( 0 < params.N_annealing_steps );
+
+    double sum = 0.0;
+    for(size_t i = 0; i < moving.points.size(); ++i){
+        sum += t_opt.value().transform(moving.points[i]).distance(stationary.points[i]);
+    }
+    REQUIRE( sum / static_cast<double>(moving.points.size()) < 5.0 );
+}
+#endif // DCMA_USE_EIGEN
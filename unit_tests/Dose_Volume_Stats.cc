@@ -0,0 +1,117 @@
+
+#include <cmath>
+#include <functional>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+#include "doctest/doctest.h"
+
+#include "Image_Stack_Fixtures.h"
+
+#include "Dose_Volume_Stats.h"
+
+
+// A stack of 1 mm images where voxel (r, c) of every image contains the value c.
+static planar_image_collection<float,double>
+make_ramp(long int rows, long int cols, long int imgs){
+    return make_image_stack(rows, cols, imgs, [](const vec3<double> &p){ return static_cast<float>(p.y); });
+}
+
+// An axis-aligned square contour on every image, enclosing voxel centres spanning [lo, hi] along both axes.
+static contour_collection<double>
+make_square(const planar_image_collection<float,double> &ic, double lo, double hi){
+    contour_collection<double> cc;
+    for(const auto &img : ic.images){
+        const auto z = img.position(0, 0).z;
+        contour_of_points<double> c;
+        c.closed = true;
+        c.points.emplace_back(lo - 0.5, lo - 0.5, z);
+        c.points.emplace_back(hi + 0.5, lo - 0.5, z);
+        c.points.emplace_back(hi + 0.5, hi + 0.5, z);
+        c.points.emplace_back(lo - 0.5, hi + 0.5, z);
+        cc.contours.push_back(c);
+    }
+    return cc;
+}
+
+
+TEST_CASE( "Compute_Dose_Volume_Stats" ){
+    const auto ramp = make_ramp(20, 20, 4);
+    auto cc_A = make_square(ramp, 5.0, 14.0);
+    auto cc_B = make_square(ramp, 0.0, 19.0);
+
+    SUBCASE("moments and extrema are exact"){
+        const auto stats = Compute_Dose_Volume_Stats(all_images(ramp), { { std::ref(cc_A) }, { std::ref(cc_B) } });
+        REQUIRE( stats.size() == 2 );
+        REQUIRE( stats[0].N_voxels == 10 * 10 * 4 );
+        REQUIRE( stats[0].D_min == 5.0 );
+        REQUIRE( stats[0].D_max == 14.0 );
+        REQUIRE( stats[0].Mean() == doctest::Approx(9.5) );
+        REQUIRE( stats[1].N_voxels == 20 * 20 * 4 );
+        REQUIRE( stats[1].Mean() == doctest::Approx(9.5) );
+        REQUIRE( stats[1].voxel_volume == doctest::Approx(1600.0) );
+    }
+
+    SUBCASE("histogram-derived quantities are accurate to within a bin"){
+        const auto stats = Compute_Dose_Volume_Stats(all_images(ramp), { { std::ref(cc_B) } }, 190);
+        const auto tol = stats[0].bin_width;
+        REQUIRE( std::abs(stats[0].Dx(0.5) - 10.0) <= tol );
+        REQUIRE( std::abs(stats[0].Dx(0.95) - 1.0) <= tol );
+        REQUIRE( std::abs(stats[0].Vx(9.5) - 0.5) <= 0.05 );
+        REQUIRE( stats[0].Vx(-1.0) == 1.0 );
+        REQUIRE( stats[0].Vx(19.0) == 0.0 );
+        REQUIRE( stats[0].Dx(0.0) == 19.0 );
+        REQUIRE( stats[0].Dx(1.0) == 0.0 );
+    }
+
+    SUBCASE("overlapping contours are counted once"){
+        auto cc_AB = cc_A;
+        for(const auto &c : cc_B.contours) cc_AB.contours.push_back(c);
+        const auto stats = Compute_Dose_Volume_Stats(all_images(ramp), { { std::ref(cc_AB) } });
+        REQUIRE( stats[0].N_voxels == 20 * 20 * 4 );
+    }
+
+    SUBCASE("images with identical geometry are summed"){
+        auto doubled = ramp;
+        for(const auto &img : ramp.images) doubled.images.push_back(img);
+        const auto stats = Compute_Dose_Volume_Stats(all_images(std::as_const(doubled)), { { std::ref(cc_A) } });
+        REQUIRE( stats[0].N_voxels == 10 * 10 * 4 );
+        REQUIRE( stats[0].D_max == 28.0 );
+        REQUIRE( stats[0].Mean() == doctest::Approx(19.0) );
+    }
+
+    SUBCASE("dose arrays on distinct grids are kept separate"){
+        // A second, uniform 100 Gy dose array sampled on a 2 mm grid that covers the same region.
+        const auto coarse = make_image_stack(10, 10, 4, [](const vec3<double> &){ return 100.0f; }, 2.0);
+
+        const auto stats = Compute_Dose_Volume_Stats({ all_images(ramp), all_images(coarse) }, { { std::ref(cc_B) } });
+        REQUIRE( stats.size() == 2 );
+        REQUIRE( stats[0][0].N_voxels == 20 * 20 * 4 );
+        REQUIRE( stats[0][0].Mean() == doctest::Approx(9.5) );
+        REQUIRE( stats[0][0].D_max == 19.0 );
+        REQUIRE( stats[1][0].N_voxels == 10 * 10 * 4 );
+        REQUIRE( stats[1][0].Mean() == doctest::Approx(100.0) );
+        REQUIRE( stats[1][0].D_min == 100.0 );
+
+        // Binning is shared, so voxels can be pooled across dose arrays.
+        REQUIRE( stats[0][0].bin_low == stats[1][0].bin_low );
+        REQUIRE( stats[0][0].bin_width == stats[1][0].bin_width );
+        auto pooled = stats[0][0];
+        pooled.Merge(stats[1][0]);
+        REQUIRE( pooled.N_voxels == 2000 );
+        REQUIRE( pooled.Vx(50.0) == doctest::Approx(0.2) );
+    }
+
+    SUBCASE("empty ROIs"){
+        contour_collection<double> cc_empty;
+        const auto stats = Compute_Dose_Volume_Stats(all_images(ramp), { { std::ref(cc_empty) } });
+        REQUIRE( stats[0].N_voxels == 0 );
+        REQUIRE( std::isnan(stats[0].Mean()) );
+        REQUIRE( std::isnan(stats[0].Dx(0.5)) );
+    }
+}
+
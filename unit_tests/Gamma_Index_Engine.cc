@@ -0,0 +1,127 @@
+
+#include <cmath>
+#include <limits>
+#include <list>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+#include "doctest/doctest.h"
+
+#include "Image_Stack_Fixtures.h"
+
+#include "YgorImages_Functors/Compute/Gamma_Index_Engine.h"
+
+
+TEST_CASE( "Gamma_Index_Engine" ){
+    Gamma_Index_Engine_Params params;
+    params.discrepancy_type = Gamma_Index_Engine_Params::DiscrepancyType::Difference;
+    params.DTA_threshold = 3.0;
+    params.Dis_threshold = 1.0;
+    params.search_radius = 5.0;
+    params.terminate_when_max_exceeded = false;
+
+    SUBCASE("identical volumes have zero gamma"){
+        auto ref = make_image_stack(16, 16, 8, [](const vec3<double> &p){ return static_cast<float>(p.x + 2.0 * p.y + 3.0 * p.z); });
+        Gamma_Index_Engine engine(all_images(ref), 0, params);
+        for(const auto &img : ref.images){
+            for(long int r = 0; r < img.rows; ++r){
+                const auto pos = img.position(r, 5);
+                REQUIRE( engine.evaluate(pos, img.value(r, 5, 0)) == doctest::Approx(0.0) );
+            }
+        }
+    }
+
+    SUBCASE("uniform dose difference"){
+        auto ref = make_image_stack(16, 16, 8, [](const vec3<double> &){ return 10.0f; });
+        Gamma_Index_Engine engine(all_images(ref), 0, params);
+        REQUIRE( engine.evaluate(vec3<double>(8.0, 8.0, 4.0), 10.5) == doctest::Approx(0.5) );
+        REQUIRE( engine.evaluate(vec3<double>(8.0, 7.0, 3.0), 11.5) == doctest::Approx(1.5) );
+    }
+
+    SUBCASE("spatial shift is recovered with sub-voxel interpolation"){
+        // With a linear gradient and a very strict dose criterion, gamma reduces to the distance to agreement.
+        params.Dis_threshold = 1.0E-6;
+        auto ref = make_image_stack(32, 32, 8, [](const vec3<double> &p){ return static_cast<float>(p.x); });
+        Gamma_Index_Engine engine(all_images(ref), 0, params);
+        REQUIRE( engine.evaluate(vec3<double>(10.0, 10.0, 4.0), 11.0) == doctest::Approx(1.0 / 3.0) );
+        REQUIRE( engine.evaluate(vec3<double>(10.0, 10.0, 4.0), 11.5) == doctest::Approx(1.5 / 3.0) );
+    }
+
+    SUBCASE("positions outside the reference volume are not evaluated"){
+        auto ref = make_image_stack(8, 8, 4, [](const vec3<double> &){ return 1.0f; });
+        Gamma_Index_Engine engine(all_images(ref), 0, params);
+        REQUIRE( std::isnan(engine.evaluate(vec3<double>(-5.0, 0.0, 0.0), 1.0)) );
+        REQUIRE( std::isnan(engine.evaluate(vec3<double>(0.0, 0.0, 10.0), 1.0)) );
+    }
+
+    SUBCASE("early termination"){
+        params.terminate_when_max_exceeded = true;
+        auto ref = make_image_stack(16, 16, 8, [](const vec3<double> &){ return 10.0f; });
+        Gamma_Index_Engine engine(all_images(ref), 0, params);
+        REQUIRE( engine.evaluate(vec3<double>(8.0, 8.0, 4.0), 10.5) == doctest::Approx(0.5) );
+        REQUIRE( engine.evaluate(vec3<double>(8.0, 8.0, 4.0), 12.0) == params.terminated_early );
+    }
+
+    SUBCASE("irregular grids are rejected"){
+        const auto f = [](const vec3<double> &){ return 1.0f; };
+        auto regular = make_image_stack(8, 8, 4, f);
+        REQUIRE( Gamma_Index_Engine::Supports(all_images(regular)) );
+
+        // Non-uniform slice spacing.
+        auto gapped = make_image_stack(8, 8, 4, f);
+        gapped.images.back().init_spatial(1.0, 1.0, 1.0, vec3<double>(0.0, 0.0, 0.0), vec3<double>(0.0, 0.0, 3.5));
+        REQUIRE( !Gamma_Index_Engine::Supports(all_images(gapped)) );
+        REQUIRE_THROWS( Gamma_Index_Engine(all_images(gapped), 0, params) );
+
+        // Misaligned slice origin.
+        auto shifted = make_image_stack(8, 8, 4, f);
+        shifted.images.back().init_spatial(1.0, 1.0, 1.0, vec3<double>(0.0, 0.0, 0.0), vec3<double>(0.5, 0.0, 3.0));
+        REQUIRE( !Gamma_Index_Engine::Supports(all_images(shifted)) );
+
+        // Differing voxel dimensions.
+        auto resized = make_image_stack(8, 8, 4, f);
+        resized.images.back().init_spatial(1.1, 1.0, 1.0, vec3<double>(0.0, 0.0, 0.0), vec3<double>(0.0, 0.0, 3.0));
+        REQUIRE( !Gamma_Index_Engine::Supports(all_images(resized)) );
+
+        // Differing orientation.
+        auto rotated = make_image_stack(8, 8, 4, f);
+        rotated.images.back().init_orientation( vec3<double>(0.0, 1.0, 0.0), vec3<double>(-1.0, 0.0, 0.0) );
+        REQUIRE( !Gamma_Index_Engine::Supports(all_images(rotated)) );
+    }
+}
+
+// A 3%/3mm comparison of a smooth dose distribution against a slightly shifted copy, for gauging performance. It is
+// slow, so it is skipped unless '--no-skip' is given.
+TEST_CASE( "Gamma_Index_Engine benchmark" * doctest::skip() ){
+    Gamma_Index_Engine_Params params;
+    params.discrepancy_type = Gamma_Index_Engine_Params::DiscrepancyType::Relative;
+    params.DTA_threshold = 3.0;
+    params.Dis_threshold = 0.03;
+    params.search_radius = 5.0;
+    params.terminate_when_max_exceeded = true;
+
+    const auto dose = [](const vec3<double> &p){
+        const auto d = p - vec3<double>(32.0, 32.0, 16.0);
+        return static_cast<float>( 2.0 + std::exp( -d.Dot(d) / 400.0 ) );
+    };
+    auto ref = make_image_stack(64, 64, 32, dose);
+    Gamma_Index_Engine engine(all_images(ref), 0, params);
+
+    long int N = 0;
+    long int passed = 0;
+    for(const auto &img : ref.images){
+        for(long int r = 0; r < img.rows; ++r){
+            for(long int c = 0; c < img.columns; ++c){
+                const auto pos = img.position(r, c);
+                const auto gamma = engine.evaluate(pos, dose(pos + vec3<double>(0.7, 0.0, 0.0)));
+                if(std::isfinite(gamma)){
+                    ++N;
+                    if(gamma < 1.0) ++passed;
+                }
+            }
+        }
+    }
+    REQUIRE( 0 < N );
+    REQUIRE( passed == N );
+}
@@ -0,0 +1,48 @@
+//Image_Stack_Fixtures.h - Shared image fixtures for unit tests.
+
+#pragma once
+
+#include <functional>
+#include <list>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+
+// Generate a rectilinear stack of axial, single-channel images with 1 mm slices starting at the origin. In-plane voxels
+// have the given size. Voxel values are given by the provided function of position.
+inline planar_image_collection<float,double>
+make_image_stack(long int rows, long int cols, long int imgs,
+                 const std::function<float(const vec3<double> &)> &f,
+                 double pxl_dxy = 1.0){
+    planar_image_collection<float,double> out;
+    for(long int k = 0; k < imgs; ++k){
+        out.images.emplace_back();
+        auto &img = out.images.back();
+        img.init_orientation( vec3<double>(1.0, 0.0, 0.0), vec3<double>(0.0, 1.0, 0.0) );
+        img.init_buffer(rows, cols, 1);
+        img.init_spatial(pxl_dxy, pxl_dxy, 1.0, vec3<double>(0.0, 0.0, 0.0), vec3<double>(0.0, 0.0, static_cast<double>(k)));
+        for(long int r = 0; r < rows; ++r){
+            for(long int c = 0; c < cols; ++c){
+                img.reference(r, c, 0) = f( img.position(r, c) );
+            }
+        }
+    }
+    return out;
+}
+
+// References to every image in a collection, for routines that accept lists of images.
+inline std::list<std::reference_wrapper<planar_image<float,double>>>
+all_images(planar_image_collection<float,double> &ic){
+    std::list<std::reference_wrapper<planar_image<float,double>>> out;
+    for(auto &img : ic.images) out.push_back( std::ref(img) );
+    return out;
+}
+
+inline std::list<std::reference_wrapper<const planar_image<float,double>>>
+all_images(const planar_image_collection<float,double> &ic){
+    std::list<std::reference_wrapper<const planar_image<float,double>>> out;
+    for(const auto &img : ic.images) out.push_back( std::cref(img) );
+    return out;
+}
+
@@ -0,0 +1,62 @@
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "PACS_Content_Hash.h"
+
+
+TEST_CASE( "PACS_Find_Stored_Duplicate" ){
+    const auto dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir / "store");
+
+    const auto write = [&](const std::string &name, const std::string &contents) -> std::string {
+        const auto p = (dir / name).string();
+        std::ofstream(p, std::ios::out | std::ios::binary) << contents;
+        return p;
+    };
+
+    // Two byte-identical files in the store, an identical incoming file, and a same-sized file that differs.
+    const auto stored_A = write("store/A.dcm", "identical contents");
+    const auto stored_B = write("store/B.dcm", "identical contents");
+    const auto incoming = write("incoming.dcm", "identical contents");
+    const auto differs  = write("differs.dcm", "different contents");
+
+    SUBCASE("a stored file is never matched against its identical twin"){
+        for(const auto &candidates : { std::vector<std::string>{ stored_A, stored_B },
+                                       std::vector<std::string>{ stored_B, stored_A } }){
+            for(const auto &f : { stored_A, stored_B }){
+                const auto m = PACS_Find_Stored_Duplicate(f, candidates);
+                REQUIRE( m.is_stored_file );
+                REQUIRE( m.stored_file.empty() );
+            }
+        }
+    }
+
+    SUBCASE("a stored file reached via another path is recognized"){
+        const auto indirect = (dir / "store" / "." / ".." / "store" / "A.dcm").string();
+        const auto m = PACS_Find_Stored_Duplicate(indirect, { stored_B, stored_A });
+        REQUIRE( m.is_stored_file );
+        REQUIRE( m.stored_file.empty() );
+    }
+
+    SUBCASE("an identical file outside the store is matched"){
+        const auto m = PACS_Find_Stored_Duplicate(incoming, { stored_A, stored_B });
+        REQUIRE( !m.is_stored_file );
+        REQUIRE( m.stored_file == stored_A );
+    }
+
+    SUBCASE("differing files are reported and not matched"){
+        std::vector<std::string> mismatches;
+        const auto m = PACS_Find_Stored_Duplicate(differs, { stored_A, stored_B },
+                                                  [&](const std::string &s){ mismatches.push_back(s); });
+        REQUIRE( !m.is_stored_file );
+        REQUIRE( m.stored_file.empty() );
+        REQUIRE( mismatches.size() == 2 );
+    }
+
+    boost::filesystem::remove_all(dir);
+}
+
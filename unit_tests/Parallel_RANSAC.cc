@@ -0,0 +1,132 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "Parallel_RANSAC.h"
+
+
+namespace {
+
+// A line y = a*x + b, along with the trial that produced it.
+struct line_model {
+    long int trial = -1;
+    double a = 0.0;
+    double b = 0.0;
+};
+
+// Points along y = 2x + 1 with small noise, mixed with uniformly-distributed outliers.
+std::vector<std::pair<double,double>>
+make_points(){
+    std::mt19937 re(1);
+    std::uniform_real_distribution<double> ud(-10.0, 10.0);
+    std::normal_distribution<double> nd(0.0, 0.05);
+    std::vector<std::pair<double,double>> out;
+    for(long int i = 0; i < 200; ++i){
+        const auto x = ud(re);
+        out.emplace_back(x, (i % 3 == 0) ? 3.0 * ud(re) : 2.0 * x + 1.0 + nd(re));
+    }
+    return out;
+}
+
+struct ransac_outcome {
+    std::optional<std::pair<line_model, double>> best;
+    std::set<long int> abandoned;
+};
+
+// Fits a line through two randomly-selected points and scores it with a truncated quadratic loss. The partial score
+// can only increase as points are visited, so the trial is abandoned as soon as it exceeds the best score so far.
+ransac_outcome
+fit_line(const std::vector<std::pair<double,double>> &pts, const Parallel_RANSAC_Params &params, bool allow_abandon){
+    ransac_outcome out;
+    std::mutex m;
+    out.best = Parallel_RANSAC<line_model>(params, [&](Parallel_RANSAC_Trial<line_model> &t)
+                                                  -> std::optional<std::pair<line_model, double>> {
+        std::uniform_int_distribution<size_t> ud(0, pts.size() - 1);
+        const auto &P = pts[ud(t.re)];
+        const auto &Q = pts[ud(t.re)];
+        if(std::abs(Q.first - P.first) < 1.0E-6) return std::nullopt;
+
+        line_model l;
+        l.trial = t.trial;
+        l.a = (Q.second - P.second) / (Q.first - P.first);
+        l.b = P.second - l.a * P.first;
+
+        double score = 0.0;
+        for(const auto &p : pts){
+            const auto r = p.second - (l.a * p.first + l.b);
+            score += std::min(r * r, 1.0);
+            if(allow_abandon && t.can_abandon(score)){
+                std::lock_guard<std::mutex> lock(m);
+                out.abandoned.insert(t.trial);
+                return std::make_pair(l, std::numeric_limits<double>::infinity());
+            }
+        }
+        return std::make_pair(l, score);
+    });
+    return out;
+}
+
+} // namespace
+
+
+TEST_CASE( "Parallel_RANSAC" ){
+    const auto pts = make_points();
+
+    Parallel_RANSAC_Params params;
+    params.random_seed = 123;
+    params.max_trials = 300;
+    params.max_failures = 300;
+
+    // Without abandonment, every trial is scored fully, so this is the reference result.
+    params.batch_size = 1;
+    params.max_concurrency = 1;
+    const auto ref = fit_line(pts, params, false);
+    REQUIRE( ref.best );
+    REQUIRE( ref.abandoned.empty() );
+    REQUIRE( ref.best->first.a == doctest::Approx(2.0).epsilon(0.05) );
+
+    SUBCASE("the result does not depend on the number of threads or the batch size"){
+        size_t N_abandoned = 0;
+        for(const long int max_concurrency : { 1L, 2L, 3L, 0L }){
+            for(const long int batch_size : { 1L, 5L, 32L, 1000L }){
+                params.max_concurrency = max_concurrency;
+                params.batch_size = batch_size;
+                const auto res = fit_line(pts, params, true);
+                REQUIRE( res.best );
+                REQUIRE( res.best->first.trial == ref.best->first.trial );
+                REQUIRE( res.best->first.a == ref.best->first.a );
+                REQUIRE( res.best->first.b == ref.best->first.b );
+                REQUIRE( res.best->second == ref.best->second );
+
+                // An abandoned trial is never selected.
+                REQUIRE( res.abandoned.count(res.best->first.trial) == 0 );
+                N_abandoned += res.abandoned.size();
+            }
+        }
+        REQUIRE( 0 < N_abandoned );
+    }
+
+    SUBCASE("early termination keeps the first acceptable model"){
+        params.acceptable_score = ref.best->second * 1.5;
+        params.batch_size = 10;
+        for(const long int max_concurrency : { 1L, 4L, 0L }){
+            params.max_concurrency = max_concurrency;
+            const auto A = fit_line(pts, params, false);
+            const auto B = fit_line(pts, params, true);
+            REQUIRE( A.best );
+            REQUIRE( B.best );
+            REQUIRE( A.best->first.trial == B.best->first.trial );
+            REQUIRE( A.best->second == B.best->second );
+            REQUIRE( A.best->second <= params.acceptable_score );
+        }
+    }
+}
+
@@ -0,0 +1,33 @@
+//Point_Cloud_Fixtures.h - Shared point cloud fixtures for unit tests.
+
+#pragma once
+
+#include <cmath>
+
+#include "YgorMath.h"
+
+#include "Structs.h"
+
+
+// A lumpy, asymmetric closed surface sampled with approximately uniform density. If requested, the surface is also
+// skewed along every axis so the principal axes have an unambiguous orientation.
+inline point_set<double>
+make_surface(long int N, bool skewed = false){
+    const double pi = 3.141592653;
+    const double golden_angle = pi * (3.0 - std::sqrt(5.0));
+    point_set<double> ps;
+    for(long int i = 0; i < N; ++i){
+        const double z = 1.0 - 2.0 * (static_cast<double>(i) + 0.5) / static_cast<double>(N);
+        const double r = std::sqrt(1.0 - z * z);
+        const double theta = golden_angle * static_cast<double>(i);
+        const double bump = 1.0 + 0.15 * std::sin(3.0 * theta) * r;
+        vec3<double> p( 60.0 * bump * r * std::cos(theta),
+                        40.0 * bump * r * std::sin(theta),
+                        25.0 * z );
+        if(skewed){
+            p = p + vec3<double>( 0.004 * p.x * p.x, 0.006 * p.y * p.y, 0.01 * p.z * p.z );
+        }
+        ps.points.emplace_back( p );
+    }
+    return ps;
+}
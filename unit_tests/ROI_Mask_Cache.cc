@@ -0,0 +1,74 @@
+#include <functional>
+#include <list>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+#include "doctest/doctest.h"
+
+#include "YgorImages_Functors/ROI_Mask_Cache.h"
+
+
+// A 4x4 square contour bounding voxel centres [2, 5] along y and [2, 5] along x, or [-5, -2] when mirrored across x = 0.
+static contour_collection<double>
+make_square(double x_sign){
+    contour_collection<double> cc;
+    contour_of_points<double> c;
+    c.closed = true;
+    c.points.emplace_back(x_sign * 1.5, 1.5, 0.0);
+    c.points.emplace_back(x_sign * 5.5, 1.5, 0.0);
+    c.points.emplace_back(x_sign * 5.5, 5.5, 0.0);
+    c.points.emplace_back(x_sign * 1.5, 5.5, 0.0);
+    cc.contours.push_back(c);
+    return cc;
+}
+
+
+TEST_CASE( "Get_ROI_Mask" ){
+    // Voxel centres span [-10, 9] along x and y.
+    planar_image<float,double> img;
+    img.init_orientation( vec3<double>(1.0, 0.0, 0.0), vec3<double>(0.0, 1.0, 0.0) );
+    img.init_buffer(20, 20, 1);
+    img.init_spatial(1.0, 1.0, 1.0, vec3<double>(0.0, 0.0, 0.0), vec3<double>(-10.0, -10.0, 0.0));
+
+    // Mirror images across x = 0. With an even number of vertices, only the sign bits of an even number of words differ.
+    auto cc_L = make_square(-1.0);
+    auto cc_R = make_square(1.0);
+    const std::list<std::reference_wrapper<contour_collection<double>>> ccsl_L = { std::ref(cc_L) };
+    const std::list<std::reference_wrapper<contour_collection<double>>> ccsl_R = { std::ref(cc_R) };
+
+    Mutate_Voxels_Opts opts;
+    opts.inclusivity = Mutate_Voxels_Opts::Inclusivity::Centre;
+    opts.contouroverlap = Mutate_Voxels_Opts::ContourOverlap::Ignore;
+
+    Clear_ROI_Mask_Cache();
+    const auto fp_L = Fingerprint_ROI_Contours(ccsl_L);
+    const auto fp_R = Fingerprint_ROI_Contours(ccsl_R);
+    REQUIRE( fp_L.hash != fp_R.hash );
+
+    SUBCASE("mirrored contours yield distinct masks"){
+        const auto mask_L = Get_ROI_Mask(img, ccsl_L, fp_L, opts);
+        const auto mask_R = Get_ROI_Mask(img, ccsl_R, fp_R, opts);
+        REQUIRE( mask_L->count() == 16 );
+        REQUIRE( mask_R->count() == 16 );
+        REQUIRE( mask_L->runs != mask_R->runs );
+
+        // The cached masks are reused.
+        REQUIRE( Get_ROI_Mask(img, ccsl_L, opts) == mask_L );
+        REQUIRE( Get_ROI_Mask(img, ccsl_R, opts) == mask_R );
+    }
+
+    SUBCASE("a colliding hash does not alias the cached mask"){
+        const auto mask_L = Get_ROI_Mask(img, ccsl_L, fp_L, opts);
+
+        auto fp_collide = fp_R;
+        fp_collide.hash = fp_L.hash;
+        const auto mask_R = Get_ROI_Mask(img, ccsl_R, fp_collide, opts);
+        REQUIRE( mask_R->count() == 16 );
+        REQUIRE( mask_L->runs != mask_R->runs );
+        REQUIRE( Get_ROI_Mask(img, ccsl_R, fp_R, opts)->runs == mask_R->runs );
+    }
+
+    Clear_ROI_Mask_Cache();
+}
+
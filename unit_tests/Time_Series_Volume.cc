@@ -0,0 +1,57 @@
+
+#include <list>
+#include <string>
+
+#include "YgorImages.h"
+#include "YgorMath.h"
+
+#include "doctest/doctest.h"
+
+#include "YgorImages_Functors/Time_Series_Volume.h"
+
+
+TEST_CASE( "Time_Series_Volume" ){
+    // Two slices, each with three time points provided out of temporal order.
+    planar_image_collection<float,double> ic;
+    for(const double dt : { 20.0, 0.0, 10.0 }){
+        for(long int z = 0; z < 2; ++z){
+            ic.images.emplace_back();
+            auto &img = ic.images.back();
+            img.init_orientation( vec3<double>(1.0, 0.0, 0.0), vec3<double>(0.0, 1.0, 0.0) );
+            img.init_buffer(3, 4, 2);
+            img.init_spatial(1.0, 1.0, 1.0, vec3<double>(0.0, 0.0, 0.0), vec3<double>(0.0, 0.0, 1.0 - static_cast<double>(z)));
+            img.metadata["dt"] = std::to_string(dt);
+            for(long int r = 0; r < 3; ++r){
+                for(long int c = 0; c < 4; ++c){
+                    for(long int ch = 0; ch < 2; ++ch){
+                        img.reference(r, c, ch) = static_cast<float>(1000.0 * dt + 100.0 * (1.0 - z) + 10.0 * r + c + 0.5 * ch);
+                    }
+                }
+            }
+        }
+    }
+
+    const Time_Series_Volume tsv(ic.get_all_images());
+    REQUIRE( tsv.times == 3 );
+    REQUIRE( tsv.slices == 2 );
+    REQUIRE( tsv.rows == 3 );
+    REQUIRE( tsv.columns == 4 );
+    REQUIRE( tsv.channels == 2 );
+
+    for(long int z = 0; z < 2; ++z){
+        // Slices are ordered along the image normal.
+        REQUIRE( tsv.image(0, z)->center().z == doctest::Approx(static_cast<double>(z)) );
+
+        const double *t = tsv.time_points(z);
+        REQUIRE( t[0] == doctest::Approx(0.0) );
+        REQUIRE( t[1] == doctest::Approx(10.0) );
+        REQUIRE( t[2] == doctest::Approx(20.0) );
+
+        const float *c = tsv.time_course(z, 2, 3, 1);
+        for(long int i = 0; i < 3; ++i){
+            REQUIRE( c[i] == doctest::Approx(1000.0 * t[i] + 100.0 * z + 23.5) );
+        }
+        REQUIRE( tsv.time_course_samples(z, 2, 3, 1).size() == 3 );
+    }
+}
+
@@ -0,0 +1,85 @@
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+#include "YgorImages_Functors/Compute/Volumetric_Convolution_FFT.h"
+
+
+// Direct evaluation, mirroring the voxel-triplet implementation in the ConvolveImages operation.
+static float
+direct_convolution(const std::vector<float> &v, long int R, long int C, long int I,
+                   const std::vector<float> &k, long int kr, long int kc, long int ki,
+                   ComputeVolumetricConvolutionFFTUserData::Operation op,
+                   long int i, long int r, long int c){
+    const bool is_conv = (op == ComputeVolumetricConvolutionFFTUserData::Operation::Convolution);
+    const bool is_mtch = (op == ComputeVolumetricConvolutionFFTUserData::Operation::PatternMatch);
+    const long int s = is_conv ? -1 : 1;
+    double inner = 0.0;
+    float dist = 0.0;
+    for(long int a = 0; a < kr; ++a){
+        for(long int b = 0; b < kc; ++b){
+            for(long int e = 0; e < ki; ++e){
+                const auto rr = r + s * (a - kr / 2);
+                const auto cc = c + s * (b - kc / 2);
+                const auto ii = i + s * (e - ki / 2);
+                float val = std::numeric_limits<float>::quiet_NaN();
+                if( (0 <= rr) && (rr < R) && (0 <= cc) && (cc < C) && (0 <= ii) && (ii < I) ){
+                    val = v[(ii * R + rr) * C + cc];
+                }
+                const auto kv = k[(e * kr + a) * kc + b];
+                inner = inner + kv * val;
+                dist += std::pow(val - kv, 2.0);
+            }
+        }
+    }
+    return is_mtch ? std::sqrt(dist) : static_cast<float>(inner);
+}
+
+
+TEST_CASE( "Convolve_Dense_Volume_FFT" ){
+    using op_t = ComputeVolumetricConvolutionFFTUserData::Operation;
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<float> U(-1.0f, 1.0f);
+
+    // Odd- and even-sized kernels, including kernels larger than a block and volumes containing a NaN.
+    const std::vector<std::array<long int, 6>> shapes = {{ {{ 12, 9, 5, 3, 3, 3 }},
+                                                           {{ 20, 17, 7, 4, 5, 2 }},
+                                                           {{ 40, 36, 3, 35, 2, 1 }},
+                                                           {{ 6, 6, 4, 1, 1, 1 }} }};
+    for(const auto &s : shapes){
+        const auto R = s[0], C = s[1], I = s[2], kr = s[3], kc = s[4], ki = s[5];
+        std::vector<float> v(R * C * I), k(kr * kc * ki);
+        for(auto &x : v) x = U(gen);
+        for(auto &x : k) x = U(gen);
+        v[v.size() / 2] = std::numeric_limits<float>::quiet_NaN();
+
+        for(const auto op : { op_t::Convolution, op_t::Correlation, op_t::PatternMatch }){
+            const auto out = Convolve_Dense_Volume_FFT(v, R, C, I, k, kr, kc, ki, op);
+            for(long int i = 0; i < I; ++i){
+                for(long int r = 0; r < R; ++r){
+                    for(long int c = 0; c < C; ++c){
+                        const auto expected = direct_convolution(v, R, C, I, k, kr, kc, ki, op, i, r, c);
+                        const auto got = out[(i * R + r) * C + c];
+                        REQUIRE( std::isnan(expected) == std::isnan(got) );
+                        if(!std::isnan(expected)) REQUIRE( got == doctest::Approx(expected).epsilon(1.0E-4) );
+                    }
+                }
+            }
+        }
+    }
+
+    SUBCASE("only requested voxels are computed"){
+        const long int R = 10, C = 10, I = 3;
+        std::vector<float> v(R * C * I, 1.0f), k(3 * 3 * 1, 1.0f);
+        std::vector<unsigned char> needed(v.size(), 0);
+        needed[(1 * R + 5) * C + 5] = 1;
+        const auto out = Convolve_Dense_Volume_FFT(v, R, C, I, k, 3, 3, 1, op_t::Correlation, &needed);
+        REQUIRE( out[(1 * R + 5) * C + 5] == doctest::Approx(9.0) );
+        REQUIRE( std::isnan(out[(1 * R + 4) * C + 4]) );
+    }
+}
+
@@ -24,11 +24,29 @@ if [ ! -f doctest/doctest.h ] ; then
 fi
 
 g++ -std=c++17 -Wall -I. -I"${REPOROOT}/src" \
+  -DDCMA_USE_EIGEN \
+  -DDCMA_USE_POSTGRES \
   Main.cc \
   {,"${REPOROOT}/src/"}Alignment_TPSRPM.cc \
+  {,"${REPOROOT}/src/"}Alignment_Rigid.cc \
+  Gamma_Index_Engine.cc \
+  "${REPOROOT}/src/YgorImages_Functors/Compute/Gamma_Index_Engine.cc" \
+  Volumetric_Convolution_FFT.cc \
+  "${REPOROOT}/src/YgorImages_Functors/Compute/Volumetric_Convolution_FFT.cc" \
+  ROI_Mask_Cache.cc \
+  "${REPOROOT}/src/YgorImages_Functors/ROI_Mask_Cache.cc" \
+  Time_Series_Volume.cc \
+  "${REPOROOT}/src/YgorImages_Functors/Time_Series_Volume.cc" \
+  "${REPOROOT}/src/YgorImages_Functors/ConvenienceRoutines.cc" \
+  Dose_Volume_Stats.cc \
+  "${REPOROOT}/src/Dose_Volume_Stats.cc" \
+  {,"${REPOROOT}/src/"}PACS_Content_Hash.cc \
+  Parallel_RANSAC.cc \
   -o run_tests \
   -pthread \
   -lboost_system \
+  -lboost_filesystem \
+  -lpqxx \
   -lygor
 
 ./run_tests #--success